@@ -0,0 +1,568 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+/*
+Benchmarks of the CPU cost of the most common commands and the bandwidth of the transfers.
+
+Usage: jd3d12_benchmarks [--output <file.json>] [--quick] [--adapter <index>]
+
+Results are printed as JSON to the standard output, or written to the file given with --output, so they can be
+compared between versions of the library. --quick runs far fewer iterations, to check that everything works.
+Times are measured on the CPU with std::chrono::steady_clock. Bandwidths include waiting for the GPU to finish.
+*/
+
+#include <jd3d12/jd3d12.hpp>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+
+using namespace jd3d12;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+struct Measurement
+{
+    const char* name;
+    const char* unit;
+    double value;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    // Values are already formatted as JSON.
+    std::vector<std::pair<std::string, std::string>> params;
+    uint32_t iteration_count = 0;
+    std::vector<Measurement> measurements;
+};
+
+constexpr size_t kTotalTransferSize = 256 * kMegabyte;
+
+const char* const kEmptyShaderHlsl = R"hlsl(
+[numthreads(64, 1, 1)]
+void Main()
+{
+}
+)hlsl";
+
+// Big enough for the compilation time to be meaningful. VARIANT makes every compilation unique when needed.
+const char* const kCompiledShaderHlsl = R"hlsl(
+RWByteAddressBuffer buf : register(u0);
+
+float Hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return float(x) / 4294967296.0;
+}
+
+[numthreads(64, 1, 1)]
+void Main(uint3 dtid : SV_DispatchThreadID)
+{
+    float sum = 0.0;
+    [loop] for(uint i = 0; i < 64; ++i)
+    {
+        const float a = Hash(dtid.x * 64 + i + VARIANT);
+        sum += sin(a) * cos(a * 2.0) + sqrt(a) * exp2(-a);
+        if(sum > 100.0)
+            sum = frac(sum);
+    }
+    buf.Store(dtid.x * 4, asuint(sum));
+}
+)hlsl";
+
+std::vector<BenchmarkResult> g_results;
+bool g_quick = false;
+
+#define CHECK_RESULT(expr) \
+    do { \
+        if(const Result check_result_res = (expr); Failed(check_result_res)) \
+        { \
+            fwprintf(stderr, L"%s(%d): %s failed with 0x%08X (%s)\n", L"" __FILE__, __LINE__, L"" #expr, \
+                uint32_t(check_result_res), GetResultString(check_result_res)); \
+            exit(1); \
+        } \
+    } while(false)
+
+uint32_t GetIterationCount(uint32_t count)
+{
+    return g_quick ? std::max(count / 100, 2u) : count;
+}
+
+// Enough iterations to transfer kTotalTransferSize, but at least a few even for the biggest sizes.
+uint32_t GetTransferIterationCount(size_t size)
+{
+    const size_t count = std::clamp<size_t>(kTotalTransferSize / size, 4, 1000);
+    return GetIterationCount(uint32_t(count));
+}
+
+double GetSecondsSince(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+double GetGigabytesPerSecond(size_t size, uint32_t iteration_count, double seconds)
+{
+    return double(size) * iteration_count / seconds / 1e9;
+}
+
+std::string ToJsonString(const std::string& str)
+{
+    std::string result = "\"";
+    for(char ch : str)
+    {
+        if(ch == '"' || ch == '\\')
+            result += '\\';
+        if(uint8_t(ch) < 0x20)
+            continue;
+        result += ch;
+    }
+    return result + "\"";
+}
+
+std::string ToJsonString(const wchar_t* str)
+{
+    const int size = WideCharToMultiByte(CP_UTF8, 0, str, -1, nullptr, 0, nullptr, nullptr);
+    std::string utf8(size > 0 ? size_t(size) : 1, '\0');
+    if(size > 0)
+        WideCharToMultiByte(CP_UTF8, 0, str, -1, utf8.data(), size, nullptr, nullptr);
+    utf8.resize(strlen(utf8.c_str()));
+    return ToJsonString(utf8);
+}
+
+void AddResult(const char* name, std::vector<std::pair<std::string, std::string>> params, uint32_t iteration_count,
+    std::vector<Measurement> measurements)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.params = std::move(params);
+    result.iteration_count = iteration_count;
+    result.measurements = std::move(measurements);
+    fprintf(stderr, "%s", name);
+    for(const auto& [key, value] : result.params)
+        fprintf(stderr, " %s=%s", key.c_str(), value.c_str());
+    for(const Measurement& measurement : result.measurements)
+        fprintf(stderr, " %s=%.3f %s", measurement.name, measurement.value, measurement.unit);
+    fprintf(stderr, "\n");
+    g_results.push_back(std::move(result));
+}
+
+std::unique_ptr<Buffer> CreateBuffer(Device& dev, const wchar_t* name, uint32_t flags, size_t size,
+    Format element_format = Format::kUnknown)
+{
+    BufferDesc desc{};
+    desc.name = name;
+    desc.flags = flags;
+    desc.size = size;
+    desc.element_format = element_format;
+    Buffer* buf_ptr = nullptr;
+    CHECK_RESULT(dev.CreateBuffer(desc, buf_ptr));
+    return std::unique_ptr<Buffer>{ buf_ptr };
+}
+
+std::unique_ptr<Shader> CompileShader(Device& dev, const char* hlsl_source)
+{
+    const wchar_t* macro_defines[] = { L"VARIANT", L"0" };
+    ShaderCompilationParams compilation_params{};
+    compilation_params.entry_point = L"Main";
+    compilation_params.macro_defines = { macro_defines, _countof(macro_defines) };
+    ShaderDesc shader_desc{};
+    shader_desc.name = L"Benchmark shader";
+    Shader* shader_ptr = nullptr;
+    CHECK_RESULT(dev.CompileAndCreateShaderFromMemory(compilation_params, shader_desc,
+        ConstDataSpan{ hlsl_source, strlen(hlsl_source) }, shader_ptr));
+    return std::unique_ptr<Shader>{ shader_ptr };
+}
+
+void BenchmarkEmptyDispatch(Device& dev)
+{
+    std::unique_ptr<Shader> shader = CompileShader(dev, kEmptyShaderHlsl);
+    // The first dispatch also creates the pipeline state.
+    CHECK_RESULT(dev.DispatchComputeShader(*shader, { 1, 1, 1 }));
+    CHECK_RESULT(dev.WaitForGPU());
+
+    const uint32_t iteration_count = GetIterationCount(100000);
+    const Clock::time_point begin = Clock::now();
+    for(uint32_t i = 0; i < iteration_count; ++i)
+        CHECK_RESULT(dev.DispatchComputeShader(*shader, { 1, 1, 1 }));
+    const double record_seconds = GetSecondsSince(begin);
+    CHECK_RESULT(dev.WaitForGPU());
+    const double total_seconds = GetSecondsSince(begin);
+
+    AddResult("empty_dispatch", {}, iteration_count, {
+        { "cpu_time_per_dispatch", "ns", record_seconds * 1e9 / iteration_count },
+        { "throughput", "dispatches/s", iteration_count / total_seconds } });
+}
+
+/* Every iteration binds slot_count buffers, alternating between two sets, so the bindings really change, then
+dispatches. The shader doesn't declare the buffers, as only the CPU cost of the bindings is measured.
+Slots are taken in turns from CBV, SRV, and UAV, so 40 is all of them.
+*/
+void BenchmarkBindAndDispatch(Device& dev, uint32_t slot_count)
+{
+    std::unique_ptr<Shader> shader = CompileShader(dev, kEmptyShaderHlsl);
+    std::unique_ptr<Buffer> cbv_bufs[2], srv_bufs[2], uav_bufs[2];
+    for(uint32_t set_index = 0; set_index < 2; ++set_index)
+    {
+        cbv_bufs[set_index] = CreateBuffer(dev, L"Benchmark CBV", kBufferUsageFlagShaderConstant, 256);
+        srv_bufs[set_index] = CreateBuffer(dev, L"Benchmark SRV",
+            kBufferUsageFlagShaderResource | kBufferFlagByteAddress, 256);
+        uav_bufs[set_index] = CreateBuffer(dev, L"Benchmark UAV",
+            kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress, 256);
+    }
+
+    uint32_t cbv_count = 0, srv_count = 0, uav_count = 0;
+    for(uint32_t slot_index = 0; cbv_count + srv_count + uav_count < slot_count; ++slot_index)
+    {
+        if(slot_index % 3 == 0 && cbv_count < 16)
+            ++cbv_count;
+        else if(slot_index % 3 == 1 && srv_count < 16)
+            ++srv_count;
+        else if(slot_index % 3 == 2 && uav_count < 8)
+            ++uav_count;
+    }
+
+    auto bind_and_dispatch = [&](uint32_t set_index)
+    {
+        for(uint32_t slot = 0; slot < cbv_count; ++slot)
+            CHECK_RESULT(dev.BindConstantBuffer(slot, cbv_bufs[set_index].get()));
+        for(uint32_t slot = 0; slot < srv_count; ++slot)
+            CHECK_RESULT(dev.BindBuffer(slot, srv_bufs[set_index].get()));
+        for(uint32_t slot = 0; slot < uav_count; ++slot)
+            CHECK_RESULT(dev.BindRWBuffer(slot, uav_bufs[set_index].get()));
+        CHECK_RESULT(dev.DispatchComputeShader(*shader, { 1, 1, 1 }));
+    };
+    bind_and_dispatch(0);
+    CHECK_RESULT(dev.WaitForGPU());
+
+    const uint32_t iteration_count = GetIterationCount(50000);
+    const Clock::time_point begin = Clock::now();
+    for(uint32_t i = 0; i < iteration_count; ++i)
+        bind_and_dispatch(i % 2);
+    const double record_seconds = GetSecondsSince(begin);
+    CHECK_RESULT(dev.WaitForGPU());
+    const double total_seconds = GetSecondsSince(begin);
+    dev.ResetAllBindings();
+
+    AddResult("bind_and_dispatch", { { "slot_count", std::to_string(slot_count) } }, iteration_count, {
+        { "cpu_time_per_dispatch", "ns", record_seconds * 1e9 / iteration_count },
+        { "throughput", "dispatches/s", iteration_count / total_seconds } });
+}
+
+/* strategy is the name of the BufferStrategy that the library chooses for buffer_flags.
+Writes include waiting for the GPU to finish the copies. Reads of buffers without kBufferUsageFlagCpuRead go
+through ReadBufferToMemoryAsync, which copies them to a staging buffer.
+*/
+void BenchmarkTransfers(Device& dev, const char* strategy, uint32_t buffer_flags, bool write, bool read)
+{
+    const size_t sizes[] = { 4 * kKilobyte, 64 * kKilobyte, kMegabyte, 16 * kMegabyte, 64 * kMegabyte };
+    std::vector<char> memory(sizes[_countof(sizes) - 1], 1);
+    for(size_t size : sizes)
+    {
+        std::unique_ptr<Buffer> buf = CreateBuffer(dev, L"Benchmark transfer buffer", buffer_flags, size);
+        const std::vector<std::pair<std::string, std::string>> params = {
+            { "strategy", ToJsonString(strategy) }, { "size", std::to_string(size) } };
+        const uint32_t iteration_count = GetTransferIterationCount(size);
+
+        if(write)
+        {
+            CHECK_RESULT(dev.WriteMemoryToBuffer(ConstDataSpan{ memory.data(), size }, *buf, 0));
+            CHECK_RESULT(dev.WaitForGPU());
+            const Clock::time_point begin = Clock::now();
+            for(uint32_t i = 0; i < iteration_count; ++i)
+                CHECK_RESULT(dev.WriteMemoryToBuffer(ConstDataSpan{ memory.data(), size }, *buf, 0));
+            CHECK_RESULT(dev.WaitForGPU());
+            const double seconds = GetSecondsSince(begin);
+            AddResult("write_memory_to_buffer", params, iteration_count, {
+                { "time_per_write", "us", seconds * 1e6 / iteration_count },
+                { "bandwidth", "GB/s", GetGigabytesPerSecond(size, iteration_count, seconds) } });
+        }
+
+        if(read)
+        {
+            const bool cpu_read = (buffer_flags & kBufferUsageFlagCpuRead) != 0;
+            auto read_buffer = [&]()
+            {
+                if(cpu_read)
+                    CHECK_RESULT(dev.ReadBufferToMemory(*buf, Range{ 0, size }, memory.data()));
+                else
+                {
+                    ReadbackTicket ticket;
+                    CHECK_RESULT(dev.ReadBufferToMemoryAsync(*buf, Range{ 0, size }, memory.data(), ticket));
+                    CHECK_RESULT(dev.WaitForReadback(ticket));
+                }
+            };
+            read_buffer();
+            const Clock::time_point begin = Clock::now();
+            for(uint32_t i = 0; i < iteration_count; ++i)
+                read_buffer();
+            const double seconds = GetSecondsSince(begin);
+            AddResult("read_buffer_to_memory", params, iteration_count, {
+                { "time_per_read", "us", seconds * 1e6 / iteration_count },
+                { "bandwidth", "GB/s", GetGigabytesPerSecond(size, iteration_count, seconds) } });
+        }
+    }
+}
+
+void BenchmarkCopyBufferRegion(Device& dev)
+{
+    const size_t sizes[] = { 64 * kKilobyte, kMegabyte, 16 * kMegabyte, 64 * kMegabyte };
+    for(size_t size : sizes)
+    {
+        const uint32_t flags = kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst;
+        std::unique_ptr<Buffer> src_buf = CreateBuffer(dev, L"Benchmark copy source", flags, size);
+        std::unique_ptr<Buffer> dst_buf = CreateBuffer(dev, L"Benchmark copy destination", flags, size);
+        CHECK_RESULT(dev.CopyBufferRegion(*src_buf, Range{ 0, size }, *dst_buf, 0));
+        CHECK_RESULT(dev.WaitForGPU());
+
+        const uint32_t iteration_count = GetTransferIterationCount(size);
+        const Clock::time_point begin = Clock::now();
+        for(uint32_t i = 0; i < iteration_count; ++i)
+            CHECK_RESULT(dev.CopyBufferRegion(*src_buf, Range{ 0, size }, *dst_buf, 0));
+        CHECK_RESULT(dev.WaitForGPU());
+        const double seconds = GetSecondsSince(begin);
+
+        AddResult("copy_buffer_region", { { "size", std::to_string(size) } }, iteration_count, {
+            { "time_per_copy", "us", seconds * 1e6 / iteration_count },
+            { "bandwidth", "GB/s", GetGigabytesPerSecond(size, iteration_count, seconds) } });
+    }
+}
+
+// Small buffers are placed in the memory blocks of the device, big ones are committed resources.
+void BenchmarkBufferCreation(Device& dev)
+{
+    const size_t sizes[] = { 64 * kKilobyte, 64 * kMegabyte };
+    for(size_t size : sizes)
+    {
+        // Each buffer is destroyed before the next one is created, so the big ones don't run out of memory.
+        const uint32_t iteration_count = GetIterationCount(size < kMegabyte ? 1000 : 100);
+        double create_seconds = 0.0;
+        double destroy_seconds = 0.0;
+        for(uint32_t i = 0; i < iteration_count; ++i)
+        {
+            const Clock::time_point create_begin = Clock::now();
+            std::unique_ptr<Buffer> buf = CreateBuffer(dev, L"Benchmark created buffer", kBufferUsageFlagCopyDst, size);
+            const Clock::time_point destroy_begin = Clock::now();
+            buf.reset();
+            create_seconds += std::chrono::duration<double>(destroy_begin - create_begin).count();
+            destroy_seconds += GetSecondsSince(destroy_begin);
+        }
+
+        AddResult("buffer_create_destroy", { { "size", std::to_string(size) } }, iteration_count, {
+            { "create_time", "us", create_seconds * 1e6 / iteration_count },
+            { "destroy_time", "us", destroy_seconds * 1e6 / iteration_count } });
+    }
+}
+
+void BenchmarkClear(Device& dev)
+{
+    constexpr size_t kSize = 16 * kMegabyte;
+    const uint32_t flags = kBufferUsageFlagShaderRWResource | kBufferFlagTyped;
+    std::unique_ptr<Buffer> uint_buf = CreateBuffer(dev, L"Benchmark clear uint", flags, kSize, Format::kR32_Uint);
+    std::unique_ptr<Buffer> float_buf = CreateBuffer(dev, L"Benchmark clear float", flags, kSize, Format::kR32_Float);
+
+    const uint32_t iteration_count = GetIterationCount(500);
+    for(bool is_float : { false, true })
+    {
+        auto clear = [&](uint32_t i)
+        {
+            if(is_float)
+                CHECK_RESULT(dev.ClearBufferToFloatValues(*float_buf, FloatVec4{ float(i), 0.f, 0.f, 0.f }));
+            else
+                CHECK_RESULT(dev.ClearBufferToUintValues(*uint_buf, UintVec4{ i, 0, 0, 0 }));
+        };
+        clear(0);
+        CHECK_RESULT(dev.WaitForGPU());
+
+        const Clock::time_point begin = Clock::now();
+        for(uint32_t i = 0; i < iteration_count; ++i)
+            clear(i);
+        const double record_seconds = GetSecondsSince(begin);
+        CHECK_RESULT(dev.WaitForGPU());
+        const double total_seconds = GetSecondsSince(begin);
+
+        AddResult(is_float ? "clear_buffer_to_float_values" : "clear_buffer_to_uint_values",
+            { { "size", std::to_string(kSize) } }, iteration_count, {
+            { "cpu_time_per_clear", "ns", record_seconds * 1e9 / iteration_count },
+            { "bandwidth", "GB/s", GetGigabytesPerSecond(kSize, iteration_count, total_seconds) } });
+    }
+}
+
+/* Cold compilations use a VARIANT not compiled before, not even by an earlier run, which would have left it
+in the shader cache directory. Cached ones compile the same variants again.
+*/
+void BenchmarkShaderCompilation(Environment& env)
+{
+    const uint32_t iteration_count = g_quick ? 2 : 20;
+    // Integer literals in HLSL are 32-bit, so all the variants must stay below 2^32.
+    const uint32_t first_variant = uint32_t(uint64_t(Clock::now().time_since_epoch().count()) % 40000000ull * 100);
+
+    double seconds[2] = {};
+    for(uint32_t pass = 0; pass < 2; ++pass)
+    {
+        const Clock::time_point begin = Clock::now();
+        for(uint32_t i = 0; i < iteration_count; ++i)
+        {
+            const std::wstring variant = std::to_wstring(first_variant + i);
+            const wchar_t* macro_defines[] = { L"VARIANT", variant.c_str() };
+            ShaderCompilationParams compilation_params{};
+            compilation_params.entry_point = L"Main";
+            compilation_params.macro_defines = { macro_defines, _countof(macro_defines) };
+            ShaderCompilationResult* result_ptr = nullptr;
+            CHECK_RESULT(env.CompileShaderFromMemory(compilation_params,
+                ConstDataSpan{ kCompiledShaderHlsl, strlen(kCompiledShaderHlsl) }, result_ptr));
+            std::unique_ptr<ShaderCompilationResult> result{ result_ptr };
+            CHECK_RESULT(result->GetResult());
+        }
+        seconds[pass] = GetSecondsSince(begin);
+    }
+
+    AddResult("shader_compilation", {}, iteration_count, {
+        { "cold_time", "ms", seconds[0] * 1e3 / iteration_count },
+        { "cached_time", "ms", seconds[1] * 1e3 / iteration_count } });
+}
+
+void RunDeviceBenchmarks(Device& dev)
+{
+    BenchmarkEmptyDispatch(dev);
+    for(uint32_t slot_count : { 1u, 8u, 40u })
+        BenchmarkBindAndDispatch(dev, slot_count);
+    BenchmarkTransfers(dev, "default", kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst, true, true);
+    BenchmarkTransfers(dev, "upload", kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCopySrc, true, false);
+    BenchmarkTransfers(dev, "readback", kBufferUsageFlagCpuRead | kBufferUsageFlagCopyDst, false, true);
+    BenchmarkCopyBufferRegion(dev);
+    BenchmarkBufferCreation(dev);
+    BenchmarkClear(dev);
+}
+
+void WriteJson(FILE* file, const AdapterDesc& adapter_desc)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"library_version\": %s,\n", ToJsonString(JD3D12_BENCHMARK_LIBRARY_VERSION).c_str());
+    fprintf(file, "  \"adapter\": %s,\n", ToJsonString(adapter_desc.description).c_str());
+    fprintf(file, "  \"quick\": %s,\n", g_quick ? "true" : "false");
+    fprintf(file, "  \"benchmarks\": [\n");
+    for(size_t result_index = 0; result_index < g_results.size(); ++result_index)
+    {
+        const BenchmarkResult& result = g_results[result_index];
+        fprintf(file, "    {\"name\": %s, \"params\": {", ToJsonString(result.name).c_str());
+        for(size_t i = 0; i < result.params.size(); ++i)
+        {
+            fprintf(file, "%s%s: %s", i > 0 ? ", " : "", ToJsonString(result.params[i].first).c_str(),
+                result.params[i].second.c_str());
+        }
+        fprintf(file, "}, \"iterations\": %u, \"results\": {", result.iteration_count);
+        for(size_t i = 0; i < result.measurements.size(); ++i)
+        {
+            const Measurement& measurement = result.measurements[i];
+            fprintf(file, "%s\"%s\": {\"value\": %.6g, \"unit\": \"%s\"}", i > 0 ? ", " : "",
+                measurement.name, measurement.value, measurement.unit);
+        }
+        fprintf(file, "}}%s\n", result_index + 1 < g_results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* output_path = nullptr;
+    uint32_t adapter_index = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output_path = argv[++i];
+        else if(strcmp(argv[i], "--adapter") == 0 && i + 1 < argc)
+            adapter_index = uint32_t(atoi(argv[++i]));
+        else if(strcmp(argv[i], "--quick") == 0)
+            g_quick = true;
+        else
+        {
+            fprintf(stderr, "Usage: %s [--output <file.json>] [--quick] [--adapter <index>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    const std::wstring shader_cache_directory =
+        (std::filesystem::temp_directory_path() / L"jd3d12_benchmark_shader_cache").wstring();
+    EnvironmentDesc env_desc{};
+    env_desc.flags = kEnvironmentFlagLogStandardError;
+    env_desc.shader_cache_directory = shader_cache_directory.c_str();
+    Environment* env_ptr = nullptr;
+    CHECK_RESULT(CreateEnvironment(env_desc, env_ptr));
+    std::unique_ptr<Environment> env{ env_ptr };
+
+    AdapterDesc adapter_desc{};
+    CHECK_RESULT(env->GetAdapterDesc(adapter_index, adapter_desc));
+
+    {
+        DeviceDesc device_desc{};
+        device_desc.name = L"Benchmark device";
+        device_desc.adapter_index = adapter_index;
+        Device* dev_ptr = nullptr;
+        CHECK_RESULT(env->CreateDevice(device_desc, dev_ptr));
+        std::unique_ptr<Device> dev{ dev_ptr };
+        RunDeviceBenchmarks(*dev);
+    }
+
+    // Only the write goes to the GPU upload heap. A buffer with kBufferUsageFlagShaderRWResource stays in it.
+    if(adapter_desc.gpu_upload_heap_supported)
+    {
+        DeviceDesc device_desc{};
+        device_desc.name = L"Benchmark device with GPU upload heap";
+        device_desc.flags = kDeviceFlagPreferGpuUploadHeap;
+        device_desc.adapter_index = adapter_index;
+        Device* dev_ptr = nullptr;
+        CHECK_RESULT(env->CreateDevice(device_desc, dev_ptr));
+        std::unique_ptr<Device> dev{ dev_ptr };
+        BenchmarkTransfers(*dev, "gpu_upload",
+            kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress,
+            true, false);
+    }
+
+    BenchmarkShaderCompilation(*env);
+
+    FILE* file = stdout;
+    if(output_path != nullptr)
+    {
+        file = fopen(output_path, "w");
+        if(file == nullptr)
+        {
+            fprintf(stderr, "Cannot open \"%s\" for writing.\n", output_path);
+            return 1;
+        }
+    }
+    WriteJson(file, adapter_desc);
+    if(file != stdout)
+        fclose(file);
+    return 0;
+}
@@ -16,6 +16,8 @@ namespace jd3d12
 
 class BufferImpl;
 class ShaderImpl;
+class RecordingImpl;
+class ShaderFamilyImpl;
 class ShaderCompilationResultImpl;
 class DeviceImpl;
 class ShaderCompiler;
@@ -43,6 +45,24 @@ enum BufferFlags : uint32_t
     kBufferFlagTyped       = 0x00000100u,
     kBufferFlagStructured  = 0x00000200u,
     kBufferFlagByteAddress = 0x00000400u,
+
+    /** Always create the buffer as a separate committed resource instead of placing it in one of the big
+    memory blocks managed by the device. Buffers bigger than a quarter of a block are always created this way.
+
+    Either way, the buffer starts zero-initialized. Placed memory that was used by another buffer before is
+    cleared when the buffer is created, with a copy recorded on the GPU for buffers in GPU memory.
+    */
+    kBufferFlagDedicatedMemory = 0x00000800u,
+
+    /** Allows the buffer to be used as the source of arguments for Device::DispatchIndirect.
+    Cannot be combined with kBufferUsageFlagCpuRead.
+    */
+    kBufferUsageFlagIndirectArgs = 0x00001000u,
+
+    /** Only for Device::AcquireTransientBuffer: the buffer shares memory with transient buffers released before it,
+    even in the same command batch. Cannot be combined with kBufferUsageFlagCpu*.
+    */
+    kBufferFlagAliasedMemory = 0x00002000u,
 };
 
 struct BufferDesc
@@ -75,6 +95,14 @@ public:
     size_t GetElementSize() const noexcept;
     /// Returns `ID3D12Resource*`.
     void* GetD3D12Resource() const noexcept;
+    /** \brief Returns the index of the buffer's SRV in `ResourceDescriptorHeap`, for kDeviceFlagBindless.
+
+    Returns `UINT32_MAX` if the device is not bindless, or the buffer was not created with
+    kBufferUsageFlagShaderResource and one of kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.
+    */
+    uint32_t GetBindlessSrvIndex() const noexcept;
+    /// Like GetBindlessSrvIndex, but returns the index of the UAV, for kBufferUsageFlagShaderRWResource.
+    uint32_t GetBindlessUavIndex() const noexcept;
 
 private:
     BufferImpl* impl_ = nullptr;
@@ -111,6 +139,28 @@ private:
     JD3D12_NO_COPY_NO_MOVE_CLASS(Shader)
 };
 
+/** \brief Sequence of commands captured between Device::BeginRecording and Device::EndRecording,
+which can be executed many times with Device::Execute.
+
+Buffers and shaders used by the recorded commands must not be destroyed before the recording.
+*/
+class Recording
+{
+public:
+    /// Waits until the GPU finishes all the executions of the recording.
+    ~Recording();
+    RecordingImpl* GetImpl() const noexcept { return impl_; }
+    Device* GetDevice() const noexcept;
+
+private:
+    RecordingImpl* impl_ = nullptr;
+
+    Recording();
+
+    friend class DeviceImpl;
+    JD3D12_NO_COPY_NO_MOVE_CLASS(Recording)
+};
+
 enum ShaderCompilationFlags : uint32_t
 {
     /// Passed to DXC as `-denorm preserve`.
@@ -302,17 +352,255 @@ private:
     JD3D12_NO_COPY_NO_MOVE_CLASS(ShaderCompilationResult)
 };
 
+/** \brief Description of a single shader to compile and create with Device::CompileAndCreateShadersBatch.
+
+Members in the first part are inputs, to be filled by you. Members in the second part are outputs,
+filled by the function.
+*/
+struct ShaderBatchItem
+{
+    ShaderCompilationParams compilation_params;
+    ShaderDesc desc;
+    /** \brief Path to the file with HLSL source code.
+
+    If null, `hlsl_source` is used instead.
+    */
+    const wchar_t* hlsl_source_file_path = nullptr;
+    /// HLSL source code in memory. Used only when `hlsl_source_file_path` is null.
+    ConstDataSpan hlsl_source = { nullptr, 0 };
+
+    /** \brief Result of compiling and creating this shader.
+
+    Failed when loading the file, the compilation, or creation of the #Shader object failed.
+    */
+    Result result = kSuccess;
+    /** \brief Created shader, or null if `result` is failed.
+
+    It becomes owned by you. You must `delete` it when no longer needed.
+    */
+    Shader* shader = nullptr;
+    /** \brief Result of the compilation, which can be used to fetch errors and warnings.
+
+    It is null only if the compilation couldn't start, e.g. the file couldn't be loaded.
+    It becomes owned by you. You must `delete` it when no longer needed.
+    */
+    ShaderCompilationResult* compilation_result = nullptr;
+};
+
+/** \brief One axis of variation of a #ShaderFamily, which becomes a macro define in HLSL.
+*/
+struct ShaderPermutationAxis
+{
+    /// Name of the macro. Cannot be null or empty.
+    const wchar_t* macro_name = nullptr;
+    /** \brief Values the macro can take, as null-terminated strings, selected by their index.
+
+    If empty, the axis is a feature toggle with 2 values: index 0 leaves the macro undefined,
+    index 1 defines it with no value.
+    */
+    ArraySpan<const wchar_t*> values = { nullptr, 0 };
+};
+
+/// Description of a #ShaderFamily object to be created. Use with Device::CreateShaderFamily.
+struct ShaderFamilyDesc
+{
+    /// Name of the family. Each variant gets it as the name, followed by the values of the axes.
+    const wchar_t* name = nullptr;
+    /** \brief Parameters used to compile every variant.
+
+    Macros of the variant are defined after ShaderCompilationParams::macro_defines.
+    */
+    ShaderCompilationParams compilation_params;
+    /** \brief Path to the file with HLSL source code.
+
+    If null, `hlsl_source` is used instead.
+    */
+    const wchar_t* hlsl_source_file_path = nullptr;
+    /// HLSL source code in memory. Used only when `hlsl_source_file_path` is null.
+    ConstDataSpan hlsl_source = { nullptr, 0 };
+    /// Axes of variation. The number of permutations is the product of numbers of their values.
+    ArraySpan<const ShaderPermutationAxis> axes = { nullptr, 0 };
+};
+
+/** \brief HLSL source code with a set of permutation axes, which compiles and creates a variant of the shader
+only the first time it is requested.
+
+Variants that compile to identical bytecode share one #Shader object. Compilation goes through
+Environment::CompileShaderFromMemory or Environment::CompileShaderFromFile, so it uses the shader cache
+enabled with EnvironmentDesc::shader_cache_directory, and pipeline states use the cache enabled with
+DeviceDesc::pipeline_library_file_path.
+
+All the strings and arrays from #ShaderFamilyDesc are copied, so they don't need to stay valid.
+Methods of this class are thread-safe. The family must be destroyed before its #Device.
+*/
+class ShaderFamily
+{
+public:
+    /// Waits for the background compilation started with Prewarm and destroys all the variants.
+    ~ShaderFamily();
+    ShaderFamilyImpl* GetImpl() const noexcept { return impl_; }
+    Device* GetDevice() const noexcept;
+    uint32_t GetAxisCount() const noexcept;
+    /// Number of all the combinations of axis values.
+    uint64_t GetPermutationCount() const noexcept;
+
+    /** \brief Returns the variant selected by `value_indices`, compiling and creating it on the first request.
+
+    `value_indices` must have one index per axis, each less than the number of values of the axis.
+    The returned shader is owned by the family and stays valid until the family is destroyed.
+    If the variant is being compiled by Prewarm or on another thread, the function waits for it.
+    A variant that failed to compile returns the same error again without compiling it again.
+    */
+    Result GetShader(ArraySpan<const uint32_t> value_indices, Shader*& out_shader);
+    /** \brief Starts compiling and creating variants in the background and returns immediately.
+
+    \param value_indices Value indices of the variants, GetAxisCount() of them for each variant, one after another.
+    \param thread_count Number of background threads to use. 0 means the number of logical processors.
+
+    The indices are copied. Variants already created or being compiled are skipped.
+    */
+    Result Prewarm(ArraySpan<const uint32_t> value_indices, uint32_t thread_count = 1);
+    /// Waits until all the variants started by Prewarm are processed. Returns the first error among them, if any.
+    Result WaitForPrewarm();
+
+    /// Number of variants created so far.
+    size_t GetVariantCount() const noexcept;
+    /// Number of distinct #Shader objects created so far, which can be lower than GetVariantCount().
+    size_t GetUniqueShaderCount() const noexcept;
+
+private:
+    ShaderFamilyImpl* impl_ = nullptr;
+
+    ShaderFamily();
+
+    friend class DeviceImpl;
+    JD3D12_NO_COPY_NO_MOVE_CLASS(ShaderFamily)
+};
+
 enum DeviceFlags : uint32_t
 {
     kDeviceFlagDisableGpuTimeout  = 0x1,
     kDeviceFlagDisableNameSetting = 0x2,
     kDeviceFlagDisableNameStoring = 0x3,
+    /** \brief Places buffers written by the CPU and accessed by shaders in GPU_UPLOAD heap, when supported.
+
+    When the adapter reports `D3D12_FEATURE_DATA_D3D12_OPTIONS16::GPUUploadHeapSupported` (typically with
+    resizable BAR enabled), buffers created with kBufferUsageFlagCpuSequentialWrite and
+    kBufferUsageFlagShaderResource, kBufferUsageFlagShaderConstant, or kBufferUsageFlagShaderRWResource are
+    created in video memory that the CPU can write directly. Device::WriteMemoryToBuffer and Device::MapBuffer
+    then write them without a staging copy. When not supported, this flag is ignored.
+    */
+    kDeviceFlagPreferGpuUploadHeap = 0x4,
+    /** \brief Enables bindless mode, where shaders access buffers through `ResourceDescriptorHeap`.
+
+    Every buffer with shader usage gets persistent SRV and UAV descriptors at creation, see
+    Buffer::GetBindlessSrvIndex. Device::BindBindlessBuffer and Device::BindBindlessRWBuffer write these
+    indices into root constants available in HLSL as:
+
+    \code
+    cbuffer JD3D12BindlessIndices : register(b0, space1) { uint4 bindless_indices[4]; };
+    \endcode
+
+    Shaders must be compiled for shader model 6.6 or higher. Binding to registers with
+    Device::BindBuffer etc. still works. Device creation fails with #kErrorUnsupported if the GPU doesn't
+    support resource binding tier 3 and shader model 6.6.
+    */
+    kDeviceFlagBindless = 0x8,
+    /** \brief Measures GPU time of each command using timestamp queries.
+
+    Every call to Device::DispatchComputeShader, Device::DispatchThreads, Device::DispatchIndirect, Device::CopyBuffer,
+    Device::CopyBufferRegion, Device::ClearBufferToUintValues, and Device::ClearBufferToFloatValues records timestamps before and after
+    the command. Results become available after the GPU completes the command, see Device::GetProfiledCommands.
+    It adds some overhead, so it is intended for development, not release builds.
+    */
+    kDeviceFlagEnableProfiling = 0x10,
+    /** \brief Disables the event markers recorded by Device::BeginRegion, Device::EndRegion, and around
+    each Device::DispatchComputeShader.
+
+    By default, the markers are recorded with `BeginEvent`/`EndEvent` of the command list, so they are visible
+    in tools like PIX. Each dispatch gets a marker with the name of the shader, if it has one.
+    Regions are still profiled with kDeviceFlagEnableProfiling.
+    */
+    kDeviceFlagDisableCommandMarkers = 0x20,
+    /** \brief Creates an additional queue of type COPY, so big copies can run in parallel with dispatches.
+
+    Device::CopyBuffer and Device::CopyBufferRegion of at least 256 KB are then recorded on the copy queue,
+    unless the source or destination buffer is already used by commands recorded since the last submission,
+    in which case they stay on the main queue to keep the order. The copy queue waits on the GPU for previous
+    commands of the main queue that use these buffers, and the main queue waits for the copies
+    before later commands that use them. Waiting on the CPU, e.g. in Device::MapBuffer or
+    Device::WaitForReadback, takes both queues into account.
+
+    Copies on the copy queue are not profiled with kDeviceFlagEnableProfiling.
+    */
+    kDeviceFlagEnableCopyQueue = 0x40,
+    /** \brief Manages residency of big buffers in GPU memory, so their total size can exceed the video memory budget.
+
+    Buffers in GPU memory that get their own committed resource, which are ones bigger than 8 MB or created with
+    kBufferFlagDedicatedMemory, are tracked with the command batch that last used them. Before a command batch is
+    submitted, if the memory usage is over the budget, the least recently used of them that no batch still executing
+    on the GPU uses are evicted with `ID3D12Device::Evict`. Buffers used by the batch that were evicted are made
+    resident again before it executes, with `ID3D12Device3::EnqueueMakeResident` where available, which makes only
+    the GPU wait, or with blocking `ID3D12Device::MakeResident` otherwise.
+
+    The budget is DeviceDesc::residency_budget or, by default, the budget of the video memory reported by
+    `IDXGIAdapter3::QueryVideoMemoryInfo`, which is checked again whenever the OS notifies about its change.
+    Smaller buffers share memory blocks with other buffers and always stay resident.
+    */
+    kDeviceFlagEnableResidencyManagement = 0x80,
 };
 
 struct DeviceDesc
 {
     const wchar_t* name = nullptr;
     uint32_t flags = 0; // Use DeviceFlags.
+    /** \brief Number of command batches in the ring, between 1 and 16.
+
+    With more than 1, commands can be recorded into a new batch while previously submitted ones are still
+    executing on the GPU. Mapping, reading, writing, or destroying a resource waits only for the batch that
+    last used it. 1 gives the old, fully serialized behavior.
+
+    Dynamic descriptors are split equally between the batches, so each batch gets a smaller portion.
+    */
+    uint32_t command_batch_count = 2;
+    /** \brief Size of the internal upload ring in bytes, rounded up to 64 KB.
+
+    The upload ring is a persistently mapped buffer in the UPLOAD heap used by Device::WriteMemoryToBuffer and
+    buffer initial data to transfer data to buffers in GPU memory. Larger writes are split into chunks,
+    so it doesn't limit the size of a write, but more memory allows more data in flight.
+    */
+    size_t upload_ring_size = 32 * kMegabyte;
+    /** \brief Number of descriptors reserved in the shader-visible descriptor heap for #Recording objects,
+    up to 16384.
+
+    Every buffer view used by the commands of a recording takes one of them for the lifetime of the recording.
+    A command recorded when they run out fails with #kErrorTooManyObjects. The rest of the heap is used for
+    dynamic descriptors of the command batches, so 0 is best when recordings are not used.
+    */
+    uint32_t recording_descriptor_count = 4096;
+    /** \brief Path to a file used as a cache of compiled pipeline states.
+
+    Using non-null and non-empty string here enables the cache, implemented with `ID3D12PipelineLibrary`.
+    Creating a #Shader looks up its pipeline state in the library first, which lets the driver skip
+    compiling the shader bytecode to GPU code. New pipeline states are added to the library, which is saved
+    back to the file when the device is destroyed.
+
+    If the file doesn't exist, or it was created with a different GPU or driver version, a new library is created
+    and the file will be overwritten.
+    */
+    const wchar_t* pipeline_library_file_path = nullptr;
+    /** \brief Index of the GPU to create the device on, as enumerated by Environment::GetAdapterDesc.
+
+    Adapters are ordered from the highest performance, so 0 selects the same GPU as Environment::GetDXGIAdapter1.
+    Ignored when adapter_luid is not 0.
+    */
+    uint32_t adapter_index = 0;
+    /// If not 0, selects the GPU with this AdapterDesc::luid instead of adapter_index.
+    uint64_t adapter_luid = 0;
+    /** \brief Used only with #kDeviceFlagEnableResidencyManagement. If not 0, limits the total size of the resident
+    buffers managed by it, instead of using the video memory budget of the OS.
+    */
+    size_t residency_budget = 0;
 };
 
 enum CommandFlags : uint32_t
@@ -320,25 +608,229 @@ enum CommandFlags : uint32_t
     kCommandFlagDontWait = 0x1,
 };
 
+/// Flags for Device::BindRWBuffer.
+enum BindFlags : uint32_t
+{
+    /** \brief Promises that consecutive dispatches don't depend on each other's writes to this buffer.
+
+    By default, a UAV barrier is issued between two dispatches that access the same buffer as a UAV.
+    With this flag, it is skipped, so the dispatches can overlap on the GPU. Use it only when they
+    read and write disjoint parts of the buffer or use atomics exclusively.
+    */
+    kBindFlagNoUavHazard = 0x1,
+};
+
+/// Type of the 32-bit elements processed by Device::Reduce, Device::InclusiveScan, and Device::ExclusiveScan.
+enum PrimitiveDataType : uint32_t
+{
+    kPrimitiveDataTypeUint,
+    kPrimitiveDataTypeInt,
+    kPrimitiveDataTypeFloat,
+};
+
+/// Operation of Device::Reduce.
+enum ReduceOperation : uint32_t
+{
+    kReduceOperationSum,
+    kReduceOperationMin,
+    kReduceOperationMax,
+};
+
+/** \brief Identifies a pending asynchronous read started by Device::ReadBufferToMemoryAsync.
+
+It is a lightweight value type. Once the read is completed by Device::WaitForReadback or
+Device::TryGetReadback, the ticket becomes empty.
+*/
+struct ReadbackTicket
+{
+    // Internal identifier of the pending read. 0 means the ticket is empty.
+    uint64_t id = 0;
+    // The read is complete when the GPU reaches this fence value.
+    uint64_t fence_value = 0;
+    void* dst_memory = nullptr;
+    size_t size = 0;
+
+    bool IsEmpty() const noexcept { return id == 0; }
+};
+
+/** \brief Statistics of the memory allocated for buffers, returned by Device::GetMemoryStatistics.
+
+Sums over all heap types.
+*/
+struct MemoryStatistics
+{
+    // Number and total size of big memory blocks (`ID3D12Heap`) allocated for placed buffers.
+    size_t block_count = 0;
+    size_t block_bytes = 0;
+    // Bytes of all the blocks occupied by buffers, including padding to internal allocation granularity.
+    size_t allocated_bytes = 0;
+    // Number and sum of requested sizes of buffers placed in the blocks.
+    size_t placed_buffer_count = 0;
+    size_t placed_buffer_bytes = 0;
+    // Number and sum of requested sizes of buffers created as separate committed resources.
+    size_t committed_buffer_count = 0;
+    size_t committed_buffer_bytes = 0;
+    /* Fragmentation of the free space in the blocks, from 0 to 1.
+    Calculated as 1 - (largest free region / total free space). 0 means all free space is contiguous.
+    */
+    float fragmentation = 0.f;
+};
+
+/** \brief Counters of the commands recorded by a #Device, part of #DeviceStatistics.
+
+Commands captured in a #Recording are counted every time it is executed.
+*/
+struct CommandStatistics
+{
+    // Dispatches, including each part of a split Device::DispatchThreads and Device::DispatchIndirect.
+    uint64_t dispatch_count = 0;
+    // Barriers changing the state of a buffer, between writes to the same buffer, and between aliased buffers.
+    uint64_t transition_barrier_count = 0;
+    uint64_t uav_barrier_count = 0;
+    uint64_t aliasing_barrier_count = 0;
+    // Descriptors created for the buffer views and the constant data used by the commands.
+    uint64_t descriptor_count = 0;
+    // Bytes written to buffers in the DEFAULT heap with `WriteBufferImmediate`, used for small writes.
+    uint64_t bytes_written_immediate = 0;
+    // Bytes written to buffers in the DEFAULT heap by copying them from the upload ring.
+    uint64_t bytes_written_through_upload_ring = 0;
+};
+
+/** \brief Statistics of the work done by a #Device, returned by Device::GetStatistics.
+
+Meant to find implicit synchronization points without attaching a profiler. Counters accumulate since the
+creation of the device.
+*/
+struct DeviceStatistics
+{
+    // Sum of the counters of all the submitted command batches. The batch being recorded is not included.
+    CommandStatistics total;
+    // Counters of the last submitted command batch.
+    CommandStatistics last_batch;
+    uint64_t submitted_batch_count = 0;
+    // Bytes written by mapping buffers in the UPLOAD and GPU_UPLOAD heaps, by WriteMemoryToBuffer.
+    uint64_t bytes_written_mapped = 0;
+    // Bytes copied from buffers to memory by ReadBufferToMemory and the asynchronous readbacks.
+    uint64_t bytes_read = 0;
+    /* Number of times the device waited for all the submitted commands to finish executing.
+    Each of them is a stall, which makes the GPU idle until the CPU records and submits new commands.
+    */
+    uint64_t wait_for_idle_count = 0;
+    // Number of times the CPU blocked on the fence of the command queue, for any reason, and the total time spent.
+    uint64_t cpu_wait_count = 0;
+    double cpu_wait_milliseconds = 0.0;
+    // Highest number of descriptors used by one command batch, out of `dynamic_descriptor_capacity` available.
+    uint32_t peak_dynamic_descriptor_count = 0;
+    uint32_t dynamic_descriptor_capacity = 0;
+    // Descriptors of buffers and recordings that stay valid for their whole lifetime, currently and at peak.
+    uint32_t persistent_descriptor_count = 0;
+    uint32_t peak_persistent_descriptor_count = 0;
+    // Video memory of the GPU (`DXGI_MEMORY_SEGMENT_GROUP_LOCAL`), from `IDXGIAdapter3::QueryVideoMemoryInfo`.
+    uint64_t local_memory_budget = 0;
+    uint64_t local_memory_usage = 0;
+    // System memory available to the GPU (`DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL`).
+    uint64_t non_local_memory_budget = 0;
+    uint64_t non_local_memory_usage = 0;
+    // Only with kDeviceFlagEnableResidencyManagement: numbers of buffers evicted and made resident again so far,
+    // and the total size of the buffers currently evicted.
+    uint64_t buffer_eviction_count = 0;
+    uint64_t buffer_make_resident_count = 0;
+    uint64_t evicted_buffer_bytes = 0;
+};
+
+/** \brief GPU time of a single command or region, returned by Device::GetProfiledCommands.
+
+Returned strings are owned by the #Device and stay valid until the next call to Device::GetProfiledCommands,
+Device::ClearProfiledCommands, or Device::SaveProfilingTrace.
+*/
+struct ProfiledCommand
+{
+    /// Name of the command, like `L"DispatchComputeShader"`, or name of the region. Never null.
+    const wchar_t* label;
+    /// Name of the shader for Device::DispatchComputeShader, null for other commands.
+    const wchar_t* shader_name;
+    /// Number of thread groups for Device::DispatchComputeShader, 0 for other commands, including Device::DispatchIndirect.
+    UintVec3 group_count;
+    /// Time when the command started on the GPU, relative to the first profiled command.
+    double gpu_begin_microseconds;
+    /// Duration of the command on the GPU.
+    double gpu_duration_microseconds;
+    /// Number of regions this command is nested in.
+    uint32_t depth;
+    /** \brief True if this is a region from Device::BeginRegion.
+
+    A region spanning multiple command batches is returned as a separate entry for each batch.
+    */
+    bool is_region;
+};
+
 class Device
 {
 public:
+    /// Number of slots for Device::BindBindlessBuffer, Device::BindBindlessRWBuffer.
+    static constexpr uint32_t kMaxBindlessIndexCount = 16;
+    /// Number of 32-bit values for Device::SetRootConstants.
+    static constexpr uint32_t kMaxRootConstantCount = 8;
+
     ~Device();
     DeviceImpl* GetImpl() const noexcept { return impl_; }
     Environment* GetEnvironment() const noexcept;
     void* GetD3D12Device() const noexcept;
+    /// Returns `IDXGIAdapter1*` of the GPU this device was created on.
+    void* GetDXGIAdapter1() const noexcept;
 
+    /** \brief Creates a buffer with zero-initialized content.
+
+    Buffers up to a quarter of a memory block are placed in the blocks managed by the device by default,
+    see #kBufferFlagDedicatedMemory. Clearing memory reused from a destroyed buffer records a copy for
+    buffers in GPU memory. If that happens between BeginRecording and EndRecording, the buffer gets its own
+    committed resource instead.
+    */
     Result CreateBuffer(const BufferDesc& desc, Buffer*& out_buffer);
     /** \brief Creates a buffer and initializes it with data from memory.
 
+    The part of the buffer after `initial_data` is zero-initialized, like in CreateBuffer.
+
     \param initial_data Optional, can be null.
     \param initial_data_size Optional, can be 0. If not 0, initial_data must not be null and this size
     must be not greater than the buffer size.
     */
     Result CreateBufferFromMemory(const BufferDesc& desc, ConstDataSpan initial_data,
         Buffer*& out_buffer);
+    /** \brief Creates a buffer and initializes it with the content of a file.
+
+    The file must not be larger than the buffer. Its data is read in chunks straight into the mapped buffer
+    or the upload ring, without loading the whole file into memory first. For a buffer in GPU memory,
+    the copy of each chunk is submitted as soon as it is read.
+    */
     Result CreateBufferFromFile(const BufferDesc& desc, const wchar_t* initial_data_file_path,
         Buffer*& out_buffer);
+    /** \brief Returns a buffer for temporary data, reused from a pool owned by the device or created if needed.
+
+    Pooled buffers are reused only for the same `desc.flags`, `element_format`, and `structure_size`. Their size is
+    `desc.size` rounded up to a power of 2, at least 64 KB, so the returned buffer can be bigger than requested.
+    Buffer::GetSize returns this rounded size, which #kFullRange also covers, so size dispatches and reads
+    from `desc.size` rather than from the buffer. A released buffer is reused only after the GPU finishes
+    the commands that use it, so acquiring never waits. Free buffers not acquired again for many command batches
+    are destroyed. `desc.name` is used only when a new buffer is created.
+
+    With kBufferFlagAliasedMemory, a new buffer of exactly `desc.size` is created each time, placed in memory
+    of a transient buffer with that flag released before, also in the same command batch. An aliasing barrier
+    between them is recorded. Buffers whose lifetimes don't overlap then take the memory of one.
+    Such a buffer cannot be used by a #Recording.
+
+    The content of the returned buffer is undefined. It must be returned with ReleaseTransientBuffer,
+    not destroyed with `delete`.
+    */
+    Result AcquireTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer);
+    /** \brief Returns a buffer acquired with AcquireTransientBuffer. It must not be used afterwards. Null is ignored.
+
+    The buffer must not be bound anymore, neither to the device nor to a #Recording still open, and must not be
+    used by commands recorded in the open recording. A debug assert checks that, but only for the recording
+    open on the calling thread, not for those recorded in parallel on other threads. The buffer can still be
+    used by ended recordings, in which case it is not reused until they are destroyed.
+    */
+    void ReleaseTransientBuffer(Buffer* buf);
 
     Result CreateShaderFromMemory(const ShaderDesc& desc, ConstDataSpan bytecode,
         Shader*& out_shader);
@@ -360,6 +852,24 @@ public:
     */
     Result CompileAndCreateShaderFromFile(const ShaderCompilationParams& compilation_params,
         const ShaderDesc& desc, const wchar_t* hlsl_source_file_path, Shader*& out_shader);
+    /** \brief Compiles and creates multiple shaders in parallel, using multiple threads.
+
+    \param items Shaders to compile. Output members of each item are filled, also when the function fails.
+    \param thread_count Maximum number of threads to use, including the calling thread.
+        0 means the number of logical processors.
+
+    The function returns after all the items are processed. It returns the first failed ShaderBatchItem::result,
+    in the order of items, or success when all the shaders were created.
+
+    Include callbacks and log callbacks may be called from multiple threads simultaneously.
+    */
+    Result CompileAndCreateShadersBatch(ArraySpan<ShaderBatchItem> items, uint32_t thread_count = 0);
+    /** \brief Creates a #ShaderFamily, which compiles its variants on demand.
+
+    No shader is compiled by this function. If `desc.hlsl_source_file_path` is used, the file is loaded
+    when a variant is compiled, like in CompileAndCreateShaderFromFile.
+    */
+    Result CreateShaderFamily(const ShaderFamilyDesc& desc, ShaderFamily*& out_family);
 
     /** \brief Maps a buffer, returning a CPU pointer for reading or writing its data.
 
@@ -373,15 +883,72 @@ public:
 
     Result ReadBufferToMemory(Buffer& src_buf, Range src_byte_range, void* dst_memory,
         uint32_t command_flags = 0);
+    /** \brief Reads data from a buffer, converting it from its BufferDesc::element_format to `dst_format`.
+
+    Both formats must have the same number of components. Supported are conversions between 32-bit float
+    components and 16-bit float, 8- or 16-bit unorm or snorm components, in either direction, as well as between
+    identical component formats. For example, a buffer of kR16G16B16A16_Float can be read as kR32G32B32A32_Float.
+
+    `src_byte_range` is in bytes of the buffer and must cover whole elements. `dst_memory` receives the same
+    number of elements of `dst_format`. The data is converted directly out of the mapped memory: of `src_buf` if
+    it was created with kBufferUsageFlagCpuRead, otherwise of an internal staging buffer, which requires
+    kBufferUsageFlagCopySrc and always waits for the copy, ignoring #kCommandFlagDontWait.
+    Large ranges are converted on multiple threads.
+    */
+    Result ReadBufferToMemoryConverted(Buffer& src_buf, Range src_byte_range, Format dst_format, void* dst_memory,
+        uint32_t command_flags = 0);
+    /** \brief Starts reading data from a buffer without waiting for the GPU.
+
+    If `src_buf` was created with kBufferUsageFlagCopySrc, a copy to an internal, pooled staging buffer is
+    recorded in the current command batch. If `src_buf` was created with kBufferUsageFlagCpuRead, it is
+    read directly once the GPU finishes writing it.
+
+    `dst_memory` is written only when the read is completed by WaitForReadback or TryGetReadback, so it must
+    stay valid until then. `src_buf` must not be destroyed before that when it is read directly.
+
+    A buffer created with kBufferUsageFlagCpuRead holds the data only once, so it must not be written on the GPU
+    again until the read is completed. Otherwise WaitForReadback and TryGetReadback drop the read, empty
+    the ticket and return #kErrorChangedState instead of returning the newer data. A buffer with
+    kBufferUsageFlagCopySrc can be written freely, as its data is captured by the copy recorded here.
+    */
+    Result ReadBufferToMemoryAsync(Buffer& src_buf, Range src_byte_range, void* dst_memory,
+        ReadbackTicket& out_ticket);
+    /// Returns true if the GPU has finished the commands needed for the read. Doesn't submit or wait.
+    bool IsReadbackComplete(const ReadbackTicket& ticket);
+    /** \brief Waits for the read to finish, then copies the data to its destination memory and empties the ticket.
+
+    Submits pending commands if they are needed for the read. Returns #kNotReady if the timeout expired.
+    */
+    Result WaitForReadback(ReadbackTicket& ticket, uint32_t timeout_milliseconds = kTimeoutInfinite);
+    /// Same as WaitForReadback with timeout 0: completes the read if possible, returns #kNotReady otherwise.
+    Result TryGetReadback(ReadbackTicket& ticket);
     /** \brief Writes data to a buffer.
 
-    The buffer must be created with kBufferUsageFlagCpuSequentialWrite.
+    The buffer must be created with kBufferUsageFlagCpuSequentialWrite or be placed in GPU memory,
+    e.g. created with kBufferUsageFlagShaderRWResource. Writes to GPU memory are recorded as copies from
+    an internal upload ring (see DeviceDesc::upload_ring_size), so their size is not limited. Very small writes
+    use `WriteBufferImmediate` instead.
 
     Memory pointed by `src_buf` can be modified or freed immediately after this call, as the data is
     written immediately, an internal copy is made, or the function blocks until the write is finished.
+
+    With #kCommandFlagDontWait, a write bigger than the free space in the upload ring can return #kNotReady
+    after only a part of the data has been written.
     */
     Result WriteMemoryToBuffer(ConstDataSpan src_data, Buffer& dst_buf, size_t dst_byte_offset,
         uint32_t command_flags = 0);
+    /** \brief Writes data of `src_format` to a buffer, converting it to the BufferDesc::element_format of the buffer.
+
+    The same conversions are supported as in ReadBufferToMemoryConverted. `src_data.size` must be a multiple of
+    the element size of `src_format`, and the size of the converted data a multiple of 4 B. `dst_byte_offset` is
+    in bytes of the buffer.
+
+    The data is converted directly into the mapped buffer or into the upload ring, without an intermediate copy.
+    Other than that, it behaves like WriteMemoryToBuffer, except that it never uses `WriteBufferImmediate`.
+    Large writes are converted on multiple threads.
+    */
+    Result WriteMemoryToBufferConverted(ConstDataSpan src_data, Format src_format, Buffer& dst_buf,
+        size_t dst_byte_offset, uint32_t command_flags = 0);
 
     template<typename T>
     Result ReadBufferToValue(Buffer& src_buf, size_t src_byte_offset, T& out_val,
@@ -396,6 +963,30 @@ public:
         return WriteMemoryToBuffer(ConstDataSpan{ &src_val, sizeof(src_val) }, dst_buf, dst_byte_offset, command_flags);
     }
 
+    void GetMemoryStatistics(MemoryStatistics& out_stats);
+    /// Returns the counters of the work done so far, cheap enough to call every frame.
+    Result GetStatistics(DeviceStatistics& out_stats);
+
+    /** \brief Returns commands profiled with kDeviceFlagEnableProfiling that completed on the GPU so far.
+
+    Commands still executing or not submitted yet are missing. Call Device::WaitForGPU first to get all of them.
+    Results accumulate until ClearProfiledCommands is called.
+    */
+    ArraySpan<const ProfiledCommand> GetProfiledCommands();
+    void ClearProfiledCommands();
+    /** \brief Saves the results of GetProfiledCommands to a file as JSON in Chrome trace event format.
+
+    The file can be viewed in `chrome://tracing` or https://ui.perfetto.dev.
+    */
+    Result SaveProfilingTrace(const wchar_t* file_path);
+
+    /** \brief Starts a named region of commands, visible in tools like PIX and in the profiling results.
+
+    Regions can be nested. Each call must be matched with EndRegion. See also #ScopedRegion.
+    */
+    Result BeginRegion(const wchar_t* name);
+    Result EndRegion();
+
     Result SubmitPendingCommands();
     Result WaitForGPU(uint32_t timeout_milliseconds = kTimeoutInfinite);
 
@@ -439,6 +1030,45 @@ public:
     */
     Result ClearBufferToFloatValues(Buffer& buf, const FloatVec4& values, Range element_range = kFullRange);
 
+    /** \brief Writes the sum, minimum, or maximum of the 32-bit elements in `src_byte_range` to `dst_buf`.
+
+    Like the other parallel primitives below, it records a sequence of compute dispatches using shaders built into
+    the library, compiled on first use, so the Environment must be able to compile shaders. They use wave intrinsics
+    when the GPU supports them. Bindings set by the user are not changed. Temporary buffers are acquired as
+    transient buffers, so they cannot be called between BeginRecording and EndRecording.
+
+    Source buffers must be created with kBufferUsageFlagShaderResource, destination buffers with
+    kBufferUsageFlagShaderRWResource, and any of kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress
+    with 4-byte elements. Byte offsets and sizes must be multiples of 4. Source and destination must be different
+    buffers. Ranges cannot be empty.
+
+    The order of float additions differs from a sequential sum, so the result may differ slightly.
+    */
+    Result Reduce(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type, ReduceOperation op,
+        Buffer& dst_buf, size_t dst_byte_offset);
+    /// Writes the prefix sums of the elements in `src_byte_range` to `dst_buf`, each including its own element.
+    Result InclusiveScan(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type,
+        Buffer& dst_buf, size_t dst_byte_offset);
+    /// Writes the prefix sums of the elements in `src_byte_range` to `dst_buf`, each excluding its own element.
+    Result ExclusiveScan(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type,
+        Buffer& dst_buf, size_t dst_byte_offset);
+    /** \brief Sorts 32-bit unsigned integer keys in place, in ascending order. The sort is stable.
+
+    If `values_buf` is not null, the 32-bit values starting at `values_byte_offset` are moved together with the keys.
+    Keys must be less than `1 << key_bit_count`. A smaller `key_bit_count` needs fewer passes over the data.
+    Keys and values must be created with both kBufferUsageFlagShaderResource and kBufferUsageFlagShaderRWResource.
+    */
+    Result RadixSort(Buffer& keys_buf, Range keys_byte_range, Buffer* values_buf = nullptr,
+        size_t values_byte_offset = 0, uint32_t key_bit_count = 32);
+    /** \brief Copies the 32-bit elements in `src_byte_range` that have a nonzero flag to the beginning of `dst_buf`.
+
+    `flags_buf` holds one 32-bit flag per element, starting at `flags_byte_offset`. The order of the copied elements
+    is preserved. Their number is written as `uint` to `count_buf` at `count_byte_offset`, so it can be used
+    by the next dispatches without reading it back.
+    */
+    Result Compact(Buffer& src_buf, Range src_byte_range, Buffer& flags_buf, size_t flags_byte_offset,
+        Buffer& dst_buf, size_t dst_byte_offset, Buffer& count_buf, size_t count_byte_offset);
+
     void ResetAllBindings();
     /** \brief Binds a buffer as a constant buffer to b# slot.
 
@@ -447,8 +1077,113 @@ public:
     */
     Result BindConstantBuffer(uint32_t b_slot, Buffer* buf, Range byte_range = kFullRange);
     Result BindBuffer(uint32_t t_slot, Buffer* buf, Range byte_range = kFullRange);
-    Result BindRWBuffer(uint32_t u_slot, Buffer* buf, Range byte_range = kFullRange);
+    /** \brief Binds a buffer as an unordered access view to u# slot.
+
+    `bind_flags` is a combination of #BindFlags.
+    */
+    Result BindRWBuffer(uint32_t u_slot, Buffer* buf, Range byte_range = kFullRange, uint32_t bind_flags = 0);
+    /** \brief Binds a copy of given data as a constant buffer to b# slot, without the need to create a Buffer.
+
+    The data is copied when this function is called, so the memory can be freed or changed right after.
+    It is uploaded to GPU memory once per command batch, on the next dispatch. It can be up to 64 KB.
+    Binding a buffer to the same slot with BindConstantBuffer replaces it.
+    */
+    Result BindConstantData(uint32_t b_slot, ConstDataSpan data);
+    template<typename T>
+    Result BindConstantValue(uint32_t b_slot, const T& val)
+    {
+        return BindConstantData(b_slot, ConstDataSpan{ &val, sizeof(val) });
+    }
+    /** \brief Sets 32-bit values passed directly in the root signature, for small parameters that change often.
+
+    They are available in HLSL in a constant buffer at `register(b1, space1)`, for example:
+
+    \code
+    cbuffer MyRootConstants : register(b1, space1) { uint iteration_index; float time; };
+    \endcode
+
+    `data.size` must be a multiple of 4 B. Values at `first_constant_index` to
+    `first_constant_index + data.size / 4` must fit in kMaxRootConstantCount. Other values stay unchanged.
+    The values persist across dispatches until changed. ResetAllBindings sets them to 0.
+    */
+    Result SetRootConstants(ConstDataSpan data, uint32_t first_constant_index = 0);
+    /** \brief Writes the index of the buffer's SRV to given slot of bindless indices, for kDeviceFlagBindless.
+
+    The shader can then access the whole buffer as `ResourceDescriptorHeap[bindless_indices[slot / 4][slot % 4]]`.
+    Only buffers bound this way get their state tracked and transitioned before the dispatch.
+    Passing null writes the index of a null descriptor. ResetAllBindings resets the slots to `UINT32_MAX`.
+    */
+    Result BindBindlessBuffer(uint32_t index_slot, Buffer* buf);
+    /// Like BindBindlessBuffer, but writes the index of the buffer's UAV.
+    Result BindBindlessRWBuffer(uint32_t index_slot, Buffer* buf);
     Result DispatchComputeShader(Shader& shader, const UintVec3& group_count);
+    /** \brief Dispatches enough thread groups to run at least `thread_count` threads, based on `numthreads`
+    declared in the shader.
+
+    Unlike DispatchComputeShader, the number of groups is not limited to 65535 per dimension. When more are
+    needed, the work is split into multiple dispatches, with no UAV barriers between them. Each shader
+    should add the thread offset of the part to its `SV_DispatchThreadID` and skip the threads beyond
+    the requested count, which occur when it is not a multiple of the group size. Both are available
+    in HLSL at `register(b2, space1)`:
+
+    \code
+    cbuffer JD3D12DispatchParams : register(b2, space1) { uint4 jd3d12_thread_offset; uint4 jd3d12_thread_count; };
+
+    [numthreads(256, 1, 1)]
+    void Main(uint3 dtid : SV_DispatchThreadID)
+    {
+        const uint3 id = dtid + jd3d12_thread_offset.xyz;
+        if(any(id >= jd3d12_thread_count.xyz))
+            return;
+        // ...
+    }
+    \endcode
+
+    DispatchComputeShader sets them too, with zero offset and the count equal to `group_count` times `numthreads`.
+
+    With #kDeviceFlagBindless, the root signature has no space left for these constants, so they are not
+    available to shaders and a dispatch needing more than 65535 groups in any dimension fails with
+    #kErrorUnsupported.
+    */
+    Result DispatchThreads(Shader& shader, const UintVec3& thread_count);
+    /** \brief Dispatches the shader with the number of thread groups read by the GPU from `args_buffer`.
+
+    `args_buffer` must be created with #kBufferUsageFlagIndirectArgs. At `byte_offset`, which must be a multiple
+    of 4, it must contain 3 `uint` values: the number of groups in X, Y, Z, like `D3D12_DISPATCH_ARGUMENTS`.
+    They are typically written by a previous dispatch, so the workload of the next pass can be decided on the GPU
+    without reading it back. The buffer is transitioned automatically, like the buffers bound to the shader,
+    but it must not be bound at the time of the dispatch, not even as a read-only buffer. The function then
+    fails with #kErrorInvalidArgument.
+
+    The thread count at `register(b2, space1)`, described in DispatchThreads, is not known on the CPU, so it is set
+    to `UINT_MAX` with zero offset. Each component of the arguments must not exceed 65535.
+    */
+    Result DispatchIndirect(Shader& shader, Buffer& args_buffer, size_t byte_offset = 0);
+
+    /** \brief Starts capturing commands into a new #Recording instead of executing them.
+
+    Between BeginRecording and EndRecording, the bind functions, SetRootConstants, DispatchComputeShader,
+    DispatchThreads, DispatchIndirect, CopyBuffer, and CopyBufferRegion are validated, and buffer state transitions
+    and descriptors are prepared once, when they are called. The commands then get executed only by Execute.
+    Other commands fail, including everything that needs to wait for the GPU, the writes and reads of buffers,
+    ClearBufferTo*Values, regions, and dispatches using data bound with BindConstantData. Recorded commands are not
+    profiled with #kDeviceFlagEnableProfiling.
+
+    The recording belongs to the calling thread. A recording starts with nothing bound, and the bindings set during
+    it don't affect the bindings of the Device or other recordings. Different threads can make their recordings in
+    parallel, each between its own BeginRecording and EndRecording, while one thread at a time calls the other
+    functions of the Device, for example Execute.
+    */
+    Result BeginRecording();
+    /// Finishes the recording started with BeginRecording on the calling thread and returns it. Destroy it with `delete`.
+    Result EndRecording(Recording*& out_recording);
+    /** \brief Executes the commands captured in the recording, after the commands called before.
+
+    Costs little CPU time, as the commands are already recorded in a command list, which is submitted again.
+    Commands called since the last submission, if any, are submitted first. Recordings executed one after another
+    are submitted together in one `ExecuteCommandLists`. The buffers it uses must not be mapped.
+    */
+    Result Execute(Recording& recording);
 
 private:
     DeviceImpl* impl_ = nullptr;
@@ -459,6 +1194,32 @@ private:
     JD3D12_NO_COPY_NO_MOVE_CLASS(Device)
 };
 
+/** \brief Helper object that calls Device::BeginRegion in the constructor and Device::EndRegion in the destructor.
+
+\code
+{
+    jd3d12::ScopedRegion region{*dev, L"Simulation step"};
+    dev->DispatchComputeShader(*shader, group_count);
+}
+\endcode
+*/
+class ScopedRegion
+{
+public:
+    ScopedRegion(Device& dev, const wchar_t* name) : dev_{dev}, begun_{Succeeded(dev.BeginRegion(name))} { }
+    ~ScopedRegion()
+    {
+        if(begun_)
+            dev_.EndRegion();
+    }
+
+private:
+    Device& dev_;
+    const bool begun_;
+
+    JD3D12_NO_COPY_NO_MOVE_CLASS(ScopedRegion)
+};
+
 /// Abstract base class for #StaticShaderFromMemory, #StaticShaderFromFile.
 class StaticShader
 {
@@ -703,6 +1464,28 @@ enum EnvironmentFlags : uint32_t
     It can reduce performance overhead of the Debug Layer.
     */
     kEnvironmentFlagDisableD3d12StateTracking = 0x80u,
+    /** Writes log messages asynchronously on a background thread.
+
+    With this flag, a thread logging a message only formats it and puts it into a bounded queue of
+    EnvironmentDesc::async_log_capacity messages, without waiting for the standard output, debug output, log file,
+    or the log callback. A background thread takes the messages from the queue and writes them in the order
+    they were posted. Messages remaining in the queue are written when the #Environment is destroyed.
+
+    When the queue is full, new messages are dropped instead of blocking the calling thread.
+    Environment::GetDroppedLogMessageCount() returns their number, and a warning is logged about them.
+
+    EnvironmentDesc::log_callback is then called only from the background thread.
+    */
+    kEnvironmentFlagAsyncLogging = 0x100u,
+};
+
+/// Counters of the shader compilations of an #Environment, returned by Environment::GetShaderCompilationStatistics.
+struct ShaderCompilationStatistics
+{
+    // Number of times DXC was invoked to compile a shader.
+    uint64_t dxc_compilation_count = 0;
+    // Number of compilations whose bytecode was found in the shader cache, without invoking DXC.
+    uint64_t shader_cache_hit_count = 0;
 };
 
 /// To be used with EnvironmentDesc::log_callback.
@@ -775,6 +1558,55 @@ struct EnvironmentDesc
     /** \brief Custom pointer to be passed back to the `log_callback` function, which can be used for any purpose.
     */
     void* log_callback_context = nullptr;
+    /** \brief Maximum number of messages waiting in the queue when #kEnvironmentFlagAsyncLogging is used.
+
+    It is rounded up to a power of two. Memory for the messages is bounded by this number.
+    */
+    uint32_t async_log_capacity = 1024;
+    /** \brief Path to a directory where compiled shader bytecode will be cached.
+
+    Using non-null and non-empty string here enables the shader cache. Each shader compiled with success is
+    stored both in memory and as a file in this directory, so compiling the same shader again - also in a later
+    run of the program - returns the bytecode without invoking the compiler. The directory is created if it
+    doesn't exist. If creating it fails, a warning is issued and the initialization continues without the cache.
+
+    The cache key includes the HLSL source, the compilation parameters including the entry point, macro defines,
+    and additional DXC arguments, as well as the version of the compiler. Files included by the shader are
+    checked for changes before a cached entry is used. Warnings printed by the compiler are not stored, so they
+    are not reported again when the shader comes from the cache.
+    */
+    const wchar_t* shader_cache_directory = nullptr;
+};
+
+/// Information about a GPU available in the system, returned by Environment::GetAdapterDesc.
+struct AdapterDesc
+{
+    /// Name of the GPU, null-terminated.
+    wchar_t description[128];
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t sub_sys_id;
+    uint32_t revision;
+    /// Locally unique identifier of the adapter, which stays the same until the system is restarted.
+    uint64_t luid;
+    size_t dedicated_video_memory;
+    size_t dedicated_system_memory;
+    size_t shared_system_memory;
+    /// True for a software adapter like WARP.
+    bool is_software;
+    /** \brief True if the adapter supports feature level 12_1, so a #Device can be created on it.
+
+    The members below are valid only if this is true.
+    */
+    bool is_supported;
+    /// Unified memory architecture, typical for integrated GPUs.
+    bool is_uma;
+    bool is_cache_coherent_uma;
+    ShaderModel highest_shader_model;
+    /// Value of `D3D12_RESOURCE_BINDING_TIER`.
+    uint32_t resource_binding_tier;
+    /// See #kDeviceFlagPreferGpuUploadHeap.
+    bool gpu_upload_heap_supported;
 };
 
 class Environment
@@ -791,6 +1623,15 @@ public:
     /// Returns `ID3D12DeviceFactory*`.
     void* GetD3D12DeviceFactory() const noexcept;
 
+    /// Returns the number of GPUs available in the system. Use with DeviceDesc::adapter_index.
+    uint32_t GetAdapterCount() const noexcept;
+    /** \brief Returns information about a GPU available in the system.
+
+    `adapter_index` must be less than GetAdapterCount(). Querying the supported features creates a temporary
+    D3D12 device on the adapter when called for it for the first time, so it may take some time.
+    */
+    Result GetAdapterDesc(uint32_t adapter_index, AdapterDesc& out_desc);
+
     /** \brief Posts a custom message to the logging system.
 
     If no logging was enabled using `kEnvironmentFlagLog*` flags, or specified `severity` was not included
@@ -806,6 +1647,13 @@ public:
     `%s` means `const wchar_t*` string.
     */
     void LogF(LogSeverity severity, const wchar_t* format, ...);
+    /** \brief Returns the number of log messages lost because the queue of #kEnvironmentFlagAsyncLogging was full.
+
+    It is always 0 when this flag is not used.
+    */
+    uint64_t GetDroppedLogMessageCount() const noexcept;
+    /// Returns the counters of the shader compilations done so far by all the functions compiling HLSL.
+    void GetShaderCompilationStatistics(ShaderCompilationStatistics& out_stats) const noexcept;
 
     /** \brief Creates the main #Device object, initializing selected GPU to prepare it for work.
     */
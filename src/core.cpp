@@ -10,6 +10,8 @@
 #include <jd3d12/config.hpp>
 #include "logger.hpp"
 #include "internal_utils.hpp"
+#include "primitive_shaders.hpp"
+#include "format_conversion.hpp"
 
 namespace jd3d12
 {
@@ -65,6 +67,94 @@ enum class BufferStrategy
 {
     kNone, kUpload, kGpuUpload, kDefault, kReadback
 };
+constexpr size_t kBufferStrategyHeapTypeCount = 4; // All except kNone.
+
+// Power-of-2 buddy allocator of offsets within a block. Doesn't allocate the memory itself.
+class BuddyAllocator
+{
+public:
+    // total_size and min_size must be powers of 2.
+    void Init(size_t total_size, size_t min_size);
+
+    size_t GetTotalSize() const noexcept { return total_size_; }
+    size_t GetUsedSize() const noexcept { return used_size_; }
+    size_t GetLargestFreeSize() const noexcept;
+    // Returns the size of the node that would be allocated for given size.
+    size_t GetAllocationSize(size_t size) const noexcept { return total_size_ >> GetLevelForSize(size); }
+    bool IsEmpty() const noexcept { return used_size_ == 0; }
+
+    // Returns false if there is no free space.
+    bool Allocate(size_t size, size_t& out_offset);
+    void Free(size_t offset, size_t size);
+
+private:
+    size_t total_size_ = 0;
+    size_t min_size_ = 0;
+    uint32_t level_count_ = 0;
+    size_t used_size_ = 0;
+    // Level 0 is the whole block, level i has nodes of size total_size_ >> i.
+    std::vector<std::unordered_set<size_t>> free_offsets_;
+
+    uint32_t GetLevelForSize(size_t size) const noexcept;
+};
+
+struct BufferHeapAllocation
+{
+    ID3D12Heap* heap = nullptr;
+    uint32_t block_index = UINT32_MAX;
+    size_t offset = 0;
+    size_t size = 0; // Requested size.
+    // The memory was used by another buffer before, so unlike a new block, it is not zero.
+    bool needs_zeroing = false;
+};
+
+// Serves buffers as placed resources from big ID3D12Heap blocks of one heap type.
+// Also counts committed buffers of that heap type for the statistics.
+class BufferHeapAllocator : public DeviceObject
+{
+public:
+    static constexpr size_t kBlockSize = 32 * kMegabyte;
+    static constexpr size_t kMinAllocationSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    // Bigger buffers always get a committed resource.
+    static constexpr size_t kMaxAllocationSize = kBlockSize / 4;
+
+    BufferHeapAllocator(DeviceImpl* device, const wchar_t* device_name, D3D12_HEAP_TYPE heap_type)
+        : DeviceObject{device, device_name}
+        , heap_type_{heap_type}
+    {
+    }
+    ~BufferHeapAllocator();
+
+    Result Allocate(size_t size, BufferHeapAllocation& out_allocation);
+    void Free(const BufferHeapAllocation& allocation);
+    void RegisterCommittedBuffer(size_t size);
+    void UnregisterCommittedBuffer(size_t size);
+    void AddStatistics(MemoryStatistics& inout_stats, size_t& inout_free_size,
+        size_t& inout_largest_free_size) const;
+
+private:
+    struct Block
+    {
+        CComPtr<ID3D12Heap> heap;
+        BuddyAllocator allocator;
+        size_t allocation_count = 0;
+        // One per kMinAllocationSize of the block: whether it was ever allocated.
+        std::vector<bool> page_used;
+    };
+
+    const D3D12_HEAP_TYPE heap_type_;
+    mutable std::mutex mutex_;
+    // Null entries are empty slots left by freed blocks.
+    std::vector<std::unique_ptr<Block>> blocks_;
+    size_t placed_buffer_count_ = 0;
+    size_t placed_buffer_bytes_ = 0;
+    size_t committed_buffer_count_ = 0;
+    size_t committed_buffer_bytes_ = 0;
+
+    Result CreateBlock(uint32_t& out_block_index);
+
+    JD3D12_NO_COPY_NO_MOVE_CLASS(BufferHeapAllocator)
+};
 
 class BufferImpl : public DeviceObject
 {
@@ -72,6 +162,10 @@ public:
     BufferImpl(Buffer* interface_obj, DeviceImpl* device, const BufferDesc& desc);
     ~BufferImpl() override;
     Result Init(ConstDataSpan initial_data);
+    // Initializes the buffer with initial_data_size bytes read from the current position in the file.
+    Result InitFromFile(HANDLE file, size_t initial_data_size);
+    // Initializes the buffer as a placed resource at the beginning of a heap shared with other buffers.
+    Result InitAliased(ID3D12Heap* heap);
 
     size_t GetSize() const noexcept { return desc_.size; }
     uint32_t GetFlags() const noexcept { return desc_.flags; }
@@ -79,6 +173,12 @@ public:
     size_t GetStructureSize() const noexcept { return desc_.structure_size; }
     size_t GetElementSize() const noexcept;
     ID3D12Resource* GetD3D12Resource() const noexcept { return resource_; }
+    uint32_t GetBindlessSrvIndex() const noexcept { return bindless_srv_index_; }
+    uint32_t GetBindlessUavIndex() const noexcept { return bindless_uav_index_; }
+
+    // Fill a view of given byte range. The buffer must be typed, structured, or byte address.
+    void FillSrvDesc(Range byte_range, D3D12_SHADER_RESOURCE_VIEW_DESC& out_desc) const;
+    void FillUavDesc(Range byte_range, D3D12_UNORDERED_ACCESS_VIEW_DESC& out_desc) const;
 
 private:
     Buffer* const interface_obj_;
@@ -87,15 +187,44 @@ private:
     CComPtr<ID3D12Resource> resource_;
     void* persistently_mapped_ptr_ = nullptr;
     bool is_user_mapped_ = false;
+    // Set while the buffer is acquired with AcquireTransientBuffer and not released yet.
+    bool is_transient_acquired_ = false;
+    // Number of Recording objects that use this buffer. It must not be destroyed while any of them exists.
+    // Atomic, as recordings can be ended on multiple threads.
+    std::atomic<uint32_t> recording_ref_count_{ 0 };
+    // Fence values of the newest command batches that read and wrote this buffer on the GPU. 0 if never.
+    uint64_t last_read_fence_value_ = 0;
+    uint64_t last_write_fence_value_ = 0;
+    // Same for the batches of the async copy queue, if used, which signal a separate fence.
+    uint64_t last_copy_queue_read_fence_value_ = 0;
+    uint64_t last_copy_queue_write_fence_value_ = 0;
+    // Incremented whenever a GPU write to the buffer is recorded, on any queue.
+    uint64_t gpu_write_count_ = 0;
+    // Set if the buffer is a placed resource. Otherwise the resource is committed.
+    BufferHeapAllocation heap_allocation_;
+    // Null for a buffer initialized with InitAliased, whose memory is owned by the device.
+    BufferHeapAllocator* heap_allocator_ = nullptr;
+    // Persistent descriptors in the shader-visible heap, created only with kDeviceFlagBindless.
+    uint32_t bindless_srv_index_ = UINT32_MAX;
+    uint32_t bindless_uav_index_ = UINT32_MAX;
+    // Only with kDeviceFlagEnableResidencyManagement, for committed buffers in the DEFAULT heap.
+    bool is_residency_managed_ = false;
+    // Set while the resource is evicted. Changed only when a batch is submitted, under DeviceImpl::residency_mutex_.
+    bool is_evicted_ = false;
 
     Result InitParameters(size_t initial_data_size);
+    // Creates the resource and its descriptors, without the initial data.
+    Result CreateResource(size_t initial_data_size, ID3D12Heap* aliasing_heap = nullptr);
+    Result CreateBindlessDescriptors();
     static D3D12_RESOURCE_STATES GetInitialState(D3D12_HEAP_TYPE heap_type);
 
     Result WriteInitialData(ConstDataSpan initial_data);
+    Result WriteInitialDataFromFile(HANDLE file, size_t size);
 
     friend class Buffer;
     friend class StaticBuffer;
     friend class DeviceImpl;
+    friend class RecordingImpl;
     JD3D12_NO_COPY_NO_MOVE_CLASS(BufferImpl)
 };
 
@@ -114,8 +243,13 @@ private:
     ShaderDesc desc_ = {};
     UintVec3 thread_group_size_ = {};
     CComPtr<ID3D12PipelineState> pipeline_state_;
+    // Number of Recording objects that use this shader. It must not be destroyed while any of them exists.
+    // Atomic, as recordings can be ended on multiple threads.
+    std::atomic<uint32_t> recording_ref_count_{ 0 };
 
     friend class Device;
+    friend class DeviceImpl;
+    friend class RecordingImpl;
     JD3D12_NO_COPY_NO_MOVE_CLASS(ShaderImpl)
 };
 
@@ -130,7 +264,8 @@ public:
         , shader_visible_{shader_visible}
     {
     }
-    Result Init(const wchar_t* device_name);
+    // persistent_count descriptors after the static ones are reserved for AllocatePersistent.
+    Result Init(const wchar_t* device_name, uint32_t partition_count, uint32_t persistent_count);
 
     ID3D12DescriptorHeap* GetDescriptorHeap() const noexcept { return descriptor_heap_; }
     D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandleBase() const noexcept { JD3D12_ASSERT(shader_visible_); return gpu_handle_; }
@@ -138,8 +273,17 @@ public:
     D3D12_GPU_DESCRIPTOR_HANDLE GetGpuHandleForDescriptor(uint32_t index) const noexcept;
     D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandleForDescriptor(uint32_t index) const noexcept;
 
-    void ClearDynamic();
-    HRESULT AllocateDynamic(uint32_t& out_index);
+    // Dynamic descriptors are split into equal partitions, one per command batch, so a batch being recorded
+    // never overwrites descriptors that a batch still executing on the GPU may use.
+    void ClearDynamic(uint32_t partition_index);
+    HRESULT AllocateDynamic(uint32_t partition_index, uint32_t& out_index);
+    uint32_t GetFreeDynamicCount(uint32_t partition_index) const noexcept;
+    uint32_t GetPartitionSize() const noexcept { return partition_size_; }
+
+    // Persistent descriptors live until freed, e.g. for the whole lifetime of a buffer.
+    HRESULT AllocatePersistent(uint32_t& out_index);
+    void FreePersistent(uint32_t index);
+    void GetPersistentCounts(uint32_t& out_count, uint32_t& out_peak_count);
 
 private:
     const bool shader_visible_ = false;
@@ -147,7 +291,107 @@ private:
     CComPtr<ID3D12DescriptorHeap> descriptor_heap_;
     D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle_ = {};
     D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle_ = {};
-    uint32_t next_dynamic_descriptor_index_ = kStaticDescriptorCount;
+    uint32_t partition_size_ = 0;
+    std::vector<uint32_t> next_dynamic_descriptor_indices_;
+    uint32_t persistent_count_ = 0;
+    // Buffers can be created and destroyed from multiple threads.
+    std::mutex persistent_mutex_;
+    uint32_t next_persistent_index_ = 0;
+    std::vector<uint32_t> free_persistent_indices_;
+
+    uint32_t GetDynamicBase() const noexcept { return kStaticDescriptorCount + persistent_count_; }
+};
+
+// Linear allocator over a persistently mapped buffer in the UPLOAD heap, used as a ring.
+// Each allocation is tagged with the fence value of the command batch that reads it, and it is recycled once
+// the GPU reaches that value.
+class UploadRing : public DeviceObject
+{
+public:
+    UploadRing(DeviceImpl* device, const wchar_t* device_name)
+        : DeviceObject{device, device_name}
+    {
+    }
+    Result Init(const wchar_t* device_name, size_t size);
+
+    ID3D12Resource* GetResource() const noexcept { return resource_; }
+    size_t GetSize() const noexcept { return size_; }
+    // Fence value of the oldest allocation still in use, or 0 if the ring is empty.
+    uint64_t GetOldestFenceValue() const noexcept { return regions_.empty() ? 0 : regions_.front().fence_value; }
+
+    // Returns kNotReady if there is not enough free space until older allocations are retired.
+    Result Allocate(size_t size, size_t alignment, uint64_t fence_value, size_t& out_offset, void*& out_ptr);
+    void Retire(uint64_t completed_fence_value);
+
+private:
+    struct Region
+    {
+        uint64_t fence_value;
+        size_t end_offset;
+        size_t byte_count; // Including padding and the space wasted when wrapping around.
+    };
+
+    CComPtr<ID3D12Resource> resource_;
+    char* mapped_ptr_ = nullptr;
+    size_t size_ = 0;
+    // Allocations are made at head_ and retired at tail_.
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    size_t used_size_ = 0;
+    std::deque<Region> regions_;
+};
+
+/* Optional queue of type COPY, created with kDeviceFlagEnableCopyQueue. Copies recorded on it run on the copy
+engines of the GPU, in parallel with the main compute queue. It has its own ring of command lists and its own fence.
+There are no automatic state promotions other than from COMMON within a command list, so TransitionResource records
+the barrier when a buffer is used again in a different state.
+*/
+class CopyQueue : public DeviceObject
+{
+public:
+    CopyQueue(DeviceImpl* device, const wchar_t* device_name)
+        : DeviceObject{device, device_name}
+    {
+    }
+    Result Init(const wchar_t* device_name, uint32_t batch_count, ID3D12Fence* compute_fence);
+
+    ID3D12Fence* GetFence() const noexcept { return fence_; }
+    uint64_t GetSubmittedFenceValue() const noexcept { return submitted_fence_value_; }
+    // Fence value that the batch currently being recorded will signal.
+    uint64_t GetRecordingFenceValue() const noexcept { return submitted_fence_value_ + 1; }
+    uint64_t GetCompletedFenceValue() const { return fence_->GetCompletedValue(); }
+
+    // Starts recording a new batch if none is open, waiting for the GPU to finish the batch it reuses.
+    Result BeginRecording(ID3D12GraphicsCommandList*& out_command_list);
+    // The batch being recorded will wait on the GPU for the compute queue to reach fence_value before it starts.
+    void AddComputeQueueWait(uint64_t fence_value);
+    void TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES state);
+    // Submits the batch being recorded, if any.
+    Result Submit();
+    // Waits on the CPU until the fence reaches fence_value, which must be already submitted.
+    Result WaitForFenceValue(uint64_t fence_value, uint32_t timeout_milliseconds);
+    Result WaitForIdle();
+
+private:
+    struct Batch
+    {
+        CComPtr<ID3D12CommandAllocator> command_allocator;
+        CComPtr<ID3D12GraphicsCommandList> command_list;
+        uint64_t fence_value = 0;
+    };
+
+    CComPtr<ID3D12CommandQueue> command_queue_;
+    CComPtr<ID3D12Fence> fence_;
+    std::unique_ptr<HANDLE, CloseHandleDeleter> fence_event_;
+    // Fence of the main compute queue.
+    ID3D12Fence* compute_fence_ = nullptr;
+    std::vector<Batch> batches_;
+    uint32_t current_batch_index_ = 0;
+    bool is_recording_ = false;
+    uint64_t submitted_fence_value_ = 0;
+    uint64_t compute_wait_fence_value_ = 0;
+    // States of the resources used by the batch being recorded.
+    std::unordered_map<ID3D12Resource*, D3D12_RESOURCE_STATES> resource_states_;
 };
 
 enum ResourceUsageFlags
@@ -170,6 +414,74 @@ public:
     bool IsUsed(BufferImpl* buf, uint32_t usage_flags) const;
 };
 
+// Raw views cover whole buffers as byte address buffers, for the built-in primitives.
+enum class ViewType { kCBV, kSRV, kUAV, kRawSRV, kRawUAV };
+
+// Identifies a descriptor created for a buffer binding, so identical views are reused within a batch.
+struct ViewKey
+{
+    BufferImpl* buffer = nullptr;
+    Range byte_range = kEmptyRange;
+    ViewType type = ViewType::kCBV;
+
+    bool operator==(const ViewKey& rhs) const noexcept
+    {
+        return buffer == rhs.buffer && byte_range.first == rhs.byte_range.first
+            && byte_range.count == rhs.byte_range.count && type == rhs.type;
+    }
+};
+
+struct ViewKeyHasher
+{
+    size_t operator()(const ViewKey& key) const noexcept
+    {
+        size_t hash = std::hash<BufferImpl*>{}(key.buffer);
+        hash = hash * 31 + std::hash<size_t>{}(key.byte_range.first);
+        hash = hash * 31 + std::hash<size_t>{}(key.byte_range.count);
+        return hash * 31 + size_t(key.type);
+    }
+};
+
+// GPU time of one command recorded with kDeviceFlagEnableProfiling.
+struct ProfileRecord
+{
+    std::wstring label;
+    std::wstring shader_name;
+    UintVec3 group_count = {};
+    // Number of regions open when the command was recorded.
+    uint32_t depth = 0;
+    bool is_region = false;
+    uint64_t begin_timestamp = 0;
+    uint64_t end_timestamp = 0;
+};
+
+// One slot of the command ring in DeviceImpl.
+struct CommandBatch
+{
+    CComPtr<ID3D12CommandAllocator> command_allocator;
+    CComPtr<ID3D12GraphicsCommandList2> command_list;
+    // Only when enhanced barriers are supported.
+    CComPtr<ID3D12GraphicsCommandList7> command_list7;
+    // Value of the device fence signaled when this batch completes on the GPU. 0 if never submitted.
+    uint64_t fence_value = 0;
+    // Fence value of the copy queue this batch waits for on the GPU before it starts. 0 if none.
+    uint64_t copy_queue_wait_fence_value = 0;
+    // Valid while the batch is recorded or executing. Cleared when the batch is retired.
+    ResourceUsageMap resource_usage_map;
+    std::unordered_set<ShaderImpl*> shader_usage_set;
+    // Descriptors in this batch's partition of the shader-visible heap, cleared when the batch is reset.
+    std::unordered_map<ViewKey, uint32_t, ViewKeyHasher> view_cache;
+    // Only with kDeviceFlagEnableProfiling: 2 timestamps per command, resolved to the readback buffer
+    // when the batch is submitted and collected when it is retired.
+    CComPtr<ID3D12QueryHeap> timestamp_query_heap;
+    CComPtr<ID3D12Resource> timestamp_readback_buffer;
+    std::vector<ProfileRecord> profile_records;
+    // Recordings passed to Device::Execute, submitted before command_list in the same ExecuteCommandLists.
+    std::vector<RecordingImpl*> recordings;
+    // Commands recorded in this batch, including the executed recordings. Added to the device totals on submission.
+    CommandStatistics statistics;
+};
+
 class MainRootSignature : public DeviceObject
 {
 public:
@@ -190,22 +502,82 @@ public:
     {
         return kMaxCBVCount + kMaxSRVCount + uav_index;
     }
+    // Device::kMaxRootConstantCount root constants at register(b1, space1).
+    static constexpr uint32_t kRootConstantsRootParamIndex = kTotalParamCount;
+    // Only in bindless mode: Device::kMaxBindlessIndexCount root constants at register(b0, space1).
+    static constexpr uint32_t kBindlessIndicesRootParamIndex = kTotalParamCount + 1;
+    /* Only without bindless mode: thread offset and thread count of the dispatch, as 2x uint4 at
+    register(b2, space1). Bindless mode uses the whole budget of the root signature, so there is no room for them.
+    */
+    static constexpr uint32_t kDispatchParamsRootParamIndex = kTotalParamCount + 1;
+    static constexpr uint32_t kDispatchParamCount = 8;
+    // Root signature is limited to 64 DWORDs. Descriptor tables take 1 DWORD each.
+    static_assert(kTotalParamCount + Device::kMaxRootConstantCount + Device::kMaxBindlessIndexCount <= 64,
+        "Root signature too big.");
+    static_assert(kTotalParamCount + Device::kMaxRootConstantCount + kDispatchParamCount <= 64,
+        "Root signature too big.");
 
     MainRootSignature(DeviceImpl* device) : DeviceObject{device, nullptr} {}
     ID3D12RootSignature* GetRootSignature() const noexcept { return root_signature_; }
-    Result Init();
+    // Hash of the serialized root signature.
+    uint64_t GetHash() const noexcept { return hash_; }
+    // For ExecuteIndirect with a single D3D12_DISPATCH_ARGUMENTS, used by Device::DispatchIndirect.
+    ID3D12CommandSignature* GetDispatchCommandSignature() const noexcept { return dispatch_command_signature_; }
+    Result Init(bool bindless);
 
 private:
     CComPtr<ID3D12RootSignature> root_signature_;
+    CComPtr<ID3D12CommandSignature> dispatch_command_signature_;
+    uint64_t hash_ = 0;
 
     JD3D12_NO_COPY_NO_MOVE_CLASS(MainRootSignature)
 };
 
+/* Wrapper over ID3D12PipelineLibrary1 loaded from and saved to DeviceDesc::pipeline_library_file_path.
+Pipeline states are named by a hash of the shader bytecode and the root signature. Thread-safe.
+*/
+class PipelineLibrary : public DeviceObject
+{
+public:
+    PipelineLibrary(DeviceImpl* device) : DeviceObject{device, nullptr} {}
+    Result Init(const wchar_t* file_path);
+    // Loads the pipeline state from the library or creates it and stores it in the library.
+    Result CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, uint64_t root_signature_hash,
+        CComPtr<ID3D12PipelineState>& out_pipeline_state);
+    // Saves the library back to the file, if any new pipeline states were stored.
+    void Save();
+
+private:
+    FileSystemPath file_path_;
+    // Data loaded from the file. It must stay alive as long as library_.
+    std::unique_ptr<char[]> file_data_;
+    CComPtr<ID3D12PipelineLibrary1> library_;
+    std::mutex mutex_;
+    bool modified_ = false;
+
+    JD3D12_NO_COPY_NO_MOVE_CLASS(PipelineLibrary)
+};
+
 struct Binding
 {
     BufferImpl* buffer = nullptr;
     Range byte_range = kFullRange;
     uint32_t descriptor_index = UINT32_MAX;
+    // Whether the root descriptor table for this slot is already set on the current command list.
+    bool root_argument_set = false;
+    // Only for UAV slots: kBindFlagNoUavHazard.
+    bool no_uav_hazard = false;
+    // Only for SRV and UAV slots bound by the built-in primitives: the view is ViewType::kRawSRV or kRawUAV.
+    bool raw_view = false;
+    // Only for CBV slots bound with Device::BindConstantData. Then buffer is null and the data is copied
+    // to the upload ring once per batch, with descriptor_index pointing to its CBV.
+    std::vector<char> constant_data;
+};
+
+struct BindlessBinding
+{
+    BufferImpl* buffer = nullptr;
+    bool writable = false;
 };
 
 struct BindingState
@@ -213,17 +585,153 @@ struct BindingState
     Binding cbv_bindings_[MainRootSignature::kMaxCBVCount];
     Binding srv_bindings_[MainRootSignature::kMaxSRVCount];
     Binding uav_bindings_[MainRootSignature::kMaxUAVCount];
-
+    BindlessBinding bindless_bindings_[Device::kMaxBindlessIndexCount];
+    uint32_t bindless_indices_[Device::kMaxBindlessIndexCount];
+    bool bindless_indices_dirty_ = true;
+    uint32_t root_constants_[Device::kMaxRootConstantCount] = {};
+    bool root_constants_dirty_ = true;
+    // Not used in bindless mode. Set by every dispatch, not by the user.
+    uint32_t dispatch_params_[MainRootSignature::kDispatchParamCount] = {};
+    bool dispatch_params_dirty_ = true;
+    // Whether descriptor heaps and the root signature are set on the current command list.
+    bool root_signature_set_ = false;
+
+    BindingState() { ResetBindlessIndices(); }
+    // Called when a new command list starts recording.
     void ResetDescriptors();
+    void ResetBindlessIndices();
     bool IsBufferBound(BufferImpl* buf);
 };
 
+// Barrier added by DeviceImpl::UseBuffer, recorded by DeviceImpl::FlushBarriers.
+struct PendingBarrier
+{
+    ID3D12Resource* resource = nullptr;
+    // Both equal to D3D12_RESOURCE_STATE_UNORDERED_ACCESS mean a UAV barrier.
+    D3D12_RESOURCE_STATES state_before = D3D12_RESOURCE_STATE_COMMON;
+    D3D12_RESOURCE_STATES state_after = D3D12_RESOURCE_STATE_COMMON;
+};
+
+/* Commands captured between Device::BeginRecording and Device::EndRecording. While capturing, it replaces
+the current batch of the device for the calling thread, so the commands are recorded the same way, but into its
+own command list, which is then closed and submitted again by every Device::Execute. Descriptors are persistent
+instead of dynamic. Buffers start every command list in the COMMON state, and the recording transitions them back
+to it at the end, so the barriers recorded inside stay valid for each execution.
+*/
+class RecordingImpl : public DeviceObject
+{
+public:
+    RecordingImpl(Recording* interface_obj, DeviceImpl* device);
+    ~RecordingImpl();
+    Result Init();
+
+private:
+    Recording* const interface_obj_;
+    // resource_usage_map and shader_usage_set hold everything the recorded commands use.
+    CommandBatch batch_;
+    // Persistent descriptors in the shader-visible heap, freed with the recording.
+    std::vector<uint32_t> descriptor_indices_;
+    // Fence value of the newest command batch that executes the recording. 0 if never executed.
+    uint64_t last_fence_value_ = 0;
+    // Set by Device::EndRecording, which adds the references to the buffers and shaders.
+    bool ended_ = false;
+    // Separate from the device's, so each thread can record its own recording in parallel.
+    BindingState binding_state_;
+    std::vector<PendingBarrier> pending_barriers_;
+
+    friend class DeviceImpl;
+    JD3D12_NO_COPY_NO_MOVE_CLASS(RecordingImpl)
+};
+
+/* HLSL source with permutation axes. A variant is identified by a key made of the value indices of all the axes,
+as digits of a mixed-radix number, the first axis being the least significant. Variants are compiled outside of
+the mutex, so different ones can be compiled on multiple threads at once, while a thread requesting a variant
+already in progress waits for it. Shaders are created one at a time, under create_mutex_, so identical bytecode
+never creates two pipeline states.
+*/
+class ShaderFamilyImpl : public DeviceObject
+{
+public:
+    ShaderFamilyImpl(ShaderFamily* interface_obj, DeviceImpl* device, const ShaderFamilyDesc& desc);
+    ~ShaderFamilyImpl();
+    Result Init(const ShaderFamilyDesc& desc);
+
+    uint32_t GetAxisCount() const noexcept { return uint32_t(axes_.size()); }
+    uint64_t GetPermutationCount() const noexcept { return permutation_count_; }
+    Result GetShader(ArraySpan<const uint32_t> value_indices, Shader*& out_shader);
+    Result Prewarm(ArraySpan<const uint32_t> value_indices, uint32_t thread_count);
+    Result WaitForPrewarm();
+    size_t GetVariantCount() const noexcept;
+    size_t GetUniqueShaderCount() const noexcept;
+
+private:
+    struct Axis
+    {
+        std::wstring macro_name;
+        // Empty for a feature toggle.
+        std::vector<std::wstring> values;
+
+        uint32_t GetValueCount() const noexcept { return values.empty() ? 2 : uint32_t(values.size()); }
+    };
+    struct Variant
+    {
+        // Null if the creation is pending or failed.
+        Shader* shader = nullptr;
+        Result result = kSuccess;
+        bool is_pending = true;
+    };
+    struct UniqueShader
+    {
+        std::vector<char> bytecode;
+        std::unique_ptr<Shader> shader;
+    };
+    // Keys of the variants to create by the threads started with one call to Prewarm.
+    struct PrewarmJob
+    {
+        std::vector<uint64_t> keys;
+        std::atomic<size_t> next_key_index{ 0 };
+    };
+
+    ShaderFamily* const interface_obj_;
+    // Copies of all the strings and arrays from the desc. compilation_params_ points to them.
+    ShaderCompilationParams compilation_params_;
+    std::wstring entry_point_;
+    std::vector<std::wstring> macro_defines_;
+    std::vector<std::wstring> additional_dxc_args_;
+    std::vector<const wchar_t*> additional_dxc_arg_ptrs_;
+    std::wstring hlsl_source_file_path_;
+    std::vector<char> hlsl_source_;
+    std::vector<Axis> axes_;
+    uint64_t permutation_count_ = 1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable variant_created_cv_;
+    std::unordered_map<uint64_t, Variant> variants_;
+    size_t created_variant_count_ = 0;
+    std::vector<std::thread> prewarm_threads_;
+    Result prewarm_result_ = kSuccess;
+    std::atomic<bool> cancel_prewarm_{ false };
+
+    std::mutex create_mutex_;
+    // Keyed by the hash of the bytecode. unique_shader_count_ mirrors its size, to be read without the lock.
+    std::unordered_multimap<uint64_t, UniqueShader> unique_shaders_;
+    std::atomic<size_t> unique_shader_count_{ 0 };
+
+    Result MakeKey(const uint32_t* value_indices, uint64_t& out_key) const;
+    // Returns the variant, creating it if it was never requested, or waiting if another thread creates it.
+    Result GetOrCreateVariant(uint64_t key, Shader*& out_shader);
+    Result CreateVariant(uint64_t key, Shader*& out_shader);
+    void PrewarmThreadMain(std::shared_ptr<PrewarmJob> job);
+};
+
 class ShaderCompilationResultImpl
 {
 public:
     ShaderCompilationResultImpl(ShaderCompilationResult* interface_obj, EnvironmentImpl* env);
     ~ShaderCompilationResultImpl() = default;
     Result Init(CComPtr<IDxcResult>&& dxc_result);
+    // Creates a successful result out of bytecode found in the shader cache.
+    Result InitFromBytecode(CComPtr<IDxcBlob>&& object);
     EnvironmentImpl* GetEnvironment() const noexcept { return env_; }
 
     Result GetResult() { return status_; }
@@ -254,6 +762,14 @@ private:
 class DeviceImpl : public DeviceObject
 {
 public:
+    static constexpr uint32_t kMaxCommandBatchCount = 16;
+    static constexpr size_t kUploadRingAlignment = 64 * kKilobyte;
+    // Smaller copies stay on the compute queue even with kDeviceFlagEnableCopyQueue.
+    static constexpr size_t kMinCopyQueueCopySize = 256 * kKilobyte;
+    // When over the residency budget, buffers are evicted until the usage drops to this fraction of it,
+    // so the next few batches don't need to evict again.
+    static constexpr double kResidencyTargetFraction = 0.9;
+
     DeviceImpl(Device* interface_obj, EnvironmentImpl* env, const DeviceDesc& desc);
     ~DeviceImpl();
     Result Init(bool enable_d3d12_debug_layer);
@@ -261,13 +777,28 @@ public:
     Device* GetInterface() const noexcept { return interface_obj_; }
     EnvironmentImpl* GetEnvironment() const noexcept { return env_; }
     ID3D12Device* GetD3D12Device() const noexcept { return device_; }
+    IDXGIAdapter1* GetDXGIAdapter1() const noexcept { return adapter_; }
     D3D12_FEATURE_DATA_D3D12_OPTIONS16 GetOptions16() const noexcept { return options16_; }
+    bool IsBindless() const noexcept { return (desc_.flags & kDeviceFlagBindless) != 0; }
+    bool IsProfilingEnabled() const noexcept { return (desc_.flags & kDeviceFlagEnableProfiling) != 0; }
+    bool AreCommandMarkersEnabled() const noexcept { return (desc_.flags & kDeviceFlagDisableCommandMarkers) == 0; }
+    bool IsResidencyManagementEnabled() const noexcept
+    {
+        return (desc_.flags & kDeviceFlagEnableResidencyManagement) != 0;
+    }
+    BufferHeapAllocator* GetBufferHeapAllocator(BufferStrategy strategy) const noexcept
+    {
+        JD3D12_ASSERT(strategy != BufferStrategy::kNone);
+        return buffer_heap_allocators_[size_t(strategy) - 1].get();
+    }
 
     Result CreateBuffer(const BufferDesc& desc, Buffer*& out_buffer);
     Result CreateBufferFromMemory(const BufferDesc& desc, ConstDataSpan initial_data,
         Buffer*& out_buffer);
     Result CreateBufferFromFile(const BufferDesc& desc, const wchar_t* initial_data_file_path,
         Buffer*& out_buffer);
+    Result AcquireTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer);
+    void ReleaseTransientBuffer(Buffer* buf);
 
     Result CreateShaderFromMemory(const ShaderDesc& desc, ConstDataSpan bytecode,
         Shader*& out_shader);
@@ -277,15 +808,27 @@ public:
         const ShaderDesc& desc, ConstDataSpan hlsl_source, Shader*& out_shader);
     Result CompileAndCreateShaderFromFile(const ShaderCompilationParams& compilation_params,
         const ShaderDesc& desc, const wchar_t* hlsl_source_file_path, Shader*& out_shader);
+    Result CompileAndCreateShadersBatch(ArraySpan<ShaderBatchItem> items, uint32_t thread_count);
+    Result CreateShaderFamily(const ShaderFamilyDesc& desc, ShaderFamily*& out_family);
 
     Result MapBuffer(BufferImpl& buf, Range byte_range, BufferFlags cpu_usage_flag, void*& out_data_ptr,
         uint32_t command_flags = 0);
     void UnmapBuffer(BufferImpl& buf);
 
+    // With `converter`, the data is converted from the element format of the buffer while it is read.
     Result ReadBufferToMemory(BufferImpl& src_buf, Range src_byte_range, void* dst_memory,
-        uint32_t command_flags = 0);
+        uint32_t command_flags = 0, const FormatConverter* converter = nullptr);
+    Result ReadBufferToMemoryConverted(BufferImpl& src_buf, Range src_byte_range, Format dst_format,
+        void* dst_memory, uint32_t command_flags);
+    Result ReadBufferToMemoryAsync(BufferImpl& src_buf, Range src_byte_range, void* dst_memory,
+        ReadbackTicket& out_ticket, const FormatConverter* converter = nullptr);
+    bool IsReadbackComplete(const ReadbackTicket& ticket);
+    Result WaitForReadback(ReadbackTicket& ticket, uint32_t timeout_milliseconds);
+    // With `converter`, src_data holds elements of its source format, converted while they are written.
     Result WriteMemoryToBuffer(ConstDataSpan src_data, BufferImpl& dst_buf, size_t dst_byte_offset,
-        uint32_t command_flags = 0);
+        uint32_t command_flags = 0, const FormatConverter* converter = nullptr);
+    Result WriteMemoryToBufferConverted(ConstDataSpan src_data, Format src_format, BufferImpl& dst_buf,
+        size_t dst_byte_offset, uint32_t command_flags);
 
     template<typename T>
     Result ReadBufferToValue(Buffer& src_buf, size_t src_byte_offset, T& out_val,
@@ -309,13 +852,162 @@ public:
     Result ClearBufferToUintValues(BufferImpl& buf, const UintVec4& values, Range element_range = kFullRange);
     Result ClearBufferToFloatValues(BufferImpl& buf, const FloatVec4& values, Range element_range = kFullRange);
 
+    Result Reduce(BufferImpl& src_buf, Range src_byte_range, PrimitiveDataType type, ReduceOperation op,
+        BufferImpl& dst_buf, size_t dst_byte_offset);
+    Result Scan(BufferImpl& src_buf, Range src_byte_range, PrimitiveDataType type, bool exclusive,
+        BufferImpl& dst_buf, size_t dst_byte_offset);
+    Result RadixSort(BufferImpl& keys_buf, Range keys_byte_range, BufferImpl* values_buf,
+        size_t values_byte_offset, uint32_t key_bit_count);
+    Result Compact(BufferImpl& src_buf, Range src_byte_range, BufferImpl& flags_buf, size_t flags_byte_offset,
+        BufferImpl& dst_buf, size_t dst_byte_offset, BufferImpl& count_buf, size_t count_byte_offset);
+
     void ResetAllBindings();
     Result BindConstantBuffer(uint32_t b_slot, BufferImpl* buf, Range byte_range = kFullRange);
     Result BindBuffer(uint32_t t_slot, BufferImpl* buf, Range byte_range = kFullRange);
-    Result BindRWBuffer(uint32_t u_slot, BufferImpl* buf, Range byte_range = kFullRange);
+    Result BindRWBuffer(uint32_t u_slot, BufferImpl* buf, Range byte_range = kFullRange, uint32_t bind_flags = 0);
+    Result BindConstantData(uint32_t b_slot, ConstDataSpan data);
+    Result SetRootConstants(ConstDataSpan data, uint32_t first_constant_index);
+    Result BindBindlessBuffer(uint32_t index_slot, BufferImpl* buf);
+    Result BindBindlessRWBuffer(uint32_t index_slot, BufferImpl* buf);
     Result DispatchComputeShader(ShaderImpl& shader, const UintVec3& group_count);
+    Result DispatchThreads(ShaderImpl& shader, const UintVec3& thread_count);
+    Result DispatchIndirect(ShaderImpl& shader, BufferImpl& args_buf, size_t byte_offset);
+
+    Result BeginRecording();
+    Result EndRecording(Recording*& out_recording);
+    Result Execute(RecordingImpl& recording);
+
+    void GetMemoryStatistics(MemoryStatistics& out_stats);
+    Result GetStatistics(DeviceStatistics& out_stats);
+
+    ArraySpan<const ProfiledCommand> GetProfiledCommands();
+    void ClearProfiledCommands();
+    Result SaveProfilingTrace(const wchar_t* file_path);
+
+    Result BeginRegion(const wchar_t* name);
+    Result EndRegion();
 
 private:
+    struct Region
+    {
+        std::wstring name;
+        // Index of the command in the current batch's profile records, or UINT32_MAX if not profiled.
+        uint32_t profiled_command_index = UINT32_MAX;
+    };
+
+    struct PendingReadback
+    {
+        // Null when reading directly from a buffer created with kBufferUsageFlagCpuRead.
+        std::unique_ptr<Buffer> staging_buffer;
+        BufferImpl* src_buffer = nullptr;
+        size_t src_offset = 0;
+        // The read also waits for this fence value of the copy queue. 0 if not needed.
+        uint64_t copy_queue_fence_value = 0;
+        // BufferImpl::gpu_write_count_ of src_buffer when the read was requested, to detect newer writes
+        // when it is read directly.
+        uint64_t src_gpu_write_count = 0;
+        // Empty when the data is copied without conversion.
+        FormatConverter converter;
+    };
+
+    // A transient buffer released with ReleaseTransientBuffer, waiting to be acquired again.
+    struct FreeTransientBuffer
+    {
+        std::unique_ptr<Buffer> buffer;
+        // Fence value of the batch that was being recorded when the buffer was released.
+        uint64_t release_fence_value = 0;
+    };
+
+    // Memory shared by transient buffers with kBufferFlagAliasedMemory, each placed at its beginning.
+    struct TransientMemoryBlock
+    {
+        CComPtr<ID3D12Heap> heap;
+        size_t size = 0;
+        // The buffer currently acquired from this block, or null if the block is free.
+        Buffer* acquired_buffer = nullptr;
+        // Buffers released from this block, from the oldest, kept alive until the GPU finishes using them.
+        std::vector<std::unique_ptr<Buffer>> released_buffers;
+        // Fence value of the batch that was being recorded when the last buffer was released.
+        uint64_t release_fence_value = 0;
+    };
+
+    // Entry points in kPrimitiveShadersHlsl.
+    enum class PrimitiveKernel { kReduce, kScan, kRadixCount, kRadixScatter, kCompactScatter };
+
+    // A buffer used by a primitive shader, with the byte offset where its data starts.
+    struct PrimitiveBuffer
+    {
+        BufferImpl* buffer = nullptr;
+        size_t byte_offset = 0;
+    };
+
+    // One dispatch of a primitive shader, recorded by DispatchPrimitive.
+    struct PrimitiveDispatch
+    {
+        PrimitiveKernel kernel = PrimitiveKernel::kReduce;
+        PrimitiveDataType type = kPrimitiveDataTypeUint;
+        ReduceOperation op = kReduceOperationSum;
+        uint32_t element_count = 0;
+        uint32_t group_count = 0;
+        // Combination of kPrimitiveFlag*.
+        uint32_t flags = 0;
+        // Bound to t0, t1, t2, u0, u1. Unused ones stay null.
+        PrimitiveBuffer buffers[5];
+    };
+
+    /* While it exists, the primitives record their dispatches with their own bindings, and the ones set by the user
+    are restored at the end. Holds the temporary buffers, released after the bindings are restored.
+    */
+    class PrimitiveScope
+    {
+    public:
+        explicit PrimitiveScope(DeviceImpl& device);
+        ~PrimitiveScope();
+        // Acquires a transient byte address buffer for element_count 32-bit elements, released with the scope.
+        Result AcquireScratchBuffer(uint32_t element_count, BufferImpl*& out_buffer);
+
+    private:
+        DeviceImpl& device_;
+        BindingState user_binding_state_;
+        // The user's bindings saved by an outer scope, restored as DeviceImpl::primitive_user_binding_state_.
+        BindingState* outer_user_binding_state_ = nullptr;
+        std::vector<Buffer*> scratch_buffers_;
+
+        JD3D12_NO_COPY_NO_MOVE_CLASS(PrimitiveScope)
+    };
+
+    static constexpr size_t kMinReadbackStagingBufferSize = 64 * kKilobyte;
+    // Limits of free_readback_staging_buffers_. The oldest free buffers are destroyed to stay within them.
+    static constexpr size_t kMaxFreeReadbackStagingBufferCount = 16;
+    static constexpr size_t kMaxFreeReadbackStagingBufferBytes = 64 * kMegabyte;
+    static constexpr size_t kMinTransientBufferSize = 64 * kKilobyte;
+    // Free transient buffers and memory blocks not acquired again for this many batches are destroyed.
+    static constexpr uint64_t kMaxTransientBufferIdleBatchCount = 64;
+    // Descriptors reserved in the shader-visible heap for buffers in bindless mode.
+    static constexpr uint32_t kBindlessDescriptorCount = 16384;
+    // Limit of DeviceDesc::recording_descriptor_count, so at least half of the heap stays for dynamic descriptors.
+    static constexpr uint32_t kMaxRecordingDescriptorCount = 16384;
+    // Writes to GPU memory up to this size use WriteBufferImmediate instead of the upload ring.
+    static constexpr size_t kMaxWriteBufferImmediateSize = 256;
+    // With kDeviceFlagEnableProfiling, the batch is split after this many commands.
+    static constexpr uint32_t kMaxProfiledCommandsPerBatch = 1024;
+    // Limit of nested BeginRegion, which must be much lower than kMaxProfiledCommandsPerBatch.
+    static constexpr uint32_t kMaxRegionDepth = 64;
+    // Must match GROUP_SIZE, BLOCK_SIZE, RADIX_BITS, and FLAG_* in kPrimitiveShadersHlsl.
+    static constexpr uint32_t kPrimitiveGroupSize = 256;
+    static constexpr uint32_t kPrimitiveBlockSize = 2048;
+    static constexpr uint32_t kPrimitiveRadixBits = 4;
+    static constexpr uint32_t kPrimitiveFlagExclusive = 0x1;
+    static constexpr uint32_t kPrimitiveFlagHasPartials = 0x2;
+    static constexpr uint32_t kPrimitiveFlagPredicate = 0x4;
+    static constexpr uint32_t kPrimitiveFlagHasValues = 0x8;
+    static constexpr uint32_t kPrimitiveFlagRadixShiftOffset = 8;
+
+    /* State of the command ring:
+    - kRecording: The current batch is open for recording. Older batches may still be executing.
+    - kExecuting: No batch is open. Some batches may still be executing.
+    - kNone: No batch is open, all submitted batches have completed.
+    */
     enum class CommandListState { kNone, kRecording, kExecuting };
 
     static void StaticDebugLayerMessageCallback(
@@ -328,6 +1020,7 @@ private:
     Device* const interface_obj_;
     EnvironmentImpl* const env_;
     DeviceDesc desc_{};
+    CComPtr<IDXGIAdapter1> adapter_;
     CComPtr<ID3D12Device> device_;
 
     // Optional, can be null if Debug Layer was not enabled.
@@ -335,25 +1028,89 @@ private:
     DWORD debug_layer_callback_cookie_ = UINT32_MAX;
 
     D3D12_FEATURE_DATA_D3D12_OPTIONS16 options16_{};
+    // Use ID3D12GraphicsCommandList7::Barrier instead of ResourceBarrier.
+    bool enhanced_barriers_ = false;
+    // The primitive shaders use wave intrinsics. They need at least 16 lanes, so a group has no more waves than lanes.
+    bool primitive_wave_ops_ = false;
 
     CComPtr<ID3D12CommandQueue> command_queue_;
-    CComPtr<ID3D12CommandAllocator> command_allocator_;
-    CComPtr<ID3D12GraphicsCommandList2> command_list_;
+    // Ring of command batches, so that one batch can be recorded while the previous ones execute.
+    // The current batch is the one being recorded, or the last one submitted.
+    std::vector<CommandBatch> command_batches_;
+    uint32_t current_batch_index_ = 0;
     CommandListState command_list_state_ = CommandListState::kRecording;
     CComPtr<ID3D12Fence> fence_;
     std::unique_ptr<HANDLE, CloseHandleDeleter> fence_event_;
     uint64_t submitted_fence_value_ = 0;
-    // Used in CommandListState::kRecording and kExecuting.
-    ResourceUsageMap resource_usage_map_;
-    std::unordered_set<ShaderImpl*> shader_usage_set_;
+    // Staging buffers for ReadBufferToMemoryAsync not currently in use, from the least recently released.
+    // Their sizes are powers of 2.
+    std::vector<std::unique_ptr<Buffer>> free_readback_staging_buffers_;
+    std::unordered_map<uint64_t, PendingReadback> pending_readbacks_;
+    uint64_t next_readback_id_ = 1;
+    // Transient buffers ready to be acquired again, in the order they were released.
+    std::vector<FreeTransientBuffer> free_transient_buffers_;
+    std::vector<std::unique_ptr<TransientMemoryBlock>> transient_memory_blocks_;
     DescriptorHeap shader_visible_descriptor_heap_;
     DescriptorHeap shader_invisible_descriptor_heap_;
+    UploadRing upload_ring_;
+    // Null if kDeviceFlagEnableCopyQueue is not used.
+    std::unique_ptr<CopyQueue> copy_queue_;
+
+    // Only with kDeviceFlagEnableResidencyManagement.
+    // Guards the members below, as buffers can be created and destroyed on any thread.
+    std::mutex residency_mutex_;
+    std::unordered_set<BufferImpl*> residency_managed_buffers_;
+    size_t resident_managed_bytes_ = 0;
+    size_t evicted_managed_bytes_ = 0;
+    // Set when a buffer is created, so the usage is checked against the budget when the next batch is submitted.
+    bool residency_check_needed_ = false;
+    // Null if not supported, so evicted buffers are made resident with blocking MakeResident.
+    CComPtr<ID3D12Device3> device3_;
+    // Signaled by EnqueueMakeResident, waited for by the command queue.
+    CComPtr<ID3D12Fence> residency_fence_;
+    uint64_t residency_fence_value_ = 0;
+    CComPtr<IDXGIAdapter3> adapter3_;
+    // Signaled by the OS when the video memory budget changes.
+    std::unique_ptr<HANDLE, CloseHandleDeleter> budget_change_event_;
+    DWORD budget_change_cookie_ = 0;
+    // Indexed by BufferStrategy - 1.
+    std::unique_ptr<BufferHeapAllocator> buffer_heap_allocators_[kBufferStrategyHeapTypeCount];
     BindingState binding_state_;
+    // The user's bindings swapped out by the innermost active PrimitiveScope, or null outside of one.
+    BindingState* primitive_user_binding_state_ = nullptr;
 
     std::unique_ptr<MainRootSignature> main_root_signature_;
+    // Null if DeviceDesc::pipeline_library_file_path is not used.
+    std::unique_ptr<PipelineLibrary> pipeline_library_;
+
+    // Only with kDeviceFlagEnableProfiling.
+    uint64_t timestamp_frequency_ = 0;
+    // The first timestamp ever collected, which becomes time 0 of the results.
+    uint64_t base_timestamp_ = UINT64_MAX;
+    // Completed commands. std::deque keeps the strings in place, as profiled_commands_ points to them.
+    std::deque<ProfileRecord> completed_profile_records_;
+    std::vector<ProfiledCommand> profiled_commands_;
+    // Compiled on first use by GetPrimitiveShader.
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> primitive_shaders_;
+    // Barriers added by UseBuffer, recorded together by FlushBarriers before the next command.
+    std::vector<PendingBarrier> pending_barriers_;
+    // Returned by GetStatistics. Counters of the batch being recorded are added when it is submitted.
+    DeviceStatistics statistics_;
+    // Of QueryPerformanceCounter, to measure the time the CPU waits for the GPU.
+    uint64_t performance_counter_frequency_ = 0;
+    /* Regions opened with BeginRegion. Every command list gets them closed before it is submitted and
+    opened again when recording of the next one starts, so each part of a region is a separate event.
+    */
+    std::vector<Region> regions_;
+    /* Between BeginRecording and EndRecording, the recording that receives the commands called on this thread
+    instead of the current batch. A thread can have one open recording at a time, of any device.
+    */
+    static thread_local Recording* open_recording_;
 
     std::atomic<size_t> buffer_count_{ 0 };
     std::atomic<size_t> shader_count_{ 0 };
+    std::atomic<size_t> recording_count_{ 0 };
+    std::atomic<size_t> open_recording_count_{ 0 };
 
     // Static descriptors in descriptor_heap_.
     uint32_t null_cbv_index_ = 0;
@@ -367,19 +1124,174 @@ private:
         D3D12_MESSAGE_ID ID,
         LPCSTR pDescription);
 
-    // Starts executing recorded commands on the GPU. (kRecording -> kExecuting)
+    // The recording of this device open on the calling thread, or null.
+    RecordingImpl* GetOpenRecording() const noexcept
+    {
+        return open_recording_ != nullptr && open_recording_->GetImpl()->GetDevice() == this
+            ? open_recording_->GetImpl() : nullptr;
+    }
+    // Between BeginRecording and EndRecording, these return the state of the recording of the calling thread.
+    CommandBatch& GetCurrentBatch() noexcept
+    {
+        RecordingImpl* const recording = GetOpenRecording();
+        return recording ? recording->batch_ : command_batches_[current_batch_index_];
+    }
+    ID3D12GraphicsCommandList2* GetCommandList() const noexcept
+    {
+        RecordingImpl* const recording = GetOpenRecording();
+        return recording ? recording->batch_.command_list : command_batches_[current_batch_index_].command_list;
+    }
+    BindingState& GetBindingState() noexcept
+    {
+        RecordingImpl* const recording = GetOpenRecording();
+        return recording ? recording->binding_state_ : binding_state_;
+    }
+    std::vector<PendingBarrier>& GetPendingBarriers() noexcept
+    {
+        RecordingImpl* const recording = GetOpenRecording();
+        return recording ? recording->pending_barriers_ : pending_barriers_;
+    }
+
+    // Starts executing the current batch on the GPU. (kRecording -> kExecuting)
     Result ExecuteRecordedCommands();
-    // Waits on the CPU until the GPU completes execution. (kExecuting -> kNone)
+    // Waits on the CPU until the GPU completes all submitted batches. (kExecuting -> kNone)
     Result WaitForCommandExecution(uint32_t timeout_milliseconds);
-    // Resets command list to the recording state. (kNone -> kRecording)
-    Result ResetCommandListForRecording();
+    // Advances to the next batch in the ring and resets it for recording, waiting only for that batch
+    // to complete. (kNone or kExecuting -> kRecording)
+    Result ResetCommandListForRecording(uint32_t timeout_milliseconds);
 
     Result EnsureCommandListState(CommandListState desired_state, uint32_t timeout_milliseconds = kTimeoutInfinite);
 
+    // Waits on the CPU until the fence reaches fence_value, then retires completed batches.
+    Result WaitForFenceValue(uint64_t fence_value, uint32_t timeout_milliseconds);
+    void RetireCompletedBatches();
+    // Waits for given batch to complete, submitting it first if it is still being recorded.
+    Result WaitForBatch(uint32_t batch_index, uint32_t timeout_milliseconds);
+    // Return the index of the newest in-flight batch that uses the shader, or UINT32_MAX if none.
+    uint32_t FindNewestBatchUsingShader(ShaderImpl* shader) const;
+    // Fence value that the batch currently being recorded will signal.
+    uint64_t GetRecordingFenceValue() const noexcept { return submitted_fence_value_ + 1; }
+    // Waits until the GPU completes the accesses to the buffer that conflict with a CPU access:
+    // CPU reads conflict with GPU writes, CPU writes conflict with any GPU access.
+    // Submits the batch being recorded first if it is the one that accesses the buffer.
+    Result WaitForBufferAccess(BufferImpl& buf, bool cpu_writes, uint32_t timeout_milliseconds);
+
     Result WaitForBufferUnused(BufferImpl* buf);
     Result WaitForShaderUnused(ShaderImpl* shader);
-    Result UseBuffer(BufferImpl& buf, D3D12_RESOURCE_STATES state);
-    Result UpdateRootArguments();
+    Result WaitForRecordingUnused(RecordingImpl* recording);
+    Result AcquireReadbackStagingBuffer(size_t size, std::unique_ptr<Buffer>& out_buffer);
+    // Returns a staging buffer to free_readback_staging_buffers_, trimming it to its limits.
+    void ReleaseReadbackStagingBuffer(std::unique_ptr<Buffer>&& buffer);
+    // Creates a buffer with kBufferFlagAliasedMemory in a free transient memory block, or a new one.
+    Result AcquireAliasedTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer);
+    // Destroys transient buffers the GPU no longer uses that are either idle for long or released from a memory block.
+    void ReclaimTransientBuffers();
+    // Returns true if no batch or recording that may still execute on the GPU uses the buffer. Doesn't wait.
+    bool IsBufferUnused(const BufferImpl& buf, uint64_t completed_fence_value) const;
+    /* Returns true if the buffer is bound, also in the user's bindings saved by an active PrimitiveScope,
+    or used by the recording open on the calling thread. Recordings open on other threads are not checked.
+    Ended recordings are not either, as IsBufferUnused keeps the buffer from being reused while they exist.
+    */
+    bool IsBufferReferenced(BufferImpl& buf);
+    // Writes the next `dst_size` bytes of the data to upload to `dst` in the upload ring.
+    using UploadChunkCallback = Result (*)(void* dst, size_t dst_size, void* context);
+    /* Records copies of `size` bytes from the upload ring to a buffer in GPU memory, splitting them into chunks
+    holding a multiple of `chunk_granularity` bytes. `fill_chunk` writes each chunk into the upload ring.
+    With `submit_each_chunk`, every chunk but the last is submitted right away, so the GPU copies it while
+    the next one is filled.
+    */
+    Result WriteToBufferThroughUploadRing(size_t size, size_t chunk_granularity, BufferImpl& dst_buf,
+        size_t dst_byte_offset, uint32_t timeout_milliseconds, bool submit_each_chunk,
+        UploadChunkCallback fill_chunk, void* fill_chunk_context);
+    /* Copies the data to the upload ring and records its copies to a buffer in GPU memory.
+    With `converter`, each chunk is converted straight into the upload ring.
+    */
+    Result WriteMemoryToBufferThroughUploadRing(ConstDataSpan src_data, BufferImpl& dst_buf,
+        size_t dst_byte_offset, uint32_t timeout_milliseconds, const FormatConverter* converter = nullptr);
+    // Reads size bytes from the file, chunk by chunk, straight into the upload ring and records their copies
+    // to the beginning of the buffer. Every chunk is submitted as soon as it is read.
+    Result WriteFileToBufferThroughUploadRing(HANDLE file, size_t size, BufferImpl& dst_buf);
+    // Fills the range of a buffer in GPU memory with zeros copied from the upload ring.
+    Result ZeroBufferThroughUploadRing(BufferImpl& dst_buf, Range byte_range);
+    // Waits until the oldest allocation in the upload ring is retired.
+    Result WaitForUploadRingSpace(uint32_t timeout_milliseconds);
+    Result WriteMemoryToBufferImmediate(ConstDataSpan src_data, BufferImpl& dst_buf, size_t dst_byte_offset);
+    // Copies the data of a completed readback to its destination and empties the ticket.
+    Result FinishReadback(ReadbackTicket& ticket);
+    /* Tracks the use of a buffer in the current batch and adds the barrier it needs to pending_barriers_.
+    no_uav_hazard skips the UAV barrier between consecutive UAV uses.
+    */
+    Result UseBuffer(BufferImpl& buf, D3D12_RESOURCE_STATES state, bool no_uav_hazard = false);
+    // Records all pending barriers at once. Must be called right before recording a command that uses buffers.
+    void FlushBarriers();
+    /* Records an aliasing barrier right away, after the pending ones, before the first use of resource_after
+    placed in the same memory as resource_before. resource_before can be null, meaning any resource.
+    */
+    void RecordAliasingBarrier(ID3D12Resource* resource_before, ID3D12Resource* resource_after);
+    /* Returns true if the copy should be recorded on the copy queue: it is big enough, and neither buffer is used
+    by the batch being recorded on the compute queue, which would require submitting it first.
+    */
+    bool ShouldUseCopyQueue(BufferImpl& src_buf, BufferImpl& dst_buf, size_t size) const;
+    // Records a copy on the copy queue, making it wait on the GPU for previous compute work on these buffers.
+    Result CopyBufferRegionOnCopyQueue(BufferImpl& src_buf, Range src_byte_range,
+        BufferImpl& dst_buf, size_t dst_byte_offset);
+    /* Returns the copy queue fence value to wait for before accessing the buffer, or 0 if none.
+    Reads conflict with writes on the copy queue, writes conflict with any access.
+    */
+    uint64_t GetCopyQueueFenceValueToWait(const BufferImpl& buf, bool writes) const;
+    Result InitResidencyManagement();
+    // For committed buffers in the DEFAULT heap, with kDeviceFlagEnableResidencyManagement. Thread-safe.
+    void RegisterResidencyManagedBuffer(BufferImpl& buf);
+    void UnregisterResidencyManagedBuffer(BufferImpl& buf);
+    /* Called right before the batch is submitted. If the memory usage is over the budget, evicts buffers least
+    recently used that no batch still executing on the GPU uses. Then makes the buffers used by the batch resident,
+    including ones used by the recordings executed in it, and makes the command queue wait for that.
+    */
+    Result UpdateResidency(CommandBatch& batch);
+    // Evicts buffers completed on the GPU and not used by the current batch, oldest first, until at least
+    // size bytes are evicted or there are no more of them. Must be called with residency_mutex_ locked.
+    Result EvictLeastRecentlyUsedBuffers(size_t size);
+    Result CheckBindlessSupport();
+    Result CreateProfilingResources(CommandBatch& batch, uint32_t batch_index);
+    // Submits the current batch and starts a new one if it has no space for another profiled command.
+    // Must be called while recording, before recording anything for the command.
+    Result EnsureProfilingSpace();
+    /* Records the timestamp before a command, when profiling is enabled. Returns the index of the command
+    in the batch to pass to EndProfiledCommand, or UINT32_MAX if profiling is disabled.
+    For a region, pass its index in regions_ as region_depth.
+    */
+    uint32_t BeginProfiledCommand(const wchar_t* label, ShaderImpl* shader = nullptr,
+        const UintVec3& group_count = {}, uint32_t region_depth = UINT32_MAX);
+    void EndProfiledCommand(uint32_t profiled_command_index);
+    // Reads timestamps of a completed batch and moves its records to completed_profile_records_.
+    void CollectProfileRecords(CommandBatch& batch);
+    // PIX-compatible event markers on the current command list, unless disabled by kDeviceFlagDisableCommandMarkers.
+    void BeginCommandListEvent(const wchar_t* name);
+    void EndCommandListEvent();
+    // Compiles and creates one shader of CompileAndCreateShadersBatch, storing the result in the item. Thread-safe.
+    void CompileAndCreateShaderBatchItem(ShaderBatchItem& item);
+    /* Makes sure the current batch has given numbers of free dynamic descriptors. If not, submits it
+    and starts a new one, so long sequences of commands never fail on descriptor heap exhaustion.
+    Must be called while recording, before recording the command that needs the descriptors.
+    */
+    Result EnsureDescriptorSpace(uint32_t shader_visible_count, uint32_t shader_invisible_count);
+    // Returns a descriptor in the shader-visible heap, reusing one created earlier in the current batch.
+    Result GetOrCreateBufferView(ViewType type, BufferImpl& buf, Range byte_range, uint32_t& out_descriptor_index);
+    /* Copies the data of slots bound with BindConstantData to the upload ring and creates their CBVs,
+    if not done yet in the current batch. May submit the batch and start a new one if the ring is full,
+    so it must be called before recording the dispatch.
+    */
+    Result UploadConstantData();
+    // continuation skips UAV barriers, for the next part of a dispatch split by DispatchThreads.
+    Result UpdateRootArguments(bool continuation = false);
+    /* Records a dispatch with group_count already validated. thread_offset and thread_count are passed
+    to the shader as dispatch params. continuation means it is not the first part of a split dispatch.
+    If indirect_args_buf is not null, group_count is ignored and the dispatch is recorded with ExecuteIndirect,
+    reading the arguments from indirect_args_buf at indirect_args_offset.
+    */
+    Result RecordDispatch(ShaderImpl& shader, const UintVec3& group_count, const UintVec3& thread_offset,
+        const UintVec3& thread_count, const wchar_t* label, bool continuation,
+        BufferImpl* indirect_args_buf = nullptr, size_t indirect_args_offset = 0);
     void FreeDescriptor(uint32_t desc_index);
     Result CreateNullDescriptors();
     Result CreateStaticShaders();
@@ -389,16 +1301,80 @@ private:
     Result BeginClearBufferToValues(BufferImpl& buf, Range element_range,
         D3D12_GPU_DESCRIPTOR_HANDLE& out_shader_visible_gpu_desc_handle,
         D3D12_CPU_DESCRIPTOR_HANDLE& out_shader_invisible_cpu_desc_handle);
+    // Checks a buffer region of 32-bit elements passed to a primitive. The size is in bytes.
+    Result ValidatePrimitiveBuffer(BufferImpl& buf, size_t byte_offset, size_t byte_size, bool writable);
+    // Returns the variant of a primitive shader, compiling it on first use.
+    Result GetPrimitiveShader(PrimitiveKernel kernel, PrimitiveDataType type, ReduceOperation op,
+        ShaderImpl*& out_shader);
+    // Binds the buffers and constants of the dispatch and records it. Must be called inside a PrimitiveScope.
+    Result DispatchPrimitive(const PrimitiveDispatch& dispatch, const wchar_t* label);
+    // Records passes of PrimitiveKernel::kReduce until the result is a single element written to dst.
+    Result RecordPrimitiveReduce(PrimitiveScope& scope, PrimitiveDataType type, ReduceOperation op, uint32_t flags,
+        PrimitiveBuffer src, uint32_t element_count, PrimitiveBuffer dst);
+    /* Records a scan of any number of elements. If they don't fit in one block, the sums of the blocks are reduced,
+    scanned recursively, and added to each block by the final pass. flags can have kPrimitiveFlagExclusive and
+    kPrimitiveFlagPredicate.
+    */
+    Result RecordPrimitiveScan(PrimitiveScope& scope, PrimitiveDataType type, uint32_t flags,
+        PrimitiveBuffer src, uint32_t element_count, PrimitiveBuffer dst);
 
     friend class Environment;
     friend class EnvironmentImpl;
     friend class DeviceObject;
     friend class BufferImpl;
     friend class ShaderImpl;
+    friend class RecordingImpl;
+    friend class ShaderFamilyImpl;
     JD3D12_NO_COPY_NO_MOVE_CLASS(DeviceImpl)
 };
 
 class ShaderCompiler;
+class IncludeHandlerBase;
+
+/* Cache of compiled shader bytecode, keyed by a hash of everything passed to DXC.
+Entries stay in memory and are also saved as files in EnvironmentDesc::shader_cache_directory.
+Files included by the shader are not known before compilation, so each entry records them with hashes
+of their contents, and they are validated on lookup. Thread-safe.
+*/
+class ShaderCache
+{
+public:
+    struct IncludedFile
+    {
+        std::wstring path;
+        uint64_t content_hash = 0;
+    };
+    struct Entry
+    {
+        std::vector<IncludedFile> included_files;
+        std::vector<char> bytecode;
+    };
+
+    ShaderCache(EnvironmentImpl& env) : env_{env} { }
+    void Init(const wchar_t* directory);
+    bool IsEnabled() const noexcept { return enabled_; }
+    Logger* GetLogger() const noexcept;
+
+    // Returns false if there is no entry. Included files are not validated.
+    bool Find(uint64_t key, Entry& out_entry);
+    void Store(uint64_t key, const Entry& entry);
+
+private:
+    static constexpr uint32_t kFileMagic = 0x4353444A; // "JDSC"
+    static constexpr uint32_t kFileVersion = 1;
+
+    EnvironmentImpl& env_;
+    bool enabled_ = false;
+    FileSystemPath directory_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, Entry> memory_entries_;
+
+    FileSystemPath GetFilePath(uint64_t key) const;
+    bool LoadFromFile(uint64_t key, Entry& out_entry);
+    void SaveToFile(uint64_t key, const Entry& entry);
+
+    JD3D12_NO_COPY_NO_MOVE_CLASS(ShaderCache)
+};
 
 class IncludeHandlerBase : public IDxcIncludeHandler
 {
@@ -411,9 +1387,17 @@ public:
     ULONG STDMETHODCALLTYPE AddRef(void) override { return 1; }
     ULONG STDMETHODCALLTYPE Release(void) override { return 1; }
 
+    // Files successfully loaded so far, for the shader cache.
+    const std::vector<ShaderCache::IncludedFile>& GetIncludedFiles() const noexcept { return included_files_; }
+
 protected:
     ShaderCompiler* const shader_compiler_ = nullptr;
     const CharacterEncoding character_encoding_ = kCharacterEncodingAnsi;
+
+    void RecordIncludedFile(LPCWSTR filename, IDxcBlob* blob);
+
+private:
+    std::vector<ShaderCache::IncludedFile> included_files_;
 };
 
 class DefaultIncludeHandler : public IncludeHandlerBase
@@ -442,6 +1426,10 @@ private:
     void* callback_context_ = nullptr;
 };
 
+/* Compiles shaders using DXC. Thread-safe: IDxcCompiler3 is not, so every compilation takes an instance
+from a pool, creating a new one when all are busy. This way, N threads compiling in parallel end up
+with N compiler instances.
+*/
 class ShaderCompiler
 {
 public:
@@ -454,17 +1442,34 @@ public:
 
     Result CompileShaderFromMemory(const ShaderCompilationParams& params, const wchar_t* main_source_file_path,
         ConstDataSpan hlsl_source, ShaderCompilationResult*& out_result);
+    void GetStatistics(ShaderCompilationStatistics& out_stats) const noexcept;
 
 private:
     EnvironmentImpl& env_;
     HMODULE module_ = nullptr;
     DxcCreateInstanceProc create_instance_proc_ = nullptr;
     CComPtr<IDxcUtils> utils_;
-    CComPtr<IDxcCompiler3> compiler3_;
+    std::mutex compiler_pool_mutex_;
+    std::vector<CComPtr<IDxcCompiler3>> free_compilers_;
+
+    // Hash of DXC version, mixed into every shader cache key.
+    uint64_t dxc_version_hash_ = kFnv1a64OffsetBasis;
+    // Atomic, as shaders can be compiled on multiple threads.
+    std::atomic<uint64_t> dxc_compilation_count_{ 0 };
+    std::atomic<uint64_t> shader_cache_hit_count_{ 0 };
 
     Result BuildArguments(const ShaderCompilationParams& params,
         const wchar_t* source_name, std::vector<std::wstring>& out_arguments);
     void LogCompilationResult(ShaderCompilationResult& result);
+    Result AcquireCompiler(CComPtr<IDxcCompiler3>& out_compiler);
+    void ReleaseCompiler(CComPtr<IDxcCompiler3>&& compiler);
+    void InitDxcVersionHash(IDxcCompiler3* compiler3);
+    uint64_t CalculateCacheKey(const ShaderCompilationParams& params, ConstDataSpan hlsl_source,
+        const StackOrHeapVector<const wchar_t*, 16>& arguments) const;
+    // Returns true if all the files load through include_handler with the same contents as recorded.
+    static bool ValidateIncludedFiles(IncludeHandlerBase* include_handler,
+        const std::vector<ShaderCache::IncludedFile>& included_files);
+    Result CreateResultFromBytecode(const std::vector<char>& bytecode, ShaderCompilationResult*& out_result);
 
     JD3D12_NO_COPY_NO_MOVE_CLASS(ShaderCompiler)
 };
@@ -481,32 +1486,56 @@ public:
 
     Environment* GetInterface() const noexcept { return interface_obj_; }
     Logger* GetLogger() const noexcept { return logger_.get(); }
+    uint64_t GetDroppedLogMessageCount() const noexcept { return logger_ ? logger_->GetDroppedMessageCount() : 0; }
+    void GetShaderCompilationStatistics(ShaderCompilationStatistics& out_stats) const noexcept
+    {
+        shader_compiler_.GetStatistics(out_stats);
+    }
     IDXGIFactory6* GetDXGIFactory6() const noexcept { return dxgi_factory6_; }
-    IDXGIAdapter1* GetDXGIAdapter1() const noexcept { return adapter_; }
+    // The default adapter, with the highest performance.
+    IDXGIAdapter1* GetDXGIAdapter1() const noexcept { return adapters_[0].adapter; }
     ID3D12SDKConfiguration1* GetD3D12SDKConfiguration1() const noexcept { return sdk_config1_; }
     ID3D12DeviceFactory* GetD3D12DeviceFactory() const noexcept { return device_factory_; }
     ShaderCompiler& GetShaderCompiler() { return shader_compiler_; }
+    ShaderCache& GetShaderCache() { return shader_cache_; }
 
     Result CreateDevice(const DeviceDesc& desc, Device*& out_device);
 
+    uint32_t GetAdapterCount() const noexcept { return uint32_t(adapters_.size()); }
+    Result GetAdapterDesc(uint32_t adapter_index, AdapterDesc& out_desc);
+    // Returns the adapter selected by DeviceDesc::adapter_luid or DeviceDesc::adapter_index.
+    Result FindAdapter(const DeviceDesc& desc, IDXGIAdapter1*& out_adapter) const;
+
     Result CompileShaderFromMemory(const ShaderCompilationParams& params, const wchar_t* name,
         ConstDataSpan hlsl_source, ShaderCompilationResult*& out_result);
     Result CompileShaderFromFile(const ShaderCompilationParams& params,
         const wchar_t* hlsl_source_file_path, ShaderCompilationResult*& out_result);
 
 private:
+    struct Adapter
+    {
+        CComPtr<IDXGIAdapter1> adapter;
+        AdapterDesc desc = {};
+        // Members of desc queried from a temporary device are filled on first use by GetAdapterDesc.
+        bool features_queried = false;
+    };
+
     Environment* const interface_obj_;
     EnvironmentDesc desc_ = {};
     std::unique_ptr<Logger> logger_;
     CComPtr<IDXGIFactory6> dxgi_factory6_;
-    UINT selected_adapter_index_ = UINT32_MAX;
-    CComPtr<IDXGIAdapter1> adapter_;
+    // In order of DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE. Never empty after Init.
+    std::vector<Adapter> adapters_;
+    std::mutex adapters_mutex_;
     CComPtr<ID3D12SDKConfiguration1> sdk_config1_;
     CComPtr<ID3D12DeviceFactory> device_factory_;
     std::atomic<size_t> device_count_{ 0 };
+    ShaderCache shader_cache_;
     ShaderCompiler shader_compiler_;
 
     Result EnableDebugLayer();
+    Result EnumerateAdapters();
+    void QueryAdapterFeatures(Adapter& adapter);
 
     JD3D12_NO_COPY_NO_MOVE_CLASS(EnvironmentImpl)
 };
@@ -575,7 +1604,7 @@ void DeviceObject::SetObjectName(ID3D12Object* obj, const wchar_t* name, const w
 Result BufferImpl::InitParameters(size_t initial_data_size)
 {
     JD3D12_ASSERT_OR_RETURN((desc_.flags &
-        (kBufferUsageMaskCpu | kBufferUsageMaskCopy | kBufferUsageMaskShader)) != 0,
+        (kBufferUsageMaskCpu | kBufferUsageMaskCopy | kBufferUsageMaskShader | kBufferUsageFlagIndirectArgs)) != 0,
         L"At least one usage flag must be specified - a buffer with no usage flags makes no sense.");
     JD3D12_ASSERT_OR_RETURN(CountBitsSet(desc_.flags & kBufferUsageMaskCpu) <= 1,
         L"kBufferUsageFlagCpu* are mutually exclusive - you can specify at most 1.");
@@ -593,13 +1622,6 @@ Result BufferImpl::InitParameters(size_t initial_data_size)
     JD3D12_ASSERT_OR_RETURN(initial_data_size <= desc_.size,
         L"initial_data_size exceeds buffer size.");
 
-    if(initial_data_size > 0)
-    {
-        // TODO Remove this limitation in the future.
-        JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0,
-            L"Buffer initial data can only be used with kBufferUsageCpuSequentialWrite.");
-    }
-
     JD3D12_ASSERT_OR_RETURN(is_typed == (desc_.element_format != Format::kUnknown),
         L"element_format should be set if and only if the buffer is used as typed buffer.");
     if(is_typed)
@@ -623,6 +1645,10 @@ Result BufferImpl::InitParameters(size_t initial_data_size)
         JD3D12_ASSERT_OR_RETURN(desc_.size % element_size == 0, L"Buffer size must be a multiple of element size.");
     }
 
+    const DeviceImpl* const dev = GetDevice();
+    const bool gpu_upload_heap_preferred = (dev->desc_.flags & kDeviceFlagPreferGpuUploadHeap) != 0
+        && dev->GetOptions16().GPUUploadHeapSupported;
+
     // Choose strategy.
     if((desc_.flags & kBufferUsageFlagShaderRWResource) != 0)
     {
@@ -630,6 +1656,9 @@ Result BufferImpl::InitParameters(size_t initial_data_size)
         // kBufferUsageFlagCpuSequentialWrite is allowed.
         JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuRead) == 0,
             L"kBufferUsageFlagCpuRead cannot be used with kBufferUsageFlagShaderRWResource.");
+
+        if(gpu_upload_heap_preferred && (desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0)
+            strategy_ = BufferStrategy::kGpuUpload;
     }
     else if((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0)
     {
@@ -637,6 +1666,9 @@ Result BufferImpl::InitParameters(size_t initial_data_size)
 
         JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCopyDst) == 0,
             L"BufferUsageFlagCopyDst cannot be used with kBufferUsageFlagCpuSequentialWrite.");
+
+        if(gpu_upload_heap_preferred && (desc_.flags & kBufferUsageMaskShader) != 0)
+            strategy_ = BufferStrategy::kGpuUpload;
     }
     else if((desc_.flags & kBufferUsageFlagCpuRead) != 0)
     {
@@ -646,12 +1678,27 @@ Result BufferImpl::InitParameters(size_t initial_data_size)
             L"kBufferUsageFlagCopySrc cannot be used with kBufferUsageFlagCpuRead.");
         JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageMaskShader) == 0,
             L"kBufferUsageFlagShader* cannot be used with kBufferUsageFlagCpuRead.");
+        JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagIndirectArgs) == 0,
+            L"kBufferUsageFlagIndirectArgs cannot be used with kBufferUsageFlagCpuRead.");
     }
     else
     {
         strategy_ = BufferStrategy::kDefault;
     }
 
+    JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferFlagAliasedMemory) == 0 || strategy_ == BufferStrategy::kDefault,
+        L"kBufferFlagAliasedMemory cannot be used with kBufferUsageFlagCpu*.");
+
+    if(initial_data_size > 0)
+    {
+        // Buffers in GPU memory are initialized through the upload ring.
+        JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0
+            || strategy_ == BufferStrategy::kDefault,
+            L"Buffer initial data can only be used with kBufferUsageCpuSequentialWrite or a buffer in GPU memory.");
+        JD3D12_ASSERT_OR_RETURN(strategy_ != BufferStrategy::kDefault || initial_data_size % 4 == 0,
+            L"Initial data size of a buffer in GPU memory must be a multiple of 4 B.");
+    }
+
     return kSuccess;
 }
 
@@ -660,9 +1707,10 @@ D3D12_RESOURCE_STATES BufferImpl::GetInitialState(D3D12_HEAP_TYPE heap_type)
     switch(heap_type)
     {
     case D3D12_HEAP_TYPE_DEFAULT:
+    // GPU_UPLOAD resources can be in any state, like DEFAULT, and are tracked with barriers the same way.
+    case D3D12_HEAP_TYPE_GPU_UPLOAD:
         return D3D12_RESOURCE_STATE_COMMON;
     case D3D12_HEAP_TYPE_UPLOAD:
-    case D3D12_HEAP_TYPE_GPU_UPLOAD:
         return D3D12_RESOURCE_STATE_GENERIC_READ;
     case D3D12_HEAP_TYPE_READBACK:
         return D3D12_RESOURCE_STATE_COPY_DEST;
@@ -691,6 +1739,25 @@ BufferImpl::~BufferImpl()
 
     JD3D12_ASSERT(!is_user_mapped_ && "Destroying buffer that is still mapped - missing call to Device::UnmapBuffer.");
 
+    if(bindless_srv_index_ != UINT32_MAX)
+        dev->shader_visible_descriptor_heap_.FreePersistent(bindless_srv_index_);
+    if(bindless_uav_index_ != UINT32_MAX)
+        dev->shader_visible_descriptor_heap_.FreePersistent(bindless_uav_index_);
+
+    if(is_residency_managed_)
+        dev->UnregisterResidencyManagedBuffer(*this);
+
+    // The resource must be released before its memory is returned to the allocator.
+    const bool was_created = resource_ != nullptr;
+    resource_.Release();
+    if(heap_allocator_ != nullptr)
+    {
+        if(heap_allocation_.heap != nullptr)
+            heap_allocator_->Free(heap_allocation_);
+        else if(was_created)
+            heap_allocator_->UnregisterCommittedBuffer(desc_.size);
+    }
+
     --dev->buffer_count_;
 }
 
@@ -722,7 +1789,30 @@ Result BufferImpl::Init(ConstDataSpan initial_data)
             L"When initial_data.size > 0, initial_data pointer cannot be null.");
     }
 
-    JD3D12_RETURN_IF_FAILED(InitParameters(initial_data.size));
+    JD3D12_RETURN_IF_FAILED(CreateResource(initial_data.size));
+    JD3D12_RETURN_IF_FAILED(WriteInitialData(initial_data));
+    return kSuccess;
+}
+
+Result BufferImpl::InitFromFile(HANDLE file, size_t initial_data_size)
+{
+    JD3D12_RETURN_IF_FAILED(CreateResource(initial_data_size));
+    JD3D12_RETURN_IF_FAILED(WriteInitialDataFromFile(file, initial_data_size));
+    return kSuccess;
+}
+
+Result BufferImpl::InitAliased(ID3D12Heap* heap)
+{
+    JD3D12_ASSERT(heap != nullptr);
+    return CreateResource(0, heap);
+}
+
+Result BufferImpl::CreateResource(size_t initial_data_size, ID3D12Heap* aliasing_heap)
+{
+    JD3D12_ASSERT_OR_RETURN(((desc_.flags & kBufferFlagAliasedMemory) != 0) == (aliasing_heap != nullptr),
+        L"kBufferFlagAliasedMemory can be used only with Device::AcquireTransientBuffer.");
+
+    JD3D12_RETURN_IF_FAILED(InitParameters(initial_data_size));
     JD3D12_ASSERT(strategy_ != BufferStrategy::kNone);
 
     D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
@@ -751,10 +1841,47 @@ Result BufferImpl::Init(ConstDataSpan initial_data)
     default:
         JD3D12_ASSERT(0);
     }
-    CD3DX12_HEAP_PROPERTIES heap_props = CD3DX12_HEAP_PROPERTIES{heap_type};
     const D3D12_RESOURCE_STATES initial_state = GetInitialState(heap_type);
-    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE,
-        &resource_desc, initial_state, nullptr, IID_PPV_ARGS(&resource_)));
+    if(aliasing_heap != nullptr)
+    {
+        JD3D12_ASSERT(heap_type == D3D12_HEAP_TYPE_DEFAULT);
+        JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreatePlacedResource(aliasing_heap,
+            0, &resource_desc, initial_state, nullptr, IID_PPV_ARGS(&resource_)));
+    }
+    else
+    {
+        heap_allocator_ = GetDevice()->GetBufferHeapAllocator(strategy_);
+        JD3D12_ASSERT(heap_allocator_ != nullptr);
+        bool use_placed_resource = (desc_.flags & kBufferFlagDedicatedMemory) == 0
+            && desc_.size <= BufferHeapAllocator::kMaxAllocationSize;
+        if(use_placed_resource)
+        {
+            JD3D12_RETURN_IF_FAILED(heap_allocator_->Allocate(desc_.size, heap_allocation_));
+            // Zeroing reused memory in the DEFAULT heap takes a copy on the GPU, which cannot be recorded while
+            // a recording is open, so such a buffer gets a zeroed committed resource instead.
+            if(heap_allocation_.needs_zeroing && strategy_ == BufferStrategy::kDefault
+                && initial_data_size < desc_.size && GetDevice()->GetOpenRecording() != nullptr)
+            {
+                heap_allocator_->Free(heap_allocation_);
+                heap_allocation_ = BufferHeapAllocation{};
+                use_placed_resource = false;
+            }
+        }
+        if(use_placed_resource)
+        {
+            JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreatePlacedResource(heap_allocation_.heap,
+                heap_allocation_.offset, &resource_desc, initial_state, nullptr, IID_PPV_ARGS(&resource_)));
+        }
+        else
+        {
+            CD3DX12_HEAP_PROPERTIES heap_props = CD3DX12_HEAP_PROPERTIES{heap_type};
+            JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateCommittedResource(&heap_props,
+                D3D12_HEAP_FLAG_NONE, &resource_desc, initial_state, nullptr, IID_PPV_ARGS(&resource_)));
+            heap_allocator_->RegisterCommittedBuffer(desc_.size);
+            if(strategy_ == BufferStrategy::kDefault && GetDevice()->IsResidencyManagementEnabled())
+                GetDevice()->RegisterResidencyManagedBuffer(*this);
+        }
+    }
 
     SetObjectName(resource_, desc_.name);
     desc_.name = nullptr;
@@ -766,27 +1893,440 @@ Result BufferImpl::Init(ConstDataSpan initial_data)
         JD3D12_LOG_AND_RETURN_IF_FAILED(resource_->Map(0, nullptr, &persistently_mapped_ptr_));
     }
 
-    JD3D12_RETURN_IF_FAILED(WriteInitialData(initial_data));
+    if(GetDevice()->IsBindless())
+    {
+        JD3D12_RETURN_IF_FAILED(CreateBindlessDescriptors());
+    }
+
+    // Like committed resources, placed buffers start zeroed. The initial data, written next, is not cleared.
+    if(heap_allocation_.needs_zeroing && initial_data_size < desc_.size)
+    {
+        const Range zero_range = { initial_data_size, desc_.size - initial_data_size };
+        if(persistently_mapped_ptr_ != nullptr)
+            memset((char*)persistently_mapped_ptr_ + zero_range.first, 0, zero_range.count);
+        else
+            JD3D12_RETURN_IF_FAILED(GetDevice()->ZeroBufferThroughUploadRing(*this, zero_range));
+    }
 
     return kSuccess;
 }
 
-Result BufferImpl::WriteInitialData(ConstDataSpan initial_data)
+void BufferImpl::FillSrvDesc(Range byte_range, D3D12_SHADER_RESOURCE_VIEW_DESC& out_desc) const
 {
-    if(initial_data.size == 0)
-        return kFalse;
-
-    JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0,
-        L"Buffer doesn't have kBufferUsageFlagCpuSequentialWrite but initial data was specified.");
+    const uint32_t buffer_type = desc_.flags & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress);
+    JD3D12_ASSERT(CountBitsSet(buffer_type) == 1);
 
-    JD3D12_ASSERT(persistently_mapped_ptr_ != nullptr);
-    memcpy(persistently_mapped_ptr_, initial_data.data, initial_data.size);
-
-    return kSuccess;
-}
-
-////////////////////////////////////////////////////////////////////////////////
-// class ShaderImpl
+    out_desc = {};
+    out_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    out_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    switch(buffer_type)
+    {
+    case kBufferFlagTyped:
+    {
+        const Format element_format = desc_.element_format;
+        const DXGI_FORMAT dxgi_format = DXGI_FORMAT(element_format);
+        const FormatDesc* format_desc = GetFormatDesc(element_format);
+        JD3D12_ASSERT(format_desc != nullptr && format_desc->bits_per_element > 0
+            && format_desc->bits_per_element % 8 == 0);
+
+        const size_t element_size = format_desc->bits_per_element / 8;
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % element_size == 0 && final_size % element_size == 0);
+        JD3D12_ASSERT(final_size / element_size <= UINT32_MAX);
+
+        out_desc.Format = dxgi_format;
+        out_desc.Buffer.StructureByteStride = 0;
+        out_desc.Buffer.FirstElement = byte_range.first / element_size;
+        out_desc.Buffer.NumElements = uint32_t(final_size / element_size);
+        break;
+    }
+    case kBufferFlagStructured:
+    {
+        const size_t structure_size = desc_.structure_size;
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % structure_size == 0 && final_size % structure_size == 0);
+        JD3D12_ASSERT(structure_size <= UINT32_MAX && final_size / structure_size <= UINT32_MAX);
+
+        out_desc.Format = DXGI_FORMAT_UNKNOWN;
+        out_desc.Buffer.StructureByteStride = uint32_t(structure_size);
+        out_desc.Buffer.FirstElement = byte_range.first / structure_size;
+        out_desc.Buffer.NumElements = uint32_t(final_size / structure_size);
+        break;
+    }
+    case kBufferFlagByteAddress:
+    {
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % 4 == 0 && final_size % 4 == 0);
+        JD3D12_ASSERT(final_size / 4 <= UINT32_MAX);
+
+        out_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+        out_desc.Buffer.StructureByteStride = 0;
+        out_desc.Buffer.FirstElement = byte_range.first / 4;
+        out_desc.Buffer.NumElements = uint32_t(final_size / 4);
+        out_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+        break;
+    }
+    default:
+        JD3D12_ASSERT(0);
+    }
+}
+
+void BufferImpl::FillUavDesc(Range byte_range, D3D12_UNORDERED_ACCESS_VIEW_DESC& out_desc) const
+{
+    const uint32_t buffer_type = desc_.flags & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress);
+    JD3D12_ASSERT(CountBitsSet(buffer_type) == 1);
+
+    out_desc = {};
+    out_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    switch(buffer_type)
+    {
+    case kBufferFlagTyped:
+    {
+        const Format element_format = desc_.element_format;
+        const DXGI_FORMAT dxgi_format = DXGI_FORMAT(element_format);
+        const FormatDesc* format_desc = GetFormatDesc(element_format);
+        JD3D12_ASSERT(format_desc != nullptr && format_desc->bits_per_element > 0
+            && format_desc->bits_per_element % 8 == 0);
+
+        const size_t element_size = format_desc->bits_per_element / 8;
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % element_size == 0 && final_size % element_size == 0);
+        JD3D12_ASSERT(final_size / element_size <= UINT32_MAX);
+
+        out_desc.Format = dxgi_format;
+        out_desc.Buffer.FirstElement = byte_range.first / element_size;
+        out_desc.Buffer.NumElements = uint32_t(final_size / element_size);
+        break;
+    }
+    case kBufferFlagStructured:
+    {
+        const size_t structure_size = desc_.structure_size;
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % structure_size == 0 && final_size % structure_size == 0);
+        JD3D12_ASSERT(structure_size <= UINT32_MAX && final_size / structure_size <= UINT32_MAX);
+
+        out_desc.Format = DXGI_FORMAT_UNKNOWN;
+        out_desc.Buffer.StructureByteStride = uint32_t(structure_size);
+        out_desc.Buffer.FirstElement = byte_range.first / structure_size;
+        out_desc.Buffer.NumElements = uint32_t(final_size / structure_size);
+        break;
+    }
+    case kBufferFlagByteAddress:
+    {
+        const size_t final_size = byte_range.count;
+        JD3D12_ASSERT(byte_range.first % 4 == 0 && final_size % 4 == 0);
+        JD3D12_ASSERT(final_size / 4 <= UINT32_MAX);
+
+        out_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+        out_desc.Buffer.StructureByteStride = 0;
+        out_desc.Buffer.FirstElement = byte_range.first / 4;
+        out_desc.Buffer.NumElements = uint32_t(final_size / 4);
+        out_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+        break;
+    }
+    default:
+        JD3D12_ASSERT(0);
+    }
+}
+
+Result BufferImpl::CreateBindlessDescriptors()
+{
+    const uint32_t buffer_type = desc_.flags & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress);
+    const size_t element_size = GetElementSize();
+    if(CountBitsSet(buffer_type) != 1 || element_size == 0)
+        return kFalse;
+
+    // The view covers the whole elements that fit in the buffer.
+    const Range byte_range = { 0, desc_.size / element_size * element_size };
+    if(byte_range.count == 0)
+        return kFalse;
+
+    DescriptorHeap& heap = GetDevice()->shader_visible_descriptor_heap_;
+    if((desc_.flags & kBufferUsageFlagShaderResource) != 0)
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(heap.AllocatePersistent(bindless_srv_index_));
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
+        FillSrvDesc(byte_range, srv_desc);
+        GetD3d12Device()->CreateShaderResourceView(resource_, &srv_desc,
+            heap.GetCpuHandleForDescriptor(bindless_srv_index_));
+    }
+    if((desc_.flags & kBufferUsageFlagShaderRWResource) != 0)
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(heap.AllocatePersistent(bindless_uav_index_));
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+        FillUavDesc(byte_range, uav_desc);
+        GetD3d12Device()->CreateUnorderedAccessView(resource_, nullptr, &uav_desc,
+            heap.GetCpuHandleForDescriptor(bindless_uav_index_));
+    }
+    return kSuccess;
+}
+
+Result BufferImpl::WriteInitialData(ConstDataSpan initial_data)
+{
+    if(initial_data.size == 0)
+        return kFalse;
+
+    if(strategy_ == BufferStrategy::kDefault)
+        return GetDevice()->WriteMemoryToBuffer(initial_data, *this, 0);
+
+    JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0,
+        L"Buffer doesn't have kBufferUsageFlagCpuSequentialWrite but initial data was specified.");
+
+    JD3D12_ASSERT(persistently_mapped_ptr_ != nullptr);
+    memcpy(persistently_mapped_ptr_, initial_data.data, initial_data.size);
+
+    return kSuccess;
+}
+
+Result BufferImpl::WriteInitialDataFromFile(HANDLE file, size_t size)
+{
+    if(size == 0)
+        return kFalse;
+
+    if(strategy_ == BufferStrategy::kDefault)
+        return GetDevice()->WriteFileToBufferThroughUploadRing(file, size, *this);
+
+    JD3D12_ASSERT_OR_RETURN((desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0,
+        L"Buffer doesn't have kBufferUsageFlagCpuSequentialWrite but initial data was specified.");
+
+    // Straight into the mapped memory, with no intermediate copy.
+    JD3D12_ASSERT(persistently_mapped_ptr_ != nullptr);
+    return ReadFileToMemory(file, persistently_mapped_ptr_, size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class BuddyAllocator
+
+void BuddyAllocator::Init(size_t total_size, size_t min_size)
+{
+    JD3D12_ASSERT(total_size >= min_size && min_size > 0);
+    JD3D12_ASSERT(NextPowerOfTwo(total_size) == total_size && NextPowerOfTwo(min_size) == min_size);
+
+    total_size_ = total_size;
+    min_size_ = min_size;
+    level_count_ = 1;
+    while((total_size_ >> level_count_) >= min_size_)
+        ++level_count_;
+    used_size_ = 0;
+
+    free_offsets_.clear();
+    free_offsets_.resize(level_count_);
+    free_offsets_[0].insert(0);
+}
+
+uint32_t BuddyAllocator::GetLevelForSize(size_t size) const noexcept
+{
+    uint32_t level = 0;
+    while(level + 1 < level_count_ && (total_size_ >> (level + 1)) >= size)
+        ++level;
+    return level;
+}
+
+size_t BuddyAllocator::GetLargestFreeSize() const noexcept
+{
+    for(uint32_t level = 0; level < level_count_; ++level)
+    {
+        if(!free_offsets_[level].empty())
+            return total_size_ >> level;
+    }
+    return 0;
+}
+
+bool BuddyAllocator::Allocate(size_t size, size_t& out_offset)
+{
+    out_offset = 0;
+    if(size == 0 || size > total_size_)
+        return false;
+
+    const uint32_t level = GetLevelForSize(size);
+
+    // Find the smallest free node that is big enough.
+    uint32_t free_level = level + 1;
+    while(free_level-- > 0)
+    {
+        if(!free_offsets_[free_level].empty())
+            break;
+    }
+    if(free_level == UINT32_MAX)
+        return false;
+
+    const auto it = free_offsets_[free_level].begin();
+    const size_t offset = *it;
+    free_offsets_[free_level].erase(it);
+
+    // Split it until it has the right size, leaving the second halves free.
+    while(free_level < level)
+    {
+        ++free_level;
+        free_offsets_[free_level].insert(offset + (total_size_ >> free_level));
+    }
+
+    used_size_ += total_size_ >> level;
+    out_offset = offset;
+    return true;
+}
+
+void BuddyAllocator::Free(size_t offset, size_t size)
+{
+    uint32_t level = GetLevelForSize(size);
+    used_size_ -= total_size_ >> level;
+
+    // Merge with free buddies as long as possible.
+    while(level > 0)
+    {
+        const size_t buddy_offset = offset ^ (total_size_ >> level);
+        const auto it = free_offsets_[level].find(buddy_offset);
+        if(it == free_offsets_[level].end())
+            break;
+        free_offsets_[level].erase(it);
+        offset = std::min(offset, buddy_offset);
+        --level;
+    }
+    free_offsets_[level].insert(offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class BufferHeapAllocator
+
+BufferHeapAllocator::~BufferHeapAllocator()
+{
+    JD3D12_ASSERT(placed_buffer_count_ == 0 && committed_buffer_count_ == 0);
+}
+
+Result BufferHeapAllocator::Allocate(size_t size, BufferHeapAllocation& out_allocation)
+{
+    out_allocation = BufferHeapAllocation{};
+    JD3D12_ASSERT(size > 0 && size <= kMaxAllocationSize);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    size_t offset = 0;
+    uint32_t block_index = UINT32_MAX;
+    for(uint32_t i = 0; i < blocks_.size(); ++i)
+    {
+        if(blocks_[i] && blocks_[i]->allocator.Allocate(size, offset))
+        {
+            block_index = i;
+            break;
+        }
+    }
+    if(block_index == UINT32_MAX)
+    {
+        JD3D12_RETURN_IF_FAILED(CreateBlock(block_index));
+        const bool allocated = blocks_[block_index]->allocator.Allocate(size, offset);
+        JD3D12_ASSERT(allocated);
+    }
+
+    Block& block = *blocks_[block_index];
+    ++block.allocation_count;
+    ++placed_buffer_count_;
+    placed_buffer_bytes_ += size;
+
+    const size_t page_end = DivideRoundingUp(offset + size, kMinAllocationSize);
+    for(size_t page_index = offset / kMinAllocationSize; page_index < page_end; ++page_index)
+    {
+        if(block.page_used[page_index])
+            out_allocation.needs_zeroing = true;
+        block.page_used[page_index] = true;
+    }
+
+    out_allocation.heap = block.heap;
+    out_allocation.block_index = block_index;
+    out_allocation.offset = offset;
+    out_allocation.size = size;
+    return kSuccess;
+}
+
+void BufferHeapAllocator::Free(const BufferHeapAllocation& allocation)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    JD3D12_ASSERT(allocation.block_index < blocks_.size() && blocks_[allocation.block_index]);
+    Block& block = *blocks_[allocation.block_index];
+    block.allocator.Free(allocation.offset, allocation.size);
+    --block.allocation_count;
+    --placed_buffer_count_;
+    placed_buffer_bytes_ -= allocation.size;
+
+    // Release an empty block, unless it is the last one, to avoid creating and destroying it repeatedly.
+    if(block.allocation_count == 0)
+    {
+        size_t block_count = 0;
+        for(const std::unique_ptr<Block>& b : blocks_)
+            block_count += b ? 1 : 0;
+        if(block_count > 1)
+            blocks_[allocation.block_index].reset();
+    }
+}
+
+void BufferHeapAllocator::RegisterCommittedBuffer(size_t size)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    ++committed_buffer_count_;
+    committed_buffer_bytes_ += size;
+}
+
+void BufferHeapAllocator::UnregisterCommittedBuffer(size_t size)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    JD3D12_ASSERT(committed_buffer_count_ > 0 && committed_buffer_bytes_ >= size);
+    --committed_buffer_count_;
+    committed_buffer_bytes_ -= size;
+}
+
+void BufferHeapAllocator::AddStatistics(MemoryStatistics& inout_stats, size_t& inout_free_size,
+    size_t& inout_largest_free_size) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    for(const std::unique_ptr<Block>& block : blocks_)
+    {
+        if(!block)
+            continue;
+        ++inout_stats.block_count;
+        inout_stats.block_bytes += block->allocator.GetTotalSize();
+        inout_stats.allocated_bytes += block->allocator.GetUsedSize();
+        inout_free_size += block->allocator.GetTotalSize() - block->allocator.GetUsedSize();
+        inout_largest_free_size = std::max(inout_largest_free_size, block->allocator.GetLargestFreeSize());
+    }
+    inout_stats.placed_buffer_count += placed_buffer_count_;
+    inout_stats.placed_buffer_bytes += placed_buffer_bytes_;
+    inout_stats.committed_buffer_count += committed_buffer_count_;
+    inout_stats.committed_buffer_bytes += committed_buffer_bytes_;
+}
+
+Result BufferHeapAllocator::CreateBlock(uint32_t& out_block_index)
+{
+    auto block = std::make_unique<Block>();
+
+    D3D12_HEAP_DESC heap_desc = {};
+    heap_desc.SizeInBytes = kBlockSize;
+    heap_desc.Properties = CD3DX12_HEAP_PROPERTIES{heap_type_};
+    heap_desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+    heap_desc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateHeap(&heap_desc, IID_PPV_ARGS(&block->heap)));
+    SetObjectName(block->heap, GetName(), L"Buffer heap block");
+
+    block->allocator.Init(kBlockSize, kMinAllocationSize);
+    block->page_used.resize(kBlockSize / kMinAllocationSize);
+
+    // Reuse an empty slot if there is one.
+    for(uint32_t i = 0; i < blocks_.size(); ++i)
+    {
+        if(!blocks_[i])
+        {
+            blocks_[i] = std::move(block);
+            out_block_index = i;
+            return kSuccess;
+        }
+    }
+    out_block_index = uint32_t(blocks_.size());
+    blocks_.push_back(std::move(block));
+    return kSuccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class ShaderImpl
 
 ShaderImpl::ShaderImpl(Shader* interface_obj, DeviceImpl* device, const ShaderDesc& desc)
     : DeviceObject{device, desc.name}
@@ -844,8 +2384,16 @@ Result ShaderImpl::Init(ConstDataSpan bytecode, ID3D12ShaderReflection* reflecti
     pso_desc.pRootSignature = dev->main_root_signature_->GetRootSignature();
     pso_desc.CS.pShaderBytecode = bytecode.data;
     pso_desc.CS.BytecodeLength = bytecode.size;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(dev->GetD3D12Device()->CreateComputePipelineState(
-        &pso_desc, IID_PPV_ARGS(&pipeline_state_)));
+    if(dev->pipeline_library_)
+    {
+        JD3D12_RETURN_IF_FAILED(dev->pipeline_library_->CreateComputePipelineState(
+            pso_desc, dev->main_root_signature_->GetHash(), pipeline_state_));
+    }
+    else
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(dev->GetD3D12Device()->CreateComputePipelineState(
+            &pso_desc, IID_PPV_ARGS(&pipeline_state_)));
+    }
 
     SetObjectName(pipeline_state_, desc_.name);
     desc_.name = nullptr;
@@ -856,8 +2404,10 @@ Result ShaderImpl::Init(ConstDataSpan bytecode, ID3D12ShaderReflection* reflecti
 ////////////////////////////////////////////////////////////////////////////////
 // class DescriptorHeap
 
-Result DescriptorHeap::Init(const wchar_t* device_name)
+Result DescriptorHeap::Init(const wchar_t* device_name, uint32_t partition_count, uint32_t persistent_count)
 {
+    JD3D12_ASSERT(partition_count > 0);
+    JD3D12_ASSERT(persistent_count < kMaxDescriptorCount - kStaticDescriptorCount);
     ID3D12Device* const d3d12_dev = GetD3d12Device();
 
     constexpr D3D12_DESCRIPTOR_HEAP_TYPE heap_type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
@@ -879,6 +2429,13 @@ Result DescriptorHeap::Init(const wchar_t* device_name)
         gpu_handle_ = descriptor_heap_->GetGPUDescriptorHandleForHeapStart();
     cpu_handle_ = descriptor_heap_->GetCPUDescriptorHandleForHeapStart();
 
+    persistent_count_ = persistent_count;
+    next_persistent_index_ = kStaticDescriptorCount;
+    partition_size_ = (kMaxDescriptorCount - GetDynamicBase()) / partition_count;
+    next_dynamic_descriptor_indices_.resize(partition_count);
+    for(uint32_t partition_index = 0; partition_index < partition_count; ++partition_index)
+        ClearDynamic(partition_index);
+
     return kSuccess;
 }
 
@@ -901,1396 +2458,4576 @@ D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::GetCpuHandleForDescriptor(uint32_t i
     return h;
 }
 
-HRESULT DescriptorHeap::AllocateDynamic(uint32_t& out_index)
+HRESULT DescriptorHeap::AllocateDynamic(uint32_t partition_index, uint32_t& out_index)
 {
-    if(next_dynamic_descriptor_index_ == kMaxDescriptorCount)
+    JD3D12_ASSERT(partition_index < next_dynamic_descriptor_indices_.size());
+    uint32_t& next_index = next_dynamic_descriptor_indices_[partition_index];
+    if(next_index == GetDynamicBase() + (partition_index + 1) * partition_size_)
         return kErrorTooManyObjects;
-    out_index = next_dynamic_descriptor_index_++;
+    out_index = next_index++;
     return kSuccess;
 }
 
-void DescriptorHeap::ClearDynamic()
+uint32_t DescriptorHeap::GetFreeDynamicCount(uint32_t partition_index) const noexcept
 {
-    next_dynamic_descriptor_index_ = kStaticDescriptorCount;
+    JD3D12_ASSERT(partition_index < next_dynamic_descriptor_indices_.size());
+    return GetDynamicBase() + (partition_index + 1) * partition_size_ - next_dynamic_descriptor_indices_[partition_index];
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// class ResourceUsageMap
-
-bool ResourceUsageMap::IsUsed(BufferImpl* buf, uint32_t usage_flags) const
+void DescriptorHeap::ClearDynamic(uint32_t partition_index)
 {
-    const auto it = map_.find(buf);
-    if(it == map_.end())
-        return false;
-    return (it->second.flags & usage_flags) != 0;
+    JD3D12_ASSERT(partition_index < next_dynamic_descriptor_indices_.size());
+    next_dynamic_descriptor_indices_[partition_index] = GetDynamicBase() + partition_index * partition_size_;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// class MainRootSignature
-
-Result MainRootSignature::Init()
+HRESULT DescriptorHeap::AllocatePersistent(uint32_t& out_index)
 {
-    D3D12_DESCRIPTOR_RANGE desc_ranges[kTotalParamCount] = {};
-    D3D12_ROOT_PARAMETER params[kTotalParamCount] = {};
-    uint32_t param_index = 0;
-    for(uint32_t i = 0; i < kMaxCBVCount; ++i, ++param_index)
+    std::lock_guard<std::mutex> lock{persistent_mutex_};
+    if(!free_persistent_indices_.empty())
     {
-        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
-        desc_ranges[param_index].NumDescriptors = 1;
-        desc_ranges[param_index].BaseShaderRegister = i;
-        desc_ranges[param_index].RegisterSpace = 0;
-        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
-
-        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
-        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
-        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        out_index = free_persistent_indices_.back();
+        free_persistent_indices_.pop_back();
+        return kSuccess;
     }
-    for(uint32_t i = 0; i < kMaxSRVCount; ++i, ++param_index)
-    {
-        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-        desc_ranges[param_index].NumDescriptors = 1;
-        desc_ranges[param_index].BaseShaderRegister = i;
-        desc_ranges[param_index].RegisterSpace = 0;
-        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
+    if(next_persistent_index_ == GetDynamicBase())
+        return kErrorTooManyObjects;
+    out_index = next_persistent_index_++;
+    return kSuccess;
+}
 
-        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
-        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
-        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-    }
-    for(uint32_t i = 0; i < kMaxUAVCount; ++i, ++param_index)
-    {
-        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
-        desc_ranges[param_index].NumDescriptors = 1;
-        desc_ranges[param_index].BaseShaderRegister = i;
-        desc_ranges[param_index].RegisterSpace = 0;
-        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
+void DescriptorHeap::FreePersistent(uint32_t index)
+{
+    JD3D12_ASSERT(index >= kStaticDescriptorCount && index < next_persistent_index_);
+    std::lock_guard<std::mutex> lock{persistent_mutex_};
+    free_persistent_indices_.push_back(index);
+}
 
-        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
-        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
-        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
-    }
-    JD3D12_ASSERT(param_index == kTotalParamCount);
+void DescriptorHeap::GetPersistentCounts(uint32_t& out_count, uint32_t& out_peak_count)
+{
+    std::lock_guard<std::mutex> lock{persistent_mutex_};
+    // Indices are allocated from the beginning, so the next one is the highest number ever used.
+    out_peak_count = next_persistent_index_ - kStaticDescriptorCount;
+    out_count = out_peak_count - uint32_t(free_persistent_indices_.size());
+}
 
-    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC root_sig_desc = {};
-    root_sig_desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_0;
-    root_sig_desc.Desc_1_0.Flags = D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_AMPLIFICATION_SHADER_ROOT_ACCESS
-        | D3D12_ROOT_SIGNATURE_FLAG_DENY_MESH_SHADER_ROOT_ACCESS;
-    root_sig_desc.Desc_1_0.pParameters = params;
-    root_sig_desc.Desc_1_0.NumParameters = kTotalParamCount;
+////////////////////////////////////////////////////////////////////////////////
+// class UploadRing
 
-    ID3DBlob *root_sig_blob_ptr = nullptr, *error_blob_ptr = nullptr;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(D3D12SerializeVersionedRootSignature(&root_sig_desc, &root_sig_blob_ptr, &error_blob_ptr));
-    CComPtr<ID3DBlob> root_sig_blob{root_sig_blob_ptr};
-    CComPtr<ID3DBlob> error_blob{error_blob_ptr};
+Result UploadRing::Init(const wchar_t* device_name, size_t size)
+{
+    JD3D12_ASSERT(size > 0);
+    size_ = size;
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateRootSignature(0, root_sig_blob->GetBufferPointer(),
-        root_sig_blob->GetBufferSize(), IID_PPV_ARGS(&root_signature_)));
-    SetObjectName(root_signature_, L"Main root signature");
+    CD3DX12_RESOURCE_DESC resource_desc = CD3DX12_RESOURCE_DESC::Buffer(size_);
+    CD3DX12_HEAP_PROPERTIES heap_props = CD3DX12_HEAP_PROPERTIES{D3D12_HEAP_TYPE_UPLOAD};
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateCommittedResource(&heap_props,
+        D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
+        IID_PPV_ARGS(&resource_)));
+    SetObjectName(resource_, device_name, L"Upload ring");
+
+    void* mapped_ptr = nullptr;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(resource_->Map(0, nullptr, &mapped_ptr));
+    mapped_ptr_ = (char*)mapped_ptr;
 
     return kSuccess;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// class BindingState
-
-void BindingState::ResetDescriptors()
+Result UploadRing::Allocate(size_t size, size_t alignment, uint64_t fence_value,
+    size_t& out_offset, void*& out_ptr)
 {
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    out_offset = 0;
+    out_ptr = nullptr;
+    JD3D12_ASSERT(size > 0 && size <= size_);
+
+    if(used_size_ == 0)
+        head_ = tail_ = 0;
+    else if(head_ == tail_)
+        return kNotReady; // Full.
+
+    size_t offset = AlignUp(head_, alignment);
+    if(head_ >= tail_)
     {
-        cbv_bindings_[slot].descriptor_index = UINT32_MAX;
+        // Free space is at the end and at the beginning.
+        if(offset + size > size_)
+        {
+            if(size > tail_)
+                return kNotReady;
+            offset = 0;
+        }
     }
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+    else
     {
-        srv_bindings_[slot].descriptor_index = UINT32_MAX;
+        // Free space is in the middle.
+        if(offset + size > tail_)
+            return kNotReady;
     }
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
+
+    const size_t end_offset = offset + size;
+    const size_t byte_count = end_offset > head_ ? end_offset - head_ : size_ - head_ + end_offset;
+    if(!regions_.empty() && regions_.back().fence_value == fence_value)
     {
-        uav_bindings_[slot].descriptor_index = UINT32_MAX;
+        regions_.back().end_offset = end_offset;
+        regions_.back().byte_count += byte_count;
     }
+    else
+        regions_.push_back(Region{fence_value, end_offset, byte_count});
+
+    used_size_ += byte_count;
+    head_ = end_offset == size_ ? 0 : end_offset;
+
+    out_offset = offset;
+    out_ptr = mapped_ptr_ + offset;
+    return kSuccess;
 }
 
-bool BindingState::IsBufferBound(BufferImpl* buf)
+void UploadRing::Retire(uint64_t completed_fence_value)
 {
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    while(!regions_.empty() && regions_.front().fence_value <= completed_fence_value)
     {
-        if(cbv_bindings_[slot].buffer == buf)
-            return true;
+        const Region& region = regions_.front();
+        tail_ = region.end_offset == size_ ? 0 : region.end_offset;
+        used_size_ -= region.byte_count;
+        regions_.pop_front();
     }
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class CopyQueue
+
+Result CopyQueue::Init(const wchar_t* device_name, uint32_t batch_count, ID3D12Fence* compute_fence)
+{
+    JD3D12_ASSERT(batch_count > 0 && compute_fence != nullptr);
+    compute_fence_ = compute_fence;
+
+    ID3D12Device* const device = GetD3d12Device();
+
+    D3D12_COMMAND_QUEUE_DESC queue_desc{};
+    queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateCommandQueue(&queue_desc, IID_PPV_ARGS(&command_queue_)));
+    SetObjectName(command_queue_, device_name, L"CopyQueue");
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence_)));
+    SetObjectName(fence_, device_name, L"CopyQueue fence");
+
+    fence_event_.reset(CreateEvent(NULL, FALSE, FALSE, NULL));
+
+    batches_.resize(batch_count);
+    for(uint32_t batch_index = 0; batch_index < batch_count; ++batch_index)
     {
-        if(srv_bindings_[slot].buffer == buf)
-            return true;
+        Batch& batch = batches_[batch_index];
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+            IID_PPV_ARGS(&batch.command_allocator)));
+        SetObjectName(batch.command_allocator, device_name,
+            SPrintF(L"CopyQueue CommandAllocator %u", batch_index).c_str());
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+            batch.command_allocator, nullptr, IID_PPV_ARGS(&batch.command_list)));
+        SetObjectName(batch.command_list, device_name, SPrintF(L"CopyQueue CommandList %u", batch_index).c_str());
+        JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Close());
     }
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
+    // The first call to BeginRecording advances to batch 0.
+    current_batch_index_ = batch_count - 1;
+
+    return kSuccess;
+}
+
+Result CopyQueue::BeginRecording(ID3D12GraphicsCommandList*& out_command_list)
+{
+    if(!is_recording_)
     {
-        if(uav_bindings_[slot].buffer == buf)
-            return true;
+        const uint32_t next_batch_index = (current_batch_index_ + 1) % uint32_t(batches_.size());
+        Batch& batch = batches_[next_batch_index];
+        JD3D12_RETURN_IF_FAILED(WaitForFenceValue(batch.fence_value, kTimeoutInfinite));
+
+        JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_allocator->Reset());
+        JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Reset(batch.command_allocator, nullptr));
+
+        current_batch_index_ = next_batch_index;
+        is_recording_ = true;
     }
-    return false;
+    out_command_list = batches_[current_batch_index_].command_list;
+    return kSuccess;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// class ShaderCompilationResultImpl
+void CopyQueue::AddComputeQueueWait(uint64_t fence_value)
+{
+    JD3D12_ASSERT(is_recording_);
+    compute_wait_fence_value_ = std::max(compute_wait_fence_value_, fence_value);
+}
 
-ShaderCompilationResultImpl::ShaderCompilationResultImpl(ShaderCompilationResult* interface_obj, EnvironmentImpl* env)
-    : interface_obj_{ interface_obj }
-    , env_{ env }
+void CopyQueue::TransitionResource(ID3D12Resource* resource, D3D12_RESOURCE_STATES state)
 {
+    JD3D12_ASSERT(is_recording_);
+    // The first use in the command list is promoted from COMMON automatically.
+    const auto [it, inserted] = resource_states_.emplace(resource, state);
+    if(inserted || it->second == state)
+        return;
+
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.Transition.pResource = resource;
+    barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+    barrier.Transition.StateBefore = it->second;
+    barrier.Transition.StateAfter = state;
+    batches_[current_batch_index_].command_list->ResourceBarrier(1, &barrier);
+    it->second = state;
 }
 
-Result ShaderCompilationResultImpl::Init(CComPtr<IDxcResult>&& dxc_result)
+Result CopyQueue::Submit()
 {
-    dxc_result_ = std::move(dxc_result);
+    if(!is_recording_)
+        return kSuccess;
 
-    dxc_result_->GetStatus(&status_);
+    Batch& batch = batches_[current_batch_index_];
+    JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Close());
 
-    if(FAILED(dxc_result_->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors_), nullptr)))
-        errors_.Release();
+    if(compute_wait_fence_value_ > 0)
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Wait(compute_fence_, compute_wait_fence_value_));
+        compute_wait_fence_value_ = 0;
+    }
 
-    if(FAILED(dxc_result_->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&object_), nullptr)))
-        object_.Release();
+    ID3D12CommandList* command_lists[] = { batch.command_list };
+    command_queue_->ExecuteCommandLists(1, command_lists);
+
+    ++submitted_fence_value_;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Signal(fence_, submitted_fence_value_));
+    batch.fence_value = submitted_fence_value_;
 
+    resource_states_.clear();
+    is_recording_ = false;
     return kSuccess;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// class DeviceImpl
-
-DeviceImpl::DeviceImpl(Device* interface_obj, EnvironmentImpl* env, const DeviceDesc& desc)
-    : DeviceObject{ this, desc }
-    , interface_obj_{ interface_obj }
-    , env_{ env }
-    , desc_{ desc }
-    , main_root_signature_{ std::make_unique<MainRootSignature>(this) }
-    , shader_visible_descriptor_heap_{ this, desc.name, true }
-    , shader_invisible_descriptor_heap_{ this, desc.name, false }
+Result CopyQueue::WaitForFenceValue(uint64_t fence_value, uint32_t timeout_milliseconds)
 {
-    JD3D12_ASSERT(env);
+    JD3D12_ASSERT(fence_value <= submitted_fence_value_);
 
-    Singleton& singleton = Singleton::GetInstance();
-    if(singleton.dev_count_ == 0)
-    {
-        singleton.first_dev_ = interface_obj;
-        singleton.dev_count_ = 1;
-    }
-    else
+    if(fence_->GetCompletedValue() >= fence_value)
+        return kSuccess;
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(fence_->SetEventOnCompletion(fence_value, fence_event_.get()));
+    const DWORD wait_result = WaitForSingleObject(fence_event_.get(), timeout_milliseconds);
+    switch(wait_result)
     {
-        ++singleton.dev_count_;
+    case WAIT_OBJECT_0:
+        return kSuccess;
+    case WAIT_TIMEOUT:
+        return kNotReady;
+    default: // Most likely WAIT_FAILED.
+        return MakeResultFromLastError();
     }
 }
 
-DeviceImpl::~DeviceImpl()
+Result CopyQueue::WaitForIdle()
 {
-    if(command_list_)
-    {
-        HRESULT hr = EnsureCommandListState(CommandListState::kNone);
-        JD3D12_ASSERT(SUCCEEDED(hr) && "Failed to process pending command list in Device destructor.");
-    }
+    JD3D12_RETURN_IF_FAILED(Submit());
+    return WaitForFenceValue(submitted_fence_value_, kTimeoutInfinite);
+}
 
-    DestroyStaticShaders();
-    DestroyStaticBuffers();
+////////////////////////////////////////////////////////////////////////////////
+// class ResourceUsageMap
 
-    // Log device destroy only after static resources have been destroyed.
-    JD3D12_LOG(kLogSeverityInfo, L"Destroying Device 0x%016" PRIXPTR, uintptr_t(GetInterface()));
+bool ResourceUsageMap::IsUsed(BufferImpl* buf, uint32_t usage_flags) const
+{
+    const auto it = map_.find(buf);
+    if(it == map_.end())
+        return false;
+    return (it->second.flags & usage_flags) != 0;
+}
 
-    JD3D12_ASSERT(buffer_count_ == 0 && "Destroying Device object while there are still Buffer objects not destroyed.");
-    JD3D12_ASSERT(shader_count_ == 0 && "Destroying Device object while there are still Shader objects not destroyed.");
+////////////////////////////////////////////////////////////////////////////////
+// class RecordingImpl
 
-    if(info_queue_ && debug_layer_callback_cookie_ != UINT32_MAX)
-    {
-        info_queue_->UnregisterMessageCallback(debug_layer_callback_cookie_);
-    }
+RecordingImpl::RecordingImpl(Recording* interface_obj, DeviceImpl* device)
+    : DeviceObject{device, nullptr}
+    , interface_obj_{interface_obj}
+{
+    ++device->recording_count_;
+}
 
-    Singleton& singleton = Singleton::GetInstance();
-    if(singleton.dev_count_ == 1)
-    {
-        singleton.first_dev_ = nullptr;
-        singleton.dev_count_ = 0;
-    }
-    else
+RecordingImpl::~RecordingImpl()
+{
+    JD3D12_LOG(kLogSeverityInfo, L"Destroying Recording 0x%016" PRIXPTR, uintptr_t(interface_obj_));
+
+    DeviceImpl* const dev = GetDevice();
+    HRESULT hr = dev->WaitForRecordingUnused(this);
+    JD3D12_ASSERT(SUCCEEDED(hr) && "Failed to wait for recording unused in Recording destructor.");
+
+    if(ended_)
     {
-        --singleton.dev_count_;
+        for(const auto& [buf, usage] : batch_.resource_usage_map.map_)
+            --buf->recording_ref_count_;
+        for(ShaderImpl* shader : batch_.shader_usage_set)
+            --shader->recording_ref_count_;
     }
+    for(uint32_t descriptor_index : descriptor_indices_)
+        dev->shader_visible_descriptor_heap_.FreePersistent(descriptor_index);
+
+    --dev->recording_count_;
 }
 
-Result DeviceImpl::CreateBuffer(const BufferDesc& desc, Buffer*& out_buffer)
+Result RecordingImpl::Init()
 {
-    return CreateBufferFromMemory(desc, ConstDataSpan{nullptr, 0}, out_buffer);
+    DeviceImpl* const dev = GetDevice();
+    ID3D12Device* const device = dev->GetD3D12Device();
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE,
+        IID_PPV_ARGS(&batch_.command_allocator)));
+    SetObjectName(batch_.command_allocator, dev->desc_.name, L"Recording CommandAllocator");
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+        batch_.command_allocator, nullptr, IID_PPV_ARGS(&batch_.command_list)));
+    SetObjectName(batch_.command_list, dev->desc_.name, L"Recording CommandList");
+    if(dev->enhanced_barriers_)
+        JD3D12_LOG_AND_RETURN_IF_FAILED(batch_.command_list->QueryInterface(IID_PPV_ARGS(&batch_.command_list7)));
+
+    return kSuccess;
 }
 
-Result DeviceImpl::CreateBufferFromMemory(const BufferDesc& desc, ConstDataSpan initial_data,
-    Buffer*& out_buffer)
+////////////////////////////////////////////////////////////////////////////////
+// class ShaderFamilyImpl
+
+ShaderFamilyImpl::ShaderFamilyImpl(ShaderFamily* interface_obj, DeviceImpl* device, const ShaderFamilyDesc& desc)
+    : DeviceObject{device, desc.name}
+    , interface_obj_{interface_obj}
 {
-    out_buffer = nullptr;
+}
 
-    auto buf = std::unique_ptr<Buffer>{new Buffer{}};
-    buf->impl_ = new BufferImpl{ buf.get(), this, desc };
+ShaderFamilyImpl::~ShaderFamilyImpl()
+{
+    JD3D12_LOG(kLogSeverityInfo, L"Destroying ShaderFamily 0x%016" PRIXPTR, uintptr_t(interface_obj_));
 
-    if(initial_data.size > 0)
+    cancel_prewarm_ = true;
+    WaitForPrewarm();
+    variants_.clear();
+    unique_shaders_.clear();
+}
+
+Result ShaderFamilyImpl::Init(const ShaderFamilyDesc& desc)
+{
+    const ShaderCompilationParams& params = desc.compilation_params;
+    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(desc.hlsl_source_file_path)
+        || (desc.hlsl_source.data != nullptr && desc.hlsl_source.size > 0),
+        L"ShaderFamilyDesc must have hlsl_source_file_path or hlsl_source.");
+    JD3D12_ASSERT_OR_RETURN(params.macro_defines.count % 2 == 0,
+        L"ShaderCompilationParams::macro_defines must have an even number of elements.");
+    JD3D12_ASSERT_OR_RETURN(desc.axes.count == 0 || desc.axes.data != nullptr, L"axes.data cannot be null.");
+
+    compilation_params_ = params;
+    if(params.entry_point != nullptr)
     {
-        JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu, initial_data.size=%zu",
-            uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size, initial_data.size);
+        entry_point_ = params.entry_point;
+        compilation_params_.entry_point = entry_point_.c_str();
+    }
+    for(size_t i = 0; i < params.macro_defines.count; ++i)
+    {
+        const wchar_t* const str = params.macro_defines.data[i];
+        macro_defines_.push_back(str != nullptr ? str : L"");
     }
+    compilation_params_.macro_defines = { nullptr, 0 };
+    for(size_t i = 0; i < params.additional_dxc_args.count; ++i)
+        additional_dxc_args_.push_back(params.additional_dxc_args.data[i]);
+    for(const std::wstring& arg : additional_dxc_args_)
+        additional_dxc_arg_ptrs_.push_back(arg.c_str());
+    compilation_params_.additional_dxc_args = { additional_dxc_arg_ptrs_.data(), additional_dxc_arg_ptrs_.size() };
+
+    if(!IsStringEmpty(desc.hlsl_source_file_path))
+        hlsl_source_file_path_ = desc.hlsl_source_file_path;
     else
     {
-        JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu",
-            uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size);
+        const char* const source = (const char*)desc.hlsl_source.data;
+        hlsl_source_.assign(source, source + desc.hlsl_source.size);
     }
 
-    JD3D12_RETURN_IF_FAILED(buf->GetImpl()->Init(initial_data));
+    axes_.resize(desc.axes.count);
+    for(size_t axis_index = 0; axis_index < desc.axes.count; ++axis_index)
+    {
+        const ShaderPermutationAxis& src_axis = desc.axes.data[axis_index];
+        JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(src_axis.macro_name),
+            L"ShaderPermutationAxis::macro_name cannot be null or empty.");
+        JD3D12_ASSERT_OR_RETURN(src_axis.values.count < UINT32_MAX
+            && (src_axis.values.count == 0 || src_axis.values.data != nullptr),
+            L"Invalid ShaderPermutationAxis::values.");
+        Axis& axis = axes_[axis_index];
+        axis.macro_name = src_axis.macro_name;
+        for(size_t value_index = 0; value_index < src_axis.values.count; ++value_index)
+        {
+            const wchar_t* const value = src_axis.values.data[value_index];
+            JD3D12_ASSERT_OR_RETURN(value != nullptr, L"ShaderPermutationAxis::values cannot contain null.");
+            axis.values.push_back(value);
+        }
+
+        const uint64_t value_count = axis.GetValueCount();
+        JD3D12_ASSERT_OR_RETURN(permutation_count_ <= UINT64_MAX / value_count,
+            L"Too many permutations in the ShaderFamily.");
+        permutation_count_ *= value_count;
+    }
 
-    out_buffer = buf.release();
     return kSuccess;
 }
 
-Result DeviceImpl::CreateBufferFromFile(const BufferDesc& desc, const wchar_t* initial_data_file_path,
-    Buffer*& out_buffer)
+Result ShaderFamilyImpl::MakeKey(const uint32_t* value_indices, uint64_t& out_key) const
 {
-    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(initial_data_file_path),
-        L"initial_data_file_path cannot be null or empty.");
-
-    JD3D12_LOG(kLogSeverityInfo, L"Loading buffer initial data from file \"%s\"",
-        initial_data_file_path);
-
-    char* data_ptr = nullptr;
-    size_t data_size = 0;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(LoadFile(initial_data_file_path, data_ptr, data_size, desc.size));
-    std::unique_ptr<char[]> data{ data_ptr };
-
-    return CreateBufferFromMemory(desc, ConstDataSpan{data_ptr, data_size}, out_buffer);
+    out_key = 0;
+    uint64_t stride = 1;
+    for(size_t axis_index = 0; axis_index < axes_.size(); ++axis_index)
+    {
+        const uint32_t value_count = axes_[axis_index].GetValueCount();
+        JD3D12_ASSERT_OR_RETURN(value_indices[axis_index] < value_count,
+            L"Value index out of range of the ShaderFamily axis.");
+        out_key += value_indices[axis_index] * stride;
+        stride *= value_count;
+    }
+    return kSuccess;
 }
 
-Result DeviceImpl::CreateShaderFromMemory(const ShaderDesc& desc, ConstDataSpan bytecode,
-    Shader*& out_shader)
+Result ShaderFamilyImpl::GetShader(ArraySpan<const uint32_t> value_indices, Shader*& out_shader)
 {
     out_shader = nullptr;
+    JD3D12_ASSERT_OR_RETURN(value_indices.count == axes_.size(),
+        L"Number of value indices must be equal to the number of ShaderFamily axes.");
+    JD3D12_ASSERT_OR_RETURN(value_indices.count == 0 || value_indices.data != nullptr,
+        L"value_indices.data cannot be null.");
 
-    JD3D12_ASSERT_OR_RETURN(bytecode.data != nullptr && bytecode.size > 0,
-        L"Shader bytecode cannot be null or empty.");
+    uint64_t key = 0;
+    JD3D12_RETURN_IF_FAILED(MakeKey(value_indices.data, key));
+    return GetOrCreateVariant(key, out_shader);
+}
 
-    CComPtr<ID3D12ShaderReflection> reflection;
-    DxcBuffer buf = {bytecode.data, bytecode.size};
-    JD3D12_LOG_AND_RETURN_IF_FAILED(env_->GetShaderCompiler().GetDxcUtils()->CreateReflection(
-        &buf, IID_PPV_ARGS(&reflection)));
+Result ShaderFamilyImpl::Prewarm(ArraySpan<const uint32_t> value_indices, uint32_t thread_count)
+{
+    const size_t axis_count = std::max<size_t>(axes_.size(), 1);
+    JD3D12_ASSERT_OR_RETURN(value_indices.count % axis_count == 0 || axes_.empty(),
+        L"Number of value indices must be a multiple of the number of ShaderFamily axes.");
+    JD3D12_ASSERT_OR_RETURN(value_indices.count == 0 || value_indices.data != nullptr,
+        L"value_indices.data cannot be null.");
 
-    auto shader = std::unique_ptr<Shader>{new Shader{}};
-    shader->impl_ = new ShaderImpl{ shader.get(), this, desc };
+    auto job = std::make_shared<PrewarmJob>();
+    if(axes_.empty())
+        job->keys.push_back(0);
+    else
+    {
+        for(size_t i = 0; i < value_indices.count; i += axis_count)
+        {
+            uint64_t key = 0;
+            JD3D12_RETURN_IF_FAILED(MakeKey(value_indices.data + i, key));
+            job->keys.push_back(key);
+        }
+    }
+    if(job->keys.empty())
+        return kSuccess;
 
-    JD3D12_LOG(kLogSeverityInfo, L"Creating Shader 0x%016" PRIXPTR " \"%s\"",
-        uintptr_t(shader.get()), EnsureNonNullString(desc.name));
+    if(thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    thread_count = uint32_t(std::min<size_t>(thread_count, job->keys.size()));
 
-    JD3D12_RETURN_IF_FAILED(shader->GetImpl()->Init(bytecode, reflection));
+    JD3D12_LOG(kLogSeverityInfo, L"Prewarming %zu variants of ShaderFamily 0x%016" PRIXPTR " using %u threads",
+        job->keys.size(), uintptr_t(interface_obj_), thread_count);
 
-    out_shader = shader.release();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(uint32_t i = 0; i < thread_count; ++i)
+        prewarm_threads_.emplace_back(&ShaderFamilyImpl::PrewarmThreadMain, this, job);
     return kSuccess;
 }
 
-Result DeviceImpl::CreateShaderFromFile(const ShaderDesc& desc, const wchar_t* bytecode_file_path,
-    Shader*& out_shader)
+void ShaderFamilyImpl::PrewarmThreadMain(std::shared_ptr<PrewarmJob> job)
 {
-    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(bytecode_file_path),
-        L"bytecode_file_path cannot be null or empty.");
-
-    JD3D12_LOG(kLogSeverityInfo, L"Loading shader bytecode from file \"%s\"", bytecode_file_path);
-
-    char* data_ptr = nullptr;
-    size_t data_size = 0;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(LoadFile(bytecode_file_path, data_ptr, data_size));
+    for(size_t i = job->next_key_index++; i < job->keys.size() && !cancel_prewarm_; i = job->next_key_index++)
+    {
+        Shader* shader = nullptr;
+        const Result res = GetOrCreateVariant(job->keys[i], shader);
+        if(Failed(res))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(Succeeded(prewarm_result_))
+                prewarm_result_ = res;
+        }
+    }
+}
 
-    if(data_ptr == nullptr || data_size == 0)
-        return kErrorUnexpected;
+Result ShaderFamilyImpl::WaitForPrewarm()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threads.swap(prewarm_threads_);
+    }
+    for(std::thread& thread : threads)
+        thread.join();
 
-    std::unique_ptr<char[]> data{ data_ptr };
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Result res = prewarm_result_;
+    prewarm_result_ = kSuccess;
+    return res;
+}
 
-    return CreateShaderFromMemory(desc, ConstDataSpan{data_ptr, data_size}, out_shader);
+size_t ShaderFamilyImpl::GetVariantCount() const noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return created_variant_count_;
 }
 
-Result DeviceImpl::CompileAndCreateShaderFromMemory(const ShaderCompilationParams& compilation_params,
-    const ShaderDesc& desc, ConstDataSpan hlsl_source, Shader*& out_shader)
+size_t ShaderFamilyImpl::GetUniqueShaderCount() const noexcept
 {
-    ShaderCompilationResult* result_ptr = nullptr;
-    JD3D12_RETURN_IF_FAILED(env_->CompileShaderFromMemory(compilation_params, L"shader_from_memory.hlsl",
-        hlsl_source, result_ptr));
-    std::unique_ptr<ShaderCompilationResult> result{ result_ptr };
+    return unique_shader_count_.load();
+}
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(result->GetResult());
+Result ShaderFamilyImpl::GetOrCreateVariant(uint64_t key, Shader*& out_shader)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const auto [it, inserted] = variants_.try_emplace(key);
+        // References to elements of std::unordered_map stay valid when other elements are inserted.
+        Variant& variant = it->second;
+        if(!inserted)
+        {
+            variant_created_cv_.wait(lock, [&variant]() { return !variant.is_pending; });
+            out_shader = variant.shader;
+            return variant.result;
+        }
+    }
 
-    const ConstDataSpan bytecode = result->GetBytecode();
-    if(bytecode.size == 0)
-        return kErrorFail;
+    Shader* shader = nullptr;
+    const Result res = CreateVariant(key, shader);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Variant& variant = variants_[key];
+        variant.shader = shader;
+        variant.result = res;
+        variant.is_pending = false;
+        if(shader != nullptr)
+            ++created_variant_count_;
+    }
+    variant_created_cv_.notify_all();
 
-    return CreateShaderFromMemory(desc, bytecode, out_shader);
+    out_shader = shader;
+    return res;
 }
 
-Result DeviceImpl::CompileAndCreateShaderFromFile(const ShaderCompilationParams& compilation_params,
-    const ShaderDesc& desc, const wchar_t* hlsl_source_file_path, Shader*& out_shader)
+Result ShaderFamilyImpl::CreateVariant(uint64_t key, Shader*& out_shader)
 {
+    out_shader = nullptr;
+
+    std::vector<const wchar_t*> macro_defines;
+    macro_defines.reserve(macro_defines_.size() + axes_.size() * 2);
+    for(const std::wstring& str : macro_defines_)
+        macro_defines.push_back(str.c_str());
+    std::wstring variant_name = EnsureNonNullString(GetName());
+    variant_name += L" [";
+    for(size_t axis_index = 0; axis_index < axes_.size(); ++axis_index)
+    {
+        const Axis& axis = axes_[axis_index];
+        const uint32_t value_index = uint32_t(key % axis.GetValueCount());
+        key /= axis.GetValueCount();
+
+        if(axis_index > 0)
+            variant_name += L", ";
+        variant_name += axis.macro_name;
+        if(axis.values.empty())
+        {
+            variant_name += value_index ? L"=on" : L"=off";
+            if(value_index == 0)
+                continue;
+            macro_defines.push_back(axis.macro_name.c_str());
+            macro_defines.push_back(nullptr);
+        }
+        else
+        {
+            variant_name += L"=";
+            variant_name += axis.values[value_index];
+            macro_defines.push_back(axis.macro_name.c_str());
+            macro_defines.push_back(axis.values[value_index].c_str());
+        }
+    }
+    variant_name += L"]";
+
+    JD3D12_LOG(kLogSeverityInfo, L"Compiling ShaderFamily variant \"%s\"", variant_name.c_str());
+
+    ShaderCompilationParams params = compilation_params_;
+    params.macro_defines = { macro_defines.data(), macro_defines.size() };
+    EnvironmentImpl* const env = GetDevice()->GetEnvironment();
     ShaderCompilationResult* result_ptr = nullptr;
-    JD3D12_RETURN_IF_FAILED(env_->CompileShaderFromFile(compilation_params, hlsl_source_file_path,
-        result_ptr));
-    std::unique_ptr<ShaderCompilationResult> shader_compilation_result{ result_ptr };
+    if(!hlsl_source_file_path_.empty())
+        JD3D12_RETURN_IF_FAILED(env->CompileShaderFromFile(params, hlsl_source_file_path_.c_str(), result_ptr));
+    else
+    {
+        JD3D12_RETURN_IF_FAILED(env->CompileShaderFromMemory(params, L"shader_from_memory.hlsl",
+            ConstDataSpan{ hlsl_source_.data(), hlsl_source_.size() }, result_ptr));
+    }
+    std::unique_ptr<ShaderCompilationResult> result{ result_ptr };
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(result->GetResult());
+    const ConstDataSpan bytecode = result->GetBytecode();
+    if(bytecode.size == 0)
+        return kErrorFail;
+
+    const char* const bytecode_bytes = (const char*)bytecode.data;
+    const uint64_t hash = HashFnv1a64(bytecode.data, bytecode.size);
+    std::lock_guard<std::mutex> create_lock(create_mutex_);
+    const auto range = unique_shaders_.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        const std::vector<char>& existing = it->second.bytecode;
+        if(existing.size() == bytecode.size && memcmp(existing.data(), bytecode.data, bytecode.size) == 0)
+        {
+            out_shader = it->second.shader.get();
+            return kSuccess;
+        }
+    }
+
+    ShaderDesc shader_desc{};
+    shader_desc.name = variant_name.c_str();
+    Shader* shader_ptr = nullptr;
+    JD3D12_RETURN_IF_FAILED(GetDevice()->CreateShaderFromMemory(shader_desc, bytecode, shader_ptr));
+
+    UniqueShader unique_shader;
+    unique_shader.bytecode.assign(bytecode_bytes, bytecode_bytes + bytecode.size);
+    unique_shader.shader.reset(shader_ptr);
+    unique_shaders_.emplace(hash, std::move(unique_shader));
+    ++unique_shader_count_;
+
+    out_shader = shader_ptr;
+    return kSuccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class MainRootSignature
+
+Result MainRootSignature::Init(bool bindless)
+{
+    D3D12_DESCRIPTOR_RANGE desc_ranges[kTotalParamCount] = {};
+    D3D12_ROOT_PARAMETER params[kTotalParamCount + 2] = {};
+    uint32_t param_index = 0;
+    for(uint32_t i = 0; i < kMaxCBVCount; ++i, ++param_index)
+    {
+        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+        desc_ranges[param_index].NumDescriptors = 1;
+        desc_ranges[param_index].BaseShaderRegister = i;
+        desc_ranges[param_index].RegisterSpace = 0;
+        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
+
+        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
+        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
+        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    }
+    for(uint32_t i = 0; i < kMaxSRVCount; ++i, ++param_index)
+    {
+        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+        desc_ranges[param_index].NumDescriptors = 1;
+        desc_ranges[param_index].BaseShaderRegister = i;
+        desc_ranges[param_index].RegisterSpace = 0;
+        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
+
+        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
+        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
+        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    }
+    for(uint32_t i = 0; i < kMaxUAVCount; ++i, ++param_index)
+    {
+        desc_ranges[param_index].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+        desc_ranges[param_index].NumDescriptors = 1;
+        desc_ranges[param_index].BaseShaderRegister = i;
+        desc_ranges[param_index].RegisterSpace = 0;
+        desc_ranges[param_index].OffsetInDescriptorsFromTableStart = 0;
+
+        params[param_index].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+        params[param_index].DescriptorTable.NumDescriptorRanges = 1;
+        params[param_index].DescriptorTable.pDescriptorRanges = &desc_ranges[param_index];
+        params[param_index].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+    }
+    JD3D12_ASSERT(param_index == kTotalParamCount);
+
+    D3D12_ROOT_PARAMETER& root_constants_param = params[kRootConstantsRootParamIndex];
+    root_constants_param.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    root_constants_param.Constants.ShaderRegister = 1;
+    root_constants_param.Constants.RegisterSpace = 1;
+    root_constants_param.Constants.Num32BitValues = Device::kMaxRootConstantCount;
+    root_constants_param.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+    D3D12_ROOT_PARAMETER& dispatch_params_param = params[kDispatchParamsRootParamIndex];
+    dispatch_params_param.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    dispatch_params_param.Constants.ShaderRegister = 2;
+    dispatch_params_param.Constants.RegisterSpace = 1;
+    dispatch_params_param.Constants.Num32BitValues = kDispatchParamCount;
+    dispatch_params_param.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+    CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC root_sig_desc = {};
+    root_sig_desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_0;
+    root_sig_desc.Desc_1_0.Flags = D3D12_ROOT_SIGNATURE_FLAG_DENY_VERTEX_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_PIXEL_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_AMPLIFICATION_SHADER_ROOT_ACCESS
+        | D3D12_ROOT_SIGNATURE_FLAG_DENY_MESH_SHADER_ROOT_ACCESS;
+    root_sig_desc.Desc_1_0.pParameters = params;
+    root_sig_desc.Desc_1_0.NumParameters = kTotalParamCount + 2;
+
+    /* Bindless mode needs version 1.1 for D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED.
+    The descriptor tables stay, marked volatile to keep the semantics of version 1.0, so shaders using
+    registers still work.
+    */
+    D3D12_DESCRIPTOR_RANGE1 desc_ranges_1_1[kTotalParamCount] = {};
+    D3D12_ROOT_PARAMETER1 params_1_1[kTotalParamCount + 2] = {};
+    if(bindless)
+    {
+        for(uint32_t i = 0; i < kTotalParamCount; ++i)
+        {
+            desc_ranges_1_1[i].RangeType = desc_ranges[i].RangeType;
+            desc_ranges_1_1[i].NumDescriptors = desc_ranges[i].NumDescriptors;
+            desc_ranges_1_1[i].BaseShaderRegister = desc_ranges[i].BaseShaderRegister;
+            desc_ranges_1_1[i].RegisterSpace = desc_ranges[i].RegisterSpace;
+            desc_ranges_1_1[i].Flags = D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE;
+            if(desc_ranges[i].RangeType != D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
+                desc_ranges_1_1[i].Flags |= D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE;
+            desc_ranges_1_1[i].OffsetInDescriptorsFromTableStart = desc_ranges[i].OffsetInDescriptorsFromTableStart;
+
+            params_1_1[i].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+            params_1_1[i].DescriptorTable.NumDescriptorRanges = 1;
+            params_1_1[i].DescriptorTable.pDescriptorRanges = &desc_ranges_1_1[i];
+            params_1_1[i].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+        }
+        D3D12_ROOT_PARAMETER1& root_constants_param_1_1 = params_1_1[kRootConstantsRootParamIndex];
+        root_constants_param_1_1.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        root_constants_param_1_1.Constants = root_constants_param.Constants;
+        root_constants_param_1_1.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+        D3D12_ROOT_PARAMETER1& indices_param = params_1_1[kBindlessIndicesRootParamIndex];
+        indices_param.ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+        indices_param.Constants.ShaderRegister = 0;
+        indices_param.Constants.RegisterSpace = 1;
+        indices_param.Constants.Num32BitValues = Device::kMaxBindlessIndexCount;
+        indices_param.ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+        const D3D12_ROOT_SIGNATURE_FLAGS flags = root_sig_desc.Desc_1_0.Flags;
+        root_sig_desc.Version = D3D_ROOT_SIGNATURE_VERSION_1_1;
+        root_sig_desc.Desc_1_1 = {};
+        root_sig_desc.Desc_1_1.Flags = flags | D3D12_ROOT_SIGNATURE_FLAG_CBV_SRV_UAV_HEAP_DIRECTLY_INDEXED;
+        root_sig_desc.Desc_1_1.pParameters = params_1_1;
+        root_sig_desc.Desc_1_1.NumParameters = kTotalParamCount + 2;
+    }
+
+    ID3DBlob *root_sig_blob_ptr = nullptr, *error_blob_ptr = nullptr;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(D3D12SerializeVersionedRootSignature(&root_sig_desc, &root_sig_blob_ptr, &error_blob_ptr));
+    CComPtr<ID3DBlob> root_sig_blob{root_sig_blob_ptr};
+    CComPtr<ID3DBlob> error_blob{error_blob_ptr};
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateRootSignature(0, root_sig_blob->GetBufferPointer(),
+        root_sig_blob->GetBufferSize(), IID_PPV_ARGS(&root_signature_)));
+    SetObjectName(root_signature_, L"Main root signature");
+
+    hash_ = HashFnv1a64(root_sig_blob->GetBufferPointer(), root_sig_blob->GetBufferSize());
+
+    // The arguments change no root parameters, so the command signature doesn't need the root signature.
+    D3D12_INDIRECT_ARGUMENT_DESC dispatch_arg_desc = {};
+    dispatch_arg_desc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+    D3D12_COMMAND_SIGNATURE_DESC command_sig_desc = {};
+    command_sig_desc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+    command_sig_desc.NumArgumentDescs = 1;
+    command_sig_desc.pArgumentDescs = &dispatch_arg_desc;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateCommandSignature(&command_sig_desc, nullptr,
+        IID_PPV_ARGS(&dispatch_command_signature_)));
+    SetObjectName(dispatch_command_signature_, L"Dispatch command signature");
+
+    return kSuccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class PipelineLibrary
+
+Result PipelineLibrary::Init(const wchar_t* file_path)
+{
+    JD3D12_ASSERT(!IsStringEmpty(file_path));
+    file_path_ = file_path;
+
+    CComPtr<ID3D12Device1> device1;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->QueryInterface(IID_PPV_ARGS(&device1)));
+
+    char* data_ptr = nullptr;
+    size_t data_size = 0;
+    if(LoadFile(file_path, data_ptr, data_size) == kSuccess)
+    {
+        file_data_.reset(data_ptr);
+        const HRESULT hr = device1->CreatePipelineLibrary(data_ptr, data_size, IID_PPV_ARGS(&library_));
+        if(SUCCEEDED(hr))
+        {
+            JD3D12_LOG(kLogSeverityInfo, L"Loaded pipeline library \"%s\": size=%zu", file_path, data_size);
+            return kSuccess;
+        }
+        // Typically D3D12_ERROR_DRIVER_VERSION_MISMATCH or D3D12_ERROR_ADAPTER_NOT_FOUND. The library is recreated.
+        JD3D12_LOG(kLogSeverityInfo, L"Pipeline library \"%s\" cannot be used (0x%08X). Creating a new one.",
+            file_path, hr);
+        file_data_.reset();
+    }
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library_)));
+    return kSuccess;
+}
+
+Result PipelineLibrary::CreateComputePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc,
+    uint64_t root_signature_hash, CComPtr<ID3D12PipelineState>& out_pipeline_state)
+{
+    JD3D12_ASSERT(library_);
+
+    const uint64_t hash = HashFnv1a64(desc.CS.pShaderBytecode, desc.CS.BytecodeLength, root_signature_hash);
+    const std::wstring name = SPrintF(L"%016llX", (unsigned long long)hash);
+
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        // Fails with E_INVALIDARG if there is no such pipeline state in the library.
+        if(SUCCEEDED(library_->LoadComputePipeline(name.c_str(), &desc, IID_PPV_ARGS(&out_pipeline_state))))
+            return kSuccess;
+    }
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(GetD3d12Device()->CreateComputePipelineState(
+        &desc, IID_PPV_ARGS(&out_pipeline_state)));
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    // Fails with E_INVALIDARG if another thread has stored the same pipeline state in the meantime.
+    if(SUCCEEDED(library_->StorePipeline(name.c_str(), out_pipeline_state)))
+        modified_ = true;
+    return kSuccess;
+}
+
+void PipelineLibrary::Save()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if(!modified_)
+        return;
+
+    std::vector<char> data(library_->GetSerializedSize());
+    HRESULT hr = library_->Serialize(data.data(), data.size());
+    if(SUCCEEDED(hr))
+        hr = SaveFileAtomically(file_path_.c_str(), ConstDataSpan{data.data(), data.size()});
+    if(FAILED(hr))
+    {
+        JD3D12_LOG(kLogSeverityWarning, L"Cannot save pipeline library \"%s\" (0x%08X).", file_path_.c_str(), hr);
+        return;
+    }
+
+    JD3D12_LOG(kLogSeverityInfo, L"Saved pipeline library \"%s\": size=%zu", file_path_.c_str(), data.size());
+    modified_ = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class BindingState
+
+void BindingState::ResetDescriptors()
+{
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    {
+        cbv_bindings_[slot].descriptor_index = UINT32_MAX;
+        cbv_bindings_[slot].root_argument_set = false;
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+    {
+        srv_bindings_[slot].descriptor_index = UINT32_MAX;
+        srv_bindings_[slot].root_argument_set = false;
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
+    {
+        uav_bindings_[slot].descriptor_index = UINT32_MAX;
+        uav_bindings_[slot].root_argument_set = false;
+    }
+    bindless_indices_dirty_ = true;
+    root_constants_dirty_ = true;
+    dispatch_params_dirty_ = true;
+    root_signature_set_ = false;
+}
+
+void BindingState::ResetBindlessIndices()
+{
+    for(uint32_t slot = 0; slot < Device::kMaxBindlessIndexCount; ++slot)
+    {
+        bindless_bindings_[slot] = BindlessBinding{};
+        bindless_indices_[slot] = UINT32_MAX;
+    }
+    bindless_indices_dirty_ = true;
+}
+
+bool BindingState::IsBufferBound(BufferImpl* buf)
+{
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    {
+        if(cbv_bindings_[slot].buffer == buf)
+            return true;
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+    {
+        if(srv_bindings_[slot].buffer == buf)
+            return true;
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
+    {
+        if(uav_bindings_[slot].buffer == buf)
+            return true;
+    }
+    for(uint32_t slot = 0; slot < Device::kMaxBindlessIndexCount; ++slot)
+    {
+        if(bindless_bindings_[slot].buffer == buf)
+            return true;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class ShaderCompilationResultImpl
+
+ShaderCompilationResultImpl::ShaderCompilationResultImpl(ShaderCompilationResult* interface_obj, EnvironmentImpl* env)
+    : interface_obj_{ interface_obj }
+    , env_{ env }
+{
+}
+
+Result ShaderCompilationResultImpl::Init(CComPtr<IDxcResult>&& dxc_result)
+{
+    dxc_result_ = std::move(dxc_result);
+
+    dxc_result_->GetStatus(&status_);
+
+    if(FAILED(dxc_result_->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&errors_), nullptr)))
+        errors_.Release();
+
+    if(FAILED(dxc_result_->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(&object_), nullptr)))
+        object_.Release();
+
+    return kSuccess;
+}
+
+Result ShaderCompilationResultImpl::InitFromBytecode(CComPtr<IDxcBlob>&& object)
+{
+    object_ = std::move(object);
+    status_ = S_OK;
+    return kSuccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// class DeviceImpl
+
+thread_local Recording* DeviceImpl::open_recording_ = nullptr;
+
+// Adds the counters of src_stats to inout_stats.
+static void AddCommandStatistics(CommandStatistics& inout_stats, const CommandStatistics& src_stats)
+{
+    inout_stats.dispatch_count += src_stats.dispatch_count;
+    inout_stats.transition_barrier_count += src_stats.transition_barrier_count;
+    inout_stats.uav_barrier_count += src_stats.uav_barrier_count;
+    inout_stats.aliasing_barrier_count += src_stats.aliasing_barrier_count;
+    inout_stats.descriptor_count += src_stats.descriptor_count;
+    inout_stats.bytes_written_immediate += src_stats.bytes_written_immediate;
+    inout_stats.bytes_written_through_upload_ring += src_stats.bytes_written_through_upload_ring;
+}
+
+DeviceImpl::DeviceImpl(Device* interface_obj, EnvironmentImpl* env, const DeviceDesc& desc)
+    : DeviceObject{ this, desc }
+    , interface_obj_{ interface_obj }
+    , env_{ env }
+    , desc_{ desc }
+    , main_root_signature_{ std::make_unique<MainRootSignature>(this) }
+    , shader_visible_descriptor_heap_{ this, desc.name, true }
+    , shader_invisible_descriptor_heap_{ this, desc.name, false }
+    , upload_ring_{ this, desc.name }
+{
+    JD3D12_ASSERT(env);
+
+    Singleton& singleton = Singleton::GetInstance();
+    if(singleton.dev_count_ == 0)
+    {
+        singleton.first_dev_ = interface_obj;
+        singleton.dev_count_ = 1;
+    }
+    else
+    {
+        ++singleton.dev_count_;
+    }
+}
+
+DeviceImpl::~DeviceImpl()
+{
+    JD3D12_ASSERT(open_recording_count_ == 0 && "Destroying Device object between BeginRecording and EndRecording.");
+    if(RecordingImpl* const recording = GetOpenRecording())
+    {
+        Recording* const recording_obj = recording->interface_obj_;
+        open_recording_ = nullptr;
+        --open_recording_count_;
+        delete recording_obj;
+    }
+    if(!command_batches_.empty() && GetCommandList() != nullptr && fence_)
+    {
+        HRESULT hr = EnsureCommandListState(CommandListState::kNone);
+        JD3D12_ASSERT(SUCCEEDED(hr) && "Failed to process pending command list in Device destructor.");
+    }
+    if(copy_queue_)
+    {
+        HRESULT hr = copy_queue_->WaitForIdle();
+        JD3D12_ASSERT(SUCCEEDED(hr) && "Failed to process pending copy queue commands in Device destructor.");
+    }
+
+    // Pending reads that were never completed are dropped.
+    pending_readbacks_.clear();
+    free_readback_staging_buffers_.clear();
+    free_transient_buffers_.clear();
+    for(const std::unique_ptr<TransientMemoryBlock>& block : transient_memory_blocks_)
+    {
+        JD3D12_ASSERT(block->acquired_buffer == nullptr
+            && "Destroying Device object while there are still transient buffers not released.");
+    }
+    transient_memory_blocks_.clear();
+
+    primitive_shaders_.clear();
+    DestroyStaticShaders();
+    DestroyStaticBuffers();
+
+    if(pipeline_library_)
+        pipeline_library_->Save();
+
+    // Log device destroy only after static resources have been destroyed.
+    JD3D12_LOG(kLogSeverityInfo, L"Destroying Device 0x%016" PRIXPTR, uintptr_t(GetInterface()));
+
+    JD3D12_ASSERT(buffer_count_ == 0 && "Destroying Device object while there are still Buffer objects not destroyed.");
+    JD3D12_ASSERT(shader_count_ == 0 && "Destroying Device object while there are still Shader objects not destroyed.");
+    JD3D12_ASSERT(recording_count_ == 0 && "Destroying Device object while there are still Recording objects not destroyed.");
+
+    if(info_queue_ && debug_layer_callback_cookie_ != UINT32_MAX)
+    {
+        info_queue_->UnregisterMessageCallback(debug_layer_callback_cookie_);
+    }
+    if(adapter3_ && budget_change_event_)
+        adapter3_->UnregisterVideoMemoryBudgetChangeNotification(budget_change_cookie_);
+
+    Singleton& singleton = Singleton::GetInstance();
+    if(singleton.dev_count_ == 1)
+    {
+        singleton.first_dev_ = nullptr;
+        singleton.dev_count_ = 0;
+    }
+    else
+    {
+        --singleton.dev_count_;
+    }
+}
+
+Result DeviceImpl::CreateBuffer(const BufferDesc& desc, Buffer*& out_buffer)
+{
+    return CreateBufferFromMemory(desc, ConstDataSpan{nullptr, 0}, out_buffer);
+}
+
+Result DeviceImpl::CreateBufferFromMemory(const BufferDesc& desc, ConstDataSpan initial_data,
+    Buffer*& out_buffer)
+{
+    out_buffer = nullptr;
+
+    auto buf = std::unique_ptr<Buffer>{new Buffer{}};
+    buf->impl_ = new BufferImpl{ buf.get(), this, desc };
+
+    if(initial_data.size > 0)
+    {
+        JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu, initial_data.size=%zu",
+            uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size, initial_data.size);
+    }
+    else
+    {
+        JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu",
+            uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size);
+    }
+
+    JD3D12_RETURN_IF_FAILED(buf->GetImpl()->Init(initial_data));
+
+    out_buffer = buf.release();
+    return kSuccess;
+}
+
+Result DeviceImpl::CreateBufferFromFile(const BufferDesc& desc, const wchar_t* initial_data_file_path,
+    Buffer*& out_buffer)
+{
+    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(initial_data_file_path),
+        L"initial_data_file_path cannot be null or empty.");
+
+    out_buffer = nullptr;
+
+    JD3D12_LOG(kLogSeverityInfo, L"Loading buffer initial data from file \"%s\"",
+        initial_data_file_path);
+
+    // The data is read straight into the mapped buffer or the upload ring, never the whole file at once.
+    std::unique_ptr<HANDLE, CloseHandleDeleter> file;
+    size_t file_size = 0;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(OpenFileForSequentialRead(initial_data_file_path, file, file_size));
+    if(file_size > desc.size)
+    {
+        JD3D12_LOG(kLogSeverityError, L"File \"%s\" of size %zu doesn't fit in the buffer of size %zu.",
+            initial_data_file_path, file_size, desc.size);
+        return kErrorOutOfBounds;
+    }
+
+    auto buf = std::unique_ptr<Buffer>{new Buffer{}};
+    buf->impl_ = new BufferImpl{ buf.get(), this, desc };
+
+    JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu, initial_data.size=%zu",
+        uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size, file_size);
+
+    JD3D12_RETURN_IF_FAILED(buf->GetImpl()->InitFromFile(file.get(), file_size));
+
+    out_buffer = buf.release();
+    return kSuccess;
+}
+
+Result DeviceImpl::AcquireTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer)
+{
+    out_buffer = nullptr;
+
+    JD3D12_ASSERT_OR_RETURN(desc.size > 0 && desc.size % 4 == 0,
+        L"Buffer size must be greater than 0 and a multiple of 4.");
+
+    ReclaimTransientBuffers();
+
+    if((desc.flags & kBufferFlagAliasedMemory) != 0)
+        return AcquireAliasedTransientBuffer(desc, out_buffer);
+
+    // Round up to a power of 2, then down to a multiple of the element size, as the views require.
+    size_t pooled_size = std::max<size_t>(NextPowerOfTwo(desc.size), kMinTransientBufferSize);
+    size_t element_size = 0;
+    if((desc.flags & kBufferFlagTyped) != 0)
+    {
+        const FormatDesc* format_desc = GetFormatDesc(desc.element_format);
+        if(format_desc != nullptr)
+            element_size = format_desc->bits_per_element / 8;
+    }
+    else if((desc.flags & kBufferFlagStructured) != 0)
+        element_size = desc.structure_size;
+    if(element_size > 0)
+    {
+        JD3D12_ASSERT_OR_RETURN(desc.size % element_size == 0, L"Buffer size must be a multiple of element size.");
+        pooled_size -= pooled_size % element_size;
+    }
+
+    const uint64_t completed_fence_value = fence_->GetCompletedValue();
+    for(size_t i = 0; i < free_transient_buffers_.size(); ++i)
+    {
+        BufferImpl* const buf = free_transient_buffers_[i].buffer->GetImpl();
+        if(buf->GetSize() == pooled_size && buf->GetFlags() == desc.flags
+            && buf->GetElementFormat() == desc.element_format && buf->GetStructureSize() == desc.structure_size
+            && IsBufferUnused(*buf, completed_fence_value))
+        {
+            buf->is_transient_acquired_ = true;
+            out_buffer = free_transient_buffers_[i].buffer.release();
+            free_transient_buffers_.erase(free_transient_buffers_.begin() + i);
+            return kSuccess;
+        }
+    }
+
+    BufferDesc pooled_desc = desc;
+    pooled_desc.size = pooled_size;
+    Buffer* buf_ptr = nullptr;
+    JD3D12_RETURN_IF_FAILED(CreateBuffer(pooled_desc, buf_ptr));
+    buf_ptr->GetImpl()->is_transient_acquired_ = true;
+    out_buffer = buf_ptr;
+    return kSuccess;
+}
+
+Result DeviceImpl::AcquireAliasedTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer)
+{
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(),
+        L"Transient buffers with kBufferFlagAliasedMemory cannot be acquired between BeginRecording and EndRecording.");
+
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+
+    // The smallest free block that fits. The copy queue doesn't see the aliasing barriers recorded
+    // on the compute queue, so the released buffers must not wait for any copies there.
+    TransientMemoryBlock* block = nullptr;
+    for(const std::unique_ptr<TransientMemoryBlock>& candidate : transient_memory_blocks_)
+    {
+        if(candidate->acquired_buffer != nullptr || candidate->size < desc.size
+            || (block != nullptr && candidate->size >= block->size))
+            continue;
+        bool used_by_copy_queue = false;
+        if(copy_queue_)
+        {
+            for(const std::unique_ptr<Buffer>& released_buf : candidate->released_buffers)
+            {
+                if(GetCopyQueueFenceValueToWait(*released_buf->GetImpl(), true) > 0)
+                    used_by_copy_queue = true;
+            }
+        }
+        if(!used_by_copy_queue)
+            block = candidate.get();
+    }
+
+    if(block == nullptr)
+    {
+        auto new_block = std::make_unique<TransientMemoryBlock>();
+        new_block->size = std::max<size_t>(NextPowerOfTwo(desc.size), kMinTransientBufferSize);
+
+        D3D12_HEAP_DESC heap_desc = {};
+        heap_desc.SizeInBytes = new_block->size;
+        heap_desc.Properties = CD3DX12_HEAP_PROPERTIES{D3D12_HEAP_TYPE_DEFAULT};
+        heap_desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+        heap_desc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateHeap(&heap_desc, IID_PPV_ARGS(&new_block->heap)));
+        SetObjectName(new_block->heap, GetName(), L"Transient memory block");
+
+        block = new_block.get();
+        transient_memory_blocks_.push_back(std::move(new_block));
+    }
+
+    auto buf = std::unique_ptr<Buffer>{new Buffer{}};
+    buf->impl_ = new BufferImpl{ buf.get(), this, desc };
+
+    JD3D12_LOG(kLogSeverityInfo, L"Creating Buffer 0x%016" PRIXPTR " \"%s\": flags=0x%X, size=%zu, aliased",
+        uintptr_t(buf.get()), EnsureNonNullString(desc.name), desc.flags, desc.size);
+
+    JD3D12_RETURN_IF_FAILED(buf->GetImpl()->InitAliased(block->heap));
+
+    ID3D12Resource* const resource_before = block->released_buffers.empty()
+        ? nullptr : block->released_buffers.back()->GetImpl()->GetD3D12Resource();
+    RecordAliasingBarrier(resource_before, buf->GetImpl()->GetD3D12Resource());
+
+    buf->GetImpl()->is_transient_acquired_ = true;
+    block->acquired_buffer = buf.get();
+    out_buffer = buf.release();
+    return kSuccess;
+}
+
+void DeviceImpl::ReleaseTransientBuffer(Buffer* buf)
+{
+    if(buf == nullptr)
+        return;
+
+    BufferImpl* const buf_impl = buf->GetImpl();
+    JD3D12_ASSERT(buf_impl->GetDevice() == this && "Buffer does not belong to this Device.");
+    JD3D12_ASSERT(buf_impl->is_transient_acquired_ && "Buffer was not acquired with AcquireTransientBuffer.");
+    JD3D12_ASSERT(!buf_impl->is_user_mapped_ && "Releasing buffer that is still mapped - missing call to Device::UnmapBuffer.");
+    JD3D12_ASSERT(!IsBufferReferenced(*buf_impl)
+        && "Releasing buffer that is still bound or used by the open Recording.");
+    buf_impl->is_transient_acquired_ = false;
+
+    if((buf_impl->GetFlags() & kBufferFlagAliasedMemory) == 0)
+    {
+        free_transient_buffers_.push_back(FreeTransientBuffer{ std::unique_ptr<Buffer>{buf}, GetRecordingFenceValue() });
+        return;
+    }
+
+    // Its memory is reused even in the current batch, which a later execution of a recording could still access.
+    JD3D12_ASSERT(!GetOpenRecording() && buf_impl->recording_ref_count_ == 0
+        && "Transient buffer with kBufferFlagAliasedMemory cannot be used by a Recording.");
+
+    for(const std::unique_ptr<TransientMemoryBlock>& block : transient_memory_blocks_)
+    {
+        if(block->acquired_buffer == buf)
+        {
+            block->acquired_buffer = nullptr;
+            block->released_buffers.emplace_back(buf);
+            block->release_fence_value = GetRecordingFenceValue();
+            return;
+        }
+    }
+    JD3D12_ASSERT(0 && "Transient buffer with kBufferFlagAliasedMemory not found in any memory block.");
+}
+
+void DeviceImpl::ReclaimTransientBuffers()
+{
+    if(free_transient_buffers_.empty() && transient_memory_blocks_.empty())
+        return;
+
+    const uint64_t completed_fence_value = fence_->GetCompletedValue();
+    const uint64_t recording_fence_value = GetRecordingFenceValue();
+
+    for(size_t i = free_transient_buffers_.size(); i--; )
+    {
+        const FreeTransientBuffer& free_buf = free_transient_buffers_[i];
+        if(free_buf.release_fence_value + kMaxTransientBufferIdleBatchCount < recording_fence_value
+            && IsBufferUnused(*free_buf.buffer->GetImpl(), completed_fence_value))
+        {
+            free_transient_buffers_.erase(free_transient_buffers_.begin() + i);
+        }
+    }
+
+    for(size_t block_index = transient_memory_blocks_.size(); block_index--; )
+    {
+        TransientMemoryBlock& block = *transient_memory_blocks_[block_index];
+        // Only the oldest ones, so the newest remaining one stays the resource before the next aliasing barrier.
+        size_t unused_count = 0;
+        while(unused_count < block.released_buffers.size()
+            && IsBufferUnused(*block.released_buffers[unused_count]->GetImpl(), completed_fence_value))
+        {
+            ++unused_count;
+        }
+        block.released_buffers.erase(block.released_buffers.begin(), block.released_buffers.begin() + unused_count);
+
+        if(block.acquired_buffer == nullptr && block.released_buffers.empty()
+            && block.release_fence_value + kMaxTransientBufferIdleBatchCount < recording_fence_value)
+        {
+            transient_memory_blocks_.erase(transient_memory_blocks_.begin() + block_index);
+        }
+    }
+}
+
+Result DeviceImpl::CreateShaderFromMemory(const ShaderDesc& desc, ConstDataSpan bytecode,
+    Shader*& out_shader)
+{
+    out_shader = nullptr;
+
+    JD3D12_ASSERT_OR_RETURN(bytecode.data != nullptr && bytecode.size > 0,
+        L"Shader bytecode cannot be null or empty.");
+
+    CComPtr<ID3D12ShaderReflection> reflection;
+    DxcBuffer buf = {bytecode.data, bytecode.size};
+    JD3D12_LOG_AND_RETURN_IF_FAILED(env_->GetShaderCompiler().GetDxcUtils()->CreateReflection(
+        &buf, IID_PPV_ARGS(&reflection)));
+
+    auto shader = std::unique_ptr<Shader>{new Shader{}};
+    shader->impl_ = new ShaderImpl{ shader.get(), this, desc };
+
+    JD3D12_LOG(kLogSeverityInfo, L"Creating Shader 0x%016" PRIXPTR " \"%s\"",
+        uintptr_t(shader.get()), EnsureNonNullString(desc.name));
+
+    JD3D12_RETURN_IF_FAILED(shader->GetImpl()->Init(bytecode, reflection));
+
+    out_shader = shader.release();
+    return kSuccess;
+}
+
+Result DeviceImpl::CreateShaderFromFile(const ShaderDesc& desc, const wchar_t* bytecode_file_path,
+    Shader*& out_shader)
+{
+    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(bytecode_file_path),
+        L"bytecode_file_path cannot be null or empty.");
+
+    JD3D12_LOG(kLogSeverityInfo, L"Loading shader bytecode from file \"%s\"", bytecode_file_path);
+
+    char* data_ptr = nullptr;
+    size_t data_size = 0;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(LoadFile(bytecode_file_path, data_ptr, data_size));
+
+    if(data_ptr == nullptr || data_size == 0)
+        return kErrorUnexpected;
+
+    std::unique_ptr<char[]> data{ data_ptr };
+
+    return CreateShaderFromMemory(desc, ConstDataSpan{data_ptr, data_size}, out_shader);
+}
+
+Result DeviceImpl::CompileAndCreateShaderFromMemory(const ShaderCompilationParams& compilation_params,
+    const ShaderDesc& desc, ConstDataSpan hlsl_source, Shader*& out_shader)
+{
+    ShaderCompilationResult* result_ptr = nullptr;
+    JD3D12_RETURN_IF_FAILED(env_->CompileShaderFromMemory(compilation_params, L"shader_from_memory.hlsl",
+        hlsl_source, result_ptr));
+    std::unique_ptr<ShaderCompilationResult> result{ result_ptr };
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(result->GetResult());
+
+    const ConstDataSpan bytecode = result->GetBytecode();
+    if(bytecode.size == 0)
+        return kErrorFail;
+
+    return CreateShaderFromMemory(desc, bytecode, out_shader);
+}
+
+Result DeviceImpl::CompileAndCreateShaderFromFile(const ShaderCompilationParams& compilation_params,
+    const ShaderDesc& desc, const wchar_t* hlsl_source_file_path, Shader*& out_shader)
+{
+    ShaderCompilationResult* result_ptr = nullptr;
+    JD3D12_RETURN_IF_FAILED(env_->CompileShaderFromFile(compilation_params, hlsl_source_file_path,
+        result_ptr));
+    std::unique_ptr<ShaderCompilationResult> shader_compilation_result{ result_ptr };
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(shader_compilation_result->GetResult());
+
+    const ConstDataSpan bytecode = shader_compilation_result->GetBytecode();
+    if(bytecode.size == 0)
+        return kErrorFail;
+
+    return CreateShaderFromMemory(desc, bytecode, out_shader);
+}
+
+Result DeviceImpl::CompileAndCreateShadersBatch(ArraySpan<ShaderBatchItem> items, uint32_t thread_count)
+{
+    JD3D12_ASSERT_OR_RETURN(items.count == 0 || items.data != nullptr, L"items.data cannot be null.");
+
+    for(size_t i = 0; i < items.count; ++i)
+    {
+        ShaderBatchItem& item = items.data[i];
+        item.result = kSuccess;
+        item.shader = nullptr;
+        item.compilation_result = nullptr;
+    }
+    if(items.count == 0)
+        return kSuccess;
+
+    if(thread_count == 0)
+        thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+    thread_count = uint32_t(std::min<size_t>(thread_count, items.count));
+
+    JD3D12_LOG(kLogSeverityInfo, L"Compiling and creating %zu shaders using %u threads",
+        items.count, thread_count);
+
+    // Each thread takes the next unprocessed item. The shader compiler gives every thread its own DXC instance.
+    // Pipeline states are created on the same threads, as ID3D12Device is free-threaded.
+    std::atomic<size_t> next_item_index{ 0 };
+    auto process_items = [this, items, &next_item_index]()
+    {
+        for(size_t i = next_item_index++; i < items.count; i = next_item_index++)
+            CompileAndCreateShaderBatchItem(items.data[i]);
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for(uint32_t i = 1; i < thread_count; ++i)
+        threads.emplace_back(process_items);
+    process_items();
+    for(std::thread& thread : threads)
+        thread.join();
+
+    for(size_t i = 0; i < items.count; ++i)
+    {
+        if(Failed(items.data[i].result))
+            return items.data[i].result;
+    }
+    return kSuccess;
+}
+
+Result DeviceImpl::CreateShaderFamily(const ShaderFamilyDesc& desc, ShaderFamily*& out_family)
+{
+    out_family = nullptr;
+
+    auto family = std::unique_ptr<ShaderFamily>{new ShaderFamily{}};
+    family->impl_ = new ShaderFamilyImpl{ family.get(), this, desc };
+
+    JD3D12_LOG(kLogSeverityInfo, L"Creating ShaderFamily 0x%016" PRIXPTR " \"%s\" with %zu axes",
+        uintptr_t(family.get()), EnsureNonNullString(desc.name), desc.axes.count);
+
+    JD3D12_RETURN_IF_FAILED(family->GetImpl()->Init(desc));
+
+    out_family = family.release();
+    return kSuccess;
+}
+
+void DeviceImpl::CompileAndCreateShaderBatchItem(ShaderBatchItem& item)
+{
+    ShaderCompilationResult* result_ptr = nullptr;
+    if(item.hlsl_source_file_path != nullptr)
+    {
+        item.result = env_->CompileShaderFromFile(item.compilation_params, item.hlsl_source_file_path,
+            result_ptr);
+    }
+    else
+    {
+        item.result = env_->CompileShaderFromMemory(item.compilation_params, L"shader_from_memory.hlsl",
+            item.hlsl_source, result_ptr);
+    }
+    item.compilation_result = result_ptr;
+    if(Failed(item.result))
+        return;
+
+    item.result = result_ptr->GetResult();
+    if(Failed(item.result))
+        return;
+
+    const ConstDataSpan bytecode = result_ptr->GetBytecode();
+    if(bytecode.size == 0)
+    {
+        item.result = kErrorFail;
+        return;
+    }
+
+    item.result = CreateShaderFromMemory(item.desc, bytecode, item.shader);
+}
+
+Result DeviceImpl::MapBuffer(BufferImpl& buf, Range byte_range, BufferFlags cpu_usage_flag, void*& out_data_ptr,
+    uint32_t command_flags)
+{
+    out_data_ptr = nullptr;
+    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
+        L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(!buf.is_user_mapped_,
+        L"Device::MapBuffer called twice. Nested mapping is not supported.");
+    JD3D12_ASSERT_OR_RETURN(buf.persistently_mapped_ptr_ != nullptr,
+        L"Cannot map this buffer.");
+    JD3D12_ASSERT_OR_RETURN(CountBitsSet(cpu_usage_flag &
+        (kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCpuRead)) == 1,
+        L"cpu_usage_flag must be kBufferUsageFlagCpuSequentialWrite or kBufferUsageFlagCpuRead.");
+    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & cpu_usage_flag) == cpu_usage_flag,
+        L"Buffer was not created with the kBufferUsageFlagCpu* used for mapping.");
+    const bool is_reading = (buf.desc_.flags & kBufferUsageFlagCpuRead) != 0;
+    const bool is_writing = (buf.desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0;
+
+    byte_range = LimitRange(byte_range, buf.desc_.size);
+    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0, L"byte_range is empty.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf.GetSize(), L"byte_range out of bounds.");
+
+    // If the buffer is being written or read on the GPU, wait only for the batch that last did it.
+    {
+        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
+        const Result res = WaitForBufferAccess(buf, is_writing, timeout);
+        if(res != kSuccess)
+            return res;
+    }
+
+    buf.is_user_mapped_ = true;
+
+    out_data_ptr = (char*)buf.persistently_mapped_ptr_ + byte_range.first;
+    return kSuccess;
+}
+
+void DeviceImpl::UnmapBuffer(BufferImpl& buf)
+{
+    JD3D12_ASSERT(buf.GetDevice() == this && "Buffer does not belong to this Device.");
+    JD3D12_ASSERT(buf.is_user_mapped_ && "Device::UnmapBuffer called but the buffer wasn't mapped.");
+
+    buf.is_user_mapped_ = false;
+}
+
+Result DeviceImpl::ReadBufferToMemory(BufferImpl& src_buf, Range src_byte_range, void* dst_memory,
+    uint32_t command_flags, const FormatConverter* converter)
+{
+    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(!src_buf.is_user_mapped_, L"Cannot call this command while the buffer is mapped.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
+
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    if(src_byte_range.count == 0)
+        return kFalse;
+
+    JD3D12_ASSERT_OR_RETURN(dst_memory != nullptr, L"dst_memory cannot be null.");
+    JD3D12_ASSERT_OR_RETURN(src_byte_range.first < src_buf.GetSize()
+        && src_byte_range.first + src_byte_range.count <= src_buf.GetSize(),
+        L"Source buffer region out of bounds.");
+
+    // If the buffer is being written to on the GPU, wait for the batch that last wrote it.
+    // If it is only read, there is no hazard.
+    {
+        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
+        const Result res = WaitForBufferAccess(src_buf, false, timeout);
+        if(res == kNotReady)
+            return res;
+        JD3D12_RETURN_IF_FAILED(res);
+    }
+
+    void* mapped_ptr = nullptr;
+    HRESULT hr = MapBuffer(src_buf, src_byte_range, kBufferUsageFlagCpuRead, mapped_ptr);
+    if(FAILED(hr))
+        return hr;
+    if(converter != nullptr)
+        converter->Convert(mapped_ptr, dst_memory, src_byte_range.count / converter->GetSrcElementSize());
+    else
+        memcpy(dst_memory, (char*)mapped_ptr, src_byte_range.count);
+    UnmapBuffer(src_buf);
+    statistics_.bytes_read += src_byte_range.count;
+    return kSuccess;
+}
+
+Result DeviceImpl::ReadBufferToMemoryConverted(BufferImpl& src_buf, Range src_byte_range, Format dst_format,
+    void* dst_memory, uint32_t command_flags)
+{
+    FormatConverter converter;
+    JD3D12_ASSERT_OR_RETURN(converter.Init(src_buf.desc_.element_format, dst_format),
+        L"ReadBufferToMemoryConverted: Conversion from the element_format of the buffer to dst_format "
+        L"is not supported.");
+
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    const size_t element_size = converter.GetSrcElementSize();
+    JD3D12_ASSERT_OR_RETURN(src_byte_range.first % element_size == 0 && src_byte_range.count % element_size == 0,
+        L"ReadBufferToMemoryConverted: src_byte_range must cover whole elements.");
+
+    if((src_buf.desc_.flags & kBufferUsageFlagCpuRead) != 0)
+        return ReadBufferToMemory(src_buf, src_byte_range, dst_memory, command_flags, &converter);
+
+    // Convert out of a staging buffer, like a readback that is waited for immediately.
+    ReadbackTicket ticket;
+    const Result res = ReadBufferToMemoryAsync(src_buf, src_byte_range, dst_memory, ticket, &converter);
+    if(res != kSuccess)
+        return res;
+    return WaitForReadback(ticket, kTimeoutInfinite);
+}
+
+Result DeviceImpl::ReadBufferToMemoryAsync(BufferImpl& src_buf, Range src_byte_range, void* dst_memory,
+    ReadbackTicket& out_ticket, const FormatConverter* converter)
+{
+    out_ticket = ReadbackTicket{};
+
+    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(!src_buf.is_user_mapped_, L"Cannot call this command while the buffer is mapped.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
+    JD3D12_ASSERT_OR_RETURN((src_buf.desc_.flags & (kBufferUsageFlagCopySrc | kBufferUsageFlagCpuRead)) != 0,
+        L"ReadBufferToMemoryAsync: Buffer must be created with kBufferUsageFlagCopySrc or kBufferUsageFlagCpuRead.");
+
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    if(src_byte_range.count == 0)
+        return kFalse;
+
+    JD3D12_ASSERT_OR_RETURN(dst_memory != nullptr, L"dst_memory cannot be null.");
+    JD3D12_ASSERT_OR_RETURN(src_byte_range.first + src_byte_range.count <= src_buf.GetSize(),
+        L"Source buffer region out of bounds.");
+
+    PendingReadback pending_readback;
+    if(converter != nullptr)
+        pending_readback.converter = *converter;
+    if((src_buf.desc_.flags & kBufferUsageFlagCpuRead) != 0)
+    {
+        // Read directly from the mapped memory once the GPU finishes writing it.
+        pending_readback.src_buffer = &src_buf;
+        pending_readback.src_offset = src_byte_range.first;
+        pending_readback.copy_queue_fence_value = src_buf.last_copy_queue_write_fence_value_;
+        pending_readback.src_gpu_write_count = src_buf.gpu_write_count_;
+        out_ticket.fence_value = src_buf.last_write_fence_value_;
+    }
+    else
+    {
+        JD3D12_ASSERT_OR_RETURN(src_byte_range.first % 4 == 0 && src_byte_range.count % 4 == 0,
+            L"ReadBufferToMemoryAsync: Offset and size must be a multiple of 4 B when copying on the GPU.");
+
+        JD3D12_RETURN_IF_FAILED(AcquireReadbackStagingBuffer(src_byte_range.count,
+            pending_readback.staging_buffer));
+        BufferImpl* const staging_buf = pending_readback.staging_buffer->GetImpl();
+        JD3D12_RETURN_IF_FAILED(CopyBufferRegion(src_buf, src_byte_range, *staging_buf, 0));
+
+        pending_readback.src_buffer = staging_buf;
+        pending_readback.src_offset = 0;
+        pending_readback.copy_queue_fence_value = staging_buf->last_copy_queue_write_fence_value_;
+        out_ticket.fence_value = staging_buf->last_write_fence_value_;
+    }
+
+    out_ticket.id = next_readback_id_++;
+    out_ticket.dst_memory = dst_memory;
+    out_ticket.size = src_byte_range.count;
+    pending_readbacks_.emplace(out_ticket.id, std::move(pending_readback));
+    return kSuccess;
+}
+
+bool DeviceImpl::IsReadbackComplete(const ReadbackTicket& ticket)
+{
+    if(ticket.IsEmpty())
+        return true;
+    if(copy_queue_)
+    {
+        const auto it = pending_readbacks_.find(ticket.id);
+        const uint64_t copy_queue_fence_value = it != pending_readbacks_.end() ? it->second.copy_queue_fence_value : 0;
+        if(copy_queue_fence_value > copy_queue_->GetSubmittedFenceValue()
+            || copy_queue_fence_value > copy_queue_->GetCompletedFenceValue())
+            return false;
+    }
+    return ticket.fence_value <= submitted_fence_value_ && ticket.fence_value <= fence_->GetCompletedValue();
+}
+
+Result DeviceImpl::WaitForReadback(ReadbackTicket& ticket, uint32_t timeout_milliseconds)
+{
+    if(ticket.IsEmpty())
+        return kFalse;
+    const auto it = pending_readbacks_.find(ticket.id);
+    JD3D12_ASSERT_OR_RETURN(it != pending_readbacks_.end(),
+        L"Invalid ReadbackTicket. It may have been completed already.");
+
+    // A buffer read directly, without a staging copy, must not be written again before the read completes,
+    // or the newer data would be returned.
+    if(!it->second.staging_buffer && it->second.src_buffer->gpu_write_count_ != it->second.src_gpu_write_count)
+    {
+        JD3D12_LOG(kLogSeverityError,
+            L"WaitForReadback: Buffer \"%s\" was written after ReadBufferToMemoryAsync. The read is dropped.",
+            EnsureNonNullString(it->second.src_buffer->GetName()));
+        pending_readbacks_.erase(it);
+        ticket = ReadbackTicket{};
+        return kErrorChangedState;
+    }
+
+    const uint64_t copy_queue_fence_value = it->second.copy_queue_fence_value;
+    if(copy_queue_fence_value > 0)
+    {
+        if(copy_queue_fence_value > copy_queue_->GetSubmittedFenceValue())
+            JD3D12_RETURN_IF_FAILED(copy_queue_->Submit());
+        const Result res = copy_queue_->WaitForFenceValue(copy_queue_fence_value, timeout_milliseconds);
+        if(res != kSuccess)
+            return res;
+    }
+
+    if(ticket.fence_value > submitted_fence_value_)
+    {
+        JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording
+            && ticket.fence_value == GetRecordingFenceValue());
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    }
+
+    const Result res = WaitForFenceValue(ticket.fence_value, timeout_milliseconds);
+    if(res != kSuccess)
+        return res;
+
+    return FinishReadback(ticket);
+}
+
+Result DeviceImpl::FinishReadback(ReadbackTicket& ticket)
+{
+    const auto it = pending_readbacks_.find(ticket.id);
+    JD3D12_ASSERT(it != pending_readbacks_.end());
+    PendingReadback& pending_readback = it->second;
+
+    BufferImpl* const src_buf = pending_readback.src_buffer;
+    JD3D12_ASSERT(src_buf != nullptr && src_buf->persistently_mapped_ptr_ != nullptr);
+    const char* const src_ptr = (const char*)src_buf->persistently_mapped_ptr_ + pending_readback.src_offset;
+    const FormatConverter& converter = pending_readback.converter;
+    if(converter.IsEmpty())
+        memcpy(ticket.dst_memory, src_ptr, ticket.size);
+    else
+        converter.Convert(src_ptr, ticket.dst_memory, ticket.size / converter.GetSrcElementSize());
+    statistics_.bytes_read += ticket.size;
+
+    if(pending_readback.staging_buffer)
+        ReleaseReadbackStagingBuffer(std::move(pending_readback.staging_buffer));
+    pending_readbacks_.erase(it);
+
+    ticket = ReadbackTicket{};
+    return kSuccess;
+}
+
+Result DeviceImpl::AcquireReadbackStagingBuffer(size_t size, std::unique_ptr<Buffer>& out_buffer)
+{
+    const size_t staging_size = std::max<size_t>(NextPowerOfTwo(size), kMinReadbackStagingBufferSize);
+
+    for(size_t i = free_readback_staging_buffers_.size(); i--; )
+    {
+        if(free_readback_staging_buffers_[i]->GetSize() == staging_size)
+        {
+            out_buffer = std::move(free_readback_staging_buffers_[i]);
+            free_readback_staging_buffers_.erase(free_readback_staging_buffers_.begin() + i);
+            return kSuccess;
+        }
+    }
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"Readback staging buffer";
+    buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    buf_desc.size = staging_size;
+    Buffer* buf_ptr = nullptr;
+    JD3D12_RETURN_IF_FAILED(CreateBuffer(buf_desc, buf_ptr));
+    out_buffer.reset(buf_ptr);
+    return kSuccess;
+}
+
+void DeviceImpl::ReleaseReadbackStagingBuffer(std::unique_ptr<Buffer>&& buffer)
+{
+    free_readback_staging_buffers_.push_back(std::move(buffer));
+
+    size_t total_size = 0;
+    for(const std::unique_ptr<Buffer>& free_buffer : free_readback_staging_buffers_)
+        total_size += free_buffer->GetSize();
+    // Keep at least the buffer just released, so that a big read repeated every frame doesn't recreate it.
+    while(free_readback_staging_buffers_.size() > 1
+        && (free_readback_staging_buffers_.size() > kMaxFreeReadbackStagingBufferCount
+            || total_size > kMaxFreeReadbackStagingBufferBytes))
+    {
+        total_size -= free_readback_staging_buffers_.front()->GetSize();
+        free_readback_staging_buffers_.erase(free_readback_staging_buffers_.begin());
+    }
+}
+
+Result DeviceImpl::WriteMemoryToBuffer(ConstDataSpan src_data, BufferImpl& dst_buf, size_t dst_byte_offset,
+    uint32_t command_flags, const FormatConverter* converter)
+{
+    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(!dst_buf.is_user_mapped_, L"Cannot call this command while the buffer is mapped.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
+
+    if(src_data.size == 0)
+        return kFalse;
+
+    const size_t dst_size = converter != nullptr ? converter->GetDstSize(src_data.size) : src_data.size;
+    JD3D12_ASSERT_OR_RETURN(src_data.data != nullptr, L"src_memory cannot be null.");
+    JD3D12_ASSERT_OR_RETURN(dst_size % 4 == 0, L"Size of the data written to the buffer must be a multiple of 4 B.");
+    JD3D12_ASSERT_OR_RETURN(dst_byte_offset < dst_buf.GetSize()
+        && dst_byte_offset + dst_size <= dst_buf.GetSize(),
+        L"Destination buffer region out of bounds.");
+
+    if(dst_buf.strategy_ == BufferStrategy::kUpload || dst_buf.strategy_ == BufferStrategy::kGpuUpload)
+    {
+        // Use MapBuffer.
+
+        // If the buffer is being written or read on the GPU, wait for the batch that last accessed it.
+        {
+            const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
+            const Result res = WaitForBufferAccess(dst_buf, true, timeout);
+            if(res != kSuccess)
+                return res;
+        }
+
+        void* mapped_ptr = nullptr;
+        HRESULT hr = MapBuffer(dst_buf, Range{dst_byte_offset, dst_size},
+            kBufferUsageFlagCpuSequentialWrite, mapped_ptr);
+        if(FAILED(hr))
+            return hr;
+        if(converter != nullptr)
+            converter->Convert(src_data.data, mapped_ptr, src_data.size / converter->GetSrcElementSize());
+        else
+            memcpy((char*)mapped_ptr, src_data.data, src_data.size);
+        UnmapBuffer(dst_buf);
+        statistics_.bytes_written_mapped += dst_size;
+        return kSuccess;
+    }
+    else if(dst_buf.strategy_ == BufferStrategy::kDefault)
+    {
+        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
+        // Converted data always goes through the upload ring, so it is written there directly.
+        if(converter != nullptr || src_data.size > kMaxWriteBufferImmediateSize)
+            return WriteMemoryToBufferThroughUploadRing(src_data, dst_buf, dst_byte_offset, timeout, converter);
+
+        const Result res = EnsureCommandListState(CommandListState::kRecording, timeout);
+        if(res != kSuccess)
+            return res;
+        return WriteMemoryToBufferImmediate(src_data, dst_buf, dst_byte_offset);
+    }
+    else
+    {
+        JD3D12_ASSERT(0);
+        return kErrorUnexpected;
+    }
+}
+
+Result DeviceImpl::WriteMemoryToBufferConverted(ConstDataSpan src_data, Format src_format, BufferImpl& dst_buf,
+    size_t dst_byte_offset, uint32_t command_flags)
+{
+    FormatConverter converter;
+    JD3D12_ASSERT_OR_RETURN(converter.Init(src_format, dst_buf.desc_.element_format),
+        L"WriteMemoryToBufferConverted: Conversion from src_format to the element_format of the buffer "
+        L"is not supported.");
+    JD3D12_ASSERT_OR_RETURN(src_data.size % converter.GetSrcElementSize() == 0,
+        L"WriteMemoryToBufferConverted: src_data.size must be a multiple of the element size "
+        L"of src_format.");
+    return WriteMemoryToBuffer(src_data, dst_buf, dst_byte_offset, command_flags, &converter);
+}
+
+Result DeviceImpl::WriteMemoryToBufferImmediate(ConstDataSpan src_data, BufferImpl& dst_buf,
+    size_t dst_byte_offset)
+{
+    JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording);
+    JD3D12_ASSERT(src_data.size <= kMaxWriteBufferImmediateSize && src_data.size % 4 == 0);
+
+    JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    const uint32_t param_count = uint32_t(src_data.size / 4);
+    StackOrHeapVector<D3D12_WRITEBUFFERIMMEDIATE_PARAMETER, 8> params{param_count};
+    const uint32_t* src_data_u32 = reinterpret_cast<const uint32_t*>(src_data.data);
+    D3D12_GPU_VIRTUAL_ADDRESS dst_gpu_address = dst_buf.GetD3D12Resource()->GetGPUVirtualAddress()
+        + dst_byte_offset;
+    for(uint32_t param_index = 0; param_index < param_count
+        ; ++param_index, ++src_data_u32, dst_gpu_address += sizeof(uint32_t))
+    {
+        params[param_index] = D3D12_WRITEBUFFERIMMEDIATE_PARAMETER{ dst_gpu_address, *src_data_u32 };
+    }
+    FlushBarriers();
+    GetCommandList()->WriteBufferImmediate(param_count, params.GetData(), nullptr);
+    GetCurrentBatch().statistics.bytes_written_immediate += src_data.size;
+    return kSuccess;
+}
+
+Result DeviceImpl::WriteToBufferThroughUploadRing(size_t size, size_t chunk_granularity, BufferImpl& dst_buf,
+    size_t dst_byte_offset, uint32_t timeout_milliseconds, bool submit_each_chunk,
+    UploadChunkCallback fill_chunk, void* fill_chunk_context)
+{
+    // Upload in chunks smaller than the ring, so that filling a chunk on the CPU can overlap with
+    // the GPU copying the previous ones. Chunk sizes are counted in the buffer and hold whole elements.
+    const size_t max_chunk_size = std::max<size_t>(
+        upload_ring_.GetSize() / 4 / chunk_granularity * chunk_granularity, chunk_granularity);
+
+    size_t remaining_size = size;
+    while(remaining_size > 0)
+    {
+        Result res = EnsureCommandListState(CommandListState::kRecording, timeout_milliseconds);
+        if(res != kSuccess)
+            return res;
+
+        const size_t chunk_size = std::min(remaining_size, max_chunk_size);
+        size_t ring_offset = 0;
+        void* ring_ptr = nullptr;
+        res = upload_ring_.Allocate(chunk_size, 4, GetRecordingFenceValue(), ring_offset, ring_ptr);
+        if(res == kNotReady)
+        {
+            res = WaitForUploadRingSpace(timeout_milliseconds);
+            if(res != kSuccess)
+                return res;
+            continue;
+        }
+        JD3D12_RETURN_IF_FAILED(res);
+
+        JD3D12_LOG_AND_RETURN_IF_FAILED(fill_chunk(ring_ptr, chunk_size, fill_chunk_context));
+
+        JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+        FlushBarriers();
+        GetCommandList()->CopyBufferRegion(dst_buf.GetD3D12Resource(), dst_byte_offset,
+            upload_ring_.GetResource(), ring_offset, chunk_size);
+        GetCurrentBatch().statistics.bytes_written_through_upload_ring += chunk_size;
+
+        dst_byte_offset += chunk_size;
+        remaining_size -= chunk_size;
+        if(submit_each_chunk && remaining_size > 0)
+            JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    }
+    return kSuccess;
+}
+
+Result DeviceImpl::WriteMemoryToBufferThroughUploadRing(ConstDataSpan src_data, BufferImpl& dst_buf,
+    size_t dst_byte_offset, uint32_t timeout_milliseconds, const FormatConverter* converter)
+{
+    struct Source
+    {
+        const char* ptr;
+        const FormatConverter* converter;
+    };
+    Source source = { (const char*)src_data.data, converter };
+    const auto fill_chunk = [](void* dst, size_t dst_size, void* context) -> Result
+    {
+        Source* const source = (Source*)context;
+        if(source->converter != nullptr)
+        {
+            source->converter->Convert(source->ptr, dst, dst_size / source->converter->GetDstElementSize());
+            source->ptr += source->converter->GetSrcSize(dst_size);
+        }
+        else
+        {
+            memcpy(dst, source->ptr, dst_size);
+            source->ptr += dst_size;
+        }
+        return kSuccess;
+    };
+
+    if(converter != nullptr)
+    {
+        return WriteToBufferThroughUploadRing(converter->GetDstSize(src_data.size),
+            converter->GetDstElementSize() * 4, dst_buf, dst_byte_offset, timeout_milliseconds, false,
+            fill_chunk, &source);
+    }
+    return WriteToBufferThroughUploadRing(src_data.size, 4, dst_buf, dst_byte_offset, timeout_milliseconds, false,
+        fill_chunk, &source);
+}
+
+Result DeviceImpl::WriteFileToBufferThroughUploadRing(HANDLE file, size_t size, BufferImpl& dst_buf)
+{
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
+
+    const auto fill_chunk = [](void* dst, size_t dst_size, void* context) -> Result
+    {
+        return ReadFileToMemory((HANDLE)context, dst, dst_size);
+    };
+    return WriteToBufferThroughUploadRing(size, 4, dst_buf, 0, kTimeoutInfinite, true, fill_chunk, file);
+}
+
+Result DeviceImpl::ZeroBufferThroughUploadRing(BufferImpl& dst_buf, Range byte_range)
+{
+    JD3D12_ASSERT(!GetOpenRecording());
+
+    const auto fill_chunk = [](void* dst, size_t dst_size, void* context) -> Result
+    {
+        memset(dst, 0, dst_size);
+        return kSuccess;
+    };
+    return WriteToBufferThroughUploadRing(byte_range.count, 4, dst_buf, byte_range.first, kTimeoutInfinite, false,
+        fill_chunk, nullptr);
+}
+
+Result DeviceImpl::WaitForUploadRingSpace(uint32_t timeout_milliseconds)
+{
+    const uint64_t fence_value = upload_ring_.GetOldestFenceValue();
+    JD3D12_ASSERT(fence_value > 0);
+
+    // The oldest allocation is used by the batch being recorded - the ring is too small for what has been
+    // recorded so far. Submit it so that it can complete.
+    if(fence_value > submitted_fence_value_)
+    {
+        JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording
+            && fence_value == GetRecordingFenceValue());
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    }
+    return WaitForFenceValue(fence_value, timeout_milliseconds);
+}
+
+Result DeviceImpl::SubmitPendingCommands()
+{
+    if(copy_queue_)
+        JD3D12_RETURN_IF_FAILED(copy_queue_->Submit());
+    if(command_list_state_ == CommandListState::kRecording)
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    return kSuccess;
+}
+
+Result DeviceImpl::WaitForGPU(uint32_t timeout_milliseconds)
+{
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kNone, timeout_milliseconds));
+    if(copy_queue_)
+    {
+        JD3D12_RETURN_IF_FAILED(copy_queue_->Submit());
+        const Result res = copy_queue_->WaitForFenceValue(copy_queue_->GetSubmittedFenceValue(),
+            timeout_milliseconds);
+        if(res != kSuccess)
+            return res;
+    }
+    return kSuccess;
+}
+
+Result DeviceImpl::CopyBuffer(BufferImpl& src_buf, BufferImpl& dst_buf)
+{
+    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"src_buf does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"dst_buf does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((src_buf.desc_.flags & kBufferUsageFlagCopySrc) != 0,
+        L"src_buf was not created with kBufferUsageFlagCopySource.");
+    JD3D12_ASSERT_OR_RETURN((dst_buf.desc_.flags & kBufferUsageFlagCopyDst) != 0,
+        L"dst_buf was not created with kBufferUsageFlagCopyDest.");
+    JD3D12_ASSERT_OR_RETURN(src_buf.GetSize() == dst_buf.GetSize(),
+        L"Source and destination buffers must have the same size.");
+
+    if(ShouldUseCopyQueue(src_buf, dst_buf, src_buf.GetSize()))
+        return CopyBufferRegionOnCopyQueue(src_buf, Range{0, src_buf.GetSize()}, dst_buf, 0);
+
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    JD3D12_RETURN_IF_FAILED(EnsureProfilingSpace());
+
+    JD3D12_RETURN_IF_FAILED(UseBuffer(src_buf, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    FlushBarriers();
+    const uint32_t profiled_command_index = BeginProfiledCommand(L"CopyBuffer");
+    GetCommandList()->CopyResource(dst_buf.GetD3D12Resource(), src_buf.GetD3D12Resource());
+    EndProfiledCommand(profiled_command_index);
+
+    return kSuccess;
+}
+
+Result DeviceImpl::CopyBufferRegion(BufferImpl& src_buf, Range src_byte_range, BufferImpl& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"src_buf does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"dst_buf does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((src_buf.desc_.flags & kBufferUsageFlagCopySrc) != 0,
+        L"src_buf was not created with kBufferUsageFlagCopySource.");
+    JD3D12_ASSERT_OR_RETURN((dst_buf.desc_.flags & kBufferUsageFlagCopyDst) != 0,
+        L"dst_buf was not created with kBufferUsageFlagCopyDest.");
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    JD3D12_ASSERT_OR_RETURN(src_byte_range.count >= 0 && src_byte_range.count % 4 == 0, L"Size must be non-zero and a multiple of 4.");
+    JD3D12_ASSERT_OR_RETURN(src_byte_range.first + src_byte_range.count <= src_buf.GetSize(), L"Source buffer overflow.");
+    JD3D12_ASSERT_OR_RETURN(dst_byte_offset + src_byte_range.count <= dst_buf.GetSize(), L"Destination buffer overflow.");
+
+    if(ShouldUseCopyQueue(src_buf, dst_buf, src_byte_range.count))
+        return CopyBufferRegionOnCopyQueue(src_buf, src_byte_range, dst_buf, dst_byte_offset);
+
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    JD3D12_RETURN_IF_FAILED(EnsureProfilingSpace());
+
+    JD3D12_RETURN_IF_FAILED(UseBuffer(src_buf, D3D12_RESOURCE_STATE_COPY_SOURCE));
+    JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+
+    FlushBarriers();
+    const uint32_t profiled_command_index = BeginProfiledCommand(L"CopyBufferRegion");
+    GetCommandList()->CopyBufferRegion(dst_buf.GetD3D12Resource(), dst_byte_offset,
+        src_buf.GetD3D12Resource(), src_byte_range.first, src_byte_range.count);
+    EndProfiledCommand(profiled_command_index);
+
+    return kSuccess;
+}
+
+Result DeviceImpl::ClearBufferToUintValues(BufferImpl& buf, const UintVec4& values, Range element_range)
+{
+    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
+        L"ClearBufferToUintValues: Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
+        L"ClearBufferToUintValues: Buffer was not created with kBufferUsageFlagShaderRWResource.");
+    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & (kBufferFlagTyped | kBufferFlagByteAddress)) != 0,
+        L"ClearBufferToUintValues: Buffer was not created with kBufferFlagTyped or kBufferFlagByteAddress.");
+
+    if(element_range.count == 0)
+        return kFalse;
+
+    D3D12_GPU_DESCRIPTOR_HANDLE shader_visible_gpu_desc_handle = {};
+    D3D12_CPU_DESCRIPTOR_HANDLE shader_invisible_cpu_desc_handle = {};
+    JD3D12_RETURN_IF_FAILED(BeginClearBufferToValues(buf, element_range,
+        shader_visible_gpu_desc_handle, shader_invisible_cpu_desc_handle));
+
+    FlushBarriers();
+    const uint32_t profiled_command_index = BeginProfiledCommand(L"ClearBufferToUintValues");
+    GetCommandList()->ClearUnorderedAccessViewUint(
+        shader_visible_gpu_desc_handle, // ViewGPUHandleInCurrentHeap
+        shader_invisible_cpu_desc_handle, // ViewCPUHandle
+        buf.GetD3D12Resource(), // pResource
+        &values.x, // Values
+        0, // NumRects
+        nullptr); // pRects
+    EndProfiledCommand(profiled_command_index);
+
+    return kSuccess;
+}
+
+Result DeviceImpl::ClearBufferToFloatValues(BufferImpl& buf, const FloatVec4& values, Range element_range)
+{
+    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
+        L"ClearBufferToFloatValues: Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
+        L"ClearBufferToFloatValues: Buffer was not created with kBufferUsageFlagShaderRWResource.");
+    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferFlagTyped) != 0,
+        L"ClearBufferToFloatValues: Buffer was not created with kBufferFlagTyped.");
+
+    if(element_range.count == 0)
+        return kFalse;
+
+    D3D12_GPU_DESCRIPTOR_HANDLE shader_visible_gpu_desc_handle = {};
+    D3D12_CPU_DESCRIPTOR_HANDLE shader_invisible_cpu_desc_handle = {};
+    JD3D12_RETURN_IF_FAILED(BeginClearBufferToValues(buf, element_range,
+        shader_visible_gpu_desc_handle, shader_invisible_cpu_desc_handle));
+
+    FlushBarriers();
+    const uint32_t profiled_command_index = BeginProfiledCommand(L"ClearBufferToFloatValues");
+    GetCommandList()->ClearUnorderedAccessViewFloat(
+        shader_visible_gpu_desc_handle, // ViewGPUHandleInCurrentHeap
+        shader_invisible_cpu_desc_handle, // ViewCPUHandle
+        buf.GetD3D12Resource(), // pResource
+        &values.x, // Values
+        0, // NumRects
+        nullptr); // pRects
+    EndProfiledCommand(profiled_command_index);
+
+    return kSuccess;
+}
+
+Result DeviceImpl::Reduce(BufferImpl& src_buf, Range src_byte_range, PrimitiveDataType type, ReduceOperation op,
+    BufferImpl& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT_OR_RETURN(type <= kPrimitiveDataTypeFloat, L"Reduce: Invalid type.");
+    JD3D12_ASSERT_OR_RETURN(op <= kReduceOperationMax, L"Reduce: Invalid operation.");
+    JD3D12_ASSERT_OR_RETURN(&src_buf != &dst_buf, L"Reduce: Source and destination must be different buffers.");
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(src_buf, src_byte_range.first, src_byte_range.count, false));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(dst_buf, dst_byte_offset, 4, true));
+
+    PrimitiveScope scope{ *this };
+    return RecordPrimitiveReduce(scope, type, op, 0, PrimitiveBuffer{ &src_buf, src_byte_range.first },
+        uint32_t(src_byte_range.count / 4), PrimitiveBuffer{ &dst_buf, dst_byte_offset });
+}
+
+Result DeviceImpl::Scan(BufferImpl& src_buf, Range src_byte_range, PrimitiveDataType type, bool exclusive,
+    BufferImpl& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT_OR_RETURN(type <= kPrimitiveDataTypeFloat, L"Scan: Invalid type.");
+    JD3D12_ASSERT_OR_RETURN(&src_buf != &dst_buf, L"Scan: Source and destination must be different buffers.");
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(src_buf, src_byte_range.first, src_byte_range.count, false));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(dst_buf, dst_byte_offset, src_byte_range.count, true));
+
+    PrimitiveScope scope{ *this };
+    return RecordPrimitiveScan(scope, type, exclusive ? kPrimitiveFlagExclusive : 0,
+        PrimitiveBuffer{ &src_buf, src_byte_range.first }, uint32_t(src_byte_range.count / 4),
+        PrimitiveBuffer{ &dst_buf, dst_byte_offset });
+}
+
+Result DeviceImpl::RadixSort(BufferImpl& keys_buf, Range keys_byte_range, BufferImpl* values_buf,
+    size_t values_byte_offset, uint32_t key_bit_count)
+{
+    JD3D12_ASSERT_OR_RETURN(key_bit_count > 0 && key_bit_count <= 32, L"RadixSort: key_bit_count must be 1...32.");
+    JD3D12_ASSERT_OR_RETURN(values_buf != &keys_buf, L"RadixSort: Keys and values must be different buffers.");
+    keys_byte_range = LimitRange(keys_byte_range, keys_buf.GetSize());
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(keys_buf, keys_byte_range.first, keys_byte_range.count, false));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(keys_buf, keys_byte_range.first, keys_byte_range.count, true));
+    if(values_buf != nullptr)
+    {
+        JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(*values_buf, values_byte_offset, keys_byte_range.count, false));
+        JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(*values_buf, values_byte_offset, keys_byte_range.count, true));
+    }
+
+    const uint32_t element_count = uint32_t(keys_byte_range.count / 4);
+    if(element_count == 1)
+        return kFalse;
+
+    PrimitiveScope scope{ *this };
+
+    // Each pass moves the elements between the user's buffers and temporary ones.
+    const uint32_t block_count = DivideRoundingUp(element_count, kPrimitiveBlockSize);
+    const uint32_t histogram_count = block_count << kPrimitiveRadixBits;
+    BufferImpl* tmp_keys_buf = nullptr;
+    BufferImpl* tmp_values_buf = nullptr;
+    BufferImpl* histogram_buf = nullptr;
+    BufferImpl* scanned_histogram_buf = nullptr;
+    JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(element_count, tmp_keys_buf));
+    if(values_buf != nullptr)
+    {
+        JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(element_count, tmp_values_buf));
+    }
+    JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(histogram_count, histogram_buf));
+    JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(histogram_count, scanned_histogram_buf));
+    const PrimitiveBuffer keys[2] = {
+        PrimitiveBuffer{ &keys_buf, keys_byte_range.first }, PrimitiveBuffer{ tmp_keys_buf, 0 } };
+    const PrimitiveBuffer values[2] = {
+        PrimitiveBuffer{ values_buf, values_byte_offset }, PrimitiveBuffer{ tmp_values_buf, 0 } };
+
+    /* With an odd number of digits, the last one is sorted again, so the elements end up in the user's buffers
+    without a copy. Sorting again by the most significant digit so far keeps the order, as the sort is stable.
+    */
+    uint32_t pass_count = DivideRoundingUp(key_bit_count, kPrimitiveRadixBits);
+    const uint32_t last_radix_shift = (pass_count - 1) * kPrimitiveRadixBits;
+    pass_count = AlignUp(pass_count, 2u);
+
+    for(uint32_t pass_index = 0; pass_index < pass_count; ++pass_index)
+    {
+        const uint32_t radix_shift = std::min(pass_index * kPrimitiveRadixBits, last_radix_shift);
+        const uint32_t src_index = pass_index % 2;
+        const uint32_t dst_index = 1 - src_index;
+
+        PrimitiveDispatch count_dispatch;
+        count_dispatch.kernel = PrimitiveKernel::kRadixCount;
+        count_dispatch.element_count = element_count;
+        count_dispatch.group_count = block_count;
+        count_dispatch.flags = radix_shift << kPrimitiveFlagRadixShiftOffset;
+        count_dispatch.buffers[0] = keys[src_index];
+        count_dispatch.buffers[3] = PrimitiveBuffer{ histogram_buf, 0 };
+        JD3D12_RETURN_IF_FAILED(DispatchPrimitive(count_dispatch, L"RadixSort"));
+
+        JD3D12_RETURN_IF_FAILED(RecordPrimitiveScan(scope, kPrimitiveDataTypeUint, kPrimitiveFlagExclusive,
+            PrimitiveBuffer{ histogram_buf, 0 }, histogram_count, PrimitiveBuffer{ scanned_histogram_buf, 0 }));
+
+        PrimitiveDispatch scatter_dispatch;
+        scatter_dispatch.kernel = PrimitiveKernel::kRadixScatter;
+        scatter_dispatch.element_count = element_count;
+        scatter_dispatch.group_count = block_count;
+        scatter_dispatch.flags = radix_shift << kPrimitiveFlagRadixShiftOffset;
+        scatter_dispatch.buffers[0] = keys[src_index];
+        scatter_dispatch.buffers[2] = PrimitiveBuffer{ scanned_histogram_buf, 0 };
+        scatter_dispatch.buffers[3] = keys[dst_index];
+        if(values_buf != nullptr)
+        {
+            scatter_dispatch.flags |= kPrimitiveFlagHasValues;
+            scatter_dispatch.buffers[1] = values[src_index];
+            scatter_dispatch.buffers[4] = values[dst_index];
+        }
+        JD3D12_RETURN_IF_FAILED(DispatchPrimitive(scatter_dispatch, L"RadixSort"));
+    }
+    return kSuccess;
+}
+
+Result DeviceImpl::Compact(BufferImpl& src_buf, Range src_byte_range, BufferImpl& flags_buf, size_t flags_byte_offset,
+    BufferImpl& dst_buf, size_t dst_byte_offset, BufferImpl& count_buf, size_t count_byte_offset)
+{
+    JD3D12_ASSERT_OR_RETURN(&src_buf != &dst_buf && &src_buf != &count_buf
+        && &flags_buf != &dst_buf && &flags_buf != &count_buf,
+        L"Compact: Sources and destinations must be different buffers.");
+    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(src_buf, src_byte_range.first, src_byte_range.count, false));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(flags_buf, flags_byte_offset, src_byte_range.count, false));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(dst_buf, dst_byte_offset, src_byte_range.count, true));
+    JD3D12_RETURN_IF_FAILED(ValidatePrimitiveBuffer(count_buf, count_byte_offset, 4, true));
+
+    const uint32_t element_count = uint32_t(src_byte_range.count / 4);
+    PrimitiveScope scope{ *this };
+
+    // The exclusive scan of the flags, each treated as 0 or 1, is the output index of each element.
+    BufferImpl* indices_buf = nullptr;
+    JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(element_count, indices_buf));
+    JD3D12_RETURN_IF_FAILED(RecordPrimitiveScan(scope, kPrimitiveDataTypeUint,
+        kPrimitiveFlagExclusive | kPrimitiveFlagPredicate, PrimitiveBuffer{ &flags_buf, flags_byte_offset },
+        element_count, PrimitiveBuffer{ indices_buf, 0 }));
+
+    PrimitiveDispatch dispatch;
+    dispatch.kernel = PrimitiveKernel::kCompactScatter;
+    dispatch.element_count = element_count;
+    dispatch.group_count = DivideRoundingUp(element_count, kPrimitiveGroupSize);
+    dispatch.buffers[0] = PrimitiveBuffer{ &src_buf, src_byte_range.first };
+    dispatch.buffers[1] = PrimitiveBuffer{ &flags_buf, flags_byte_offset };
+    dispatch.buffers[2] = PrimitiveBuffer{ indices_buf, 0 };
+    dispatch.buffers[3] = PrimitiveBuffer{ &dst_buf, dst_byte_offset };
+    dispatch.buffers[4] = PrimitiveBuffer{ &count_buf, count_byte_offset };
+    return DispatchPrimitive(dispatch, L"Compact");
+}
+
+void DeviceImpl::ResetAllBindings()
+{
+    BindingState& binding_state = GetBindingState();
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    {
+        binding_state.cbv_bindings_[slot] = Binding{};
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+    {
+        binding_state.srv_bindings_[slot] = Binding{};
+    }
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
+    {
+        binding_state.uav_bindings_[slot] = Binding{};
+    }
+    binding_state.ResetBindlessIndices();
+    for(uint32_t i = 0; i < Device::kMaxRootConstantCount; ++i)
+        binding_state.root_constants_[i] = 0;
+    binding_state.root_constants_dirty_ = true;
+}
+
+Result DeviceImpl::BindConstantBuffer(uint32_t b_slot, BufferImpl* buf, Range byte_range)
+{
+    JD3D12_ASSERT_OR_RETURN(b_slot < MainRootSignature::kMaxCBVCount, L"CBV slot out of bounds.");
+
+    if(buf != nullptr)
+        byte_range = LimitRange(byte_range, buf->GetSize());
+    else
+        byte_range = kEmptyRange;
+
+    JD3D12_ASSERT_OR_RETURN(byte_range.first % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0
+        && byte_range.count % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0,
+        L"Constant buffer offset and size must be a multiple of 256 B.");
+
+    Binding* binding = &GetBindingState().cbv_bindings_[b_slot];
+    if(binding->buffer == buf && binding->byte_range == byte_range && binding->constant_data.empty())
+        return kFalse;
+
+    if(buf == nullptr)
+    {
+        *binding = Binding{};
+        return kSuccess;
+    }
+
+    size_t alignment = buf->GetElementSize();
+    if(alignment == 0)
+        alignment = 4;
+
+    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
+        L"Size must be greater than zero and a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderConstant) != 0,
+        L"BindConstantBuffer: Buffer was not created with kBufferUsageFlagShaderConstant.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+
+    binding->buffer = buf;
+    binding->byte_range = byte_range;
+    binding->descriptor_index = UINT32_MAX;
+    binding->root_argument_set = false;
+    binding->constant_data.clear();
+
+    return kSuccess;
+}
+
+Result DeviceImpl::BindBuffer(uint32_t t_slot, BufferImpl* buf, Range byte_range)
+{
+    JD3D12_ASSERT_OR_RETURN(t_slot < MainRootSignature::kMaxSRVCount, L"SRV slot out of bounds.");
+
+    if(buf != nullptr)
+        byte_range = LimitRange(byte_range, buf->GetSize());
+    else
+        byte_range = kEmptyRange;
+
+    Binding* binding = &GetBindingState().srv_bindings_[t_slot];
+    if(binding->buffer == buf && binding->byte_range == byte_range)
+        return kFalse;
+
+    if(buf == nullptr)
+    {
+        *binding = Binding{};
+        return kSuccess;
+    }
+
+    const uint32_t type_bit_count = CountBitsSet(buf->desc_.flags
+        & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress));
+    JD3D12_ASSERT_OR_RETURN(type_bit_count == 1,
+        L"Buffer must be one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
+
+    size_t alignment = buf->GetElementSize();
+    if(alignment == 0)
+        alignment = 4;
+
+    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
+        L"Size must be greater than zero and a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderResource) != 0,
+        L"BindBuffer: Buffer was not created with kBufferUsageFlagGpuShaderResource.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+
+    binding->buffer = buf;
+    binding->byte_range = byte_range;
+    binding->descriptor_index = UINT32_MAX;
+    binding->root_argument_set = false;
+
+    return kSuccess;
+}
+
+Result DeviceImpl::BindRWBuffer(uint32_t u_slot, BufferImpl* buf, Range byte_range, uint32_t bind_flags)
+{
+    JD3D12_ASSERT_OR_RETURN(u_slot < MainRootSignature::kMaxUAVCount, L"UAV slot out of bounds.");
+
+    if(buf != nullptr)
+        byte_range = LimitRange(byte_range, buf->GetSize());
+    else
+        byte_range = kEmptyRange;
+
+    const bool no_uav_hazard = (bind_flags & kBindFlagNoUavHazard) != 0;
+    Binding* binding = &GetBindingState().uav_bindings_[u_slot];
+    if(binding->buffer == buf && binding->byte_range == byte_range)
+    {
+        if(binding->no_uav_hazard == no_uav_hazard)
+            return kFalse;
+        binding->no_uav_hazard = no_uav_hazard;
+        return kSuccess;
+    }
+
+    if(buf == nullptr)
+    {
+        *binding = Binding{};
+        return kSuccess;
+    }
+
+    const uint32_t type_bit_count = CountBitsSet(buf->desc_.flags
+        & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress));
+    JD3D12_ASSERT_OR_RETURN(type_bit_count == 1,
+        L"Buffer must be one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
+
+    size_t alignment = buf->GetElementSize();
+    if(alignment == 0)
+        alignment = 4;
+    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
+        L"Size must be greater than zero and a multiple of element size.");
+    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
+        L"BindRWBuffer: Buffer was not created with kBufferUsageFlagShaderRWResource.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
+    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+
+    binding->buffer = buf;
+    binding->byte_range = byte_range;
+    binding->descriptor_index = UINT32_MAX;
+    binding->root_argument_set = false;
+    binding->no_uav_hazard = no_uav_hazard;
+
+    return kSuccess;
+}
+
+Result DeviceImpl::BindConstantData(uint32_t b_slot, ConstDataSpan data)
+{
+    JD3D12_ASSERT_OR_RETURN(b_slot < MainRootSignature::kMaxCBVCount, L"CBV slot out of bounds.");
+    JD3D12_ASSERT_OR_RETURN(data.data != nullptr && data.size > 0, L"Constant data cannot be empty.");
+    JD3D12_ASSERT_OR_RETURN(data.size <= D3D12_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16,
+        L"Constant data cannot exceed 64 KB.");
+
+    Binding* binding = &GetBindingState().cbv_bindings_[b_slot];
+    *binding = Binding{};
+    binding->byte_range = Range{ 0, data.size };
+    binding->constant_data.assign((const char*)data.data, (const char*)data.data + data.size);
+
+    return kSuccess;
+}
+
+Result DeviceImpl::SetRootConstants(ConstDataSpan data, uint32_t first_constant_index)
+{
+    JD3D12_ASSERT_OR_RETURN(data.data != nullptr || data.size == 0, L"data.data cannot be null.");
+    JD3D12_ASSERT_OR_RETURN(data.size % sizeof(uint32_t) == 0, L"data.size must be a multiple of 4 B.");
+    JD3D12_ASSERT_OR_RETURN(first_constant_index + data.size / sizeof(uint32_t) <= Device::kMaxRootConstantCount,
+        L"Root constants out of bounds.");
+
+    BindingState& binding_state = GetBindingState();
+    memcpy(binding_state.root_constants_ + first_constant_index, data.data, data.size);
+    binding_state.root_constants_dirty_ = true;
+
+    return kSuccess;
+}
+
+Result DeviceImpl::BindBindlessBuffer(uint32_t index_slot, BufferImpl* buf)
+{
+    JD3D12_ASSERT_OR_RETURN(IsBindless(), L"BindBindlessBuffer requires kDeviceFlagBindless.");
+    JD3D12_ASSERT_OR_RETURN(index_slot < Device::kMaxBindlessIndexCount, L"Bindless index slot out of bounds.");
+
+    BindlessBinding& binding = GetBindingState().bindless_bindings_[index_slot];
+    if(binding.buffer == buf && !binding.writable && buf != nullptr)
+        return kFalse;
+
+    uint32_t descriptor_index = null_srv_index_;
+    if(buf != nullptr)
+    {
+        JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
+        JD3D12_ASSERT_OR_RETURN(buf->GetBindlessSrvIndex() != UINT32_MAX,
+            L"BindBindlessBuffer: Buffer has no bindless SRV. It must be created with "
+            L"kBufferUsageFlagShaderResource and one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
+        descriptor_index = buf->GetBindlessSrvIndex();
+    }
+
+    binding.buffer = buf;
+    binding.writable = false;
+    GetBindingState().bindless_indices_[index_slot] = descriptor_index;
+    GetBindingState().bindless_indices_dirty_ = true;
+    return kSuccess;
+}
+
+Result DeviceImpl::BindBindlessRWBuffer(uint32_t index_slot, BufferImpl* buf)
+{
+    JD3D12_ASSERT_OR_RETURN(IsBindless(), L"BindBindlessRWBuffer requires kDeviceFlagBindless.");
+    JD3D12_ASSERT_OR_RETURN(index_slot < Device::kMaxBindlessIndexCount, L"Bindless index slot out of bounds.");
+
+    BindlessBinding& binding = GetBindingState().bindless_bindings_[index_slot];
+    if(binding.buffer == buf && binding.writable && buf != nullptr)
+        return kFalse;
+
+    uint32_t descriptor_index = null_uav_index_;
+    if(buf != nullptr)
+    {
+        JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
+        JD3D12_ASSERT_OR_RETURN(buf->GetBindlessUavIndex() != UINT32_MAX,
+            L"BindBindlessRWBuffer: Buffer has no bindless UAV. It must be created with "
+            L"kBufferUsageFlagShaderRWResource and one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
+        descriptor_index = buf->GetBindlessUavIndex();
+    }
+
+    binding.buffer = buf;
+    binding.writable = true;
+    GetBindingState().bindless_indices_[index_slot] = descriptor_index;
+    GetBindingState().bindless_indices_dirty_ = true;
+    return kSuccess;
+}
+
+Result DeviceImpl::CheckBindlessSupport()
+{
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    HRESULT hr = device_->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options));
+    if(FAILED(hr) || options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_3)
+    {
+        JD3D12_LOG(kLogSeverityError, L"kDeviceFlagBindless requires resource binding tier 3.");
+        return kErrorUnsupported;
+    }
+
+    D3D12_FEATURE_DATA_SHADER_MODEL shader_model = { D3D_SHADER_MODEL_6_6 };
+    hr = device_->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shader_model, sizeof(shader_model));
+    if(FAILED(hr) || shader_model.HighestShaderModel < D3D_SHADER_MODEL_6_6)
+    {
+        JD3D12_LOG(kLogSeverityError, L"kDeviceFlagBindless requires shader model 6.6.");
+        return kErrorUnsupported;
+    }
+
+    return kSuccess;
+}
+
+Result DeviceImpl::Init(bool enable_d3d12_debug_layer)
+{
+    {
+        LARGE_INTEGER frequency = {};
+        QueryPerformanceFrequency(&frequency);
+        performance_counter_frequency_ = uint64_t(frequency.QuadPart);
+    }
+
+    {
+        IDXGIAdapter1* adapter = nullptr;
+        JD3D12_RETURN_IF_FAILED(env_->FindAdapter(desc_, adapter));
+        adapter_ = adapter;
+    }
+
+    DXGI_ADAPTER_DESC adapter_desc = {};
+    {
+        adapter_->GetDesc(&adapter_desc);
+        // Ignoring the result.
+    }
+
+    JD3D12_LOG(kLogSeverityInfo, L"Creating Device 0x%016" PRIXPTR " \"%s\": flags=0x%X for GPU \"%s\"",
+        uintptr_t(GetInterface()),
+        EnsureNonNullString(desc_.name), desc_.flags, adapter_desc.Description);
+
+    JD3D12_ASSERT_OR_RETURN(desc_.command_batch_count > 0 && desc_.command_batch_count <= kMaxCommandBatchCount,
+        L"DeviceDesc::command_batch_count must be between 1 and 16.");
+    JD3D12_ASSERT_OR_RETURN(desc_.upload_ring_size > 0, L"DeviceDesc::upload_ring_size cannot be 0.");
+    JD3D12_ASSERT_OR_RETURN(desc_.recording_descriptor_count <= kMaxRecordingDescriptorCount,
+        L"DeviceDesc::recording_descriptor_count cannot exceed 16384.");
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(env_->GetD3D12DeviceFactory()->CreateDevice(adapter_,
+        D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device_)));
+
+    if(enable_d3d12_debug_layer)
+    {
+        JD3D12_RETURN_IF_FAILED(EnableDebugLayer());
+    }
+
+    HRESULT hr = device_->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS16, &options16_, sizeof(options16_));
+    if(FAILED(hr))
+        options16_ = {};
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS12 options12 = {};
+    hr = device_->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS12, &options12, sizeof(options12));
+    enhanced_barriers_ = SUCCEEDED(hr) && options12.EnhancedBarriersSupported;
+    D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1 = {};
+    hr = device_->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS1, &options1, sizeof(options1));
+    primitive_wave_ops_ = SUCCEEDED(hr) && options1.WaveOps && options1.WaveLaneCountMin >= 16;
+
+    if (!IsStringEmpty(desc_.name))
+        device_->SetName(desc_.name);
+
+    D3D12_COMMAND_QUEUE_DESC cmd_queue_desc{};
+    cmd_queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+    cmd_queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+    if((desc_.flags & kDeviceFlagDisableGpuTimeout) != 0)
+        cmd_queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_DISABLE_GPU_TIMEOUT;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandQueue(&cmd_queue_desc, IID_PPV_ARGS(&command_queue_)));
+    SetObjectName(command_queue_, desc_.name, L"CommandQueue");
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence_)));
+    SetObjectName(fence_, desc_.name, L"Fence");
+
+    HANDLE fence_event_handle = NULL;
+    fence_event_handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+    fence_event_.reset(fence_event_handle);
+
+    command_batches_.resize(desc_.command_batch_count);
+    for(uint32_t batch_index = 0; batch_index < desc_.command_batch_count; ++batch_index)
+    {
+        CommandBatch& batch = command_batches_[batch_index];
+
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE,
+            IID_PPV_ARGS(&batch.command_allocator)));
+        SetObjectName(batch.command_allocator, desc_.name,
+            SPrintF(L"CommandAllocator %u", batch_index).c_str());
+
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+            batch.command_allocator, nullptr, IID_PPV_ARGS(&batch.command_list)));
+        SetObjectName(batch.command_list, desc_.name, SPrintF(L"CommandList %u", batch_index).c_str());
+        // Enhanced barriers are used only when all command lists support them.
+        if(enhanced_barriers_ && FAILED(batch.command_list->QueryInterface(IID_PPV_ARGS(&batch.command_list7))))
+            enhanced_barriers_ = false;
+
+        // Only the first batch starts in the recording state.
+        if(batch_index > 0)
+            JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Close());
+
+        if(IsProfilingEnabled())
+            JD3D12_RETURN_IF_FAILED(CreateProfilingResources(batch, batch_index));
+    }
+    if(IsProfilingEnabled())
+        JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->GetTimestampFrequency(&timestamp_frequency_));
+
+    if((desc_.flags & kDeviceFlagEnableCopyQueue) != 0)
+    {
+        copy_queue_ = std::make_unique<CopyQueue>(this, desc_.name);
+        JD3D12_RETURN_IF_FAILED(copy_queue_->Init(desc_.name, desc_.command_batch_count, fence_));
+    }
+    if(IsResidencyManagementEnabled())
+        JD3D12_RETURN_IF_FAILED(InitResidencyManagement());
+
+    if(IsBindless())
+    {
+        JD3D12_RETURN_IF_FAILED(CheckBindlessSupport());
+    }
+    JD3D12_RETURN_IF_FAILED(main_root_signature_->Init(IsBindless()));
+    if(!IsStringEmpty(desc_.pipeline_library_file_path))
+    {
+        pipeline_library_ = std::make_unique<PipelineLibrary>(this);
+        JD3D12_RETURN_IF_FAILED(pipeline_library_->Init(desc_.pipeline_library_file_path));
+    }
+
+    JD3D12_RETURN_IF_FAILED(shader_visible_descriptor_heap_.Init(desc_.name, desc_.command_batch_count,
+        (IsBindless() ? kBindlessDescriptorCount : 0) + desc_.recording_descriptor_count));
+    JD3D12_RETURN_IF_FAILED(shader_invisible_descriptor_heap_.Init(desc_.name, desc_.command_batch_count, 0));
+    {
+        const BufferStrategy strategies[] = {
+            BufferStrategy::kUpload, BufferStrategy::kGpuUpload, BufferStrategy::kDefault, BufferStrategy::kReadback };
+        const D3D12_HEAP_TYPE heap_types[] = {
+            D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_TYPE_GPU_UPLOAD, D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_TYPE_READBACK };
+        for(size_t i = 0; i < kBufferStrategyHeapTypeCount; ++i)
+        {
+            buffer_heap_allocators_[size_t(strategies[i]) - 1] =
+                std::make_unique<BufferHeapAllocator>(this, desc_.name, heap_types[i]);
+        }
+    }
+    JD3D12_RETURN_IF_FAILED(upload_ring_.Init(desc_.name, AlignUp(desc_.upload_ring_size, kUploadRingAlignment)));
+    JD3D12_RETURN_IF_FAILED(CreateNullDescriptors());
+
+    JD3D12_RETURN_IF_FAILED(CreateStaticBuffers());
+    JD3D12_RETURN_IF_FAILED(CreateStaticShaders());
+
+    desc_.name = nullptr;
+    desc_.pipeline_library_file_path = nullptr;
+    return kSuccess;
+}
+
+Result DeviceImpl::EnableDebugLayer()
+{
+    HRESULT hr = device_->QueryInterface(IID_PPV_ARGS(&info_queue_));
+    // QueryInterface for ID3D12InfoQueue1 or ID3D12InfoQueue fails unless the Debug Layer
+    // is force-enabled externally using "dxcpl" app. I don't know why.
+    if(SUCCEEDED(hr))
+    {
+        info_queue_->RegisterMessageCallback(StaticDebugLayerMessageCallback,
+            D3D12_MESSAGE_CALLBACK_FLAG_NONE, this, &debug_layer_callback_cookie_);
+    }
+
+    return kSuccess;
+}
+
+void DeviceImpl::DebugLayerMessageCallback(
+    D3D12_MESSAGE_CATEGORY Category,
+    D3D12_MESSAGE_SEVERITY Severity,
+    D3D12_MESSAGE_ID ID,
+    LPCSTR pDescription)
+{
+    const LogSeverity log_severity = D3d12MessageSeverityToLogSeverity(Severity);
+    GetLogger()->LogF(log_severity, L"%S [%s #%u]", pDescription,
+        GetD3d12MessageCategoryString(Category), uint32_t(ID));
+}
+
+Result DeviceImpl::ExecuteRecordedCommands()
+{
+    JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording);
+    // Any command that needs to submit or wait for the GPU ends up here.
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(shader_compilation_result->GetResult());
+    CommandBatch& batch = GetCurrentBatch();
+    // Normally empty, unless recording of a command failed after its buffers were already tracked.
+    FlushBarriers();
+    for(auto it = regions_.rbegin(); it != regions_.rend(); ++it)
+    {
+        EndProfiledCommand(it->profiled_command_index);
+        it->profiled_command_index = UINT32_MAX;
+        EndCommandListEvent();
+    }
+    if(!batch.profile_records.empty())
+    {
+        batch.command_list->ResolveQueryData(batch.timestamp_query_heap, D3D12_QUERY_TYPE_TIMESTAMP,
+            0, uint32_t(batch.profile_records.size() * 2), batch.timestamp_readback_buffer, 0);
+    }
+    JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Close());
 
-    const ConstDataSpan bytecode = shader_compilation_result->GetBytecode();
-    if(bytecode.size == 0)
-        return kErrorFail;
+    if(batch.copy_queue_wait_fence_value > 0)
+    {
+        if(batch.copy_queue_wait_fence_value > copy_queue_->GetSubmittedFenceValue())
+            JD3D12_RETURN_IF_FAILED(copy_queue_->Submit());
+        JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Wait(copy_queue_->GetFence(),
+            batch.copy_queue_wait_fence_value));
+        batch.copy_queue_wait_fence_value = 0;
+    }
+    if(IsResidencyManagementEnabled())
+        JD3D12_RETURN_IF_FAILED(UpdateResidency(batch));
 
-    return CreateShaderFromMemory(desc, bytecode, out_shader);
+    // Recordings go first, as they were executed before any command recorded in the batch's command list.
+    StackOrHeapVector<ID3D12CommandList*, 8> command_lists;
+    for(RecordingImpl* recording : batch.recordings)
+    {
+        ID3D12CommandList* const recorded_command_list = recording->batch_.command_list;
+        command_lists.PushBack(recorded_command_list);
+    }
+    batch.recordings.clear();
+    ID3D12CommandList* const batch_command_list = batch.command_list;
+    command_lists.PushBack(batch_command_list);
+    command_queue_->ExecuteCommandLists(uint32_t(command_lists.GetCount()), command_lists.GetData());
+
+    ++submitted_fence_value_;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Signal(fence_, submitted_fence_value_));
+    batch.fence_value = submitted_fence_value_;
+
+    AddCommandStatistics(statistics_.total, batch.statistics);
+    statistics_.last_batch = batch.statistics;
+    batch.statistics = CommandStatistics{};
+    ++statistics_.submitted_batch_count;
+    statistics_.peak_dynamic_descriptor_count = std::max(statistics_.peak_dynamic_descriptor_count,
+        shader_visible_descriptor_heap_.GetPartitionSize()
+        - shader_visible_descriptor_heap_.GetFreeDynamicCount(current_batch_index_));
+
+    command_list_state_ = CommandListState::kExecuting;
+
+    return kSuccess;
 }
 
-Result DeviceImpl::MapBuffer(BufferImpl& buf, Range byte_range, BufferFlags cpu_usage_flag, void*& out_data_ptr,
-    uint32_t command_flags)
+Result DeviceImpl::WaitForCommandExecution(uint32_t timeout_milliseconds)
 {
-    out_data_ptr = nullptr;
-    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
-        L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN(!buf.is_user_mapped_,
-        L"Device::MapBuffer called twice. Nested mapping is not supported.");
-    JD3D12_ASSERT_OR_RETURN(buf.persistently_mapped_ptr_ != nullptr,
-        L"Cannot map this buffer.");
-    JD3D12_ASSERT_OR_RETURN(CountBitsSet(cpu_usage_flag &
-        (kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCpuRead)) == 1,
-        L"cpu_usage_flag must be kBufferUsageFlagCpuSequentialWrite or kBufferUsageFlagCpuRead.");
-    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & cpu_usage_flag) == cpu_usage_flag,
-        L"Buffer was not created with the kBufferUsageFlagCpu* used for mapping.");
-    const bool is_reading = (buf.desc_.flags & kBufferUsageFlagCpuRead) != 0;
-    const bool is_writing = (buf.desc_.flags & kBufferUsageFlagCpuSequentialWrite) != 0;
+    JD3D12_ASSERT(command_list_state_ == CommandListState::kExecuting);
 
-    byte_range = LimitRange(byte_range, buf.desc_.size);
-    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0, L"byte_range is empty.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf.GetSize(), L"byte_range out of bounds.");
+    if(fence_->GetCompletedValue() < submitted_fence_value_)
+        ++statistics_.wait_for_idle_count;
+
+    const Result res = WaitForFenceValue(submitted_fence_value_, timeout_milliseconds);
+    if(res != kSuccess)
+        return res;
+
+    JD3D12_ASSERT(command_list_state_ == CommandListState::kNone);
+    return kSuccess;
+}
+
+Result DeviceImpl::ResetCommandListForRecording(uint32_t timeout_milliseconds)
+{
+    JD3D12_ASSERT(command_list_state_ == CommandListState::kNone
+        || command_list_state_ == CommandListState::kExecuting);
+
+    const uint32_t next_batch_index = (current_batch_index_ + 1) % uint32_t(command_batches_.size());
+    CommandBatch& batch = command_batches_[next_batch_index];
+
+    // Wait only for the batch we are going to reuse. Newer ones may still be executing.
+    const Result res = WaitForFenceValue(batch.fence_value, timeout_milliseconds);
+    if(res != kSuccess)
+        return res;
+    JD3D12_ASSERT(batch.resource_usage_map.map_.empty() && batch.shader_usage_set.empty()
+        && batch.profile_records.empty());
 
-    // If the buffer is being written or read to in the current command list, execute it and wait for it to finish.
-    const uint32_t conflicting_usage_flags = is_writing
-        ? (kResourceUsageFlagWrite | kResourceUsageFlagRead)
-        : kResourceUsageFlagWrite;
-    if(resource_usage_map_.IsUsed(&buf, conflicting_usage_flags))
+    binding_state_.ResetDescriptors();
+    batch.view_cache.clear();
+    shader_invisible_descriptor_heap_.ClearDynamic(next_batch_index);
+    shader_visible_descriptor_heap_.ClearDynamic(next_batch_index);
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_allocator->Reset());
+    JD3D12_LOG_AND_RETURN_IF_FAILED(batch.command_list->Reset(batch.command_allocator, nullptr));
+
+    current_batch_index_ = next_batch_index;
+    command_list_state_ = CommandListState::kRecording;
+
+    // Reopen the regions closed when the previous batch was submitted.
+    for(uint32_t region_index = 0; region_index < uint32_t(regions_.size()); ++region_index)
     {
-        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
-        const Result res = EnsureCommandListState(CommandListState::kNone, timeout);
-        if(res != kSuccess)
-            return res;
+        Region& region = regions_[region_index];
+        BeginCommandListEvent(region.name.c_str());
+        region.profiled_command_index = BeginProfiledCommand(region.name.c_str(), nullptr, {}, region_index);
     }
 
-    buf.is_user_mapped_ = true;
-
-    out_data_ptr = (char*)buf.persistently_mapped_ptr_ + byte_range.first;
     return kSuccess;
 }
 
-void DeviceImpl::UnmapBuffer(BufferImpl& buf)
+Result DeviceImpl::EnsureCommandListState(CommandListState desired_state, uint32_t timeout_milliseconds)
 {
-    JD3D12_ASSERT(buf.GetDevice() == this && "Buffer does not belong to this Device.");
-    JD3D12_ASSERT(buf.is_user_mapped_ && "Device::UnmapBuffer called but the buffer wasn't mapped.");
+    // The command list of a recording is always open, while other threads may change the state of the device.
+    if(GetOpenRecording() != nullptr)
+    {
+        JD3D12_ASSERT_OR_RETURN(desired_state == CommandListState::kRecording,
+            L"This command cannot be used between BeginRecording and EndRecording.");
+        return kSuccess;
+    }
 
-    buf.is_user_mapped_ = false;
+    if(desired_state == command_list_state_)
+        return kSuccess;
+    if(command_list_state_ == CommandListState::kRecording)
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    if(desired_state == command_list_state_)
+        return kSuccess;
+    if(desired_state == CommandListState::kRecording)
+        return ResetCommandListForRecording(timeout_milliseconds);
+    if(command_list_state_ == CommandListState::kExecuting)
+        return WaitForCommandExecution(timeout_milliseconds);
+    return kSuccess;
 }
 
-Result DeviceImpl::ReadBufferToMemory(BufferImpl& src_buf, Range src_byte_range, void* dst_memory,
-    uint32_t command_flags)
+Result DeviceImpl::WaitForFenceValue(uint64_t fence_value, uint32_t timeout_milliseconds)
 {
-    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN(!src_buf.is_user_mapped_, L"Cannot call this command while the buffer is mapped.");
+    JD3D12_ASSERT(fence_value <= submitted_fence_value_);
 
-    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
-    if(src_byte_range.count == 0)
-        return kFalse;
+    if(fence_->GetCompletedValue() < fence_value)
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(fence_->SetEventOnCompletion(fence_value, fence_event_.get()));
+        LARGE_INTEGER wait_begin = {}, wait_end = {};
+        QueryPerformanceCounter(&wait_begin);
+        const DWORD wait_result = WaitForSingleObject(fence_event_.get(), timeout_milliseconds);
+        QueryPerformanceCounter(&wait_end);
+        ++statistics_.cpu_wait_count;
+        statistics_.cpu_wait_milliseconds += double(wait_end.QuadPart - wait_begin.QuadPart) * 1000.0
+            / double(performance_counter_frequency_);
+        switch(wait_result)
+        {
+        case WAIT_OBJECT_0:
+            // Waiting succeeded, event was is signaled (and got automatically reset to unsignaled).
+            break;
+        case WAIT_TIMEOUT:
+            return kNotReady;
+        default: // Most likely WAIT_FAILED.
+            return MakeResultFromLastError();
+        }
+    }
 
-    JD3D12_ASSERT_OR_RETURN(dst_memory != nullptr, L"dst_memory cannot be null.");
-    JD3D12_ASSERT_OR_RETURN(src_byte_range.first < src_buf.GetSize()
-        && src_byte_range.first + src_byte_range.count <= src_buf.GetSize(),
-        L"Source buffer region out of bounds.");
+    RetireCompletedBatches();
+    return kSuccess;
+}
 
-    // If the buffer is being written to in the current command list, execute it and wait for it to finish.
-    // If it is only read, there is no hazard.
-    if(resource_usage_map_.IsUsed(&src_buf, kResourceUsageFlagWrite))
+void DeviceImpl::RetireCompletedBatches()
+{
+    const uint64_t completed_fence_value = fence_->GetCompletedValue();
+    const uint32_t batch_count = uint32_t(command_batches_.size());
+    for(uint32_t batch_index = 0; batch_index < batch_count; ++batch_index)
     {
-        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
-        const Result res = EnsureCommandListState(CommandListState::kNone, timeout);
-        if(res == kNotReady)
-            return res;
-        JD3D12_RETURN_IF_FAILED(res);
+        const bool is_recording = batch_index == current_batch_index_
+            && command_list_state_ == CommandListState::kRecording;
+        CommandBatch& batch = command_batches_[batch_index];
+        if(!is_recording && batch.fence_value <= completed_fence_value)
+        {
+            batch.resource_usage_map.map_.clear();
+            batch.shader_usage_set.clear();
+            if(!batch.profile_records.empty())
+                CollectProfileRecords(batch);
+        }
     }
 
-    void* mapped_ptr = nullptr;
-    HRESULT hr = MapBuffer(src_buf, src_byte_range, kBufferUsageFlagCpuRead, mapped_ptr);
-    if(FAILED(hr))
-        return hr;
-    memcpy(dst_memory, (char*)mapped_ptr, src_byte_range.count);
-    UnmapBuffer(src_buf);
-    return kSuccess;
+    upload_ring_.Retire(completed_fence_value);
+
+    if(command_list_state_ == CommandListState::kExecuting && completed_fence_value >= submitted_fence_value_)
+        command_list_state_ = CommandListState::kNone;
 }
 
-Result DeviceImpl::WriteMemoryToBuffer(ConstDataSpan src_data, BufferImpl& dst_buf, size_t dst_byte_offset,
-    uint32_t command_flags)
+Result DeviceImpl::WaitForBatch(uint32_t batch_index, uint32_t timeout_milliseconds)
 {
-    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN(!dst_buf.is_user_mapped_, L"Cannot call this command while the buffer is mapped.");
+    if(batch_index == current_batch_index_ && command_list_state_ == CommandListState::kRecording)
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    return WaitForFenceValue(command_batches_[batch_index].fence_value, timeout_milliseconds);
+}
 
-    if(src_data.size == 0)
-        return kFalse;
+uint32_t DeviceImpl::FindNewestBatchUsingShader(ShaderImpl* shader) const
+{
+    const uint32_t batch_count = uint32_t(command_batches_.size());
+    for(uint32_t i = 0; i < batch_count; ++i)
+    {
+        const uint32_t batch_index = (current_batch_index_ + batch_count - i) % batch_count;
+        const std::unordered_set<ShaderImpl*>& usage_set = command_batches_[batch_index].shader_usage_set;
+        if(usage_set.find(shader) != usage_set.end())
+            return batch_index;
+    }
+    return UINT32_MAX;
+}
 
-    JD3D12_ASSERT_OR_RETURN(src_data.data != nullptr, L"src_memory cannot be null.");
-    JD3D12_ASSERT_OR_RETURN(src_data.size % 4 == 0, L"src_data.size must be a multiple of 4 B.");
-    JD3D12_ASSERT_OR_RETURN(dst_byte_offset < dst_buf.GetSize()
-        && dst_byte_offset + src_data.size <= dst_buf.GetSize(),
-        L"Destination buffer region out of bounds.");
+Result DeviceImpl::WaitForBufferUnused(BufferImpl* buf)
+{
+    JD3D12_ASSERT_OR_RETURN(!binding_state_.IsBufferBound(buf), L"Buffer is still bound.");
+    JD3D12_ASSERT_OR_RETURN(buf->recording_ref_count_ == 0, L"Buffer is still used by a Recording.");
+
+    return WaitForBufferAccess(*buf, true, kTimeoutInfinite);
+}
 
-    if(dst_buf.strategy_ == BufferStrategy::kUpload)
+bool DeviceImpl::IsBufferUnused(const BufferImpl& buf, uint64_t completed_fence_value) const
+{
+    if(buf.recording_ref_count_ > 0)
+        return false;
+    if(copy_queue_ && GetCopyQueueFenceValueToWait(buf, true) > 0)
+        return false;
+    const uint64_t fence_value = std::max(buf.last_read_fence_value_, buf.last_write_fence_value_);
+    return fence_value <= submitted_fence_value_ && fence_value <= completed_fence_value;
+}
+
+bool DeviceImpl::IsBufferReferenced(BufferImpl& buf)
+{
+    if(binding_state_.IsBufferBound(&buf))
+        return true;
+    if(primitive_user_binding_state_ != nullptr && primitive_user_binding_state_->IsBufferBound(&buf))
+        return true;
+    if(RecordingImpl* const recording = GetOpenRecording())
     {
-        // Use MapBuffer.
+        const auto& usage_map = recording->batch_.resource_usage_map.map_;
+        if(recording->binding_state_.IsBufferBound(&buf) || usage_map.find(&buf) != usage_map.end())
+            return true;
+    }
+    return false;
+}
 
-        // If the buffer is being written or read to in the current command list, execute it and wait for it to finish.
-        if(resource_usage_map_.IsUsed(&dst_buf, kResourceUsageFlagWrite | kResourceUsageFlagRead))
+Result DeviceImpl::WaitForBufferAccess(BufferImpl& buf, bool cpu_writes, uint32_t timeout_milliseconds)
+{
+    if(copy_queue_)
+    {
+        const uint64_t copy_queue_fence_value = GetCopyQueueFenceValueToWait(buf, cpu_writes);
+        if(copy_queue_fence_value > copy_queue_->GetSubmittedFenceValue())
+            JD3D12_RETURN_IF_FAILED(copy_queue_->Submit());
+        if(copy_queue_fence_value > 0)
         {
-            const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
-            const Result res = EnsureCommandListState(CommandListState::kNone, timeout);
+            const Result res = copy_queue_->WaitForFenceValue(copy_queue_fence_value, timeout_milliseconds);
             if(res != kSuccess)
                 return res;
         }
+    }
 
-        void* mapped_ptr = nullptr;
-        HRESULT hr = MapBuffer(dst_buf, Range{dst_byte_offset, src_data.size},
-            kBufferUsageFlagCpuSequentialWrite, mapped_ptr);
-        if(FAILED(hr))
-            return hr;
-        memcpy((char*)mapped_ptr, src_data.data, src_data.size);
-        UnmapBuffer(dst_buf);
+    const uint64_t fence_value = cpu_writes
+        ? std::max(buf.last_read_fence_value_, buf.last_write_fence_value_)
+        : buf.last_write_fence_value_;
+    if(fence_value == 0)
         return kSuccess;
+
+    if(fence_value > submitted_fence_value_)
+    {
+        JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording
+            && fence_value == GetRecordingFenceValue());
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
     }
-    else if(dst_buf.strategy_ == BufferStrategy::kDefault)
+    return WaitForFenceValue(fence_value, timeout_milliseconds);
+}
+
+Result DeviceImpl::WaitForShaderUnused(ShaderImpl* shader)
+{
+    JD3D12_ASSERT_OR_RETURN(shader->recording_ref_count_ == 0, L"Shader is still used by a Recording.");
+
+    const uint32_t batch_index = FindNewestBatchUsingShader(shader);
+    if(batch_index != UINT32_MAX)
+        return WaitForBatch(batch_index, kTimeoutInfinite);
+    return kSuccess;
+}
+
+Result DeviceImpl::WaitForRecordingUnused(RecordingImpl* recording)
+{
+    const uint64_t fence_value = recording->last_fence_value_;
+    if(fence_value == 0)
+        return kSuccess;
+
+    if(fence_value > submitted_fence_value_)
     {
-        // Use WriteBufferImmediate.
+        JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording
+            && fence_value == GetRecordingFenceValue());
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    }
+    return WaitForFenceValue(fence_value, kTimeoutInfinite);
+}
 
-        JD3D12_ASSERT_OR_RETURN(src_data.size <= 0x10000,
-            L"Writing to buffers in GPU memory is currently limited to 64 KB per call. It will be improved in the future.");
+Result DeviceImpl::UseBuffer(BufferImpl& buf, D3D12_RESOURCE_STATES state, bool no_uav_hazard)
+{
+    JD3D12_ASSERT(GetOpenRecording() != nullptr || command_list_state_ == CommandListState::kRecording);
 
-        const uint32_t timeout = (command_flags & kCommandFlagDontWait) ? 0 : kTimeoutInfinite;
-        const Result res = EnsureCommandListState(CommandListState::kRecording, timeout);
-        if(res != kSuccess)
-            return res;
+    JD3D12_ASSERT_OR_RETURN(!buf.is_user_mapped_, L"Cannot use a buffer on the GPU while it is mapped.");
+
+    uint32_t usage_flags = kResourceUsageFlagRead;
+    switch(state)
+    {
+    case D3D12_RESOURCE_STATE_COPY_SOURCE:
+    case D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE:
+    case D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER:
+    case D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT:
+        break;
+    case D3D12_RESOURCE_STATE_COPY_DEST:
+    case D3D12_RESOURCE_STATE_UNORDERED_ACCESS:
+        usage_flags |= kResourceUsageFlagWrite;
+        break;
+    default:
+        JD3D12_ASSERT(0);
+    }
+
+    // A recording accesses the buffer only when executed, which updates these in Execute.
+    if(!GetOpenRecording())
+    {
+        if((usage_flags & kResourceUsageFlagWrite) != 0)
+        {
+            buf.last_write_fence_value_ = GetRecordingFenceValue();
+            ++buf.gpu_write_count_;
+        }
+        else
+            buf.last_read_fence_value_ = GetRecordingFenceValue();
+
+        if(copy_queue_)
+        {
+            uint64_t& wait_fence_value = GetCurrentBatch().copy_queue_wait_fence_value;
+            wait_fence_value = std::max(wait_fence_value,
+                GetCopyQueueFenceValueToWait(buf, (usage_flags & kResourceUsageFlagWrite) != 0));
+        }
+    }
+
+    ResourceUsageMap& resource_usage_map = GetCurrentBatch().resource_usage_map;
+    const auto it = resource_usage_map.map_.find(&buf);
+    // Buffer wasn't used in this command list before.
+    // No barrier issued - rely on automatic state promotion.
+    if(it == resource_usage_map.map_.end())
+    {
+        resource_usage_map.map_.emplace(&buf, ResourceUsage{usage_flags, state});
+        return kSuccess;
+    }
+
+    // Use barriers only in DEAFULT and GPU_UPLOAD heap types.
+    if(buf.strategy_ == BufferStrategy::kDefault || buf.strategy_ == BufferStrategy::kGpuUpload)
+    {
+        // Transition the state if necessary, or UAV barrier unless the caller promised there is no hazard.
+        if(state != it->second.last_state ||
+            (state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS && !no_uav_hazard))
+        {
+            PendingBarrier barrier;
+            barrier.resource = buf.GetD3D12Resource();
+            barrier.state_before = it->second.last_state;
+            barrier.state_after = state;
+            GetPendingBarriers().push_back(barrier);
+        }
+    }
+
+    it->second.flags |= usage_flags;
+    it->second.last_state = state;
+
+    return kSuccess;
+}
+
+bool DeviceImpl::ShouldUseCopyQueue(BufferImpl& src_buf, BufferImpl& dst_buf, size_t size) const
+{
+    if(!copy_queue_ || size < kMinCopyQueueCopySize || GetOpenRecording())
+        return false;
+    // Evicted buffers are made resident only for batches of the compute queue.
+    if(src_buf.is_evicted_ || dst_buf.is_evicted_)
+        return false;
+    // Buffers used by the batch being recorded, including by the recordings executed in it, have its fence value.
+    const uint64_t recording_fence_value = GetRecordingFenceValue();
+    return std::max(src_buf.last_read_fence_value_, src_buf.last_write_fence_value_) < recording_fence_value
+        && std::max(dst_buf.last_read_fence_value_, dst_buf.last_write_fence_value_) < recording_fence_value;
+}
+
+Result DeviceImpl::CopyBufferRegionOnCopyQueue(BufferImpl& src_buf, Range src_byte_range,
+    BufferImpl& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT(copy_queue_);
+
+    ID3D12GraphicsCommandList* command_list = nullptr;
+    JD3D12_RETURN_IF_FAILED(copy_queue_->BeginRecording(command_list));
+
+    // Neither buffer is used by the batch being recorded, so everything to wait for is already submitted.
+    const uint64_t compute_fence_value = std::max({ src_buf.last_write_fence_value_,
+        dst_buf.last_read_fence_value_, dst_buf.last_write_fence_value_ });
+    JD3D12_ASSERT(compute_fence_value <= submitted_fence_value_);
+    if(compute_fence_value > fence_->GetCompletedValue())
+        copy_queue_->AddComputeQueueWait(compute_fence_value);
+
+    // Buffers in UPLOAD and READBACK heaps stay in their initial state, like on the compute queue.
+    if(src_buf.strategy_ == BufferStrategy::kDefault || src_buf.strategy_ == BufferStrategy::kGpuUpload)
+        copy_queue_->TransitionResource(src_buf.GetD3D12Resource(), D3D12_RESOURCE_STATE_COPY_SOURCE);
+    if(dst_buf.strategy_ == BufferStrategy::kDefault || dst_buf.strategy_ == BufferStrategy::kGpuUpload)
+        copy_queue_->TransitionResource(dst_buf.GetD3D12Resource(), D3D12_RESOURCE_STATE_COPY_DEST);
+
+    command_list->CopyBufferRegion(dst_buf.GetD3D12Resource(), dst_byte_offset,
+        src_buf.GetD3D12Resource(), src_byte_range.first, src_byte_range.count);
+
+    src_buf.last_copy_queue_read_fence_value_ = copy_queue_->GetRecordingFenceValue();
+    dst_buf.last_copy_queue_write_fence_value_ = copy_queue_->GetRecordingFenceValue();
+    ++dst_buf.gpu_write_count_;
+    return kSuccess;
+}
+
+uint64_t DeviceImpl::GetCopyQueueFenceValueToWait(const BufferImpl& buf, bool writes) const
+{
+    JD3D12_ASSERT(copy_queue_);
+    const uint64_t fence_value = writes
+        ? std::max(buf.last_copy_queue_read_fence_value_, buf.last_copy_queue_write_fence_value_)
+        : buf.last_copy_queue_write_fence_value_;
+    return fence_value > copy_queue_->GetCompletedFenceValue() ? fence_value : 0;
+}
+
+Result DeviceImpl::InitResidencyManagement()
+{
+    if(SUCCEEDED(device_->QueryInterface(IID_PPV_ARGS(&device3_))))
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+            IID_PPV_ARGS(&residency_fence_)));
+        SetObjectName(residency_fence_, desc_.name, L"ResidencyFence");
+    }
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(adapter_->QueryInterface(IID_PPV_ARGS(&adapter3_)));
+    budget_change_event_.reset(CreateEvent(NULL, FALSE, FALSE, NULL));
+    JD3D12_LOG_AND_RETURN_IF_FAILED(adapter3_->RegisterVideoMemoryBudgetChangeNotificationEvent(
+        budget_change_event_.get(), &budget_change_cookie_));
+    return kSuccess;
+}
+
+void DeviceImpl::RegisterResidencyManagedBuffer(BufferImpl& buf)
+{
+    std::lock_guard<std::mutex> lock(residency_mutex_);
+    residency_managed_buffers_.insert(&buf);
+    resident_managed_bytes_ += buf.GetSize();
+    residency_check_needed_ = true;
+    buf.is_residency_managed_ = true;
+}
 
-        JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+void DeviceImpl::UnregisterResidencyManagedBuffer(BufferImpl& buf)
+{
+    std::lock_guard<std::mutex> lock(residency_mutex_);
+    residency_managed_buffers_.erase(&buf);
+    if(buf.is_evicted_)
+        evicted_managed_bytes_ -= buf.GetSize();
+    else
+        resident_managed_bytes_ -= buf.GetSize();
+}
+
+Result DeviceImpl::UpdateResidency(CommandBatch& batch)
+{
+    std::lock_guard<std::mutex> lock(residency_mutex_);
 
-        const uint32_t param_count = uint32_t(src_data.size / 4);
-        StackOrHeapVector<D3D12_WRITEBUFFERIMMEDIATE_PARAMETER, 8> params{param_count};
+    // Every buffer used by the batch has its fence value, so none of them can be evicted below.
+    StackOrHeapVector<ID3D12Pageable*, 16> pageables;
+    size_t make_resident_bytes = 0;
+    const auto collect_evicted_buffers = [&](const ResourceUsageMap& usage_map)
+    {
+        for(const auto& [buf, usage] : usage_map.map_)
         {
-            const uint32_t* src_data_u32 = reinterpret_cast<const uint32_t*>(src_data.data);
-            D3D12_GPU_VIRTUAL_ADDRESS dst_gpu_address = dst_buf.GetD3D12Resource()->GetGPUVirtualAddress();
-            for(uint32_t param_index = 0; param_index < param_count
-                ; ++param_index, ++src_data_u32, dst_gpu_address += sizeof(uint32_t))
+            if(buf->is_evicted_)
             {
-                params[param_index] = D3D12_WRITEBUFFERIMMEDIATE_PARAMETER{ dst_gpu_address, *src_data_u32 };
+                buf->is_evicted_ = false;
+                pageables.PushBack(buf->GetD3D12Resource());
+                make_resident_bytes += buf->GetSize();
             }
-            command_list_->WriteBufferImmediate(param_count, params.GetData(), nullptr);
         }
+    };
+    collect_evicted_buffers(batch.resource_usage_map);
+    for(RecordingImpl* recording : batch.recordings)
+        collect_evicted_buffers(recording->batch_.resource_usage_map);
+
+    // With the custom budget, the check is cheap, so it is done every time.
+    const bool budget_changed = WaitForSingleObject(budget_change_event_.get(), 0) == WAIT_OBJECT_0;
+    if(desc_.residency_budget > 0 || budget_changed || residency_check_needed_ || make_resident_bytes > 0)
+    {
+        residency_check_needed_ = false;
+        uint64_t budget = desc_.residency_budget;
+        uint64_t usage = resident_managed_bytes_;
+        if(budget == 0)
+        {
+            DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+            JD3D12_LOG_AND_RETURN_IF_FAILED(adapter3_->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL,
+                &info));
+            budget = info.Budget;
+            usage = info.CurrentUsage;
+        }
+        usage += make_resident_bytes;
+        if(usage > budget)
+        {
+            const uint64_t target_usage = uint64_t(double(budget) * kResidencyTargetFraction);
+            JD3D12_RETURN_IF_FAILED(EvictLeastRecentlyUsedBuffers(size_t(usage - target_usage)));
+        }
+    }
+
+    if(pageables.IsEmpty())
         return kSuccess;
+
+    if(device3_)
+    {
+        ++residency_fence_value_;
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device3_->EnqueueMakeResident(D3D12_RESIDENCY_FLAG_NONE,
+            uint32_t(pageables.GetCount()), pageables.GetData(), residency_fence_, residency_fence_value_));
+        JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Wait(residency_fence_, residency_fence_value_));
     }
     else
     {
-        JD3D12_ASSERT(0);
-        return kErrorUnexpected;
+        JD3D12_LOG_AND_RETURN_IF_FAILED(device_->MakeResident(uint32_t(pageables.GetCount()),
+            pageables.GetData()));
     }
+    resident_managed_bytes_ += make_resident_bytes;
+    evicted_managed_bytes_ -= make_resident_bytes;
+    statistics_.buffer_make_resident_count += pageables.GetCount();
+    JD3D12_LOG(kLogSeverityInfo, L"Made %zu buffers resident again (%zu B)", pageables.GetCount(),
+        make_resident_bytes);
+    return kSuccess;
 }
 
-Result DeviceImpl::SubmitPendingCommands()
+Result DeviceImpl::EvictLeastRecentlyUsedBuffers(size_t size)
 {
-    if(command_list_state_ == CommandListState::kRecording)
-        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    const uint64_t completed_fence_value = fence_->GetCompletedValue();
+    const uint64_t copy_queue_completed_fence_value = copy_queue_ ? copy_queue_->GetCompletedFenceValue() : 0;
+
+    // Buffers used by the current batch have a fence value that is not completed yet.
+    std::vector<BufferImpl*> candidates;
+    for(BufferImpl* const buf : residency_managed_buffers_)
+    {
+        if(buf->is_evicted_
+            || std::max(buf->last_read_fence_value_, buf->last_write_fence_value_) > completed_fence_value)
+            continue;
+        if(copy_queue_ && std::max(buf->last_copy_queue_read_fence_value_,
+            buf->last_copy_queue_write_fence_value_) > copy_queue_completed_fence_value)
+            continue;
+        candidates.push_back(buf);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const BufferImpl* lhs, const BufferImpl* rhs)
+        {
+            return std::max(lhs->last_read_fence_value_, lhs->last_write_fence_value_)
+                < std::max(rhs->last_read_fence_value_, rhs->last_write_fence_value_);
+        });
+
+    StackOrHeapVector<ID3D12Pageable*, 16> pageables;
+    size_t evicted_bytes = 0;
+    for(size_t i = 0; i < candidates.size() && evicted_bytes < size; ++i)
+    {
+        pageables.PushBack(candidates[i]->GetD3D12Resource());
+        evicted_bytes += candidates[i]->GetSize();
+    }
+    if(pageables.IsEmpty())
+        return kSuccess;
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->Evict(uint32_t(pageables.GetCount()), pageables.GetData()));
+    for(size_t i = 0; i < pageables.GetCount(); ++i)
+        candidates[i]->is_evicted_ = true;
+    resident_managed_bytes_ -= evicted_bytes;
+    evicted_managed_bytes_ += evicted_bytes;
+    statistics_.buffer_eviction_count += pageables.GetCount();
+    JD3D12_LOG(kLogSeverityInfo, L"Evicted %zu buffers (%zu B) to stay within the residency budget",
+        pageables.GetCount(), evicted_bytes);
     return kSuccess;
 }
 
-Result DeviceImpl::WaitForGPU(uint32_t timeout_milliseconds)
+// Synchronization scope and access of a buffer in given legacy state, for enhanced barriers.
+static void GetBarrierSyncAndAccess(D3D12_RESOURCE_STATES state,
+    D3D12_BARRIER_SYNC& out_sync, D3D12_BARRIER_ACCESS& out_access)
 {
-    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kNone, timeout_milliseconds));
-    return kSuccess;
+    switch(state)
+    {
+    case D3D12_RESOURCE_STATE_COPY_SOURCE:
+        out_sync = D3D12_BARRIER_SYNC_COPY;
+        out_access = D3D12_BARRIER_ACCESS_COPY_SOURCE;
+        break;
+    case D3D12_RESOURCE_STATE_COPY_DEST:
+        out_sync = D3D12_BARRIER_SYNC_COPY;
+        out_access = D3D12_BARRIER_ACCESS_COPY_DEST;
+        break;
+    case D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE:
+        out_sync = D3D12_BARRIER_SYNC_COMPUTE_SHADING;
+        out_access = D3D12_BARRIER_ACCESS_SHADER_RESOURCE;
+        break;
+    case D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER:
+        out_sync = D3D12_BARRIER_SYNC_COMPUTE_SHADING;
+        out_access = D3D12_BARRIER_ACCESS_CONSTANT_BUFFER;
+        break;
+    case D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT:
+        out_sync = D3D12_BARRIER_SYNC_EXECUTE_INDIRECT;
+        out_access = D3D12_BARRIER_ACCESS_INDIRECT_ARGUMENT;
+        break;
+    case D3D12_RESOURCE_STATE_COMMON:
+        // Transition at the end of a recording, before any command of the next command list.
+        out_sync = D3D12_BARRIER_SYNC_ALL;
+        out_access = D3D12_BARRIER_ACCESS_COMMON;
+        break;
+    case D3D12_RESOURCE_STATE_UNORDERED_ACCESS:
+        // Both dispatches and ClearBufferTo*Values access buffers in this state.
+        out_sync = D3D12_BARRIER_SYNC_COMPUTE_SHADING | D3D12_BARRIER_SYNC_CLEAR_UNORDERED_ACCESS_VIEW;
+        out_access = D3D12_BARRIER_ACCESS_UNORDERED_ACCESS;
+        break;
+    default:
+        JD3D12_ASSERT(0);
+        out_sync = D3D12_BARRIER_SYNC_ALL;
+        out_access = D3D12_BARRIER_ACCESS_COMMON;
+    }
 }
 
-Result DeviceImpl::CopyBuffer(BufferImpl& src_buf, BufferImpl& dst_buf)
+void DeviceImpl::FlushBarriers()
 {
-    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"src_buf does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"dst_buf does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((src_buf.desc_.flags & kBufferUsageFlagCopySrc) != 0,
-        L"src_buf was not created with kBufferUsageFlagCopySource.");
-    JD3D12_ASSERT_OR_RETURN((dst_buf.desc_.flags & kBufferUsageFlagCopyDst) != 0,
-        L"dst_buf was not created with kBufferUsageFlagCopyDest.");
-    JD3D12_ASSERT_OR_RETURN(src_buf.GetSize() == dst_buf.GetSize(),
-        L"Source and destination buffers must have the same size.");
-
-    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    JD3D12_ASSERT(GetOpenRecording() != nullptr || command_list_state_ == CommandListState::kRecording);
+    std::vector<PendingBarrier>& pending_barriers = GetPendingBarriers();
+    if(pending_barriers.empty())
+        return;
 
-    JD3D12_RETURN_IF_FAILED(UseBuffer(src_buf, D3D12_RESOURCE_STATE_COPY_SOURCE));
-    JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+    CommandStatistics& stats = GetCurrentBatch().statistics;
+    for(const PendingBarrier& pending_barrier : pending_barriers)
+    {
+        if(pending_barrier.state_before == pending_barrier.state_after)
+            ++stats.uav_barrier_count;
+        else
+            ++stats.transition_barrier_count;
+    }
 
-    command_list_->CopyResource(dst_buf.GetD3D12Resource(), src_buf.GetD3D12Resource());
+    if(enhanced_barriers_)
+    {
+        StackOrHeapVector<D3D12_BUFFER_BARRIER, 16> barriers;
+        for(const PendingBarrier& pending_barrier : pending_barriers)
+        {
+            D3D12_BUFFER_BARRIER barrier = {};
+            GetBarrierSyncAndAccess(pending_barrier.state_before, barrier.SyncBefore, barrier.AccessBefore);
+            GetBarrierSyncAndAccess(pending_barrier.state_after, barrier.SyncAfter, barrier.AccessAfter);
+            barrier.pResource = pending_barrier.resource;
+            barrier.Offset = 0;
+            barrier.Size = UINT64_MAX;
+            barriers.PushBack(barrier);
+        }
+        D3D12_BARRIER_GROUP group = {};
+        group.Type = D3D12_BARRIER_TYPE_BUFFER;
+        group.NumBarriers = uint32_t(barriers.GetCount());
+        group.pBufferBarriers = barriers.GetData();
+        GetCurrentBatch().command_list7->Barrier(1, &group);
+    }
+    else
+    {
+        StackOrHeapVector<D3D12_RESOURCE_BARRIER, 16> barriers;
+        for(const PendingBarrier& pending_barrier : pending_barriers)
+        {
+            D3D12_RESOURCE_BARRIER barrier = {};
+            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            if(pending_barrier.state_before == pending_barrier.state_after)
+            {
+                JD3D12_ASSERT(pending_barrier.state_after == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                barrier.UAV.pResource = pending_barrier.resource;
+            }
+            else
+            {
+                barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+                barrier.Transition.pResource = pending_barrier.resource;
+                barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+                barrier.Transition.StateBefore = pending_barrier.state_before;
+                barrier.Transition.StateAfter = pending_barrier.state_after;
+            }
+            barriers.PushBack(barrier);
+        }
+        GetCommandList()->ResourceBarrier(uint32_t(barriers.GetCount()), barriers.GetData());
+    }
 
-    return kSuccess;
+    pending_barriers.clear();
 }
 
-Result DeviceImpl::CopyBufferRegion(BufferImpl& src_buf, Range src_byte_range, BufferImpl& dst_buf, size_t dst_byte_offset)
+void DeviceImpl::RecordAliasingBarrier(ID3D12Resource* resource_before, ID3D12Resource* resource_after)
 {
-    JD3D12_ASSERT_OR_RETURN(src_buf.GetDevice() == this, L"src_buf does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN(dst_buf.GetDevice() == this, L"dst_buf does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((src_buf.desc_.flags & kBufferUsageFlagCopySrc) != 0,
-        L"src_buf was not created with kBufferUsageFlagCopySource.");
-    JD3D12_ASSERT_OR_RETURN((dst_buf.desc_.flags & kBufferUsageFlagCopyDst) != 0,
-        L"dst_buf was not created with kBufferUsageFlagCopyDest.");
-    src_byte_range = LimitRange(src_byte_range, src_buf.GetSize());
-    JD3D12_ASSERT_OR_RETURN(src_byte_range.count >= 0 && src_byte_range.count % 4 == 0, L"Size must be non-zero and a multiple of 4.");
-    JD3D12_ASSERT_OR_RETURN(src_byte_range.first + src_byte_range.count <= src_buf.GetSize(), L"Source buffer overflow.");
-    JD3D12_ASSERT_OR_RETURN(dst_byte_offset + src_byte_range.count <= dst_buf.GetSize(), L"Destination buffer overflow.");
+    FlushBarriers();
 
-    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    // Legacy barriers can be mixed with enhanced barriers. A placed buffer needs no discard after aliasing.
+    D3D12_RESOURCE_BARRIER barrier = {};
+    barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    barrier.Aliasing.pResourceBefore = resource_before;
+    barrier.Aliasing.pResourceAfter = resource_after;
+    GetCommandList()->ResourceBarrier(1, &barrier);
+    ++GetCurrentBatch().statistics.aliasing_barrier_count;
+}
 
-    JD3D12_RETURN_IF_FAILED(UseBuffer(src_buf, D3D12_RESOURCE_STATE_COPY_SOURCE));
-    JD3D12_RETURN_IF_FAILED(UseBuffer(dst_buf, D3D12_RESOURCE_STATE_COPY_DEST));
+Result DeviceImpl::EnsureDescriptorSpace(uint32_t shader_visible_count, uint32_t shader_invisible_count)
+{
+    JD3D12_ASSERT(GetOpenRecording() != nullptr || command_list_state_ == CommandListState::kRecording);
+    JD3D12_ASSERT(shader_visible_count <= shader_visible_descriptor_heap_.GetPartitionSize()
+        && shader_invisible_count <= shader_invisible_descriptor_heap_.GetPartitionSize());
 
-    command_list_->CopyBufferRegion(dst_buf.GetD3D12Resource(), dst_byte_offset,
-        src_buf.GetD3D12Resource(), src_byte_range.first, src_byte_range.count);
+    // A recording uses persistent descriptors, allocated by GetOrCreateBufferView.
+    if(GetOpenRecording())
+        return kSuccess;
+
+    if(shader_visible_descriptor_heap_.GetFreeDynamicCount(current_batch_index_) >= shader_visible_count
+        && shader_invisible_descriptor_heap_.GetFreeDynamicCount(current_batch_index_) >= shader_invisible_count)
+        return kSuccess;
 
+    JD3D12_LOG(kLogSeverityDebug, L"Descriptor heap partition exhausted, splitting the command batch.");
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kExecuting));
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
     return kSuccess;
 }
 
-Result DeviceImpl::ClearBufferToUintValues(BufferImpl& buf, const UintVec4& values, Range element_range)
+Result DeviceImpl::GetOrCreateBufferView(ViewType type, BufferImpl& buf, Range byte_range,
+    uint32_t& out_descriptor_index)
 {
-    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
-        L"ClearBufferToUintValues: Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
-        L"ClearBufferToUintValues: Buffer was not created with kBufferUsageFlagShaderRWResource.");
-    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & (kBufferFlagTyped | kBufferFlagByteAddress)) != 0,
-        L"ClearBufferToUintValues: Buffer was not created with kBufferFlagTyped or kBufferFlagByteAddress.");
-
-    if(element_range.count == 0)
-        return kFalse;
+    CommandBatch& batch = GetCurrentBatch();
+    const ViewKey key = { &buf, byte_range, type };
+    const auto it = batch.view_cache.find(key);
+    if(it != batch.view_cache.end())
+    {
+        out_descriptor_index = it->second;
+        return kSuccess;
+    }
 
-    D3D12_GPU_DESCRIPTOR_HANDLE shader_visible_gpu_desc_handle = {};
-    D3D12_CPU_DESCRIPTOR_HANDLE shader_invisible_cpu_desc_handle = {};
-    JD3D12_RETURN_IF_FAILED(BeginClearBufferToValues(buf, element_range,
-        shader_visible_gpu_desc_handle, shader_invisible_cpu_desc_handle));
+    // Descriptors of a recording must stay valid for as long as it can be executed.
+    if(RecordingImpl* const recording = GetOpenRecording())
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocatePersistent(out_descriptor_index));
+        recording->descriptor_indices_.push_back(out_descriptor_index);
+    }
+    else
+    {
+        JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(
+            current_batch_index_, out_descriptor_index));
+    }
+    ++batch.statistics.descriptor_count;
+    const D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle =
+        shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(out_descriptor_index);
 
-    command_list_->ClearUnorderedAccessViewUint(
-        shader_visible_gpu_desc_handle, // ViewGPUHandleInCurrentHeap
-        shader_invisible_cpu_desc_handle, // ViewCPUHandle
-        buf.GetD3D12Resource(), // pResource
-        &values.x, // Values
-        0, // NumRects
-        nullptr); // pRects
+    switch(type)
+    {
+    case ViewType::kCBV:
+    {
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+        cbv_desc.BufferLocation = buf.GetD3D12Resource()->GetGPUVirtualAddress() + byte_range.first;
+        JD3D12_ASSERT(byte_range.count <= UINT32_MAX);
+        cbv_desc.SizeInBytes = uint32_t(byte_range.count);
+        device_->CreateConstantBufferView(&cbv_desc, cpu_handle);
+        break;
+    }
+    case ViewType::kSRV:
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc;
+        buf.FillSrvDesc(byte_range, srv_desc);
+        device_->CreateShaderResourceView(buf.GetD3D12Resource(), &srv_desc, cpu_handle);
+        break;
+    }
+    case ViewType::kUAV:
+    {
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc;
+        buf.FillUavDesc(byte_range, uav_desc);
+        device_->CreateUnorderedAccessView(buf.GetD3D12Resource(), nullptr, &uav_desc, cpu_handle);
+        break;
+    }
+    case ViewType::kRawSRV:
+    {
+        D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+        srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+        srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srv_desc.Buffer.FirstElement = byte_range.first / 4;
+        srv_desc.Buffer.NumElements = uint32_t(byte_range.count / 4);
+        srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+        device_->CreateShaderResourceView(buf.GetD3D12Resource(), &srv_desc, cpu_handle);
+        break;
+    }
+    case ViewType::kRawUAV:
+    {
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+        uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+        uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+        uav_desc.Buffer.FirstElement = byte_range.first / 4;
+        uav_desc.Buffer.NumElements = uint32_t(byte_range.count / 4);
+        uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+        device_->CreateUnorderedAccessView(buf.GetD3D12Resource(), nullptr, &uav_desc, cpu_handle);
+        break;
+    }
+    default:
+        JD3D12_ASSERT(0);
+    }
 
+    batch.view_cache.emplace(key, out_descriptor_index);
     return kSuccess;
 }
 
-Result DeviceImpl::ClearBufferToFloatValues(BufferImpl& buf, const FloatVec4& values, Range element_range)
+Result DeviceImpl::UploadConstantData()
 {
-    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this,
-        L"ClearBufferToFloatValues: Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
-        L"ClearBufferToFloatValues: Buffer was not created with kBufferUsageFlagShaderRWResource.");
-    JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferFlagTyped) != 0,
-        L"ClearBufferToFloatValues: Buffer was not created with kBufferFlagTyped.");
-
-    if(element_range.count == 0)
-        return kFalse;
-
-    D3D12_GPU_DESCRIPTOR_HANDLE shader_visible_gpu_desc_handle = {};
-    D3D12_CPU_DESCRIPTOR_HANDLE shader_invisible_cpu_desc_handle = {};
-    JD3D12_RETURN_IF_FAILED(BeginClearBufferToValues(buf, element_range,
-        shader_visible_gpu_desc_handle, shader_invisible_cpu_desc_handle));
-
-    command_list_->ClearUnorderedAccessViewFloat(
-        shader_visible_gpu_desc_handle, // ViewGPUHandleInCurrentHeap
-        shader_invisible_cpu_desc_handle, // ViewCPUHandle
-        buf.GetD3D12Resource(), // pResource
-        &values.x, // Values
-        0, // NumRects
-        nullptr); // pRects
+    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    {
+        Binding& binding = GetBindingState().cbv_bindings_[slot];
+        if(binding.constant_data.empty() || binding.descriptor_index != UINT32_MAX)
+            continue;
+        // The upload ring is reused as soon as the batch completes, so a recording cannot point to it.
+        JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(),
+            L"Data bound with BindConstantData cannot be used between BeginRecording and EndRecording.");
+
+        const size_t cbv_size = AlignUp<size_t>(binding.constant_data.size(),
+            D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+        size_t ring_offset = 0;
+        void* ring_ptr = nullptr;
+        Result res = upload_ring_.Allocate(cbv_size, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT,
+            GetRecordingFenceValue(), ring_offset, ring_ptr);
+        if(res == kNotReady)
+        {
+            // If this submits the current batch, the new one needs all the data uploaded again.
+            JD3D12_RETURN_IF_FAILED(WaitForUploadRingSpace(kTimeoutInfinite));
+            JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+            JD3D12_RETURN_IF_FAILED(EnsureDescriptorSpace(MainRootSignature::kTotalParamCount, 0));
+            slot = UINT32_MAX; // Incremented to 0.
+            continue;
+        }
+        JD3D12_RETURN_IF_FAILED(res);
 
+        memcpy(ring_ptr, binding.constant_data.data(), binding.constant_data.size());
+
+        JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(
+            current_batch_index_, binding.descriptor_index));
+        ++GetCurrentBatch().statistics.descriptor_count;
+        D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+        cbv_desc.BufferLocation = upload_ring_.GetResource()->GetGPUVirtualAddress() + ring_offset;
+        cbv_desc.SizeInBytes = uint32_t(cbv_size);
+        device_->CreateConstantBufferView(&cbv_desc,
+            shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(binding.descriptor_index));
+        binding.root_argument_set = false;
+    }
     return kSuccess;
 }
 
-void DeviceImpl::ResetAllBindings()
+Result DeviceImpl::UpdateRootArguments(bool continuation)
 {
+    JD3D12_ASSERT(GetOpenRecording() != nullptr || command_list_state_ == CommandListState::kRecording);
+
+    BindingState& binding_state = GetBindingState();
+
+    // Root arguments persist on the command list between dispatches, so only the changed ones are set.
+    if(!binding_state.root_signature_set_)
+    {
+        ID3D12DescriptorHeap* const desc_heap = shader_visible_descriptor_heap_.GetDescriptorHeap();
+        GetCommandList()->SetDescriptorHeaps(1, &desc_heap);
+        GetCommandList()->SetComputeRootSignature(main_root_signature_->GetRootSignature());
+        binding_state.root_signature_set_ = true;
+    }
+
     for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
     {
-        binding_state_.cbv_bindings_[slot] = Binding{};
+        Binding& binding = binding_state.cbv_bindings_[slot];
+        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForCBV(slot);
+        if(!binding.constant_data.empty())
+        {
+            // Uploaded by UploadConstantData.
+            JD3D12_ASSERT(binding.descriptor_index != UINT32_MAX);
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
+            }
+        }
+        else if(binding.buffer == nullptr)
+        {
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_cbv_index_));
+            }
+        }
+        else
+        {
+            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
+
+            if(binding.descriptor_index == UINT32_MAX)
+            {
+                JD3D12_RETURN_IF_FAILED(GetOrCreateBufferView(ViewType::kCBV, *binding.buffer,
+                    binding.byte_range, binding.descriptor_index));
+                binding.root_argument_set = false;
+            }
+
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
+            }
+        }
+        binding.root_argument_set = true;
     }
+
     for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
     {
-        binding_state_.srv_bindings_[slot] = Binding{};
+        Binding& binding = binding_state.srv_bindings_[slot];
+        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForSRV(slot);
+        if(binding.buffer == nullptr)
+        {
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_srv_index_));
+            }
+        }
+        else
+        {
+            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+            if(binding.descriptor_index == UINT32_MAX)
+            {
+                JD3D12_RETURN_IF_FAILED(GetOrCreateBufferView(binding.raw_view ? ViewType::kRawSRV : ViewType::kSRV,
+                    *binding.buffer, binding.byte_range, binding.descriptor_index));
+                binding.root_argument_set = false;
+            }
+
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
+            }
+        }
+        binding.root_argument_set = true;
     }
+
     for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
     {
-        binding_state_.uav_bindings_[slot] = Binding{};
-    }
-}
-
-Result DeviceImpl::BindConstantBuffer(uint32_t b_slot, BufferImpl* buf, Range byte_range)
-{
-    JD3D12_ASSERT_OR_RETURN(b_slot < MainRootSignature::kMaxCBVCount, L"CBV slot out of bounds.");
-
-    if(buf != nullptr)
-        byte_range = LimitRange(byte_range, buf->GetSize());
-    else
-        byte_range = kEmptyRange;
+        Binding& binding = binding_state.uav_bindings_[slot];
+        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForUAV(slot);
+        if(binding.buffer == nullptr)
+        {
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_uav_index_));
+            }
+        }
+        else
+        {
+            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+                binding.no_uav_hazard || continuation));
 
-    JD3D12_ASSERT_OR_RETURN(byte_range.first % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0
-        && byte_range.count % D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT == 0,
-        L"Constant buffer offset and size must be a multiple of 256 B.");
+            if(binding.descriptor_index == UINT32_MAX)
+            {
+                JD3D12_RETURN_IF_FAILED(GetOrCreateBufferView(binding.raw_view ? ViewType::kRawUAV : ViewType::kUAV,
+                    *binding.buffer, binding.byte_range, binding.descriptor_index));
+                binding.root_argument_set = false;
+            }
 
-    Binding* binding = &binding_state_.cbv_bindings_[b_slot];
-    if(binding->buffer == buf && binding->byte_range == byte_range)
-        return kFalse;
+            if(!binding.root_argument_set)
+            {
+                GetCommandList()->SetComputeRootDescriptorTable(root_param_index,
+                    shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
+            }
+        }
+        binding.root_argument_set = true;
+    }
 
-    if(buf == nullptr)
+    if(binding_state.root_constants_dirty_)
     {
-        *binding = Binding{};
-        return kSuccess;
+        GetCommandList()->SetComputeRoot32BitConstants(MainRootSignature::kRootConstantsRootParamIndex,
+            Device::kMaxRootConstantCount, binding_state.root_constants_, 0);
+        binding_state.root_constants_dirty_ = false;
     }
 
-    size_t alignment = buf->GetElementSize();
-    if(alignment == 0)
-        alignment = 4;
-
-    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
-        L"Size must be greater than zero and a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderConstant) != 0,
-        L"BindConstantBuffer: Buffer was not created with kBufferUsageFlagShaderConstant.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+    if(!IsBindless() && binding_state.dispatch_params_dirty_)
+    {
+        GetCommandList()->SetComputeRoot32BitConstants(MainRootSignature::kDispatchParamsRootParamIndex,
+            MainRootSignature::kDispatchParamCount, binding_state.dispatch_params_, 0);
+        binding_state.dispatch_params_dirty_ = false;
+    }
 
-    binding->buffer = buf;
-    binding->byte_range = byte_range;
-    binding->descriptor_index = UINT32_MAX;
+    if(IsBindless())
+    {
+        for(uint32_t slot = 0; slot < Device::kMaxBindlessIndexCount; ++slot)
+        {
+            const BindlessBinding& binding = binding_state.bindless_bindings_[slot];
+            if(binding.buffer != nullptr)
+            {
+                JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, binding.writable
+                    ? D3D12_RESOURCE_STATE_UNORDERED_ACCESS
+                    : D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, continuation));
+            }
+        }
+        if(binding_state.bindless_indices_dirty_)
+        {
+            GetCommandList()->SetComputeRoot32BitConstants(MainRootSignature::kBindlessIndicesRootParamIndex,
+                Device::kMaxBindlessIndexCount, binding_state.bindless_indices_, 0);
+            binding_state.bindless_indices_dirty_ = false;
+        }
+    }
 
     return kSuccess;
 }
 
-Result DeviceImpl::BindBuffer(uint32_t t_slot, BufferImpl* buf, Range byte_range)
+Result DeviceImpl::CreateNullDescriptors()
 {
-    JD3D12_ASSERT_OR_RETURN(t_slot < MainRootSignature::kMaxSRVCount, L"SRV slot out of bounds.");
-
-    if(buf != nullptr)
-        byte_range = LimitRange(byte_range, buf->GetSize());
-    else
-        byte_range = kEmptyRange;
-
-    Binding* binding = &binding_state_.srv_bindings_[t_slot];
-    if(binding->buffer == buf && binding->byte_range == byte_range)
-        return kFalse;
-
-    if(buf == nullptr)
-    {
-        *binding = Binding{};
-        return kSuccess;
-    }
-
-    const uint32_t type_bit_count = CountBitsSet(buf->desc_.flags
-        & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress));
-    JD3D12_ASSERT_OR_RETURN(type_bit_count == 1,
-        L"Buffer must be one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
+    D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle;
 
-    size_t alignment = buf->GetElementSize();
-    if(alignment == 0)
-        alignment = 4;
+    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_cbv_index_);
+    D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
+    device_->CreateConstantBufferView(&cbv_desc, cpu_handle);
 
-    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
-        L"Size must be greater than zero and a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderResource) != 0,
-        L"BindBuffer: Buffer was not created with kBufferUsageFlagGpuShaderResource.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_srv_index_);
+    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+    srv_desc.Format = DXGI_FORMAT_R32_UINT;
+    srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    device_->CreateShaderResourceView(nullptr, &srv_desc, cpu_handle);
 
-    binding->buffer = buf;
-    binding->byte_range = byte_range;
-    binding->descriptor_index = UINT32_MAX;
+    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_uav_index_);
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+    uav_desc.Format = DXGI_FORMAT_R32_UINT;
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    device_->CreateUnorderedAccessView(nullptr, nullptr, &uav_desc, cpu_handle);
 
     return kSuccess;
 }
 
-Result DeviceImpl::BindRWBuffer(uint32_t u_slot, BufferImpl* buf, Range byte_range)
+Result DeviceImpl::CreateStaticShaders()
 {
-    JD3D12_ASSERT_OR_RETURN(u_slot < MainRootSignature::kMaxUAVCount, L"UAV slot out of bounds.");
-
-    if(buf != nullptr)
-        byte_range = LimitRange(byte_range, buf->GetSize());
-    else
-        byte_range = kEmptyRange;
+    Singleton& singleton = Singleton::GetInstance();
 
-    Binding* binding = &binding_state_.uav_bindings_[u_slot];
-    if(binding->buffer == buf && binding->byte_range == byte_range)
-        return kFalse;
+    JD3D12_ASSERT_OR_RETURN(singleton.static_shaders_.empty() || singleton.dev_count_ == 1,
+        L"Static shaders can only be used when at most 1 Device is created at a time.");
 
-    if(buf == nullptr)
+    for(StaticShader* static_shader : singleton.static_shaders_)
     {
-        *binding = Binding{};
-        return kSuccess;
+        JD3D12_RETURN_IF_FAILED(static_shader->Init());
     }
+    return kSuccess;
+}
 
-    const uint32_t type_bit_count = CountBitsSet(buf->desc_.flags
-        & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress));
-    JD3D12_ASSERT_OR_RETURN(type_bit_count == 1,
-        L"Buffer must be one of: kBufferFlagTyped, kBufferFlagStructured, kBufferFlagByteAddress.");
-
-    size_t alignment = buf->GetElementSize();
-    if(alignment == 0)
-        alignment = 4;
-    JD3D12_ASSERT_OR_RETURN(byte_range.first % alignment == 0, L"Buffer offset must be a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.count > 0 && byte_range.count % alignment == 0,
-        L"Size must be greater than zero and a multiple of element size.");
-    JD3D12_ASSERT_OR_RETURN(buf->GetDevice() == this, L"Buffer does not belong to this Device.");
-    JD3D12_ASSERT_OR_RETURN((buf->desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
-        L"BindRWBuffer: Buffer was not created with kBufferUsageFlagShaderRWResource.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first < buf->GetSize(), L"Buffer offset out of bounds.");
-    JD3D12_ASSERT_OR_RETURN(byte_range.first + byte_range.count <= buf->GetSize(), L"Buffer region out of bounds.");
+Result DeviceImpl::CreateStaticBuffers()
+{
+    Singleton& singleton = Singleton::GetInstance();
 
-    binding->buffer = buf;
-    binding->byte_range = byte_range;
-    binding->descriptor_index = UINT32_MAX;
+    JD3D12_ASSERT_OR_RETURN(singleton.static_buffers_.empty() || singleton.dev_count_ == 1,
+        L"Static buffers can only be used when at most 1 Device is created at a time.");
 
+    for(StaticBuffer* static_buffer: singleton.static_buffers_)
+    {
+        JD3D12_RETURN_IF_FAILED(static_buffer->Init());
+    }
     return kSuccess;
 }
 
-Result DeviceImpl::Init(bool enable_d3d12_debug_layer)
+void DeviceImpl::DestroyStaticShaders()
 {
-    DXGI_ADAPTER_DESC adapter_desc = {};
+    Singleton& singleton = Singleton::GetInstance();
+    for(size_t i = singleton.static_shaders_.size(); i--; )
     {
-        env_->GetDXGIAdapter1()->GetDesc(&adapter_desc);
-        // Ignoring the result.
+        StaticShader* const static_shader = singleton.static_shaders_[i];
+        delete static_shader->shader_;
+        static_shader->shader_ = nullptr;
     }
+}
 
-    JD3D12_LOG(kLogSeverityInfo, L"Creating Device 0x%016" PRIXPTR " \"%s\": flags=0x%X for GPU \"%s\"",
-        uintptr_t(GetInterface()),
-        EnsureNonNullString(desc_.name), desc_.flags, adapter_desc.Description);
-
-    JD3D12_LOG_AND_RETURN_IF_FAILED(env_->GetD3D12DeviceFactory()->CreateDevice(env_->GetDXGIAdapter1(),
-        D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device_)));
-
-    if(enable_d3d12_debug_layer)
+void DeviceImpl::DestroyStaticBuffers()
+{
+    Singleton& singleton = Singleton::GetInstance();
+    for(size_t i = singleton.static_buffers_.size(); i--; )
     {
-        JD3D12_RETURN_IF_FAILED(EnableDebugLayer());
+        StaticBuffer* const static_buffer = singleton.static_buffers_[i];
+        delete static_buffer->buffer_;
+        static_buffer->buffer_ = nullptr;
     }
+}
 
-    HRESULT hr = device_->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS16, &options16_, sizeof(options16_));
-    if(FAILED(hr))
-        options16_ = {};
+Result DeviceImpl::BeginClearBufferToValues(BufferImpl& buf, Range element_range,
+    D3D12_GPU_DESCRIPTOR_HANDLE& out_shader_visible_gpu_desc_handle,
+    D3D12_CPU_DESCRIPTOR_HANDLE& out_shader_invisible_cpu_desc_handle)
+{
+    out_shader_visible_gpu_desc_handle = {};
+    out_shader_invisible_cpu_desc_handle = {};
 
-    if (!IsStringEmpty(desc_.name))
-        device_->SetName(desc_.name);
+    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this, L"buf does not belong to this Device.");
+    // Uses dynamic descriptors of the current batch.
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
 
-    D3D12_COMMAND_QUEUE_DESC cmd_queue_desc{};
-    cmd_queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
-    cmd_queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
-    if((desc_.flags & kDeviceFlagDisableGpuTimeout) != 0)
-        cmd_queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_DISABLE_GPU_TIMEOUT;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandQueue(&cmd_queue_desc, IID_PPV_ARGS(&command_queue_)));
-    SetObjectName(command_queue_, desc_.name, L"CommandQueue");
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    JD3D12_RETURN_IF_FAILED(EnsureDescriptorSpace(1, 1));
+    JD3D12_RETURN_IF_FAILED(EnsureProfilingSpace());
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE,
-        IID_PPV_ARGS(&command_allocator_)));
-    SetObjectName(command_allocator_, desc_.name, L"CommandAllocator");
+    // Once the root signature is set, the same heap is already set, so root arguments stay valid.
+    if(!GetBindingState().root_signature_set_)
+    {
+        ID3D12DescriptorHeap* const desc_heap = shader_visible_descriptor_heap_.GetDescriptorHeap();
+        GetCommandList()->SetDescriptorHeaps(1, &desc_heap);
+    }
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
-        command_allocator_, nullptr, IID_PPV_ARGS(&command_list_)));
-    SetObjectName(command_list_, desc_.name, L"CommandList");
+    JD3D12_RETURN_IF_FAILED(UseBuffer(buf, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence_)));
-    SetObjectName(fence_, desc_.name, L"Fence");
+    uint32_t shader_visible_desc_index = UINT32_MAX;
+    uint32_t shader_invisible_desc_index = UINT32_MAX;
+    JD3D12_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(
+        current_batch_index_, shader_visible_desc_index));
+    JD3D12_RETURN_IF_FAILED(shader_invisible_descriptor_heap_.AllocateDynamic(
+        current_batch_index_, shader_invisible_desc_index));
+    GetCurrentBatch().statistics.descriptor_count += 2;
 
-    HANDLE fence_event_handle = NULL;
-    fence_event_handle = CreateEvent(NULL, FALSE, FALSE, NULL);
-    fence_event_.reset(fence_event_handle);
+    const size_t buf_size = buf.GetSize();
 
-    JD3D12_RETURN_IF_FAILED(main_root_signature_->Init());
+    DXGI_FORMAT dxgi_format;
+    size_t element_size;
+    if((buf.desc_.flags & kBufferFlagTyped) != 0)
+    {
+        const Format element_format = buf.desc_.element_format;
+        dxgi_format = DXGI_FORMAT(element_format);
+        const FormatDesc* format_desc = GetFormatDesc(element_format);
+        JD3D12_ASSERT_OR_RETURN(format_desc != nullptr && format_desc->bits_per_element > 0
+            && format_desc->bits_per_element % 8 == 0,
+            L"Invalid element format of a typed buffer.");
+        element_size = format_desc->bits_per_element / 8;
+    }
+    else
+    {
+        JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferFlagByteAddress) != 0,
+            L"Only typed and byte address buffers are supported.");
+        dxgi_format = DXGI_FORMAT_R32_UINT;
+        element_size = sizeof(uint32_t);
+    }
 
-    JD3D12_RETURN_IF_FAILED(shader_visible_descriptor_heap_.Init(desc_.name));
-    JD3D12_RETURN_IF_FAILED(shader_invisible_descriptor_heap_.Init(desc_.name));
-    JD3D12_RETURN_IF_FAILED(CreateNullDescriptors());
+    element_range = LimitRange(element_range, buf_size / element_size);
+    JD3D12_ASSERT_OR_RETURN(element_range.first * element_size < buf_size
+        && (element_range.first + element_range.count) * element_size <= buf_size,
+        L"Element range out of bounds.");
+    JD3D12_ASSERT_OR_RETURN(element_range.count <= UINT32_MAX, L"Element count exceeds UINT32_MAX.");
 
-    JD3D12_RETURN_IF_FAILED(CreateStaticBuffers());
-    JD3D12_RETURN_IF_FAILED(CreateStaticShaders());
+    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
+    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    uav_desc.Format = dxgi_format;
+    uav_desc.Buffer.FirstElement = element_range.first;
+    uav_desc.Buffer.NumElements = uint32_t(element_range.count);
 
-    desc_.name = nullptr;
-    return kSuccess;
-}
+    out_shader_visible_gpu_desc_handle =
+        shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(shader_visible_desc_index);
+    const D3D12_CPU_DESCRIPTOR_HANDLE shader_visible_cpu_desc_handle =
+        shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(shader_visible_desc_index);
+    out_shader_invisible_cpu_desc_handle =
+        shader_invisible_descriptor_heap_.GetCpuHandleForDescriptor(shader_invisible_desc_index);
 
-Result DeviceImpl::EnableDebugLayer()
-{
-    HRESULT hr = device_->QueryInterface(IID_PPV_ARGS(&info_queue_));
-    // QueryInterface for ID3D12InfoQueue1 or ID3D12InfoQueue fails unless the Debug Layer
-    // is force-enabled externally using "dxcpl" app. I don't know why.
-    if(SUCCEEDED(hr))
-    {
-        info_queue_->RegisterMessageCallback(StaticDebugLayerMessageCallback,
-            D3D12_MESSAGE_CALLBACK_FLAG_NONE, this, &debug_layer_callback_cookie_);
-    }
+    ID3D12Resource* const d3d12_res = buf.GetD3D12Resource();
+    JD3D12_ASSERT(d3d12_res != nullptr);
+    device_->CreateUnorderedAccessView(d3d12_res, nullptr, &uav_desc, shader_visible_cpu_desc_handle);
+    device_->CreateUnorderedAccessView(d3d12_res, nullptr, &uav_desc, out_shader_invisible_cpu_desc_handle);
 
     return kSuccess;
 }
 
-void DeviceImpl::DebugLayerMessageCallback(
-    D3D12_MESSAGE_CATEGORY Category,
-    D3D12_MESSAGE_SEVERITY Severity,
-    D3D12_MESSAGE_ID ID,
-    LPCSTR pDescription)
+DeviceImpl::PrimitiveScope::PrimitiveScope(DeviceImpl& device) : device_{ device }
 {
-    const LogSeverity log_severity = D3d12MessageSeverityToLogSeverity(Severity);
-    GetLogger()->LogF(log_severity, L"%S [%s #%u]", pDescription,
-        GetD3d12MessageCategoryString(Category), uint32_t(ID));
+    // The primitives start with nothing bound, with every root argument set again on the command list.
+    std::swap(device_.binding_state_, user_binding_state_);
+    outer_user_binding_state_ = device_.primitive_user_binding_state_;
+    device_.primitive_user_binding_state_ = &user_binding_state_;
 }
 
-Result DeviceImpl::ExecuteRecordedCommands()
+DeviceImpl::PrimitiveScope::~PrimitiveScope()
 {
-    JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording);
-
-    JD3D12_LOG_AND_RETURN_IF_FAILED(command_list_->Close());
-
-    ID3D12CommandList* command_lists[] = { command_list_ };
-    command_queue_->ExecuteCommandLists(1, command_lists);
-
-    ++submitted_fence_value_;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(command_queue_->Signal(fence_, submitted_fence_value_));
+    device_.primitive_user_binding_state_ = outer_user_binding_state_;
+    std::swap(device_.binding_state_, user_binding_state_);
+    // Root arguments set by the primitives replaced the user's on the command list.
+    device_.binding_state_.ResetDescriptors();
 
-    command_list_state_ = CommandListState::kExecuting;
+    for(Buffer* buf : scratch_buffers_)
+        device_.ReleaseTransientBuffer(buf);
+}
 
+Result DeviceImpl::PrimitiveScope::AcquireScratchBuffer(uint32_t element_count, BufferImpl*& out_buffer)
+{
+    BufferDesc desc = {};
+    desc.name = L"Primitive scratch buffer";
+    desc.flags = kBufferUsageFlagShaderResource | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress;
+    desc.size = size_t(element_count) * 4;
+    Buffer* buf = nullptr;
+    JD3D12_RETURN_IF_FAILED(device_.AcquireTransientBuffer(desc, buf));
+    scratch_buffers_.push_back(buf);
+    out_buffer = buf->GetImpl();
     return kSuccess;
 }
 
-Result DeviceImpl::WaitForCommandExecution(uint32_t timeout_milliseconds)
+Result DeviceImpl::ValidatePrimitiveBuffer(BufferImpl& buf, size_t byte_offset, size_t byte_size, bool writable)
 {
-    JD3D12_ASSERT(command_list_state_ == CommandListState::kExecuting);
-
-    if(fence_->GetCompletedValue() < submitted_fence_value_)
+    JD3D12_ASSERT_OR_RETURN(GetOpenRecording() == nullptr,
+        L"Parallel primitives cannot be used between BeginRecording and EndRecording.");
+    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(buf.GetElementSize() == 4, L"Buffer elements must be 32-bit.");
+    if(writable)
     {
-        JD3D12_LOG_AND_RETURN_IF_FAILED(fence_->SetEventOnCompletion(submitted_fence_value_, fence_event_.get()));
-        const DWORD wait_result = WaitForSingleObject(fence_event_.get(), timeout_milliseconds);
-        switch(wait_result)
-        {
-        case WAIT_OBJECT_0:
-            // Waiting succeeded, event was is signaled (and got automatically reset to unsignaled).
-            break;
-        case WAIT_TIMEOUT:
-            return kNotReady;
-        default: // Most likely WAIT_FAILED.
-            return MakeResultFromLastError();
-        }
+        JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderRWResource) != 0,
+            L"Destination buffer was not created with kBufferUsageFlagShaderRWResource.");
+    }
+    else
+    {
+        JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferUsageFlagShaderResource) != 0,
+            L"Source buffer was not created with kBufferUsageFlagShaderResource.");
     }
+    // Offsets in the shaders are 32-bit.
+    JD3D12_ASSERT_OR_RETURN(buf.GetSize() <= UINT32_MAX, L"Buffers used by primitives cannot exceed 4 GB.");
+    JD3D12_ASSERT_OR_RETURN(byte_offset % 4 == 0, L"Buffer offset must be a multiple of 4.");
+    JD3D12_ASSERT_OR_RETURN(byte_size > 0 && byte_size % 4 == 0, L"Size must be greater than zero and a multiple of 4.");
+    JD3D12_ASSERT_OR_RETURN(byte_offset <= buf.GetSize() && byte_size <= buf.GetSize() - byte_offset,
+        L"Buffer region out of bounds.");
+    return kSuccess;
+}
 
-    command_list_state_ = CommandListState::kNone;
-    resource_usage_map_.map_.clear();
-    shader_usage_set_.clear();
+Result DeviceImpl::GetPrimitiveShader(PrimitiveKernel kernel, PrimitiveDataType type, ReduceOperation op,
+    ShaderImpl*& out_shader)
+{
+    const uint32_t key = uint32_t(kernel) | (uint32_t(type) << 8) | (uint32_t(op) << 16);
+    const auto it = primitive_shaders_.find(key);
+    if(it != primitive_shaders_.end())
+    {
+        out_shader = it->second->GetImpl();
+        return kSuccess;
+    }
 
+    static const wchar_t* const kEntryPoints[] = {
+        L"Reduce", L"Scan", L"RadixCount", L"RadixScatter", L"CompactScatter" };
+    static const wchar_t* const kDigits[] = { L"0", L"1", L"2" };
+    const wchar_t* macro_defines[] = {
+        L"JD3D12_TYPE", kDigits[type],
+        L"JD3D12_OP", kDigits[op],
+        L"JD3D12_WAVE_OPS", nullptr };
+
+    ShaderCompilationParams compilation_params = {};
+    compilation_params.entry_point = kEntryPoints[size_t(kernel)];
+    compilation_params.macro_defines = { macro_defines, primitive_wave_ops_ ? 6u : 4u };
+    ShaderDesc shader_desc = {};
+    shader_desc.name = compilation_params.entry_point;
+
+    Shader* shader = nullptr;
+    JD3D12_RETURN_IF_FAILED(CompileAndCreateShaderFromMemory(compilation_params, shader_desc,
+        ConstDataSpan{ kPrimitiveShadersHlsl, sizeof(kPrimitiveShadersHlsl) - 1 }, shader));
+    primitive_shaders_.emplace(key, std::unique_ptr<Shader>{ shader });
+    out_shader = shader->GetImpl();
     return kSuccess;
 }
 
-Result DeviceImpl::ResetCommandListForRecording()
+Result DeviceImpl::DispatchPrimitive(const PrimitiveDispatch& dispatch, const wchar_t* label)
 {
-    JD3D12_ASSERT(command_list_state_ == CommandListState::kNone);
+    ShaderImpl* shader = nullptr;
+    JD3D12_RETURN_IF_FAILED(GetPrimitiveShader(dispatch.kernel, dispatch.type, dispatch.op, shader));
 
-    binding_state_.ResetDescriptors();
-    shader_invisible_descriptor_heap_.ClearDynamic();
-    shader_visible_descriptor_heap_.ClearDynamic();
+    // Raw views of whole buffers, so consecutive dispatches reuse them.
+    for(uint32_t buffer_index = 0; buffer_index < 5; ++buffer_index)
+    {
+        BufferImpl* const buf = dispatch.buffers[buffer_index].buffer;
+        Binding& binding = buffer_index < 3
+            ? binding_state_.srv_bindings_[buffer_index]
+            : binding_state_.uav_bindings_[buffer_index - 3];
+        if(binding.buffer == buf && (buf != nullptr || binding.root_argument_set))
+            continue;
+        binding = Binding{};
+        if(buf != nullptr)
+        {
+            binding.buffer = buf;
+            binding.byte_range = Range{ 0, buf->GetSize() };
+            binding.raw_view = true;
+        }
+    }
 
-    JD3D12_LOG_AND_RETURN_IF_FAILED(command_allocator_->Reset());
-    JD3D12_LOG_AND_RETURN_IF_FAILED(command_list_->Reset(command_allocator_, nullptr));
+    // Big dispatches are 2D, as a dimension cannot exceed 65535 groups.
+    const UintVec3 group_count = {
+        std::min<uint32_t>(dispatch.group_count, UINT16_MAX),
+        DivideRoundingUp(dispatch.group_count, uint32_t(UINT16_MAX)),
+        1 };
+    const uint32_t constants[Device::kMaxRootConstantCount] = {
+        dispatch.element_count,
+        group_count.x,
+        dispatch.flags,
+        uint32_t(dispatch.buffers[0].byte_offset),
+        uint32_t(dispatch.buffers[1].byte_offset),
+        uint32_t(dispatch.buffers[2].byte_offset),
+        uint32_t(dispatch.buffers[3].byte_offset),
+        uint32_t(dispatch.buffers[4].byte_offset) };
+    memcpy(binding_state_.root_constants_, constants, sizeof(constants));
+    binding_state_.root_constants_dirty_ = true;
+
+    const UintVec3 thread_count = { group_count.x * kPrimitiveGroupSize, group_count.y, 1 };
+    return RecordDispatch(*shader, group_count, UintVec3{}, thread_count, label, false);
+}
+
+Result DeviceImpl::RecordPrimitiveReduce(PrimitiveScope& scope, PrimitiveDataType type, ReduceOperation op,
+    uint32_t flags, PrimitiveBuffer src, uint32_t element_count, PrimitiveBuffer dst)
+{
+    for(;;)
+    {
+        PrimitiveDispatch dispatch;
+        dispatch.kernel = PrimitiveKernel::kReduce;
+        dispatch.type = type;
+        dispatch.op = op;
+        dispatch.element_count = element_count;
+        dispatch.group_count = DivideRoundingUp(element_count, kPrimitiveBlockSize);
+        dispatch.flags = flags;
+        dispatch.buffers[0] = src;
+        if(dispatch.group_count == 1)
+        {
+            dispatch.buffers[3] = dst;
+            return DispatchPrimitive(dispatch, L"Reduce");
+        }
 
-    command_list_state_ = CommandListState::kRecording;
+        // One element per block, reduced again by the next pass.
+        BufferImpl* partials_buf = nullptr;
+        JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(dispatch.group_count, partials_buf));
+        dispatch.buffers[3] = PrimitiveBuffer{ partials_buf, 0 };
+        JD3D12_RETURN_IF_FAILED(DispatchPrimitive(dispatch, L"Reduce"));
 
-    return kSuccess;
+        src = PrimitiveBuffer{ partials_buf, 0 };
+        element_count = dispatch.group_count;
+        // The partials are already 0 or 1.
+        flags &= ~kPrimitiveFlagPredicate;
+    }
 }
 
-Result DeviceImpl::EnsureCommandListState(CommandListState desired_state, uint32_t timeout_milliseconds)
+Result DeviceImpl::RecordPrimitiveScan(PrimitiveScope& scope, PrimitiveDataType type, uint32_t flags,
+    PrimitiveBuffer src, uint32_t element_count, PrimitiveBuffer dst)
 {
-    if(desired_state == command_list_state_)
-        return kSuccess;
-    if(command_list_state_ == CommandListState::kRecording)
-        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
-    if(desired_state == command_list_state_)
-        return kSuccess;
-    if(command_list_state_ == CommandListState::kExecuting)
-        JD3D12_RETURN_IF_FAILED(WaitForCommandExecution(timeout_milliseconds));
-    if(desired_state == command_list_state_)
-        return kSuccess;
-    if(command_list_state_ == CommandListState::kNone)
-        JD3D12_RETURN_IF_FAILED(ResetCommandListForRecording());
-    return kSuccess;
+    PrimitiveDispatch dispatch;
+    dispatch.kernel = PrimitiveKernel::kScan;
+    dispatch.type = type;
+    dispatch.element_count = element_count;
+    dispatch.group_count = DivideRoundingUp(element_count, kPrimitiveBlockSize);
+    dispatch.flags = flags;
+    dispatch.buffers[0] = src;
+    dispatch.buffers[3] = dst;
+
+    /* Reduce-then-scan instead of a single pass with decoupled look-back, which would need the groups to make
+    forward progress in order, which D3D12 doesn't guarantee. The extra pass reads the data once more.
+    */
+    if(dispatch.group_count > 1)
+    {
+        BufferImpl* partials_buf = nullptr;
+        BufferImpl* scanned_partials_buf = nullptr;
+        JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(dispatch.group_count, partials_buf));
+        JD3D12_RETURN_IF_FAILED(scope.AcquireScratchBuffer(dispatch.group_count, scanned_partials_buf));
+
+        PrimitiveDispatch reduce_dispatch;
+        reduce_dispatch.kernel = PrimitiveKernel::kReduce;
+        reduce_dispatch.type = type;
+        reduce_dispatch.element_count = element_count;
+        reduce_dispatch.group_count = dispatch.group_count;
+        reduce_dispatch.flags = flags & kPrimitiveFlagPredicate;
+        reduce_dispatch.buffers[0] = src;
+        reduce_dispatch.buffers[3] = PrimitiveBuffer{ partials_buf, 0 };
+        JD3D12_RETURN_IF_FAILED(DispatchPrimitive(reduce_dispatch, L"Scan"));
+
+        JD3D12_RETURN_IF_FAILED(RecordPrimitiveScan(scope, type, kPrimitiveFlagExclusive,
+            PrimitiveBuffer{ partials_buf, 0 }, dispatch.group_count, PrimitiveBuffer{ scanned_partials_buf, 0 }));
+
+        dispatch.flags |= kPrimitiveFlagHasPartials;
+        dispatch.buffers[1] = PrimitiveBuffer{ scanned_partials_buf, 0 };
+    }
+    return DispatchPrimitive(dispatch, L"Scan");
 }
 
-Result DeviceImpl::WaitForBufferUnused(BufferImpl* buf)
+Result DeviceImpl::DispatchComputeShader(ShaderImpl& shader, const UintVec3& group_count)
 {
-    JD3D12_ASSERT_OR_RETURN(!binding_state_.IsBufferBound(buf), L"Buffer is still bound.");
+    JD3D12_ASSERT_OR_RETURN(shader.GetDevice() == this, L"Shader does not belong to this Device.");
 
-    if(resource_usage_map_.map_.find(buf) != resource_usage_map_.map_.end())
-        return EnsureCommandListState(CommandListState::kNone);
-    return kSuccess;
-}
+    if(group_count.x == 0 || group_count.y == 0 || group_count.z == 0)
+        return kFalse;
 
-Result DeviceImpl::WaitForShaderUnused(ShaderImpl* shader)
-{
-    if(shader_usage_set_.find(shader) != shader_usage_set_.end())
-        return EnsureCommandListState(CommandListState::kNone);
-    return kSuccess;
+    /*
+    This is the most common bug when calling compute shader dispatch!!!
+    While GPUs are able to quickly run millions of threads, the number of groups is
+    limited to maximum 65535 per dimension. If you need more, use any or all of
+    these methods:
+    - Process multiple elements per thread, using a loop in the shader.
+    - Use more threads per group, using numthreads attribute in HLSL, like:
+      [numthreads(256, 1, 1)].
+      A power of two is a good number, like 32 or 64, but it can be up to 1024.
+    - Use 2D or 3D group_count, e.g. UintVec3(1000, 1000, 1) and flatten the index
+      in the shader code, like:
+      uint group_index = GroupID.y * 1000 + GroupID.x;
+    */
+    JD3D12_ASSERT_OR_RETURN(group_count.x <= UINT16_MAX
+        && group_count.y <= UINT16_MAX
+        && group_count.z <= UINT16_MAX, L"Dispatch group count cannot exceed 65535 in any dimension.");
+
+    const UintVec3 group_size = shader.GetThreadGroupSize();
+    const UintVec3 thread_count = {
+        group_count.x * group_size.x, group_count.y * group_size.y, group_count.z * group_size.z };
+    return RecordDispatch(shader, group_count, UintVec3{}, thread_count, L"DispatchComputeShader", false);
 }
 
-Result DeviceImpl::UseBuffer(BufferImpl& buf, D3D12_RESOURCE_STATES state)
+Result DeviceImpl::DispatchThreads(ShaderImpl& shader, const UintVec3& thread_count)
 {
-    JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording);
+    JD3D12_ASSERT_OR_RETURN(shader.GetDevice() == this, L"Shader does not belong to this Device.");
 
-    JD3D12_ASSERT_OR_RETURN(!buf.is_user_mapped_, L"Cannot use a buffer on the GPU while it is mapped.");
+    if(thread_count.x == 0 || thread_count.y == 0 || thread_count.z == 0)
+        return kFalse;
 
-    uint32_t usage_flags = kResourceUsageFlagRead;
-    switch(state)
-    {
-    case D3D12_RESOURCE_STATE_COPY_SOURCE:
-    case D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE:
-    case D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER:
-        break;
-    case D3D12_RESOURCE_STATE_COPY_DEST:
-    case D3D12_RESOURCE_STATE_UNORDERED_ACCESS:
-        usage_flags |= kResourceUsageFlagWrite;
-        break;
-    default:
-        JD3D12_ASSERT(0);
-    }
+    // 64-bit, as rounding up can overflow and the loops below can step past UINT32_MAX.
+    const UintVec3 group_size = shader.GetThreadGroupSize();
+    const uint64_t group_count_x = (uint64_t(thread_count.x) + group_size.x - 1) / group_size.x;
+    const uint64_t group_count_y = (uint64_t(thread_count.y) + group_size.y - 1) / group_size.y;
+    const uint64_t group_count_z = (uint64_t(thread_count.z) + group_size.z - 1) / group_size.z;
 
-    const auto it = resource_usage_map_.map_.find(&buf);
-    // Buffer wasn't used in this command list before.
-    // No barrier issued - rely on automatic state promotion.
-    if(it == resource_usage_map_.map_.end())
+    const bool needs_split = group_count_x > UINT16_MAX || group_count_y > UINT16_MAX || group_count_z > UINT16_MAX;
+    if(needs_split && IsBindless())
     {
-        resource_usage_map_.map_.emplace(&buf, ResourceUsage{usage_flags, state});
-        return kSuccess;
+        JD3D12_LOG(kLogSeverityError,
+            L"DispatchThreads needing more than 65535 groups in a dimension is not supported with kDeviceFlagBindless.");
+        return kErrorUnsupported;
     }
 
-    // Use barriers only in DEAFULT heap type.
-    if(buf.strategy_ == BufferStrategy::kDefault)
+    bool continuation = false;
+    for(uint64_t first_z = 0; first_z < group_count_z; first_z += UINT16_MAX)
     {
-        // Transition the state if necessary.
-        if(state != it->second.last_state)
-        {
-            D3D12_RESOURCE_BARRIER barrier = {};
-            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-            barrier.Transition.pResource = buf.GetD3D12Resource();
-            barrier.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-            barrier.Transition.StateBefore = it->second.last_state;
-            barrier.Transition.StateAfter = state;
-            command_list_->ResourceBarrier(1, &barrier);
-        }
-        // UAV barrier if necessary.
-        else if(state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS &&
-            it->second.last_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+        for(uint64_t first_y = 0; first_y < group_count_y; first_y += UINT16_MAX)
         {
-            D3D12_RESOURCE_BARRIER barrier = {};
-            barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-            barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-            barrier.UAV.pResource = buf.GetD3D12Resource();
-            command_list_->ResourceBarrier(1, &barrier);
+            for(uint64_t first_x = 0; first_x < group_count_x; first_x += UINT16_MAX)
+            {
+                const UintVec3 group_count = {
+                    uint32_t(std::min<uint64_t>(group_count_x - first_x, UINT16_MAX)),
+                    uint32_t(std::min<uint64_t>(group_count_y - first_y, UINT16_MAX)),
+                    uint32_t(std::min<uint64_t>(group_count_z - first_z, UINT16_MAX)) };
+                // Less than thread_count, so it fits in 32 bits.
+                const UintVec3 thread_offset = {
+                    uint32_t(first_x * group_size.x), uint32_t(first_y * group_size.y), uint32_t(first_z * group_size.z) };
+                JD3D12_RETURN_IF_FAILED(RecordDispatch(shader, group_count, thread_offset, thread_count,
+                    L"DispatchThreads", continuation));
+                continuation = true;
+            }
         }
     }
+    return kSuccess;
+}
 
-    it->second.flags |= usage_flags;
-    it->second.last_state = state;
+Result DeviceImpl::DispatchIndirect(ShaderImpl& shader, BufferImpl& args_buf, size_t byte_offset)
+{
+    JD3D12_ASSERT_OR_RETURN(shader.GetDevice() == this, L"Shader does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(args_buf.GetDevice() == this, L"Buffer does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN((args_buf.GetFlags() & kBufferUsageFlagIndirectArgs) != 0,
+        L"Buffer must be created with kBufferUsageFlagIndirectArgs to be used by DispatchIndirect.");
+    JD3D12_ASSERT_OR_RETURN(byte_offset % 4 == 0, L"DispatchIndirect byte_offset must be a multiple of 4.");
+    JD3D12_ASSERT_OR_RETURN(byte_offset <= args_buf.GetSize()
+        && args_buf.GetSize() - byte_offset >= sizeof(D3D12_DISPATCH_ARGUMENTS),
+        L"DispatchIndirect arguments exceed the buffer size.");
+    /* The bindings transition the buffer to a shader state, which the INDIRECT_ARGUMENT state would override
+    before the dispatch, even for read-only ones. Not an assert, so that it can be tested.
+    */
+    if(GetBindingState().IsBufferBound(&args_buf))
+    {
+        JD3D12_LOG(kLogSeverityError, L"DispatchIndirect: Buffer \"%s\" used as args_buf is also bound to the shader.",
+            EnsureNonNullString(args_buf.GetName()));
+        return kErrorInvalidArgument;
+    }
 
-    return kSuccess;
+    // Group count is known only on the GPU, so the shader gets no limit on the thread count.
+    const UintVec3 thread_count = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+    return RecordDispatch(shader, UintVec3{}, UintVec3{}, thread_count, L"DispatchIndirect", false,
+        &args_buf, byte_offset);
 }
 
-Result DeviceImpl::UpdateRootArguments()
+Result DeviceImpl::RecordDispatch(ShaderImpl& shader, const UintVec3& group_count, const UintVec3& thread_offset,
+    const UintVec3& thread_count, const wchar_t* label, bool continuation,
+    BufferImpl* indirect_args_buf, size_t indirect_args_offset)
 {
-    JD3D12_ASSERT(command_list_state_ == CommandListState::kRecording);
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    // Enough for all the slots, so UpdateRootArguments never runs out of descriptors in the middle.
+    JD3D12_RETURN_IF_FAILED(EnsureDescriptorSpace(MainRootSignature::kTotalParamCount, 0));
+    JD3D12_RETURN_IF_FAILED(EnsureProfilingSpace());
+    JD3D12_RETURN_IF_FAILED(UploadConstantData());
 
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxCBVCount; ++slot)
+    GetCommandList()->SetPipelineState(shader.GetD3D12PipelineState());
+    GetCurrentBatch().shader_usage_set.insert(&shader);
+
+    if(!IsBindless())
     {
-        Binding& binding = binding_state_.cbv_bindings_[slot];
-        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForCBV(slot);
-        if(binding.buffer == nullptr)
+        const uint32_t dispatch_params[MainRootSignature::kDispatchParamCount] = {
+            thread_offset.x, thread_offset.y, thread_offset.z, 0,
+            thread_count.x, thread_count.y, thread_count.z, 0 };
+        BindingState& binding_state = GetBindingState();
+        if(memcmp(dispatch_params, binding_state.dispatch_params_, sizeof(dispatch_params)) != 0)
         {
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_cbv_index_));
+            memcpy(binding_state.dispatch_params_, dispatch_params, sizeof(dispatch_params));
+            binding_state.dispatch_params_dirty_ = true;
         }
-        else
-        {
-            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-            if(binding.descriptor_index == UINT32_MAX)
-            {
-                JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(binding.descriptor_index));
-
-                D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
-                cbv_desc.BufferLocation = binding.buffer->GetD3D12Resource()->GetGPUVirtualAddress()
-                    + binding.byte_range.first;
-                const size_t final_size = binding.byte_range.count;
-                JD3D12_ASSERT(final_size <= UINT32_MAX);
-                cbv_desc.SizeInBytes = uint32_t(final_size);
-                device_->CreateConstantBufferView(&cbv_desc,
-                    shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(binding.descriptor_index));
-            }
+    }
 
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
-        }
+    JD3D12_RETURN_IF_FAILED(UpdateRootArguments(continuation));
+    if(indirect_args_buf != nullptr)
+    {
+        JD3D12_RETURN_IF_FAILED(UseBuffer(*indirect_args_buf, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
     }
+    FlushBarriers();
 
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxSRVCount; ++slot)
+    const wchar_t* const shader_name = shader.GetName();
+    if(shader_name != nullptr)
+        BeginCommandListEvent(shader_name);
+    const uint32_t profiled_command_index = BeginProfiledCommand(label, &shader, group_count);
+    if(indirect_args_buf != nullptr)
     {
-        Binding& binding = binding_state_.srv_bindings_[slot];
-        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForSRV(slot);
-        if(binding.buffer == nullptr)
-        {
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_srv_index_));
-        }
-        else
-        {
-            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+        GetCommandList()->ExecuteIndirect(main_root_signature_->GetDispatchCommandSignature(), 1,
+            indirect_args_buf->GetD3D12Resource(), indirect_args_offset, nullptr, 0);
+    }
+    else
+        GetCommandList()->Dispatch(group_count.x, group_count.y, group_count.z);
+    ++GetCurrentBatch().statistics.dispatch_count;
+    EndProfiledCommand(profiled_command_index);
+    if(shader_name != nullptr)
+        EndCommandListEvent();
 
-            if(binding.descriptor_index == UINT32_MAX)
-            {
-                JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(binding.descriptor_index));
+    return kSuccess;
+}
 
-                const uint32_t buffer_type = binding.buffer->desc_.flags
-                    & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress);
-                JD3D12_ASSERT(CountBitsSet(buffer_type) == 1);
+Result DeviceImpl::BeginRecording()
+{
+    JD3D12_ASSERT_OR_RETURN(open_recording_ == nullptr, L"BeginRecording called again on this thread before EndRecording.");
 
-                D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
-                srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-                srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-                switch(buffer_type)
-                {
-                case kBufferFlagTyped:
-                {
-                    const Format element_format = binding.buffer->desc_.element_format;
-                    const DXGI_FORMAT dxgi_format = DXGI_FORMAT(element_format);
-                    const FormatDesc* format_desc = GetFormatDesc(element_format);
-                    JD3D12_ASSERT(format_desc != nullptr && format_desc->bits_per_element > 0
-                        && format_desc->bits_per_element % 8 == 0);
-
-                    const size_t element_size = format_desc->bits_per_element / 8;
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % element_size == 0 && final_size % element_size == 0);
-                    JD3D12_ASSERT(final_size / element_size <= UINT32_MAX);
-
-                    srv_desc.Format = dxgi_format;
-                    srv_desc.Buffer.StructureByteStride = 0;
-                    srv_desc.Buffer.FirstElement = binding.byte_range.first / element_size;
-                    srv_desc.Buffer.NumElements = uint32_t(final_size / element_size);
-                    break;
-                }
-                case kBufferFlagStructured:
-                {
-                    const size_t structure_size = binding.buffer->desc_.structure_size;
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % structure_size == 0 && final_size % structure_size == 0);
-                    JD3D12_ASSERT(structure_size <= UINT32_MAX && final_size / structure_size <= UINT32_MAX);
-
-                    srv_desc.Format = DXGI_FORMAT_UNKNOWN;
-                    srv_desc.Buffer.StructureByteStride = uint32_t(structure_size);
-                    srv_desc.Buffer.FirstElement = binding.byte_range.first / structure_size;
-                    srv_desc.Buffer.NumElements = uint32_t(final_size / structure_size);
-                    break;
-                }
-                case kBufferFlagByteAddress:
-                {
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % 4 == 0 && final_size % 4 == 0);
-                    JD3D12_ASSERT(final_size / 4 <= UINT32_MAX);
-
-                    srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
-                    srv_desc.Buffer.StructureByteStride = 0;
-                    srv_desc.Buffer.FirstElement = binding.byte_range.first / 4;
-                    srv_desc.Buffer.NumElements = uint32_t(final_size / 4);
-                    srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
-                    break;
-                }
-                default:
-                    JD3D12_ASSERT(0);
-                }
-                device_->CreateShaderResourceView(binding.buffer->GetD3D12Resource(), &srv_desc,
-                    shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(binding.descriptor_index));
-            }
+    auto recording = std::unique_ptr<Recording>{new Recording{}};
+    recording->impl_ = new RecordingImpl{ recording.get(), this };
 
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
-        }
-    }
+    JD3D12_LOG(kLogSeverityInfo, L"Creating Recording 0x%016" PRIXPTR, uintptr_t(recording.get()));
 
-    for(uint32_t slot = 0; slot < MainRootSignature::kMaxUAVCount; ++slot)
-    {
-        Binding& binding = binding_state_.uav_bindings_[slot];
-        const uint32_t root_param_index = main_root_signature_->GetRootParamIndexForUAV(slot);
-        if(binding.buffer == nullptr)
-        {
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(null_uav_index_));
-        }
-        else
-        {
-            JD3D12_RETURN_IF_FAILED(UseBuffer(*binding.buffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    JD3D12_RETURN_IF_FAILED(recording->GetImpl()->Init());
 
-            if(binding.descriptor_index == UINT32_MAX)
-            {
-                JD3D12_LOG_AND_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(binding.descriptor_index));
+    // From now on, the commands called on this thread touch only the state of the recording.
+    open_recording_ = recording.release();
+    ++open_recording_count_;
+    return kSuccess;
+}
 
-                const uint32_t buffer_type = binding.buffer->desc_.flags
-                    & (kBufferFlagTyped | kBufferFlagStructured | kBufferFlagByteAddress);
-                JD3D12_ASSERT(CountBitsSet(buffer_type) == 1);
+Result DeviceImpl::EndRecording(Recording*& out_recording)
+{
+    out_recording = nullptr;
 
-                D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
-                uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-                switch(buffer_type)
-                {
-                case kBufferFlagTyped:
-                {
-                    const Format element_format = binding.buffer->desc_.element_format;
-                    const DXGI_FORMAT dxgi_format = DXGI_FORMAT(element_format);
-                    const FormatDesc* format_desc = GetFormatDesc(element_format);
-                    JD3D12_ASSERT(format_desc != nullptr && format_desc->bits_per_element > 0
-                        && format_desc->bits_per_element % 8 == 0);
-
-                    const size_t element_size = format_desc->bits_per_element / 8;
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % element_size == 0 && final_size % element_size == 0);
-                    JD3D12_ASSERT(final_size / element_size <= UINT32_MAX);
-
-                    uav_desc.Format = dxgi_format;
-                    uav_desc.Buffer.FirstElement = binding.byte_range.first / element_size;
-                    uav_desc.Buffer.NumElements = uint32_t(final_size / element_size);
-                    break;
-                }
-                case kBufferFlagStructured:
-                {
-                    const size_t structure_size = binding.buffer->desc_.structure_size;
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % structure_size == 0 && final_size % structure_size == 0);
-                    JD3D12_ASSERT(structure_size <= UINT32_MAX && final_size / structure_size <= UINT32_MAX);
-
-                    uav_desc.Format = DXGI_FORMAT_UNKNOWN;
-                    uav_desc.Buffer.StructureByteStride = uint32_t(structure_size);
-                    uav_desc.Buffer.FirstElement = binding.byte_range.first / structure_size;
-                    uav_desc.Buffer.NumElements = uint32_t(final_size / structure_size);
-                    break;
-                }
-                case kBufferFlagByteAddress:
-                {
-                    const size_t final_size = binding.byte_range.count;
-                    JD3D12_ASSERT(binding.byte_range.first % 4 == 0 && final_size % 4 == 0);
-                    JD3D12_ASSERT(final_size / 4 <= UINT32_MAX);
-
-                    uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
-                    uav_desc.Buffer.StructureByteStride = 0;
-                    uav_desc.Buffer.FirstElement = binding.byte_range.first / 4;
-                    uav_desc.Buffer.NumElements = uint32_t(final_size / 4);
-                    uav_desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
-                    break;
-                }
-                default:
-                    JD3D12_ASSERT(0);
-                }
-                device_->CreateUnorderedAccessView(binding.buffer->GetD3D12Resource(), nullptr, &uav_desc,
-                    shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(binding.descriptor_index));
-            }
+    RecordingImpl* const open_recording = GetOpenRecording();
+    JD3D12_ASSERT_OR_RETURN(open_recording != nullptr, L"EndRecording called without matching BeginRecording.");
 
-            command_list_->SetComputeRootDescriptorTable(root_param_index,
-                shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(binding.descriptor_index));
+    /*
+    All the recordings executed in a batch are submitted with it in one ExecuteCommandLists, and buffers decay
+    to the COMMON state only at the end of it. Every command list expects the buffers in COMMON at the beginning,
+    so the recording transitions them back.
+    */
+    for(const auto& [buf, usage] : open_recording->batch_.resource_usage_map.map_)
+    {
+        if(usage.last_state != D3D12_RESOURCE_STATE_COMMON
+            && (buf->strategy_ == BufferStrategy::kDefault || buf->strategy_ == BufferStrategy::kGpuUpload))
+        {
+            PendingBarrier barrier;
+            barrier.resource = buf->GetD3D12Resource();
+            barrier.state_before = usage.last_state;
+            barrier.state_after = D3D12_RESOURCE_STATE_COMMON;
+            open_recording->pending_barriers_.push_back(barrier);
         }
     }
+    FlushBarriers();
+
+    std::unique_ptr<Recording> recording{ open_recording_ };
+    open_recording_ = nullptr;
+    --open_recording_count_;
+
+    RecordingImpl& recording_impl = *recording->GetImpl();
+    JD3D12_LOG_AND_RETURN_IF_FAILED(recording_impl.batch_.command_list->Close());
+    for(const auto& [buf, usage] : recording_impl.batch_.resource_usage_map.map_)
+        ++buf->recording_ref_count_;
+    for(ShaderImpl* shader : recording_impl.batch_.shader_usage_set)
+        ++shader->recording_ref_count_;
+    recording_impl.ended_ = true;
 
+    out_recording = recording.release();
     return kSuccess;
 }
 
-Result DeviceImpl::CreateNullDescriptors()
+Result DeviceImpl::Execute(RecordingImpl& recording)
 {
-    D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle;
-
-    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_cbv_index_);
-    D3D12_CONSTANT_BUFFER_VIEW_DESC cbv_desc = {};
-    device_->CreateConstantBufferView(&cbv_desc, cpu_handle);
+    JD3D12_ASSERT_OR_RETURN(recording.GetDevice() == this, L"Recording does not belong to this Device.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"Execute cannot be called between BeginRecording and EndRecording.");
 
-    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_srv_index_);
-    D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
-    srv_desc.Format = DXGI_FORMAT_R32_UINT;
-    srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-    srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-    device_->CreateShaderResourceView(nullptr, &srv_desc, cpu_handle);
+    /*
+    Recordings are submitted before the command list of the batch, so the commands recorded in it so far
+    must be submitted first. Every command that has any effect uses a buffer, so a batch with no buffers used
+    can take the recording.
+    */
+    if(command_list_state_ == CommandListState::kRecording && !GetCurrentBatch().resource_usage_map.map_.empty())
+        JD3D12_RETURN_IF_FAILED(ExecuteRecordedCommands());
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
 
-    cpu_handle = shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(null_uav_index_);
-    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
-    uav_desc.Format = DXGI_FORMAT_R32_UINT;
-    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-    device_->CreateUnorderedAccessView(nullptr, nullptr, &uav_desc, cpu_handle);
+    CommandBatch& batch = GetCurrentBatch();
+    const uint64_t fence_value = GetRecordingFenceValue();
+    for(const auto& [buf, usage] : recording.batch_.resource_usage_map.map_)
+    {
+        JD3D12_ASSERT_OR_RETURN(!buf->is_user_mapped_, L"Cannot use a buffer on the GPU while it is mapped.");
+        const bool writes = (usage.flags & kResourceUsageFlagWrite) != 0;
+        if(writes)
+        {
+            buf->last_write_fence_value_ = fence_value;
+            ++buf->gpu_write_count_;
+        }
+        else
+            buf->last_read_fence_value_ = fence_value;
+        if(copy_queue_)
+        {
+            batch.copy_queue_wait_fence_value = std::max(batch.copy_queue_wait_fence_value,
+                GetCopyQueueFenceValueToWait(*buf, writes));
+        }
+    }
+    batch.shader_usage_set.insert(recording.batch_.shader_usage_set.begin(),
+        recording.batch_.shader_usage_set.end());
+    AddCommandStatistics(batch.statistics, recording.batch_.statistics);
+    batch.recordings.push_back(&recording);
+    recording.last_fence_value_ = fence_value;
 
     return kSuccess;
 }
 
-Result DeviceImpl::CreateStaticShaders()
+void DeviceImpl::GetMemoryStatistics(MemoryStatistics& out_stats)
 {
-    Singleton& singleton = Singleton::GetInstance();
-
-    JD3D12_ASSERT_OR_RETURN(singleton.static_shaders_.empty() || singleton.dev_count_ == 1,
-        L"Static shaders can only be used when at most 1 Device is created at a time.");
-
-    for(StaticShader* static_shader : singleton.static_shaders_)
+    out_stats = MemoryStatistics{};
+    size_t free_size = 0;
+    size_t largest_free_size = 0;
+    for(const std::unique_ptr<BufferHeapAllocator>& allocator : buffer_heap_allocators_)
     {
-        JD3D12_RETURN_IF_FAILED(static_shader->Init());
+        if(allocator)
+            allocator->AddStatistics(out_stats, free_size, largest_free_size);
     }
-    return kSuccess;
+    if(free_size > 0)
+        out_stats.fragmentation = 1.f - float(double(largest_free_size) / double(free_size));
 }
 
-Result DeviceImpl::CreateStaticBuffers()
+Result DeviceImpl::GetStatistics(DeviceStatistics& out_stats)
 {
-    Singleton& singleton = Singleton::GetInstance();
+    out_stats = statistics_;
+    out_stats.dynamic_descriptor_capacity = shader_visible_descriptor_heap_.GetPartitionSize();
+    shader_visible_descriptor_heap_.GetPersistentCounts(out_stats.persistent_descriptor_count,
+        out_stats.peak_persistent_descriptor_count);
 
-    JD3D12_ASSERT_OR_RETURN(singleton.static_buffers_.empty() || singleton.dev_count_ == 1,
-        L"Static buffers can only be used when at most 1 Device is created at a time.");
+    CComPtr<IDXGIAdapter3> adapter3;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(adapter_->QueryInterface(IID_PPV_ARGS(&adapter3)));
+    DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+    JD3D12_LOG_AND_RETURN_IF_FAILED(adapter3->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info));
+    out_stats.local_memory_budget = info.Budget;
+    out_stats.local_memory_usage = info.CurrentUsage;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(adapter3->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_NON_LOCAL, &info));
+    out_stats.non_local_memory_budget = info.Budget;
+    out_stats.non_local_memory_usage = info.CurrentUsage;
 
-    for(StaticBuffer* static_buffer: singleton.static_buffers_)
+    if(IsResidencyManagementEnabled())
     {
-        JD3D12_RETURN_IF_FAILED(static_buffer->Init());
+        std::lock_guard<std::mutex> lock(residency_mutex_);
+        out_stats.evicted_buffer_bytes = evicted_managed_bytes_;
     }
     return kSuccess;
 }
 
-void DeviceImpl::DestroyStaticShaders()
+ArraySpan<const ProfiledCommand> DeviceImpl::GetProfiledCommands()
 {
-    Singleton& singleton = Singleton::GetInstance();
-    for(size_t i = singleton.static_shaders_.size(); i--; )
+    RetireCompletedBatches();
+
+    profiled_commands_.clear();
+    profiled_commands_.reserve(completed_profile_records_.size());
+    const double microseconds_per_tick = timestamp_frequency_ > 0 ? 1e6 / double(timestamp_frequency_) : 0.0;
+    for(const ProfileRecord& record : completed_profile_records_)
     {
-        StaticShader* const static_shader = singleton.static_shaders_[i];
-        delete static_shader->shader_;
-        static_shader->shader_ = nullptr;
+        ProfiledCommand command{};
+        command.label = record.label.c_str();
+        command.shader_name = !record.shader_name.empty() ? record.shader_name.c_str() : nullptr;
+        command.group_count = record.group_count;
+        command.gpu_begin_microseconds = double(record.begin_timestamp - base_timestamp_) * microseconds_per_tick;
+        command.gpu_duration_microseconds = record.end_timestamp >= record.begin_timestamp
+            ? double(record.end_timestamp - record.begin_timestamp) * microseconds_per_tick : 0.0;
+        command.depth = record.depth;
+        command.is_region = record.is_region;
+        profiled_commands_.push_back(command);
     }
+    return ArraySpan<const ProfiledCommand>{ profiled_commands_.data(), profiled_commands_.size() };
 }
 
-void DeviceImpl::DestroyStaticBuffers()
+void DeviceImpl::ClearProfiledCommands()
 {
-    Singleton& singleton = Singleton::GetInstance();
-    for(size_t i = singleton.static_buffers_.size(); i--; )
+    RetireCompletedBatches();
+    profiled_commands_.clear();
+    completed_profile_records_.clear();
+}
+
+Result DeviceImpl::SaveProfilingTrace(const wchar_t* file_path)
+{
+    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(file_path), L"file_path cannot be null or empty.");
+
+    auto append_json_string = [](std::string& json, const wchar_t* str)
     {
-        StaticBuffer* const static_buffer = singleton.static_buffers_[i];
-        delete static_buffer->buffer_;
-        static_buffer->buffer_ = nullptr;
+        json += '"';
+        for(const char ch : ConvertWideToUtf8(str))
+        {
+            if(ch == '"' || ch == '\\')
+            {
+                json += '\\';
+                json += ch;
+            }
+            else if(uint8_t(ch) < 0x20)
+                json += ' ';
+            else
+                json += ch;
+        }
+        json += '"';
+    };
+
+    // Chrome trace event format, viewable in chrome://tracing or https://ui.perfetto.dev.
+    const ArraySpan<const ProfiledCommand> commands = GetProfiledCommands();
+    std::string json = "{\"traceEvents\":[\n";
+    for(size_t i = 0; i < commands.count; ++i)
+    {
+        const ProfiledCommand& command = commands.data[i];
+        json += "{\"name\":";
+        append_json_string(json, command.shader_name != nullptr ? command.shader_name : command.label);
+        json += ",\"cat\":";
+        append_json_string(json, command.is_region ? L"Region" : command.label);
+        char buf[256];
+        sprintf_s(buf, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f",
+            command.gpu_begin_microseconds, command.gpu_duration_microseconds);
+        json += buf;
+        if(command.shader_name != nullptr)
+        {
+            sprintf_s(buf, ",\"args\":{\"group_count\":\"%u, %u, %u\"}",
+                command.group_count.x, command.group_count.y, command.group_count.z);
+            json += buf;
+        }
+        json += i + 1 < commands.count ? "},\n" : "}\n";
     }
+    json += "],\"displayTimeUnit\":\"ns\"}\n";
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(SaveFileAtomically(file_path, ConstDataSpan{ json.data(), json.size() }));
+    return kSuccess;
 }
 
-Result DeviceImpl::BeginClearBufferToValues(BufferImpl& buf, Range element_range,
-    D3D12_GPU_DESCRIPTOR_HANDLE& out_shader_visible_gpu_desc_handle,
-    D3D12_CPU_DESCRIPTOR_HANDLE& out_shader_invisible_cpu_desc_handle)
+Result DeviceImpl::CreateProfilingResources(CommandBatch& batch, uint32_t batch_index)
 {
-    out_shader_visible_gpu_desc_handle = {};
-    out_shader_invisible_cpu_desc_handle = {};
+    D3D12_QUERY_HEAP_DESC query_heap_desc = {};
+    query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    query_heap_desc.Count = kMaxProfiledCommandsPerBatch * 2;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateQueryHeap(&query_heap_desc,
+        IID_PPV_ARGS(&batch.timestamp_query_heap)));
+    SetObjectName(batch.timestamp_query_heap, desc_.name,
+        SPrintF(L"Timestamp query heap %u", batch_index).c_str());
 
-    JD3D12_ASSERT_OR_RETURN(buf.GetDevice() == this, L"buf does not belong to this Device.");
+    CD3DX12_RESOURCE_DESC resource_desc = CD3DX12_RESOURCE_DESC::Buffer(query_heap_desc.Count * sizeof(uint64_t));
+    CD3DX12_HEAP_PROPERTIES heap_props = CD3DX12_HEAP_PROPERTIES{D3D12_HEAP_TYPE_READBACK};
+    JD3D12_LOG_AND_RETURN_IF_FAILED(device_->CreateCommittedResource(&heap_props,
+        D3D12_HEAP_FLAG_NONE, &resource_desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+        IID_PPV_ARGS(&batch.timestamp_readback_buffer)));
+    SetObjectName(batch.timestamp_readback_buffer, desc_.name,
+        SPrintF(L"Timestamp readback buffer %u", batch_index).c_str());
 
-    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    batch.profile_records.reserve(kMaxProfiledCommandsPerBatch);
+    return kSuccess;
+}
 
-    ID3D12DescriptorHeap* const desc_heap = shader_visible_descriptor_heap_.GetDescriptorHeap();
-    command_list_->SetDescriptorHeaps(1, &desc_heap);
+Result DeviceImpl::EnsureProfilingSpace()
+{
+    JD3D12_ASSERT(GetOpenRecording() != nullptr || command_list_state_ == CommandListState::kRecording);
 
-    JD3D12_RETURN_IF_FAILED(UseBuffer(buf, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+    if(!IsProfilingEnabled() || GetOpenRecording() || GetCurrentBatch().profile_records.size() < kMaxProfiledCommandsPerBatch)
+        return kSuccess;
 
-    uint32_t shader_visible_desc_index = UINT32_MAX;
-    uint32_t shader_invisible_desc_index = UINT32_MAX;
-    JD3D12_RETURN_IF_FAILED(shader_visible_descriptor_heap_.AllocateDynamic(shader_visible_desc_index));
-    JD3D12_RETURN_IF_FAILED(shader_invisible_descriptor_heap_.AllocateDynamic(shader_invisible_desc_index));
+    JD3D12_LOG(kLogSeverityDebug, L"Timestamp query heap exhausted, splitting the command batch.");
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kExecuting));
+    JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    return kSuccess;
+}
 
-    const size_t buf_size = buf.GetSize();
+uint32_t DeviceImpl::BeginProfiledCommand(const wchar_t* label, ShaderImpl* shader, const UintVec3& group_count,
+    uint32_t region_depth)
+{
+    // Timestamp queries belong to a batch, so commands of a recording are not profiled.
+    if(!IsProfilingEnabled() || GetOpenRecording())
+        return UINT32_MAX;
 
-    DXGI_FORMAT dxgi_format;
-    size_t element_size;
-    if((buf.desc_.flags & kBufferFlagTyped) != 0)
-    {
-        const Format element_format = buf.desc_.element_format;
-        dxgi_format = DXGI_FORMAT(element_format);
-        const FormatDesc* format_desc = GetFormatDesc(element_format);
-        JD3D12_ASSERT_OR_RETURN(format_desc != nullptr && format_desc->bits_per_element > 0
-            && format_desc->bits_per_element % 8 == 0,
-            L"Invalid element format of a typed buffer.");
-        element_size = format_desc->bits_per_element / 8;
-    }
-    else
+    CommandBatch& batch = GetCurrentBatch();
+    JD3D12_ASSERT(batch.profile_records.size() < kMaxProfiledCommandsPerBatch);
+    const uint32_t profiled_command_index = uint32_t(batch.profile_records.size());
+
+    ProfileRecord record;
+    record.label = label;
+    if(shader != nullptr)
     {
-        JD3D12_ASSERT_OR_RETURN((buf.desc_.flags & kBufferFlagByteAddress) != 0,
-            L"Only typed and byte address buffers are supported.");
-        dxgi_format = DXGI_FORMAT_R32_UINT;
-        element_size = sizeof(uint32_t);
+        const wchar_t* const shader_name = shader->GetName();
+        record.shader_name = shader_name != nullptr ? shader_name : L"Unnamed shader";
     }
+    record.group_count = group_count;
+    record.is_region = region_depth != UINT32_MAX;
+    record.depth = record.is_region ? region_depth : uint32_t(regions_.size());
+    batch.profile_records.push_back(std::move(record));
 
-    element_range = LimitRange(element_range, buf_size / element_size);
-    JD3D12_ASSERT_OR_RETURN(element_range.first * element_size < buf_size
-        && (element_range.first + element_range.count) * element_size <= buf_size,
-        L"Element range out of bounds.");
-    JD3D12_ASSERT_OR_RETURN(element_range.count <= UINT32_MAX, L"Element count exceeds UINT32_MAX.");
-
-    D3D12_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
-    uav_desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-    uav_desc.Format = dxgi_format;
-    uav_desc.Buffer.FirstElement = element_range.first;
-    uav_desc.Buffer.NumElements = uint32_t(element_range.count);
-
-    out_shader_visible_gpu_desc_handle =
-        shader_visible_descriptor_heap_.GetGpuHandleForDescriptor(shader_visible_desc_index);
-    const D3D12_CPU_DESCRIPTOR_HANDLE shader_visible_cpu_desc_handle =
-        shader_visible_descriptor_heap_.GetCpuHandleForDescriptor(shader_visible_desc_index);
-    out_shader_invisible_cpu_desc_handle =
-        shader_invisible_descriptor_heap_.GetCpuHandleForDescriptor(shader_invisible_desc_index);
-
-    ID3D12Resource* const d3d12_res = buf.GetD3D12Resource();
-    JD3D12_ASSERT(d3d12_res != nullptr);
-    device_->CreateUnorderedAccessView(d3d12_res, nullptr, &uav_desc, shader_visible_cpu_desc_handle);
-    device_->CreateUnorderedAccessView(d3d12_res, nullptr, &uav_desc, out_shader_invisible_cpu_desc_handle);
-
-    return kSuccess;
+    GetCommandList()->EndQuery(batch.timestamp_query_heap, D3D12_QUERY_TYPE_TIMESTAMP, profiled_command_index * 2);
+    return profiled_command_index;
 }
 
-Result DeviceImpl::DispatchComputeShader(ShaderImpl& shader, const UintVec3& group_count)
+void DeviceImpl::EndProfiledCommand(uint32_t profiled_command_index)
 {
-    JD3D12_ASSERT_OR_RETURN(shader.GetDevice() == this, L"Shader does not belong to this Device.");
-
-    if(group_count.x == 0 || group_count.y == 0 || group_count.z == 0)
-        return kFalse;
+    if(profiled_command_index == UINT32_MAX)
+        return;
+    GetCommandList()->EndQuery(GetCurrentBatch().timestamp_query_heap, D3D12_QUERY_TYPE_TIMESTAMP,
+        profiled_command_index * 2 + 1);
+}
 
-    /*
-    This is the most common bug when calling compute shader dispatch!!!
-    While GPUs are able to quickly run millions of threads, the number of groups is
-    limited to maximum 65535 per dimension. If you need more, use any or all of
-    these methods:
-    - Process multiple elements per thread, using a loop in the shader.
-    - Use more threads per group, using numthreads attribute in HLSL, like:
-      [numthreads(256, 1, 1)].
-      A power of two is a good number, like 32 or 64, but it can be up to 1024.
-    - Use 2D or 3D group_count, e.g. UintVec3(1000, 1000, 1) and flatten the index
-      in the shader code, like:
-      uint group_index = GroupID.y * 1000 + GroupID.x;
-    */
-    JD3D12_ASSERT_OR_RETURN(group_count.x <= UINT16_MAX
-        && group_count.y <= UINT16_MAX
-        && group_count.z <= UINT16_MAX, L"Dispatch group count cannot exceed 65535 in any dimension.");
+Result DeviceImpl::BeginRegion(const wchar_t* name)
+{
+    JD3D12_ASSERT_OR_RETURN(!IsStringEmpty(name), L"Region name cannot be null or empty.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
+    JD3D12_ASSERT_OR_RETURN(regions_.size() < kMaxRegionDepth, L"Too many nested regions.");
 
     JD3D12_RETURN_IF_FAILED(EnsureCommandListState(CommandListState::kRecording));
+    JD3D12_RETURN_IF_FAILED(EnsureProfilingSpace());
 
-    ID3D12DescriptorHeap* const desc_heap = shader_visible_descriptor_heap_.GetDescriptorHeap();
-    command_list_->SetDescriptorHeaps(1, &desc_heap);
+    Region region;
+    region.name = name;
+    regions_.push_back(std::move(region));
 
-    command_list_->SetPipelineState(shader.GetD3D12PipelineState());
+    BeginCommandListEvent(name);
+    regions_.back().profiled_command_index = BeginProfiledCommand(name, nullptr, {}, uint32_t(regions_.size() - 1));
+    return kSuccess;
+}
+
+Result DeviceImpl::EndRegion()
+{
+    JD3D12_ASSERT_OR_RETURN(!regions_.empty(), L"EndRegion called without matching BeginRegion.");
+    JD3D12_ASSERT_OR_RETURN(!GetOpenRecording(), L"This command cannot be used between BeginRecording and EndRecording.");
 
-    command_list_->SetComputeRootSignature(main_root_signature_->GetRootSignature());
+    // If no batch is being recorded, the region was already closed when the last one was submitted.
+    if(command_list_state_ == CommandListState::kRecording)
+    {
+        EndProfiledCommand(regions_.back().profiled_command_index);
+        EndCommandListEvent();
+    }
+    regions_.pop_back();
+    return kSuccess;
+}
 
-    JD3D12_RETURN_IF_FAILED(UpdateRootArguments());
+void DeviceImpl::BeginCommandListEvent(const wchar_t* name)
+{
+    if(!AreCommandMarkersEnabled())
+        return;
+    // Metadata 0 means a UTF-16 string, as understood by PIX without WinPixEventRuntime.
+    GetCommandList()->BeginEvent(0, name, UINT((wcslen(name) + 1) * sizeof(wchar_t)));
+}
 
-    command_list_->Dispatch(group_count.x, group_count.y, group_count.z);
+void DeviceImpl::EndCommandListEvent()
+{
+    if(AreCommandMarkersEnabled())
+        GetCommandList()->EndEvent();
+}
 
-    return kSuccess;
+void DeviceImpl::CollectProfileRecords(CommandBatch& batch)
+{
+    const size_t timestamp_count = batch.profile_records.size() * 2;
+    const D3D12_RANGE read_range = { 0, timestamp_count * sizeof(uint64_t) };
+    void* mapped_ptr = nullptr;
+    if(SUCCEEDED(batch.timestamp_readback_buffer->Map(0, &read_range, &mapped_ptr)))
+    {
+        const uint64_t* const timestamps = (const uint64_t*)mapped_ptr;
+        for(size_t i = 0; i < batch.profile_records.size(); ++i)
+        {
+            ProfileRecord& record = batch.profile_records[i];
+            record.begin_timestamp = timestamps[i * 2];
+            record.end_timestamp = timestamps[i * 2 + 1];
+            base_timestamp_ = std::min(base_timestamp_, record.begin_timestamp);
+            completed_profile_records_.push_back(std::move(record));
+        }
+        const D3D12_RANGE written_range = { 0, 0 };
+        batch.timestamp_readback_buffer->Unmap(0, &written_range);
+    }
+    else
+        JD3D12_LOG(kLogSeverityWarning, L"Failed to map the timestamp readback buffer.");
+    batch.profile_records.clear();
 }
 
 void DeviceImpl::StaticDebugLayerMessageCallback(
@@ -2314,6 +7051,15 @@ IncludeHandlerBase::IncludeHandlerBase(ShaderCompiler* shader_compiler, Characte
 {
 }
 
+void IncludeHandlerBase::RecordIncludedFile(LPCWSTR filename, IDxcBlob* blob)
+{
+    JD3D12_ASSERT(blob != nullptr);
+    ShaderCache::IncludedFile included_file;
+    included_file.path = filename;
+    included_file.content_hash = HashFnv1a64(blob->GetBufferPointer(), blob->GetBufferSize());
+    included_files_.push_back(std::move(included_file));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class DefaultIncludeHandler
 
@@ -2336,6 +7082,7 @@ HRESULT STDMETHODCALLTYPE DefaultIncludeHandler::LoadSource(_In_z_ LPCWSTR pFile
         if(SUCCEEDED(hr))
         {
             JD3D12_ASSERT(blob_encoding != nullptr);
+            RecordIncludedFile(pFilename, blob_encoding);
             *ppIncludeSource = blob_encoding;
         }
         return hr;
@@ -2382,10 +7129,151 @@ HRESULT STDMETHODCALLTYPE CallbackIncludeHandler::LoadSource(_In_z_ LPCWSTR pFil
     JD3D12_RETURN_IF_FAILED(shader_compiler_->GetDxcUtils()->CreateBlob(data_ptr, static_cast<UINT32>(data_size),
         static_cast<UINT32>(character_encoding_), &blob_encoding));
 
+    RecordIncludedFile(pFilename, blob_encoding);
     *ppIncludeSource = blob_encoding;
     return res;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// class ShaderCache
+
+void ShaderCache::Init(const wchar_t* directory)
+{
+    if(IsStringEmpty(directory))
+        return;
+
+    directory_ = directory;
+    std::error_code error_code;
+    std::filesystem::create_directories(directory_, error_code);
+    if(error_code)
+    {
+        JD3D12_LOG(kLogSeverityWarning, L"Cannot create shader cache directory \"%s\". Shader cache disabled.",
+            directory);
+        return;
+    }
+    enabled_ = true;
+}
+
+Logger* ShaderCache::GetLogger() const noexcept
+{
+    return env_.GetLogger();
+}
+
+bool ShaderCache::Find(uint64_t key, Entry& out_entry)
+{
+    JD3D12_ASSERT(enabled_);
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        const auto it = memory_entries_.find(key);
+        if(it != memory_entries_.end())
+        {
+            out_entry = it->second;
+            return true;
+        }
+    }
+
+    if(!LoadFromFile(key, out_entry))
+        return false;
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    memory_entries_[key] = out_entry;
+    return true;
+}
+
+void ShaderCache::Store(uint64_t key, const Entry& entry)
+{
+    JD3D12_ASSERT(enabled_);
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        memory_entries_[key] = entry;
+    }
+    SaveToFile(key, entry);
+}
+
+FileSystemPath ShaderCache::GetFilePath(uint64_t key) const
+{
+    return directory_ / SPrintF(L"%016llX.jd3d12shader", (unsigned long long)key);
+}
+
+bool ShaderCache::LoadFromFile(uint64_t key, Entry& out_entry)
+{
+    const FileSystemPath file_path = GetFilePath(key);
+    char* data_ptr = nullptr;
+    size_t data_size = 0;
+    if(LoadFile(file_path.c_str(), data_ptr, data_size) != kSuccess)
+        return false;
+    std::unique_ptr<char[]> data{data_ptr};
+
+    // Reads from the file data with bounds checking. Returns false once any read goes out of bounds.
+    size_t offset = 0;
+    auto read = [&](void* dst, size_t size) -> bool
+    {
+        if(size > data_size - offset)
+            return false;
+        memcpy(dst, data_ptr + offset, size);
+        offset += size;
+        return true;
+    };
+
+    uint32_t magic = 0, version = 0, included_file_count = 0;
+    uint64_t file_key = 0, bytecode_size = 0;
+    if(!read(&magic, sizeof(magic)) || magic != kFileMagic
+        || !read(&version, sizeof(version)) || version != kFileVersion
+        || !read(&file_key, sizeof(file_key)) || file_key != key
+        || !read(&included_file_count, sizeof(included_file_count)))
+        return false;
+
+    Entry entry;
+    for(uint32_t i = 0; i < included_file_count; ++i)
+    {
+        uint32_t path_length = 0;
+        if(!read(&path_length, sizeof(path_length)) || path_length > (data_size - offset) / sizeof(wchar_t))
+            return false;
+        IncludedFile included_file;
+        included_file.path.resize(path_length);
+        if(!read(included_file.path.data(), path_length * sizeof(wchar_t))
+            || !read(&included_file.content_hash, sizeof(included_file.content_hash)))
+            return false;
+        entry.included_files.push_back(std::move(included_file));
+    }
+
+    if(!read(&bytecode_size, sizeof(bytecode_size)) || bytecode_size == 0 || bytecode_size != data_size - offset)
+        return false;
+    entry.bytecode.assign(data_ptr + offset, data_ptr + data_size);
+
+    out_entry = std::move(entry);
+    return true;
+}
+
+void ShaderCache::SaveToFile(uint64_t key, const Entry& entry)
+{
+    std::vector<char> data;
+    auto write = [&data](const void* src, size_t size)
+    {
+        data.insert(data.end(), (const char*)src, (const char*)src + size);
+    };
+
+    write(&kFileMagic, sizeof(kFileMagic));
+    write(&kFileVersion, sizeof(kFileVersion));
+    write(&key, sizeof(key));
+    const uint32_t included_file_count = uint32_t(entry.included_files.size());
+    write(&included_file_count, sizeof(included_file_count));
+    for(const IncludedFile& included_file : entry.included_files)
+    {
+        const uint32_t path_length = uint32_t(included_file.path.length());
+        write(&path_length, sizeof(path_length));
+        write(included_file.path.data(), path_length * sizeof(wchar_t));
+        write(&included_file.content_hash, sizeof(included_file.content_hash));
+    }
+    const uint64_t bytecode_size = entry.bytecode.size();
+    write(&bytecode_size, sizeof(bytecode_size));
+    write(entry.bytecode.data(), entry.bytecode.size());
+
+    const FileSystemPath file_path = GetFilePath(key);
+    if(Failed(SaveFileAtomically(file_path.c_str(), ConstDataSpan{data.data(), data.size()})))
+        JD3D12_LOG(kLogSeverityWarning, L"Cannot write shader cache file \"%s\".", file_path.c_str());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // class ShaderCompiler
 
@@ -2402,8 +7290,117 @@ Result ShaderCompiler::Init(const EnvironmentDesc& env_desc)
         return kErrorFail;
 
     JD3D12_LOG_AND_RETURN_IF_FAILED(create_instance_proc_(CLSID_DxcUtils, IID_PPV_ARGS(&utils_)));
-    JD3D12_LOG_AND_RETURN_IF_FAILED(create_instance_proc_(CLSID_DxcCompiler, IID_PPV_ARGS(&compiler3_)));
 
+    CComPtr<IDxcCompiler3> compiler3;
+    JD3D12_RETURN_IF_FAILED(AcquireCompiler(compiler3));
+    InitDxcVersionHash(compiler3);
+    ReleaseCompiler(std::move(compiler3));
+
+    return kSuccess;
+}
+
+Result ShaderCompiler::AcquireCompiler(CComPtr<IDxcCompiler3>& out_compiler)
+{
+    {
+        std::lock_guard<std::mutex> lock{compiler_pool_mutex_};
+        if(!free_compilers_.empty())
+        {
+            out_compiler = std::move(free_compilers_.back());
+            free_compilers_.pop_back();
+            return kSuccess;
+        }
+    }
+
+    JD3D12_LOG_AND_RETURN_IF_FAILED(create_instance_proc_(CLSID_DxcCompiler, IID_PPV_ARGS(&out_compiler)));
+    return kSuccess;
+}
+
+void ShaderCompiler::ReleaseCompiler(CComPtr<IDxcCompiler3>&& compiler)
+{
+    JD3D12_ASSERT(compiler != nullptr);
+    std::lock_guard<std::mutex> lock{compiler_pool_mutex_};
+    free_compilers_.push_back(std::move(compiler));
+}
+
+void ShaderCompiler::InitDxcVersionHash(IDxcCompiler3* compiler3)
+{
+    uint64_t hash = kFnv1a64OffsetBasis;
+
+    CComPtr<IDxcVersionInfo> version_info;
+    if(SUCCEEDED(compiler3->QueryInterface(IID_PPV_ARGS(&version_info))))
+    {
+        UINT32 version[2] = {};
+        if(SUCCEEDED(version_info->GetVersion(&version[0], &version[1])))
+            hash = HashFnv1a64(version, sizeof(version), hash);
+    }
+
+    CComPtr<IDxcVersionInfo2> version_info2;
+    if(SUCCEEDED(compiler3->QueryInterface(IID_PPV_ARGS(&version_info2))))
+    {
+        UINT32 commit_count = 0;
+        char* commit_hash = nullptr;
+        if(SUCCEEDED(version_info2->GetCommitInfo(&commit_count, &commit_hash)))
+        {
+            hash = HashFnv1a64(&commit_count, sizeof(commit_count), hash);
+            if(commit_hash != nullptr)
+            {
+                hash = HashFnv1a64(commit_hash, strlen(commit_hash), hash);
+                CoTaskMemFree(commit_hash);
+            }
+        }
+    }
+
+    dxc_version_hash_ = hash;
+}
+
+uint64_t ShaderCompiler::CalculateCacheKey(const ShaderCompilationParams& params, ConstDataSpan hlsl_source,
+    const StackOrHeapVector<const wchar_t*, 16>& arguments) const
+{
+    uint64_t hash = dxc_version_hash_;
+    hash = HashFnv1a64(&params.character_encoding, sizeof(params.character_encoding), hash);
+    // Which include handler is used. Contents of included files are validated separately.
+    const uint32_t include_mode = (params.flags & kShaderCompilationFlagDisableIncludes) != 0 ? 0
+        : params.include_callback != nullptr ? 1 : 2;
+    hash = HashFnv1a64(&include_mode, sizeof(include_mode), hash);
+    // Arguments include the entry point, macro defines, and additional DXC arguments.
+    for(const wchar_t* arg : arguments)
+        hash = HashFnv1a64(arg, (wcslen(arg) + 1) * sizeof(wchar_t), hash);
+    hash = HashFnv1a64(&hlsl_source.size, sizeof(hlsl_source.size), hash);
+    return HashFnv1a64(hlsl_source.data, hlsl_source.size, hash);
+}
+
+bool ShaderCompiler::ValidateIncludedFiles(IncludeHandlerBase* include_handler,
+    const std::vector<ShaderCache::IncludedFile>& included_files)
+{
+    if(included_files.empty())
+        return true;
+    if(include_handler == nullptr)
+        return false;
+
+    for(const ShaderCache::IncludedFile& included_file : included_files)
+    {
+        CComPtr<IDxcBlob> blob;
+        if(FAILED(include_handler->LoadSource(included_file.path.c_str(), &blob)) || blob == nullptr)
+            return false;
+        if(HashFnv1a64(blob->GetBufferPointer(), blob->GetBufferSize()) != included_file.content_hash)
+            return false;
+    }
+    return true;
+}
+
+Result ShaderCompiler::CreateResultFromBytecode(const std::vector<char>& bytecode,
+    ShaderCompilationResult*& out_result)
+{
+    JD3D12_ASSERT(!bytecode.empty() && bytecode.size() <= UINT32_MAX);
+
+    CComPtr<IDxcBlobEncoding> blob_encoding;
+    JD3D12_LOG_AND_RETURN_IF_FAILED(utils_->CreateBlob(bytecode.data(), UINT32(bytecode.size()),
+        DXC_CP_ACP, &blob_encoding));
+
+    auto result = std::unique_ptr<ShaderCompilationResult>{ new ShaderCompilationResult{} };
+    result->impl_ = new ShaderCompilationResultImpl(result.get(), &env_);
+    JD3D12_RETURN_IF_FAILED(result->impl_->InitFromBytecode(CComPtr<IDxcBlob>{blob_encoding.p}));
+    out_result = result.release();
     return kSuccess;
 }
 
@@ -2455,26 +7452,84 @@ Result ShaderCompiler::CompileShaderFromMemory(const ShaderCompilationParams& pa
         }
     }
 
+    ShaderCache& shader_cache = env_.GetShaderCache();
+    uint64_t cache_key = 0;
+    if(shader_cache.IsEnabled())
+    {
+        cache_key = CalculateCacheKey(params, hlsl_source, arg_pointers);
+        ShaderCache::Entry entry;
+        if(shader_cache.Find(cache_key, entry))
+        {
+            // Validate with a separate handler, so the files are not recorded twice.
+            std::unique_ptr<IncludeHandlerBase> validation_include_handler;
+            if(include_handler)
+            {
+                if(params.include_callback != nullptr)
+                {
+                    validation_include_handler = std::make_unique<CallbackIncludeHandler>(this,
+                        params.character_encoding, params.include_callback, params.include_callback_context);
+                }
+                else
+                {
+                    validation_include_handler = std::make_unique<DefaultIncludeHandler>(this,
+                        params.character_encoding);
+                }
+            }
+            if(ValidateIncludedFiles(validation_include_handler.get(), entry.included_files))
+            {
+                JD3D12_LOG(kLogSeverityInfo, L"Shader \"%s\" found in shader cache: key=%016llX",
+                    main_source_file_path, (unsigned long long)cache_key);
+                ++shader_cache_hit_count_;
+                return CreateResultFromBytecode(entry.bytecode, out_result);
+            }
+        }
+    }
+
     // Invoke DXC.
     DxcBuffer source_buf{};
     source_buf.Ptr = hlsl_source.data;
     source_buf.Size = hlsl_source.size;
     source_buf.Encoding = DXC_CP_ACP; // TODO support other encodings.
 
+    CComPtr<IDxcCompiler3> compiler3;
+    JD3D12_RETURN_IF_FAILED(AcquireCompiler(compiler3));
+    ++dxc_compilation_count_;
     CComPtr<IDxcResult> dxc_result;
-    JD3D12_LOG_AND_RETURN_IF_FAILED(compiler3_->Compile(&source_buf,
+    const HRESULT compile_hr = compiler3->Compile(&source_buf,
         arg_pointers.GetData(), UINT32(arg_pointers.GetCount()),
-        include_handler.get(), IID_PPV_ARGS(&dxc_result)));
+        include_handler.get(), IID_PPV_ARGS(&dxc_result));
+    ReleaseCompiler(std::move(compiler3));
+    JD3D12_LOG_AND_RETURN_IF_FAILED(compile_hr);
 
     // Create ShaderCompilationResult.
     auto result = std::unique_ptr<ShaderCompilationResult>{ new ShaderCompilationResult{} };
     result->impl_ = new ShaderCompilationResultImpl(result.get(), &env_);
     JD3D12_RETURN_IF_FAILED(result->impl_->Init(std::move(dxc_result)));
     LogCompilationResult(*result);
+
+    if(shader_cache.IsEnabled() && Succeeded(result->GetResult()))
+    {
+        const ConstDataSpan bytecode = result->GetBytecode();
+        if(bytecode.size > 0)
+        {
+            ShaderCache::Entry entry;
+            if(include_handler)
+                entry.included_files = include_handler->GetIncludedFiles();
+            entry.bytecode.assign((const char*)bytecode.data, (const char*)bytecode.data + bytecode.size);
+            shader_cache.Store(cache_key, entry);
+        }
+    }
+
     out_result = result.release();
     return kSuccess;
 }
 
+void ShaderCompiler::GetStatistics(ShaderCompilationStatistics& out_stats) const noexcept
+{
+    out_stats.dxc_compilation_count = dxc_compilation_count_.load();
+    out_stats.shader_cache_hit_count = shader_cache_hit_count_.load();
+}
+
 Result ShaderCompiler::BuildArguments(const ShaderCompilationParams& params,
     const wchar_t* source_name, std::vector<std::wstring>& out_arguments)
 {
@@ -2599,6 +7654,7 @@ void ShaderCompiler::LogCompilationResult(ShaderCompilationResult& result)
 EnvironmentImpl::EnvironmentImpl(Environment* interface_obj, const EnvironmentDesc& desc)
     : interface_obj_{interface_obj}
     , desc_{desc}
+    , shader_cache_{*this}
     , shader_compiler_{*this}
 {
     Singleton& singleton = Singleton::GetInstance();
@@ -2636,23 +7692,7 @@ Result EnvironmentImpl::Init()
 
     JD3D12_LOG_AND_RETURN_IF_FAILED(CreateDXGIFactory2(create_factory_flags, IID_PPV_ARGS(&dxgi_factory6_)));
 
-    for(UINT adapter_index = 0; ; ++adapter_index)
-    {
-        CComPtr<IDXGIAdapter1> adapter1;
-        HRESULT hr = dxgi_factory6_->EnumAdapterByGpuPreference(adapter_index,
-            DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&adapter1));
-        if(FAILED(hr))
-            break;
-
-        DXGI_ADAPTER_DESC1 adapter_desc = {};
-        JD3D12_LOG_AND_RETURN_IF_FAILED(adapter1->GetDesc1(&adapter_desc));
-
-        selected_adapter_index_ = adapter_index;
-        adapter_ = std::move(adapter1);
-        break;
-    }
-
-    JD3D12_ASSERT_OR_RETURN(selected_adapter_index_ != UINT32_MAX, L"Adapter not found.");
+    JD3D12_RETURN_IF_FAILED(EnumerateAdapters());
 
     JD3D12_LOG_AND_RETURN_IF_FAILED(D3D12GetInterface(CLSID_D3D12SDKConfiguration, IID_PPV_ARGS(&sdk_config1_)));
 
@@ -2662,10 +7702,12 @@ Result EnvironmentImpl::Init()
         IID_PPV_ARGS(&device_factory_)));
 
     JD3D12_RETURN_IF_FAILED(shader_compiler_.Init(desc_));
+    shader_cache_.Init(desc_.shader_cache_directory);
 
     // Clear strings as they can become invalid after this call.
     desc_.d3d12_dll_path = nullptr;
     desc_.dxc_dll_path = nullptr;
+    desc_.shader_cache_directory = nullptr;
 
     return kSuccess;
 }
@@ -2690,6 +7732,110 @@ EnvironmentImpl::~EnvironmentImpl()
     Singleton::GetInstance().env_ = nullptr;
 }
 
+Result EnvironmentImpl::EnumerateAdapters()
+{
+    for(UINT adapter_index = 0; ; ++adapter_index)
+    {
+        CComPtr<IDXGIAdapter1> adapter1;
+        HRESULT hr = dxgi_factory6_->EnumAdapterByGpuPreference(adapter_index,
+            DXGI_GPU_PREFERENCE_HIGH_PERFORMANCE, IID_PPV_ARGS(&adapter1));
+        if(FAILED(hr))
+            break;
+
+        DXGI_ADAPTER_DESC1 adapter_desc = {};
+        JD3D12_LOG_AND_RETURN_IF_FAILED(adapter1->GetDesc1(&adapter_desc));
+
+        Adapter adapter;
+        adapter.adapter = std::move(adapter1);
+        AdapterDesc& desc = adapter.desc;
+        static_assert(_countof(desc.description) == _countof(adapter_desc.Description));
+        memcpy(desc.description, adapter_desc.Description, sizeof(desc.description));
+        desc.vendor_id = adapter_desc.VendorId;
+        desc.device_id = adapter_desc.DeviceId;
+        desc.sub_sys_id = adapter_desc.SubSysId;
+        desc.revision = adapter_desc.Revision;
+        desc.luid = (uint64_t(uint32_t(adapter_desc.AdapterLuid.HighPart)) << 32) | adapter_desc.AdapterLuid.LowPart;
+        desc.dedicated_video_memory = adapter_desc.DedicatedVideoMemory;
+        desc.dedicated_system_memory = adapter_desc.DedicatedSystemMemory;
+        desc.shared_system_memory = adapter_desc.SharedSystemMemory;
+        desc.is_software = (adapter_desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) != 0;
+
+        JD3D12_LOG(kLogSeverityInfo, L"Adapter %u: \"%s\" LUID=0x%016llX, dedicated video memory %zu MB",
+            adapter_index, desc.description, desc.luid, desc.dedicated_video_memory / kMegabyte);
+
+        adapters_.push_back(std::move(adapter));
+    }
+
+    JD3D12_ASSERT_OR_RETURN(!adapters_.empty(), L"Adapter not found.");
+    return kSuccess;
+}
+
+void EnvironmentImpl::QueryAdapterFeatures(Adapter& adapter)
+{
+    adapter.features_queried = true;
+
+    CComPtr<ID3D12Device> device;
+    if(FAILED(device_factory_->CreateDevice(adapter.adapter, D3D_FEATURE_LEVEL_12_1, IID_PPV_ARGS(&device))))
+        return;
+
+    AdapterDesc& desc = adapter.desc;
+    desc.is_supported = true;
+
+    D3D12_FEATURE_DATA_ARCHITECTURE1 architecture = {};
+    if(SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_ARCHITECTURE1, &architecture, sizeof(architecture))))
+    {
+        desc.is_uma = architecture.UMA != FALSE;
+        desc.is_cache_coherent_uma = architecture.CacheCoherentUMA != FALSE;
+    }
+
+    D3D12_FEATURE_DATA_SHADER_MODEL shader_model = { D3D_HIGHEST_SHADER_MODEL };
+    if(SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shader_model, sizeof(shader_model))))
+        desc.highest_shader_model = ShaderModel(shader_model.HighestShaderModel);
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+    if(SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+        desc.resource_binding_tier = uint32_t(options.ResourceBindingTier);
+
+    D3D12_FEATURE_DATA_D3D12_OPTIONS16 options16 = {};
+    if(SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS16, &options16, sizeof(options16))))
+        desc.gpu_upload_heap_supported = options16.GPUUploadHeapSupported != FALSE;
+}
+
+Result EnvironmentImpl::GetAdapterDesc(uint32_t adapter_index, AdapterDesc& out_desc)
+{
+    out_desc = {};
+    JD3D12_ASSERT_OR_RETURN(adapter_index < adapters_.size(), L"adapter_index out of bounds.");
+
+    std::lock_guard<std::mutex> lock(adapters_mutex_);
+    Adapter& adapter = adapters_[adapter_index];
+    if(!adapter.features_queried)
+        QueryAdapterFeatures(adapter);
+    out_desc = adapter.desc;
+    return kSuccess;
+}
+
+Result EnvironmentImpl::FindAdapter(const DeviceDesc& desc, IDXGIAdapter1*& out_adapter) const
+{
+    out_adapter = nullptr;
+    if(desc.adapter_luid != 0)
+    {
+        for(const Adapter& adapter : adapters_)
+        {
+            if(adapter.desc.luid == desc.adapter_luid)
+            {
+                out_adapter = adapter.adapter;
+                return kSuccess;
+            }
+        }
+        JD3D12_LOG(kLogSeverityError, L"Adapter with LUID 0x%016llX not found.", desc.adapter_luid);
+        return kErrorInvalidArgument;
+    }
+
+    JD3D12_ASSERT_OR_RETURN(desc.adapter_index < adapters_.size(), L"DeviceDesc::adapter_index out of bounds.");
+    out_adapter = adapters_[desc.adapter_index].adapter;
+    return kSuccess;
+}
+
 Result EnvironmentImpl::CreateDevice(const DeviceDesc& desc, Device*& out_device)
 {
     out_device = nullptr;
@@ -2829,6 +7975,18 @@ void* Buffer::GetD3D12Resource() const noexcept
     return impl_->GetD3D12Resource();
 }
 
+uint32_t Buffer::GetBindlessSrvIndex() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetBindlessSrvIndex();
+}
+
+uint32_t Buffer::GetBindlessUavIndex() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetBindlessUavIndex();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public class Shader
 
@@ -2866,6 +8024,86 @@ void* Shader::GetD3D12PipelineState() const noexcept
     return impl_->GetD3D12PipelineState();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Public class Recording
+
+Recording::Recording()
+{
+    // Empty.
+}
+
+Recording::~Recording()
+{
+    delete impl_;
+}
+
+Device* Recording::GetDevice() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetDevice()->GetInterface();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public class ShaderFamily
+
+ShaderFamily::ShaderFamily()
+{
+    // Empty.
+}
+
+ShaderFamily::~ShaderFamily()
+{
+    delete impl_;
+}
+
+Device* ShaderFamily::GetDevice() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetDevice()->GetInterface();
+}
+
+uint32_t ShaderFamily::GetAxisCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetAxisCount();
+}
+
+uint64_t ShaderFamily::GetPermutationCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetPermutationCount();
+}
+
+Result ShaderFamily::GetShader(ArraySpan<const uint32_t> value_indices, Shader*& out_shader)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetShader(value_indices, out_shader);
+}
+
+Result ShaderFamily::Prewarm(ArraySpan<const uint32_t> value_indices, uint32_t thread_count)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->Prewarm(value_indices, thread_count);
+}
+
+Result ShaderFamily::WaitForPrewarm()
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->WaitForPrewarm();
+}
+
+size_t ShaderFamily::GetVariantCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetVariantCount();
+}
+
+size_t ShaderFamily::GetUniqueShaderCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetUniqueShaderCount();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public class ShaderCompilationResult
 
@@ -2928,6 +8166,12 @@ void* Device::GetD3D12Device() const noexcept
     return impl_->GetD3D12Device();
 }
 
+void* Device::GetDXGIAdapter1() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetDXGIAdapter1();
+}
+
 Result Device::CreateBuffer(const BufferDesc& desc, Buffer*& out_buffer)
 {
     JD3D12_ASSERT(impl_ != nullptr);
@@ -2948,6 +8192,18 @@ Result Device::CreateBufferFromFile(const BufferDesc& desc, const wchar_t* initi
     return impl_->CreateBufferFromFile(desc, initial_data_file_path, out_buffer);
 }
 
+Result Device::AcquireTransientBuffer(const BufferDesc& desc, Buffer*& out_buffer)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->AcquireTransientBuffer(desc, out_buffer);
+}
+
+void Device::ReleaseTransientBuffer(Buffer* buf)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    impl_->ReleaseTransientBuffer(buf);
+}
+
 Result Device::CreateShaderFromMemory(const ShaderDesc& desc, ConstDataSpan bytecode,
     Shader*& out_shader)
 {
@@ -2976,6 +8232,48 @@ Result Device::CompileAndCreateShaderFromFile(const ShaderCompilationParams& com
     return impl_->CompileAndCreateShaderFromFile(compilation_params, desc, hlsl_source_file_path, out_shader);
 }
 
+Result Device::CompileAndCreateShadersBatch(ArraySpan<ShaderBatchItem> items, uint32_t thread_count)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->CompileAndCreateShadersBatch(items, thread_count);
+}
+
+Result Device::CreateShaderFamily(const ShaderFamilyDesc& desc, ShaderFamily*& out_family)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->CreateShaderFamily(desc, out_family);
+}
+
+Result Device::BeginRegion(const wchar_t* name)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->BeginRegion(name);
+}
+
+Result Device::EndRegion()
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->EndRegion();
+}
+
+ArraySpan<const ProfiledCommand> Device::GetProfiledCommands()
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetProfiledCommands();
+}
+
+void Device::ClearProfiledCommands()
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    impl_->ClearProfiledCommands();
+}
+
+Result Device::SaveProfilingTrace(const wchar_t* file_path)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->SaveProfilingTrace(file_path);
+}
+
 Result Device::MapBuffer(Buffer& buf, Range byte_range, BufferFlags cpu_usage_flag, void*& out_data_ptr,
     uint32_t command_flags)
 {
@@ -2996,6 +8294,39 @@ Result Device::ReadBufferToMemory(Buffer& src_buf, Range src_byte_range, void* d
     return impl_->ReadBufferToMemory(*src_buf.GetImpl(), src_byte_range, dst_memory, command_flags);
 }
 
+Result Device::ReadBufferToMemoryConverted(Buffer& src_buf, Range src_byte_range, Format dst_format,
+    void* dst_memory, uint32_t command_flags)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr);
+    return impl_->ReadBufferToMemoryConverted(*src_buf.GetImpl(), src_byte_range, dst_format, dst_memory,
+        command_flags);
+}
+
+Result Device::ReadBufferToMemoryAsync(Buffer& src_buf, Range src_byte_range, void* dst_memory,
+    ReadbackTicket& out_ticket)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr);
+    return impl_->ReadBufferToMemoryAsync(*src_buf.GetImpl(), src_byte_range, dst_memory, out_ticket);
+}
+
+bool Device::IsReadbackComplete(const ReadbackTicket& ticket)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->IsReadbackComplete(ticket);
+}
+
+Result Device::WaitForReadback(ReadbackTicket& ticket, uint32_t timeout_milliseconds)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->WaitForReadback(ticket, timeout_milliseconds);
+}
+
+Result Device::TryGetReadback(ReadbackTicket& ticket)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->WaitForReadback(ticket, 0);
+}
+
 Result Device::WriteMemoryToBuffer(ConstDataSpan src_data, Buffer& dst_buf, size_t dst_byte_offset,
     uint32_t command_flags)
 {
@@ -3003,6 +8334,26 @@ Result Device::WriteMemoryToBuffer(ConstDataSpan src_data, Buffer& dst_buf, size
     return impl_->WriteMemoryToBuffer(src_data, *dst_buf.GetImpl(), dst_byte_offset, command_flags);
 }
 
+Result Device::WriteMemoryToBufferConverted(ConstDataSpan src_data, Format src_format, Buffer& dst_buf,
+    size_t dst_byte_offset, uint32_t command_flags)
+{
+    JD3D12_ASSERT(impl_ != nullptr && dst_buf.GetImpl() != nullptr);
+    return impl_->WriteMemoryToBufferConverted(src_data, src_format, *dst_buf.GetImpl(), dst_byte_offset,
+        command_flags);
+}
+
+void Device::GetMemoryStatistics(MemoryStatistics& out_stats)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    impl_->GetMemoryStatistics(out_stats);
+}
+
+Result Device::GetStatistics(DeviceStatistics& out_stats)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetStatistics(out_stats);
+}
+
 Result Device::SubmitPendingCommands()
 {
     JD3D12_ASSERT(impl_ != nullptr);
@@ -3039,6 +8390,44 @@ Result Device::ClearBufferToFloatValues(Buffer& buf, const FloatVec4& values, Ra
     return impl_->ClearBufferToFloatValues(*buf.GetImpl(), values, element_range);
 }
 
+Result Device::Reduce(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type, ReduceOperation op,
+    Buffer& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr && dst_buf.GetImpl() != nullptr);
+    return impl_->Reduce(*src_buf.GetImpl(), src_byte_range, type, op, *dst_buf.GetImpl(), dst_byte_offset);
+}
+
+Result Device::InclusiveScan(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type,
+    Buffer& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr && dst_buf.GetImpl() != nullptr);
+    return impl_->Scan(*src_buf.GetImpl(), src_byte_range, type, false, *dst_buf.GetImpl(), dst_byte_offset);
+}
+
+Result Device::ExclusiveScan(Buffer& src_buf, Range src_byte_range, PrimitiveDataType type,
+    Buffer& dst_buf, size_t dst_byte_offset)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr && dst_buf.GetImpl() != nullptr);
+    return impl_->Scan(*src_buf.GetImpl(), src_byte_range, type, true, *dst_buf.GetImpl(), dst_byte_offset);
+}
+
+Result Device::RadixSort(Buffer& keys_buf, Range keys_byte_range, Buffer* values_buf,
+    size_t values_byte_offset, uint32_t key_bit_count)
+{
+    JD3D12_ASSERT(impl_ != nullptr && keys_buf.GetImpl() != nullptr);
+    return impl_->RadixSort(*keys_buf.GetImpl(), keys_byte_range, values_buf ? values_buf->GetImpl() : nullptr,
+        values_byte_offset, key_bit_count);
+}
+
+Result Device::Compact(Buffer& src_buf, Range src_byte_range, Buffer& flags_buf, size_t flags_byte_offset,
+    Buffer& dst_buf, size_t dst_byte_offset, Buffer& count_buf, size_t count_byte_offset)
+{
+    JD3D12_ASSERT(impl_ != nullptr && src_buf.GetImpl() != nullptr && flags_buf.GetImpl() != nullptr
+        && dst_buf.GetImpl() != nullptr && count_buf.GetImpl() != nullptr);
+    return impl_->Compact(*src_buf.GetImpl(), src_byte_range, *flags_buf.GetImpl(), flags_byte_offset,
+        *dst_buf.GetImpl(), dst_byte_offset, *count_buf.GetImpl(), count_byte_offset);
+}
+
 void Device::ResetAllBindings()
 {
     JD3D12_ASSERT(impl_ != nullptr);
@@ -3059,11 +8448,37 @@ Result Device::BindBuffer(uint32_t t_slot, Buffer* buf, Range byte_range)
     return impl_->BindBuffer(t_slot, buf ? buf->GetImpl() : nullptr, byte_range);
 }
 
-Result Device::BindRWBuffer(uint32_t u_slot, Buffer* buf, Range byte_range)
+Result Device::BindRWBuffer(uint32_t u_slot, Buffer* buf, Range byte_range, uint32_t bind_flags)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    JD3D12_ASSERT(buf == nullptr || buf->GetImpl() != nullptr);
+    return impl_->BindRWBuffer(u_slot, buf ? buf->GetImpl() : nullptr, byte_range, bind_flags);
+}
+
+Result Device::BindConstantData(uint32_t b_slot, ConstDataSpan data)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->BindConstantData(b_slot, data);
+}
+
+Result Device::SetRootConstants(ConstDataSpan data, uint32_t first_constant_index)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->SetRootConstants(data, first_constant_index);
+}
+
+Result Device::BindBindlessBuffer(uint32_t index_slot, Buffer* buf)
 {
     JD3D12_ASSERT(impl_ != nullptr);
     JD3D12_ASSERT(buf == nullptr || buf->GetImpl() != nullptr);
-    return impl_->BindRWBuffer(u_slot, buf ? buf->GetImpl() : nullptr, byte_range);
+    return impl_->BindBindlessBuffer(index_slot, buf ? buf->GetImpl() : nullptr);
+}
+
+Result Device::BindBindlessRWBuffer(uint32_t index_slot, Buffer* buf)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    JD3D12_ASSERT(buf == nullptr || buf->GetImpl() != nullptr);
+    return impl_->BindBindlessRWBuffer(index_slot, buf ? buf->GetImpl() : nullptr);
 }
 
 Result Device::DispatchComputeShader(Shader& shader, const UintVec3& group_count)
@@ -3072,6 +8487,36 @@ Result Device::DispatchComputeShader(Shader& shader, const UintVec3& group_count
     return impl_->DispatchComputeShader(*shader.GetImpl(), group_count);
 }
 
+Result Device::DispatchThreads(Shader& shader, const UintVec3& thread_count)
+{
+    JD3D12_ASSERT(impl_ != nullptr && shader.GetImpl() != nullptr);
+    return impl_->DispatchThreads(*shader.GetImpl(), thread_count);
+}
+
+Result Device::DispatchIndirect(Shader& shader, Buffer& args_buffer, size_t byte_offset)
+{
+    JD3D12_ASSERT(impl_ != nullptr && shader.GetImpl() != nullptr && args_buffer.GetImpl() != nullptr);
+    return impl_->DispatchIndirect(*shader.GetImpl(), *args_buffer.GetImpl(), byte_offset);
+}
+
+Result Device::BeginRecording()
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->BeginRecording();
+}
+
+Result Device::EndRecording(Recording*& out_recording)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->EndRecording(out_recording);
+}
+
+Result Device::Execute(Recording& recording)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->Execute(*recording.GetImpl());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Public class StaticShader
 
@@ -3408,6 +8853,18 @@ void* Environment::GetD3D12DeviceFactory() const noexcept
     return impl_->GetD3D12DeviceFactory();
 }
 
+uint32_t Environment::GetAdapterCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetAdapterCount();
+}
+
+Result Environment::GetAdapterDesc(uint32_t adapter_index, AdapterDesc& out_desc)
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetAdapterDesc(adapter_index, out_desc);
+}
+
 void Environment::Log(LogSeverity severity, const wchar_t* message)
 {
     JD3D12_ASSERT(impl_ != nullptr);
@@ -3424,6 +8881,18 @@ void jd3d12::Environment::LogF(LogSeverity severity, const wchar_t* format, ...)
     va_end(arg_list);
 }
 
+uint64_t Environment::GetDroppedLogMessageCount() const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    return impl_->GetDroppedLogMessageCount();
+}
+
+void Environment::GetShaderCompilationStatistics(ShaderCompilationStatistics& out_stats) const noexcept
+{
+    JD3D12_ASSERT(impl_ != nullptr);
+    impl_->GetShaderCompilationStatistics(out_stats);
+}
+
 Result Environment::CreateDevice(const DeviceDesc& desc, Device*& out_device)
 {
     JD3D12_ASSERT(impl_ != nullptr);
@@ -0,0 +1,562 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+#include "format_conversion.hpp"
+#include "internal_utils.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #define JD3D12_FORMAT_CONVERSION_X64 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #endif
+#else
+    #define JD3D12_FORMAT_CONVERSION_X64 0
+#endif
+
+// MSVC allows AVX2 intrinsics in any function, while GCC and Clang need them enabled per function.
+#if JD3D12_FORMAT_CONVERSION_X64 && (defined(__GNUC__) || defined(__clang__))
+    #define JD3D12_TARGET_AVX2_F16C __attribute__((target("avx2,f16c")))
+#else
+    #define JD3D12_TARGET_AVX2_F16C
+#endif
+
+namespace jd3d12
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// Scalar conversions
+// They also process the elements left after the last full SIMD vector, so they must round the same way.
+
+// Rounds to nearest even. Based on "float_to_half_fast3_rtne" by Fabian Giesen:
+// https://gist.github.com/rygorous/2156668
+static uint16_t FloatToHalf(float value)
+{
+    constexpr uint32_t kF32Infinity = 255u << 23;
+    constexpr uint32_t kF16MaxLimit = (127u + 16u) << 23;
+    constexpr uint32_t kDenormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t result;
+    if(bits >= kF16MaxLimit)
+        result = bits > kF32Infinity ? 0x7E00 : 0x7C00; // NaN becomes quiet NaN, too large values become infinity.
+    else if(bits < (113u << 23))
+    {
+        // Denormal or zero. Adding the magic number aligns the mantissa and rounds it.
+        float denorm_magic;
+        memcpy(&denorm_magic, &kDenormMagicBits, sizeof(denorm_magic));
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        f += denorm_magic;
+        memcpy(&bits, &f, sizeof(bits));
+        result = uint16_t(bits - kDenormMagicBits);
+    }
+    else
+    {
+        const uint32_t mantissa_odd = (bits >> 13) & 1u;
+        bits += ((15u - 127u) << 23) + 0xFFFu;
+        bits += mantissa_odd;
+        result = uint16_t(bits >> 13);
+    }
+    return uint16_t(result | (sign >> 16));
+}
+
+static float HalfToFloat(uint16_t value)
+{
+    constexpr uint32_t kShiftedExponent = 0x7C00u << 13;
+    constexpr uint32_t kMagicBits = 113u << 23;
+
+    uint32_t bits = uint32_t(value & 0x7FFFu) << 13;
+    const uint32_t exponent = bits & kShiftedExponent;
+    bits += (127u - 15u) << 23;
+    if(exponent == kShiftedExponent)
+        bits += (128u - 16u) << 23; // Infinity or NaN.
+    else if(exponent == 0)
+    {
+        // Zero or denormal - renormalize.
+        bits += 1u << 23;
+        float magic, f;
+        memcpy(&magic, &kMagicBits, sizeof(magic));
+        memcpy(&f, &bits, sizeof(f));
+        f -= magic;
+        memcpy(&bits, &f, sizeof(bits));
+    }
+    bits |= uint32_t(value & 0x8000u) << 16;
+
+    float result;
+    memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+// 255 for uint8_t, 127 for int8_t etc.
+template<typename T>
+constexpr float kNormScale = float(std::numeric_limits<T>::max());
+template<typename T>
+constexpr float kNormMin = std::is_signed_v<T> ? -1.f : 0.f;
+
+// Like on the GPU, NaN becomes 0 and other values are clamped to the representable range.
+template<typename T>
+static T FloatToNorm(float value)
+{
+    value = value == value ? std::min(std::max(value, kNormMin<T>), 1.f) : 0.f;
+    return T(std::lrintf(value * kNormScale<T>));
+}
+
+// For snorm, both the minimum and the one above it become -1.
+template<typename T>
+static float NormToFloat(T value)
+{
+    return std::max(float(value) / kNormScale<T>, kNormMin<T>);
+}
+
+static void ConvertFloatToHalfScalar(const float* src, uint16_t* dst, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+        dst[i] = FloatToHalf(src[i]);
+}
+
+static void ConvertHalfToFloatScalar(const uint16_t* src, float* dst, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+        dst[i] = HalfToFloat(src[i]);
+}
+
+template<typename T>
+static void ConvertFloatToNormScalar(const float* src, T* dst, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+        dst[i] = FloatToNorm<T>(src[i]);
+}
+
+template<typename T>
+static void ConvertNormToFloatScalar(const T* src, float* dst, size_t count)
+{
+    for(size_t i = 0; i < count; ++i)
+        dst[i] = NormToFloat<T>(src[i]);
+}
+
+#if JD3D12_FORMAT_CONVERSION_X64
+
+////////////////////////////////////////////////////////////////////////////////
+// SSE2 conversions, 4 components at a time
+
+static void ConvertFloatToHalfSse2(const float* src, uint16_t* dst, size_t count)
+{
+    // Same algorithm as FloatToHalf, with both branches computed and then selected.
+    const __m128i sign_mask = _mm_set1_epi32(int(0x80000000u));
+    const __m128i f32_infinity = _mm_set1_epi32(255 << 23);
+    const __m128i f16_max = _mm_set1_epi32(((127 + 16) << 23) - 1);
+    const __m128i denorm_limit = _mm_set1_epi32(113 << 23);
+    const __m128i denorm_magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normal_bias = _mm_set1_epi32(int((15u - 127u) << 23) + 0xFFF);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i infinity = _mm_set1_epi32(0x7C00);
+    const __m128i quiet_nan_bit = _mm_set1_epi32(0x0200);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i bits = _mm_castps_si128(_mm_loadu_ps(src + i));
+        const __m128i sign = _mm_and_si128(bits, sign_mask);
+        bits = _mm_xor_si128(bits, sign);
+
+        const __m128i denormal = _mm_sub_epi32(_mm_castps_si128(
+            _mm_add_ps(_mm_castsi128_ps(bits), _mm_castsi128_ps(denorm_magic))), denorm_magic);
+        const __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(bits, 13), one);
+        const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, normal_bias), mantissa_odd), 13);
+
+        const __m128i is_denormal = _mm_cmplt_epi32(bits, denorm_limit);
+        __m128i result = _mm_or_si128(_mm_and_si128(is_denormal, denormal), _mm_andnot_si128(is_denormal, normal));
+        const __m128i is_infinity_or_nan = _mm_cmpgt_epi32(bits, f16_max);
+        const __m128i infinity_or_nan = _mm_or_si128(infinity,
+            _mm_and_si128(_mm_cmpgt_epi32(bits, f32_infinity), quiet_nan_bit));
+        result = _mm_or_si128(_mm_and_si128(is_infinity_or_nan, infinity_or_nan),
+            _mm_andnot_si128(is_infinity_or_nan, result));
+        result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+        // Sign-extend the 16-bit values so that the saturating pack keeps them unchanged.
+        result = _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packs_epi32(result, result));
+    }
+    ConvertFloatToHalfScalar(src + i, dst + i, count - i);
+}
+
+static void ConvertHalfToFloatSse2(const uint16_t* src, float* dst, size_t count)
+{
+    // Multiplying by 2^112 rebiases the exponent and renormalizes denormals at once.
+    // Based on "half_to_float_SSE2" by Fabian Giesen: https://gist.github.com/rygorous/2144712
+    const __m128i no_sign_mask = _mm_set1_epi32(0x7FFF);
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128i max_finite = _mm_set1_epi32(0x7BFF);
+    const __m128i f32_infinity = _mm_set1_epi32(255 << 23);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128i half = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(src + i)), zero);
+        const __m128i exponent_mantissa = _mm_and_si128(half, no_sign_mask);
+        const __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exponent_mantissa), 16);
+        const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponent_mantissa, 13)), magic);
+        const __m128i infinity_or_nan = _mm_and_si128(_mm_cmpgt_epi32(exponent_mantissa, max_finite),
+            f32_infinity);
+        const __m128 result = _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infinity_or_nan)));
+        _mm_storeu_ps(dst + i, result);
+    }
+    ConvertHalfToFloatScalar(src + i, dst + i, count - i);
+}
+
+// Loads 4 norm components, extended to 32-bit integers.
+static __m128i LoadNorm4(const uint8_t* src)
+{
+    int32_t packed;
+    memcpy(&packed, src, sizeof(packed));
+    __m128i v = _mm_cvtsi32_si128(packed);
+    v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, v), _mm_unpacklo_epi8(v, v));
+    return _mm_srli_epi32(v, 24);
+}
+static __m128i LoadNorm4(const int8_t* src)
+{
+    int32_t packed;
+    memcpy(&packed, src, sizeof(packed));
+    __m128i v = _mm_cvtsi32_si128(packed);
+    v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, v), _mm_unpacklo_epi8(v, v));
+    return _mm_srai_epi32(v, 24);
+}
+static __m128i LoadNorm4(const uint16_t* src)
+{
+    const __m128i v = _mm_loadl_epi64((const __m128i*)src);
+    return _mm_srli_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+static __m128i LoadNorm4(const int16_t* src)
+{
+    const __m128i v = _mm_loadl_epi64((const __m128i*)src);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+// Stores 4 32-bit integers already clamped to the range of the norm type.
+static void StoreNorm4(uint8_t* dst, __m128i v)
+{
+    v = _mm_packs_epi32(v, v);
+    const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+    memcpy(dst, &packed, sizeof(packed));
+}
+static void StoreNorm4(int8_t* dst, __m128i v)
+{
+    v = _mm_packs_epi32(v, v);
+    const int32_t packed = _mm_cvtsi128_si32(_mm_packs_epi16(v, v));
+    memcpy(dst, &packed, sizeof(packed));
+}
+static void StoreNorm4(uint16_t* dst, __m128i v)
+{
+    // SSE2 has no unsigned saturating pack from 32 bits. Sign-extend so that the signed one keeps the values.
+    v = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+    _mm_storel_epi64((__m128i*)dst, _mm_packs_epi32(v, v));
+}
+static void StoreNorm4(int16_t* dst, __m128i v)
+{
+    _mm_storel_epi64((__m128i*)dst, _mm_packs_epi32(v, v));
+}
+
+template<typename T>
+static void ConvertFloatToNormSse2(const float* src, T* dst, size_t count)
+{
+    const __m128 min = _mm_set1_ps(kNormMin<T>);
+    const __m128 max = _mm_set1_ps(1.f);
+    const __m128 scale = _mm_set1_ps(kNormScale<T>);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(src + i);
+        v = _mm_and_ps(v, _mm_cmpord_ps(v, v)); // NaN becomes 0.
+        v = _mm_min_ps(_mm_max_ps(v, min), max);
+        StoreNorm4(dst + i, _mm_cvtps_epi32(_mm_mul_ps(v, scale)));
+    }
+    ConvertFloatToNormScalar(src + i, dst + i, count - i);
+}
+
+template<typename T>
+static void ConvertNormToFloatSse2(const T* src, float* dst, size_t count)
+{
+    const __m128 min = _mm_set1_ps(kNormMin<T>);
+    const __m128 scale = _mm_set1_ps(kNormScale<T>);
+
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128 v = _mm_cvtepi32_ps(LoadNorm4(src + i));
+        _mm_storeu_ps(dst + i, _mm_max_ps(_mm_div_ps(v, scale), min));
+    }
+    ConvertNormToFloatScalar(src + i, dst + i, count - i);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AVX2 and F16C conversions, 8 components at a time
+
+JD3D12_TARGET_AVX2_F16C static void ConvertFloatToHalfAvx2(const float* src, uint16_t* dst, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i result = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(dst + i), result);
+    }
+    ConvertFloatToHalfScalar(src + i, dst + i, count - i);
+}
+
+JD3D12_TARGET_AVX2_F16C static void ConvertHalfToFloatAvx2(const uint16_t* src, float* dst, size_t count)
+{
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+    ConvertHalfToFloatScalar(src + i, dst + i, count - i);
+}
+
+JD3D12_TARGET_AVX2_F16C static __m256i LoadNorm8(const uint8_t* src)
+{
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+}
+JD3D12_TARGET_AVX2_F16C static __m256i LoadNorm8(const int8_t* src)
+{
+    return _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)src));
+}
+JD3D12_TARGET_AVX2_F16C static __m256i LoadNorm8(const uint16_t* src)
+{
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)src));
+}
+JD3D12_TARGET_AVX2_F16C static __m256i LoadNorm8(const int16_t* src)
+{
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)src));
+}
+
+// The 256-bit packs work within 128-bit lanes, so the halves are packed with 128-bit instructions instead.
+JD3D12_TARGET_AVX2_F16C static void StoreNorm8(uint8_t* dst, __m256i v)
+{
+    const __m128i v16 = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(v16, v16));
+}
+JD3D12_TARGET_AVX2_F16C static void StoreNorm8(int8_t* dst, __m256i v)
+{
+    const __m128i v16 = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    _mm_storel_epi64((__m128i*)dst, _mm_packs_epi16(v16, v16));
+}
+JD3D12_TARGET_AVX2_F16C static void StoreNorm8(uint16_t* dst, __m256i v)
+{
+    _mm_storeu_si128((__m128i*)dst, _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+JD3D12_TARGET_AVX2_F16C static void StoreNorm8(int16_t* dst, __m256i v)
+{
+    _mm_storeu_si128((__m128i*)dst, _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+}
+
+template<typename T>
+JD3D12_TARGET_AVX2_F16C static void ConvertFloatToNormAvx2(const float* src, T* dst, size_t count)
+{
+    const __m256 min = _mm256_set1_ps(kNormMin<T>);
+    const __m256 max = _mm256_set1_ps(1.f);
+    const __m256 scale = _mm256_set1_ps(kNormScale<T>);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(src + i);
+        v = _mm256_and_ps(v, _mm256_cmp_ps(v, v, _CMP_ORD_Q)); // NaN becomes 0.
+        v = _mm256_min_ps(_mm256_max_ps(v, min), max);
+        StoreNorm8(dst + i, _mm256_cvtps_epi32(_mm256_mul_ps(v, scale)));
+    }
+    ConvertFloatToNormScalar(src + i, dst + i, count - i);
+}
+
+template<typename T>
+JD3D12_TARGET_AVX2_F16C static void ConvertNormToFloatAvx2(const T* src, float* dst, size_t count)
+{
+    const __m256 min = _mm256_set1_ps(kNormMin<T>);
+    const __m256 scale = _mm256_set1_ps(kNormScale<T>);
+
+    size_t i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m256 v = _mm256_cvtepi32_ps(LoadNorm8(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_max_ps(_mm256_div_ps(v, scale), min));
+    }
+    ConvertNormToFloatScalar(src + i, dst + i, count - i);
+}
+
+static bool IsAvx2F16cSupported()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#else
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool f16c = (info[2] & (1 << 29)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    // The OS must also save the YMM registers.
+    if(!f16c || !avx || !osxsave || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#endif // #if JD3D12_FORMAT_CONVERSION_X64
+
+////////////////////////////////////////////////////////////////////////////////
+// class FormatConverter
+
+// Adapts a typed conversion function to FormatConverter::ConvertFunction.
+template<typename Src, typename Dst, void (*Function)(const Src*, Dst*, size_t)>
+static void ConvertComponents(const void* src, void* dst, size_t component_count)
+{
+    Function(static_cast<const Src*>(src), static_cast<Dst*>(dst), component_count);
+}
+
+template<size_t ComponentSize>
+static void CopyComponentsOfSize(const void* src, void* dst, size_t component_count)
+{
+    memcpy(dst, src, component_count * ComponentSize);
+}
+
+template<typename T>
+static FormatConverter::ConvertFunction SelectFloatToNormFunction(bool avx2)
+{
+#if JD3D12_FORMAT_CONVERSION_X64
+    return avx2 ? &ConvertComponents<float, T, ConvertFloatToNormAvx2<T>>
+        : &ConvertComponents<float, T, ConvertFloatToNormSse2<T>>;
+#else
+    return &ConvertComponents<float, T, ConvertFloatToNormScalar<T>>;
+#endif
+}
+
+template<typename T>
+static FormatConverter::ConvertFunction SelectNormToFloatFunction(bool avx2)
+{
+#if JD3D12_FORMAT_CONVERSION_X64
+    return avx2 ? &ConvertComponents<T, float, ConvertNormToFloatAvx2<T>>
+        : &ConvertComponents<T, float, ConvertNormToFloatSse2<T>>;
+#else
+    return &ConvertComponents<T, float, ConvertNormToFloatScalar<T>>;
+#endif
+}
+
+bool FormatConverter::Init(Format src_format, Format dst_format)
+{
+    *this = FormatConverter{};
+
+    const FormatDesc* const src_desc = GetFormatDesc(src_format);
+    const FormatDesc* const dst_desc = GetFormatDesc(dst_format);
+    if(src_desc == nullptr || dst_desc == nullptr || !src_desc->is_simple || !dst_desc->is_simple
+        || src_desc->component_count != dst_desc->component_count)
+        return false;
+
+#if JD3D12_FORMAT_CONVERSION_X64
+    static const bool avx2 = IsAvx2F16cSupported();
+#else
+    constexpr bool avx2 = false;
+#endif
+
+    const Format src_component = src_desc->component_format;
+    const Format dst_component = dst_desc->component_format;
+    ConvertFunction function = nullptr;
+    if(src_component == dst_component)
+    {
+        switch(src_desc->bits_per_element / src_desc->component_count)
+        {
+        case 8: function = &CopyComponentsOfSize<1>; break;
+        case 16: function = &CopyComponentsOfSize<2>; break;
+        case 32: function = &CopyComponentsOfSize<4>; break;
+        }
+    }
+    else if(src_component == Format::kR32_Float)
+    {
+        switch(dst_component)
+        {
+        case Format::kR16_Float:
+#if JD3D12_FORMAT_CONVERSION_X64
+            function = avx2 ? &ConvertComponents<float, uint16_t, ConvertFloatToHalfAvx2>
+                : &ConvertComponents<float, uint16_t, ConvertFloatToHalfSse2>;
+#else
+            function = &ConvertComponents<float, uint16_t, ConvertFloatToHalfScalar>;
+#endif
+            break;
+        case Format::kR8_Unorm: function = SelectFloatToNormFunction<uint8_t>(avx2); break;
+        case Format::kR8_Snorm: function = SelectFloatToNormFunction<int8_t>(avx2); break;
+        case Format::kR16_Unorm: function = SelectFloatToNormFunction<uint16_t>(avx2); break;
+        case Format::kR16_Snorm: function = SelectFloatToNormFunction<int16_t>(avx2); break;
+        default: break;
+        }
+    }
+    else if(dst_component == Format::kR32_Float)
+    {
+        switch(src_component)
+        {
+        case Format::kR16_Float:
+#if JD3D12_FORMAT_CONVERSION_X64
+            function = avx2 ? &ConvertComponents<uint16_t, float, ConvertHalfToFloatAvx2>
+                : &ConvertComponents<uint16_t, float, ConvertHalfToFloatSse2>;
+#else
+            function = &ConvertComponents<uint16_t, float, ConvertHalfToFloatScalar>;
+#endif
+            break;
+        case Format::kR8_Unorm: function = SelectNormToFloatFunction<uint8_t>(avx2); break;
+        case Format::kR8_Snorm: function = SelectNormToFloatFunction<int8_t>(avx2); break;
+        case Format::kR16_Unorm: function = SelectNormToFloatFunction<uint16_t>(avx2); break;
+        case Format::kR16_Snorm: function = SelectNormToFloatFunction<int16_t>(avx2); break;
+        default: break;
+        }
+    }
+    if(function == nullptr)
+        return false;
+
+    function_ = function;
+    component_count_ = src_desc->component_count;
+    src_element_size_ = src_desc->bits_per_element / 8;
+    dst_element_size_ = dst_desc->bits_per_element / 8;
+    return true;
+}
+
+void FormatConverter::Convert(const void* src, void* dst, size_t element_count) const
+{
+    JD3D12_ASSERT(function_ != nullptr);
+
+    const size_t component_count = element_count * component_count_;
+    const size_t byte_count = element_count * std::max(src_element_size_, dst_element_size_);
+    const size_t thread_count = std::min<size_t>(std::thread::hardware_concurrency(),
+        byte_count / kMinBytesPerThread);
+    if(thread_count <= 1)
+    {
+        function_(src, dst, component_count);
+        return;
+    }
+
+    // Parts are a multiple of the SIMD width, so that only the last one has a scalar tail.
+    const size_t src_component_size = src_element_size_ / component_count_;
+    const size_t dst_component_size = dst_element_size_ / component_count_;
+    const size_t part_component_count = AlignUp<size_t>((component_count + thread_count - 1) / thread_count, 64);
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for(size_t first = part_component_count; first < component_count; first += part_component_count)
+    {
+        threads.emplace_back(function_, (const char*)src + first * src_component_size,
+            (char*)dst + first * dst_component_size, std::min(part_component_count, component_count - first));
+    }
+    function_(src, dst, std::min(part_component_count, component_count));
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+} // namespace jd3d12
@@ -0,0 +1,54 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+#pragma once
+
+#include <jd3d12/utils.hpp>
+
+namespace jd3d12
+{
+
+/* Converts arrays of elements between two formats with the same number of components, used by
+Device::WriteMemoryToBufferConverted and Device::ReadBufferToMemoryConverted.
+
+Supported are conversions between 32-bit float components and 16-bit float, 8- or 16-bit unorm or snorm
+components, in both directions, as well as between identical component formats. The kernels use AVX2 and F16C
+when the CPU supports them, SSE2 otherwise. Large arrays are split across multiple threads.
+*/
+class FormatConverter
+{
+public:
+    typedef void (*ConvertFunction)(const void* src, void* dst, size_t component_count);
+
+    // Returns false if converting between these formats is not supported. The object stays empty then.
+    bool Init(Format src_format, Format dst_format);
+    bool IsEmpty() const { return function_ == nullptr; }
+    size_t GetSrcElementSize() const { return src_element_size_; }
+    size_t GetDstElementSize() const { return dst_element_size_; }
+    // Returns the size of the converted data for `src_size` bytes of source data, which must hold whole elements.
+    size_t GetDstSize(size_t src_size) const { return src_size / src_element_size_ * dst_element_size_; }
+    size_t GetSrcSize(size_t dst_size) const { return dst_size / dst_element_size_ * src_element_size_; }
+
+    // Converts `element_count` elements from `src` to `dst`. The memory regions must not overlap.
+    void Convert(const void* src, void* dst, size_t element_count) const;
+
+private:
+    /* Minimum number of bytes for each thread to make splitting the conversion worth it. Convert creates and joins
+    new threads on every call that splits, without a pool, like the other parallel loops in the library. Each one
+    costs tens of microseconds on Windows, so parts must take much longer than that: about 100 us for 1 MB.
+    The calling thread converts the first part itself.
+    */
+    static constexpr size_t kMinBytesPerThread = 1024 * 1024;
+
+    ConvertFunction function_ = nullptr;
+    size_t component_count_ = 0;
+    size_t src_element_size_ = 0;
+    size_t dst_element_size_ = 0;
+};
+
+} // namespace jd3d12
@@ -28,9 +28,50 @@
 namespace jd3d12
 {
 
+template<typename T>
+constexpr T AlignUp(T val, T alignment)
+{
+    return (val + alignment - 1) / alignment * alignment;
+}
+
+// Returns the smallest power of 2 greater than or equal to val. val must be greater than 0.
+inline uint64_t NextPowerOfTwo(uint64_t val)
+{
+    --val;
+    val |= val >> 1;
+    val |= val >> 2;
+    val |= val >> 4;
+    val |= val >> 8;
+    val |= val >> 16;
+    val |= val >> 32;
+    return val + 1;
+}
+
+constexpr uint64_t kFnv1a64OffsetBasis = 0xCBF29CE484222325ull;
+
+// 64-bit FNV-1a hash. Pass the previous result as `hash` to hash multiple pieces of data together.
+inline uint64_t HashFnv1a64(const void* data, size_t size, uint64_t hash = kFnv1a64OffsetBasis)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
 std::wstring SVPrintF(const wchar_t* format, va_list arg_list);
 std::wstring SPrintF(const wchar_t* format, ...);
 
+// Converts a null-terminated UTF-16 string to UTF-8.
+std::string ConvertWideToUtf8(const wchar_t* str);
+
+/* Saves binary data to a file, replacing it if it exists. The data is first written to a temporary file
+in the same directory, which is then renamed, so other processes never see a partially written file.
+*/
+Result SaveFileAtomically(const wchar_t* path, ConstDataSpan data);
+
 LogSeverity D3d12MessageSeverityToLogSeverity(D3D12_MESSAGE_SEVERITY severity);
 const wchar_t* GetD3d12MessageCategoryString(D3D12_MESSAGE_CATEGORY category);
 
@@ -53,6 +94,12 @@ struct CloseHandleDeleter
     }
 };
 
+// Opens an existing file for reading from the beginning to the end, and returns its size.
+Result OpenFileForSequentialRead(const wchar_t* path, std::unique_ptr<HANDLE, CloseHandleDeleter>& out_file,
+    size_t& out_size);
+// Reads exactly `size` bytes from the current position in the file.
+Result ReadFileToMemory(HANDLE file, void* dst_memory, size_t size);
+
 // Internal.
 template<typename T, size_t stack_item_max_count>
 class StackOrHeapVector
@@ -233,7 +233,15 @@ Logger::Logger()
 
 Logger::~Logger()
 {
-    // Empty.
+#if JD3D12_ENABLE_LOGGING
+    if(async_thread_.joinable())
+    {
+        // The thread writes all the messages remaining in the queue before it exits.
+        async_thread_exit_.store(true);
+        SetEvent(async_event_.get());
+        async_thread_.join();
+    }
+#endif // #if JD3D12_ENABLE_LOGGING
 }
 
 Result Logger::Init(const EnvironmentDesc& env_desc)
@@ -267,17 +275,78 @@ Result Logger::Init(const EnvironmentDesc& env_desc)
             JD3D12_LOG(kLogSeverityWarning, L"Failed to open log file for writing: \"%s\"", env_desc.log_file_path);
         }
     }
+
+    // Nowhere to send messages to - filter out all of them before any formatting.
+    if(print_streams_.IsEmpty() && callback_ == nullptr)
+        severity_mask_ = 0;
+
+    if((env_desc.flags & kEnvironmentFlagAsyncLogging) != 0 && severity_mask_ != 0)
+    {
+        const size_t capacity = (size_t)NextPowerOfTwo(std::max<uint64_t>(env_desc.async_log_capacity, 2));
+        async_records_ = std::make_unique<AsyncRecord[]>(capacity);
+        for(size_t i = 0; i < capacity; ++i)
+            async_records_[i].sequence.store(i, std::memory_order_relaxed);
+        async_record_mask_ = capacity - 1;
+
+        // Auto-reset event.
+        async_event_.reset(CreateEvent(NULL, FALSE, FALSE, NULL));
+
+        async_thread_ = std::thread(&Logger::AsyncThreadMain, this);
+    }
 #endif // #if JD3D12_ENABLE_LOGGING
 
     return kSuccess;
 }
 
+uint64_t Logger::GetDroppedMessageCount() const noexcept
+{
+#if JD3D12_ENABLE_LOGGING
+    return dropped_message_count_.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
 void Logger::Log(LogSeverity severity, const wchar_t* message)
 {
 #if JD3D12_ENABLE_LOGGING
-    if((severity & severity_mask_) == 0)
+    if(!IsSeverityEnabled(severity))
+        return;
+
+    if(IsAsync())
+        Enqueue(severity, std::wstring{message});
+    else
+        Write(severity, message);
+#endif // #if JD3D12_ENABLE_LOGGING
+}
+
+void Logger::VLogF(LogSeverity severity, const wchar_t* format, va_list arg_list)
+{
+#if JD3D12_ENABLE_LOGGING
+    if(!IsSeverityEnabled(severity))
         return;
 
+    if(IsAsync())
+        Enqueue(severity, SVPrintF(format, arg_list));
+    else
+        Write(severity, SVPrintF(format, arg_list).c_str());
+#endif // #if JD3D12_ENABLE_LOGGING
+}
+
+void Logger::LogF(LogSeverity severity, const wchar_t* format, ...)
+{
+#if JD3D12_ENABLE_LOGGING
+    va_list arg_list;
+    va_start(arg_list, format);
+    VLogF(severity, format, arg_list);
+    va_end(arg_list);
+#endif // #if JD3D12_ENABLE_LOGGING
+}
+
+#if JD3D12_ENABLE_LOGGING
+
+void Logger::Write(LogSeverity severity, const wchar_t* message)
+{
     if(callback_ != nullptr)
     {
         callback_(severity, message, callback_context_);
@@ -295,29 +364,95 @@ void Logger::Log(LogSeverity severity, const wchar_t* message)
                 s->Flush();
         }
     }
-#endif // #if JD3D12_ENABLE_LOGGING
 }
 
-void Logger::VLogF(LogSeverity severity, const wchar_t* format, va_list arg_list)
+// The queue is the bounded MPMC queue by Dmitry Vyukov, reduced to a single consumer.
+// Producers only contend on `async_enqueue_pos_` and never wait for the logging thread.
+
+void Logger::Enqueue(LogSeverity severity, std::wstring&& message)
 {
-#if JD3D12_ENABLE_LOGGING
-    if((severity & severity_mask_) == 0)
-        return;
-    if(print_streams_.IsEmpty() && callback_ == nullptr)
-        return;
+    size_t pos = async_enqueue_pos_.load(std::memory_order_relaxed);
+    for(;;)
+    {
+        AsyncRecord& record = async_records_[pos & async_record_mask_];
+        const size_t sequence = record.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if(diff == 0)
+        {
+            if(async_enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                record.severity = severity;
+                record.message = std::move(message);
+                record.sequence.store(pos + 1, std::memory_order_release);
+                break;
+            }
+        }
+        else if(diff < 0)
+        {
+            // The queue is full.
+            dropped_message_count_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+            pos = async_enqueue_pos_.load(std::memory_order_relaxed);
+    }
 
-    Log(severity, SVPrintF(format, arg_list).c_str());
-#endif // #if JD3D12_ENABLE_LOGGING
+    // Pairs with the fence in AsyncThreadMain, so either the thread sees the new message
+    // or we see it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(async_thread_waiting_.load(std::memory_order_relaxed))
+        SetEvent(async_event_.get());
 }
 
-void Logger::LogF(LogSeverity severity, const wchar_t* format, ...)
+bool Logger::TryDequeue(LogSeverity& out_severity, std::wstring& out_message)
 {
-#if JD3D12_ENABLE_LOGGING
-    va_list arg_list;
-    va_start(arg_list, format);
-    VLogF(severity, format, arg_list);
-    va_end(arg_list);
-#endif // #if JD3D12_ENABLE_LOGGING
+    AsyncRecord& record = async_records_[async_dequeue_pos_ & async_record_mask_];
+    if(record.sequence.load(std::memory_order_acquire) != async_dequeue_pos_ + 1)
+        return false;
+    out_severity = record.severity;
+    out_message = std::move(record.message);
+    record.sequence.store(async_dequeue_pos_ + async_record_mask_ + 1, std::memory_order_release);
+    ++async_dequeue_pos_;
+    return true;
+}
+
+bool Logger::IsQueueEmpty() const noexcept
+{
+    const AsyncRecord& record = async_records_[async_dequeue_pos_ & async_record_mask_];
+    return record.sequence.load(std::memory_order_acquire) != async_dequeue_pos_ + 1;
 }
 
+void Logger::AsyncThreadMain()
+{
+    uint64_t reported_dropped_count = 0;
+    LogSeverity severity = kLogSeverityInfo;
+    std::wstring message;
+    for(;;)
+    {
+        while(TryDequeue(severity, message))
+            Write(severity, message.c_str());
+
+        const uint64_t dropped_count = dropped_message_count_.load(std::memory_order_relaxed);
+        if(dropped_count != reported_dropped_count
+            && (severity_mask_ & kLogSeverityWarning) != 0)
+        {
+            Write(kLogSeverityWarning, SPrintF(
+                L"%llu log messages were dropped because the asynchronous logging queue was full.",
+                dropped_count - reported_dropped_count).c_str());
+        }
+        reported_dropped_count = dropped_count;
+
+        if(async_thread_exit_.load())
+            break;
+
+        async_thread_waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(IsQueueEmpty() && !async_thread_exit_.load())
+            WaitForSingleObject(async_event_.get(), INFINITE);
+        async_thread_waiting_.store(false, std::memory_order_relaxed);
+    }
+}
+
+#endif // #if JD3D12_ENABLE_LOGGING
+
 } // namespace jd3d12
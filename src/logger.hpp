@@ -15,11 +15,12 @@
 #include "internal_utils.hpp"
 
 // The place where you use this macro must have `GetLogger()` available.
+// Arguments are not evaluated and the message is not formatted when its severity is disabled.
 #if JD3D12_ENABLE_LOGGING
     #define JD3D12_LOG(severity, format, ...) \
         do { \
             Logger* const logger = GetLogger(); \
-            if(logger != nullptr) \
+            if(logger != nullptr && logger->IsSeverityEnabled(severity)) \
                 logger->LogF(severity, format, __VA_ARGS__); \
         } while(false)
 #else
@@ -40,6 +41,18 @@ public:
 
     Logger* GetLogger() noexcept { return this; }
 
+    // Returns false also when there is no callback and no print stream to send the message to.
+    bool IsSeverityEnabled(LogSeverity severity) const noexcept
+    {
+#if JD3D12_ENABLE_LOGGING
+        return (severity & severity_mask_) != 0;
+#else
+        return false;
+#endif
+    }
+    // Number of messages lost because the queue of the asynchronous logging was full.
+    uint64_t GetDroppedMessageCount() const noexcept;
+
     void Log(LogSeverity severity, const wchar_t* message);
     void VLogF(LogSeverity severity, const wchar_t* format, va_list arg_list);
     void LogF(LogSeverity severity, const wchar_t* format, ...);
@@ -47,6 +60,16 @@ public:
 private:
 
 #if JD3D12_ENABLE_LOGGING
+    // One slot of the bounded multi-producer, single-consumer queue used with
+    // kEnvironmentFlagAsyncLogging. `sequence` tells whether the slot is free for the producer
+    // with enqueue position equal to it or filled for the consumer at position `sequence - 1`.
+    struct AsyncRecord
+    {
+        std::atomic<size_t> sequence{0};
+        LogSeverity severity = kLogSeverityInfo;
+        std::wstring message;
+    };
+
     uint32_t severity_mask_ = 0;
 
     LogCallback callback_ = nullptr;
@@ -54,6 +77,27 @@ private:
 
     std::mutex print_streams_mutex_;
     StackOrHeapVector<std::unique_ptr<PrintStream>, 4> print_streams_;
+
+    // Members used only with kEnvironmentFlagAsyncLogging.
+    std::unique_ptr<AsyncRecord[]> async_records_;
+    size_t async_record_mask_ = 0;
+    std::atomic<size_t> async_enqueue_pos_{0};
+    // Accessed only by the logging thread.
+    size_t async_dequeue_pos_ = 0;
+    std::atomic<uint64_t> dropped_message_count_{0};
+    std::atomic<bool> async_thread_waiting_{false};
+    std::atomic<bool> async_thread_exit_{false};
+    std::unique_ptr<HANDLE, CloseHandleDeleter> async_event_;
+    std::thread async_thread_;
+
+    bool IsAsync() const noexcept { return async_records_ != nullptr; }
+    // Sends the message to the callback and all print streams on the calling thread.
+    void Write(LogSeverity severity, const wchar_t* message);
+    // Puts the message to the queue or counts it as dropped if the queue is full.
+    void Enqueue(LogSeverity severity, std::wstring&& message);
+    bool TryDequeue(LogSeverity& out_severity, std::wstring& out_message);
+    bool IsQueueEmpty() const noexcept;
+    void AsyncThreadMain();
 #endif // #if JD3D12_ENABLE_LOGGING
 
     JD3D12_NO_COPY_NO_MOVE_CLASS(Logger);
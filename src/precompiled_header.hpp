@@ -25,6 +25,7 @@
 
 #include <array>
 #include <vector>
+#include <deque>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
@@ -33,7 +34,10 @@
 #include <utility>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <iterator>
+#include <limits>
 #include <type_traits>
 #include <filesystem>
 
@@ -0,0 +1,375 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+#pragma once
+
+namespace jd3d12
+{
+
+/* HLSL source of the shaders used by Device::Reduce, Device::InclusiveScan, Device::ExclusiveScan,
+Device::RadixSort, and Device::Compact. DeviceImpl compiles each variant on its first use, with macros:
+
+- JD3D12_TYPE: 0 = uint, 1 = int, 2 = float.
+- JD3D12_OP: 0 = sum, 1 = min, 2 = max. Only Reduce uses other than sum.
+- JD3D12_WAVE_OPS: defined when wave intrinsics are supported with at least 16 lanes per wave.
+
+All buffers are bound as raw views of whole buffers, with the byte offsets of the data in the constants.
+Split into multiple literals, as MSVC limits the length of a single one.
+*/
+inline constexpr char kPrimitiveShadersHlsl[] = R"hlsl(
+#define GROUP_SIZE 256
+#define ITEMS_PER_THREAD 8
+#define BLOCK_SIZE (GROUP_SIZE * ITEMS_PER_THREAD)
+
+#define RADIX_BITS 4
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+#define FLAG_EXCLUSIVE 0x1
+#define FLAG_HAS_PARTIALS 0x2
+#define FLAG_PREDICATE 0x4
+#define FLAG_HAS_VALUES 0x8
+// The bits of flags from this one hold the shift of the digit sorted by RadixCount and RadixScatter.
+#define FLAG_RADIX_SHIFT_OFFSET 8
+
+#if JD3D12_TYPE == 2
+typedef float T;
+#define FROM_BITS asfloat
+#elif JD3D12_TYPE == 1
+typedef int T;
+#define FROM_BITS asint
+#else
+typedef uint T;
+#define FROM_BITS asuint
+#endif
+
+#if JD3D12_OP == 1
+#define IDENTITY_BITS (JD3D12_TYPE == 2 ? 0x7F800000u : JD3D12_TYPE == 1 ? 0x7FFFFFFFu : 0xFFFFFFFFu)
+#define WAVE_OP WaveActiveMin
+T Op(T a, T b) { return min(a, b); }
+#elif JD3D12_OP == 2
+#define IDENTITY_BITS (JD3D12_TYPE == 2 ? 0xFF800000u : JD3D12_TYPE == 1 ? 0x80000000u : 0u)
+#define WAVE_OP WaveActiveMax
+T Op(T a, T b) { return max(a, b); }
+#else
+#define IDENTITY_BITS 0u
+#define WAVE_OP WaveActiveSum
+T Op(T a, T b) { return a + b; }
+#endif
+
+T Identity() { return FROM_BITS(IDENTITY_BITS); }
+
+cbuffer PrimitiveConstants : register(b1, space1)
+{
+    uint element_count;
+    // Big dispatches are 2D, as a dimension cannot exceed 65535 groups.
+    uint group_count_x;
+    uint flags;
+    // Where the data starts in each buffer, as views cover whole buffers.
+    uint src_byte_offset;
+    uint aux_byte_offset;
+    uint aux2_byte_offset;
+    uint dst_byte_offset;
+    uint dst2_byte_offset;
+};
+
+ByteAddressBuffer src_buf : register(t0);
+ByteAddressBuffer aux_buf : register(t1);
+ByteAddressBuffer aux2_buf : register(t2);
+RWByteAddressBuffer dst_buf : register(u0);
+RWByteAddressBuffer dst2_buf : register(u1);
+
+uint LoadSrc(uint index) { return src_buf.Load(src_byte_offset + index * 4); }
+uint LoadAux(uint index) { return aux_buf.Load(aux_byte_offset + index * 4); }
+uint LoadAux2(uint index) { return aux2_buf.Load(aux2_byte_offset + index * 4); }
+void StoreDst(uint index, uint value) { dst_buf.Store(dst_byte_offset + index * 4, value); }
+void StoreDst2(uint index, uint value) { dst2_buf.Store(dst2_byte_offset + index * 4, value); }
+
+groupshared T g_shared[GROUP_SIZE];
+groupshared T g_group_total;
+
+uint GetGroupIndex(uint3 group_id)
+{
+    return group_id.y * group_count_x + group_id.x;
+}
+
+// Number of blocks of BLOCK_SIZE elements, written without overflowing for big element_count.
+uint GetBlockCount()
+{
+    return element_count / BLOCK_SIZE + (element_count % BLOCK_SIZE != 0 ? 1 : 0);
+}
+
+T LoadInput(uint index)
+{
+    const uint bits = LoadSrc(index);
+    // Only with uint: Compact scans the flags as 0 or 1.
+    if((flags & FLAG_PREDICATE) != 0)
+        return FROM_BITS(bits != 0 ? 1u : 0u);
+    return FROM_BITS(bits);
+}
+
+/* Returns Op over the values of all the threads of the group, valid in thread 0.
+With wave intrinsics, waves are assumed to be made of consecutive SV_GroupIndex values.
+*/
+T GroupReduce(T value, uint gi)
+{
+#ifdef JD3D12_WAVE_OPS
+    const uint lane_count = WaveGetLaneCount();
+    value = WAVE_OP(value);
+    if(WaveIsFirstLane())
+        g_shared[gi / lane_count] = value;
+    GroupMemoryBarrierWithGroupSync();
+    // With at least 16 lanes, there are no more waves than lanes, so the first wave reduces the results of all.
+    const uint wave_count = GROUP_SIZE / lane_count;
+    value = WAVE_OP(gi < wave_count ? g_shared[gi] : Identity());
+#else
+    g_shared[gi] = value;
+    GroupMemoryBarrierWithGroupSync();
+    [unroll] for(uint stride = GROUP_SIZE / 2; stride > 0; stride >>= 1)
+    {
+        if(gi < stride)
+            g_shared[gi] = Op(g_shared[gi], g_shared[gi + stride]);
+        GroupMemoryBarrierWithGroupSync();
+    }
+    value = g_shared[0];
+#endif
+    GroupMemoryBarrierWithGroupSync();
+    return value;
+}
+
+// Returns the sum of the values of the threads before this one in the group, and the sum of all in group_total.
+T GroupExclusiveScan(T value, uint gi, out T group_total)
+{
+#ifdef JD3D12_WAVE_OPS
+    const uint lane_count = WaveGetLaneCount();
+    const uint wave_index = gi / lane_count;
+    const T wave_prefix = WavePrefixSum(value);
+    if(WaveGetLaneIndex() == lane_count - 1)
+        g_shared[wave_index] = wave_prefix + value;
+    GroupMemoryBarrierWithGroupSync();
+    const uint wave_count = GROUP_SIZE / lane_count;
+    const T wave_total = gi < wave_count ? g_shared[gi] : (T)0;
+    const T wave_offset = WavePrefixSum(wave_total);
+    GroupMemoryBarrierWithGroupSync();
+    if(gi < wave_count)
+        g_shared[gi] = wave_offset;
+    if(gi == wave_count - 1)
+        g_group_total = wave_offset + wave_total;
+    GroupMemoryBarrierWithGroupSync();
+    const T result = g_shared[wave_index] + wave_prefix;
+#else
+    g_shared[gi] = value;
+    GroupMemoryBarrierWithGroupSync();
+    [unroll] for(uint offset = 1; offset < GROUP_SIZE; offset <<= 1)
+    {
+        const T other = gi >= offset ? g_shared[gi - offset] : (T)0;
+        GroupMemoryBarrierWithGroupSync();
+        g_shared[gi] += other;
+        GroupMemoryBarrierWithGroupSync();
+    }
+    if(gi == GROUP_SIZE - 1)
+        g_group_total = g_shared[gi];
+    const T result = gi > 0 ? g_shared[gi - 1] : (T)0;
+    GroupMemoryBarrierWithGroupSync();
+#endif
+    group_total = g_group_total;
+    GroupMemoryBarrierWithGroupSync();
+    return result;
+}
+
+// Writes Op over each block of src_buf to dst_buf, one element per block.
+[numthreads(GROUP_SIZE, 1, 1)]
+void Reduce(uint3 group_id : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint group_index = GetGroupIndex(group_id);
+    if(group_index >= GetBlockCount())
+        return;
+
+    const uint block_begin = group_index * BLOCK_SIZE;
+    T value = Identity();
+    [unroll] for(uint i = 0; i < ITEMS_PER_THREAD; ++i)
+    {
+        const uint index = block_begin + i * GROUP_SIZE + gi;
+        if(index < element_count)
+            value = Op(value, LoadInput(index));
+    }
+    value = GroupReduce(value, gi);
+    if(gi == 0)
+        StoreDst(group_index, asuint(value));
+}
+
+/* Writes the prefix sums of src_buf to dst_buf, within each block. With FLAG_HAS_PARTIALS, aux_buf holds
+the exclusive prefix sums of the block sums, added to each block.
+*/
+[numthreads(GROUP_SIZE, 1, 1)]
+void Scan(uint3 group_id : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint group_index = GetGroupIndex(group_id);
+    if(group_index >= GetBlockCount())
+        return;
+
+    // Each thread scans consecutive elements, so the group only has to scan the sums of the threads.
+    const uint thread_begin = group_index * BLOCK_SIZE + gi * ITEMS_PER_THREAD;
+    const bool exclusive = (flags & FLAG_EXCLUSIVE) != 0;
+    T values[ITEMS_PER_THREAD];
+    T thread_sum = (T)0;
+    [unroll] for(uint i = 0; i < ITEMS_PER_THREAD; ++i)
+    {
+        const uint index = thread_begin + i;
+        const T value = index < element_count ? LoadInput(index) : (T)0;
+        values[i] = exclusive ? thread_sum : thread_sum + value;
+        thread_sum += value;
+    }
+
+    T group_total;
+    T offset = GroupExclusiveScan(thread_sum, gi, group_total);
+    if((flags & FLAG_HAS_PARTIALS) != 0)
+        offset += FROM_BITS(LoadAux(group_index));
+
+    [unroll] for(uint j = 0; j < ITEMS_PER_THREAD; ++j)
+    {
+        const uint index = thread_begin + j;
+        if(index < element_count)
+            StoreDst(index, asuint(offset + values[j]));
+    }
+}
+)hlsl" R"hlsl(
+groupshared uint g_histogram[RADIX_SIZE];
+
+uint GetRadixShift()
+{
+    return flags >> FLAG_RADIX_SHIFT_OFFSET;
+}
+
+/* Counts the keys in src_buf with each value of the digit at GetRadixShift(), per block. Written to dst_buf
+digit-major, so the exclusive scan of it is the first output index for each digit and block.
+*/
+[numthreads(GROUP_SIZE, 1, 1)]
+void RadixCount(uint3 group_id : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint group_index = GetGroupIndex(group_id);
+    const uint block_count = GetBlockCount();
+    if(group_index >= block_count)
+        return;
+
+    if(gi < RADIX_SIZE)
+        g_histogram[gi] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint block_begin = group_index * BLOCK_SIZE;
+    [unroll] for(uint i = 0; i < ITEMS_PER_THREAD; ++i)
+    {
+        const uint index = block_begin + i * GROUP_SIZE + gi;
+        if(index < element_count)
+        {
+            const uint digit = (LoadSrc(index) >> GetRadixShift()) & (RADIX_SIZE - 1);
+            InterlockedAdd(g_histogram[digit], 1);
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if(gi < RADIX_SIZE)
+        StoreDst(gi * block_count + group_index, g_histogram[gi]);
+}
+
+groupshared uint g_keys[GROUP_SIZE];
+groupshared uint g_values[GROUP_SIZE];
+groupshared uint g_digits[GROUP_SIZE];
+// Output index of the next element with each digit.
+groupshared uint g_digit_offsets[RADIX_SIZE];
+// Index in the sorted sub-block of the first element with each digit.
+groupshared uint g_digit_begins[RADIX_SIZE];
+
+/* Moves the keys from src_buf to dst_buf and, with FLAG_HAS_VALUES, the values from aux_buf to dst2_buf,
+to their place sorted by the digit at GetRadixShift(). aux2_buf is the scanned output of RadixCount.
+Each block is processed in sub-blocks of GROUP_SIZE elements, in order, so the sort is stable.
+*/
+[numthreads(GROUP_SIZE, 1, 1)]
+void RadixScatter(uint3 group_id : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint group_index = GetGroupIndex(group_id);
+    const uint block_count = GetBlockCount();
+    if(group_index >= block_count)
+        return;
+
+    if(gi < RADIX_SIZE)
+        g_digit_offsets[gi] = LoadAux2(gi * block_count + group_index);
+    GroupMemoryBarrierWithGroupSync();
+
+    const bool has_values = (flags & FLAG_HAS_VALUES) != 0;
+    const uint radix_shift = GetRadixShift();
+    const uint block_begin = group_index * BLOCK_SIZE;
+    for(uint i = 0; i < ITEMS_PER_THREAD; ++i)
+    {
+        const uint sub_block_begin = block_begin + i * GROUP_SIZE;
+        if(sub_block_begin >= element_count)
+            break;
+
+        const uint index = sub_block_begin + gi;
+        const bool valid = index < element_count;
+        uint key = valid ? LoadSrc(index) : 0;
+        uint value = valid && has_values ? LoadAux(index) : 0;
+        // Elements past the end get a digit that sorts after all the others, using one more bit.
+        uint digit = valid ? (key >> radix_shift) & (RADIX_SIZE - 1) : RADIX_SIZE;
+        const uint bit_count = sub_block_begin + GROUP_SIZE > element_count ? RADIX_BITS + 1 : RADIX_BITS;
+
+        // Stable sort of the sub-block by the digit in shared memory, one bit at a time.
+        for(uint bit = 0; bit < bit_count; ++bit)
+        {
+            const uint is_one = (digit >> bit) & 1;
+            uint zero_count;
+            const uint zeros_before = GroupExclusiveScan(1 - is_one, gi, zero_count);
+            const uint position = is_one != 0 ? zero_count + gi - zeros_before : zeros_before;
+            g_keys[position] = key;
+            g_values[position] = value;
+            g_digits[position] = digit;
+            GroupMemoryBarrierWithGroupSync();
+            key = g_keys[gi];
+            value = g_values[gi];
+            digit = g_digits[gi];
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        if(digit < RADIX_SIZE && (gi == 0 || g_digits[gi - 1] != digit))
+            g_digit_begins[digit] = gi;
+        GroupMemoryBarrierWithGroupSync();
+
+        if(digit < RADIX_SIZE)
+        {
+            const uint output_index = g_digit_offsets[digit] + gi - g_digit_begins[digit];
+            StoreDst(output_index, key);
+            if(has_values)
+                StoreDst2(output_index, value);
+        }
+        GroupMemoryBarrierWithGroupSync();
+
+        if(digit < RADIX_SIZE && (gi == GROUP_SIZE - 1 || g_digits[gi + 1] != digit))
+            g_digit_offsets[digit] += gi - g_digit_begins[digit] + 1;
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+/* Copies the elements of src_buf with a nonzero flag in aux_buf to dst_buf, at the index from aux2_buf,
+which is the exclusive scan of the flags. The last thread writes the number of copied elements to dst2_buf.
+*/
+[numthreads(GROUP_SIZE, 1, 1)]
+void CompactScatter(uint3 group_id : SV_GroupID, uint gi : SV_GroupIndex)
+{
+    const uint index = GetGroupIndex(group_id) * GROUP_SIZE + gi;
+    if(index >= element_count)
+        return;
+
+    const bool keep = LoadAux(index) != 0;
+    const uint output_index = LoadAux2(index);
+    if(keep)
+        StoreDst(output_index, LoadSrc(index));
+    if(index == element_count - 1)
+        StoreDst2(0, output_index + (keep ? 1 : 0));
+}
+)hlsl";
+
+} // namespace jd3d12
@@ -372,29 +372,29 @@ const FormatDesc* GetFormatDesc(Format format)
     return nullptr;
 }
 
-Result LoadFile(const wchar_t* path, char*& out_data, size_t& out_size, size_t max_size)
+Result OpenFileForSequentialRead(const wchar_t* path, std::unique_ptr<HANDLE, CloseHandleDeleter>& out_file,
+    size_t& out_size)
 {
-    out_data = nullptr;
     out_size = 0;
 
-    std::unique_ptr<HANDLE, CloseHandleDeleter> file;
-    file.reset(CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL, nullptr));
-    if (file.get() == INVALID_HANDLE_VALUE)
+    // The flag makes the system read ahead, so the disk keeps reading while the caller processes the data.
+    out_file.reset(CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr));
+    if (out_file.get() == INVALID_HANDLE_VALUE)
+    {
+        out_file.release();
         return MakeResultFromLastError();
+    }
 
     LARGE_INTEGER li_size = {};
-    if (!GetFileSizeEx(file.get(), &li_size))
+    if (!GetFileSizeEx(out_file.get(), &li_size))
         return MakeResultFromLastError();
-    const size_t size = size_t(li_size.QuadPart);
-
-    if(size == 0)
-        return kFalse;
-    if (size > max_size)
-        return kErrorOutOfBounds;
-
-    std::unique_ptr<char[]> data = std::unique_ptr<char[]>(new char[size]);
+    out_size = size_t(li_size.QuadPart);
+    return kSuccess;
+}
 
+Result ReadFileToMemory(HANDLE file, void* dst_memory, size_t size)
+{
     // Read in a loop because ReadFile takes a DWORD for size (32-bit).
     size_t total_read = 0;
     while (total_read < size)
@@ -402,16 +402,84 @@ Result LoadFile(const wchar_t* path, char*& out_data, size_t& out_size, size_t m
         const size_t remaining = size - total_read;
         const DWORD to_read = DWORD(remaining > UINT32_MAX ? UINT32_MAX : remaining);
         DWORD bytes_read = 0;
-        if (!ReadFile(file.get(), data.get() + total_read, to_read, &bytes_read, nullptr))
+        if (!ReadFile(file, (char*)dst_memory + total_read, to_read, &bytes_read, nullptr))
             return MakeResultFromLastError();
         if (bytes_read == 0)
             return kErrorUnexpected;
         total_read += bytes_read;
     }
+    return kSuccess;
+}
+
+Result LoadFile(const wchar_t* path, char*& out_data, size_t& out_size, size_t max_size)
+{
+    out_data = nullptr;
+    out_size = 0;
+
+    std::unique_ptr<HANDLE, CloseHandleDeleter> file;
+    size_t size = 0;
+    JD3D12_RETURN_IF_FAILED(OpenFileForSequentialRead(path, file, size));
+
+    if(size == 0)
+        return kFalse;
+    if (size > max_size)
+        return kErrorOutOfBounds;
+
+    std::unique_ptr<char[]> data = std::unique_ptr<char[]>(new char[size]);
+    JD3D12_RETURN_IF_FAILED(ReadFileToMemory(file.get(), data.get(), size));
 
     out_data = data.release();
     out_size = size;
     return kSuccess;
 }
 
+std::string ConvertWideToUtf8(const wchar_t* str)
+{
+    if (IsStringEmpty(str))
+        return std::string{};
+    const int size = WideCharToMultiByte(CP_UTF8, 0, str, -1, nullptr, 0, nullptr, nullptr);
+    if (size <= 1)
+        return std::string{};
+    std::string result(size_t(size - 1), '\0');
+    WideCharToMultiByte(CP_UTF8, 0, str, -1, result.data(), size, nullptr, nullptr);
+    return result;
+}
+
+Result SaveFileAtomically(const wchar_t* path, ConstDataSpan data)
+{
+    const std::wstring temp_path = SPrintF(L"%s.%u.%u.tmp", path, GetCurrentProcessId(), GetCurrentThreadId());
+    {
+        std::unique_ptr<HANDLE, CloseHandleDeleter> file;
+        file.reset(CreateFile(temp_path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL, nullptr));
+        if (file.get() == INVALID_HANDLE_VALUE)
+            return MakeResultFromLastError();
+
+        // Write in a loop because WriteFile takes a DWORD for size (32-bit).
+        size_t total_written = 0;
+        while (total_written < data.size)
+        {
+            const size_t remaining = data.size - total_written;
+            const DWORD to_write = DWORD(remaining > UINT32_MAX ? UINT32_MAX : remaining);
+            DWORD bytes_written = 0;
+            if (!WriteFile(file.get(), (const char*)data.data + total_written, to_write, &bytes_written, nullptr))
+            {
+                const Result res = MakeResultFromLastError();
+                file.reset();
+                DeleteFile(temp_path.c_str());
+                return res;
+            }
+            total_written += bytes_written;
+        }
+    }
+
+    if (!MoveFileEx(temp_path.c_str(), path, MOVEFILE_REPLACE_EXISTING))
+    {
+        const Result res = MakeResultFromLastError();
+        DeleteFile(temp_path.c_str());
+        return res;
+    }
+    return kSuccess;
+}
+
 } // namespace jd3d12
@@ -0,0 +1,22 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+cbuffer JD3D12BindlessIndices : register(b0, space1)
+{
+    uint4 bindless_indices[4];
+};
+
+[numthreads(1, 1, 1)]
+void Main(uint3 dtid : SV_DispatchThreadID)
+{
+    ByteAddressBuffer src_buf = ResourceDescriptorHeap[bindless_indices[0].x];
+    RWByteAddressBuffer dst_buf = ResourceDescriptorHeap[bindless_indices[0].y];
+    uint address = dtid.x * 4;
+    uint value = src_buf.Load(address);
+    dst_buf.Store(address, value * 2 + 1);
+}
@@ -0,0 +1,23 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+cbuffer JD3D12DispatchParams : register(b2, space1)
+{
+    uint4 jd3d12_thread_offset;
+    uint4 jd3d12_thread_count;
+};
+RWByteAddressBuffer output_buffer : register(u0);
+
+[numthreads(2, 1, 1)]
+void Main(uint3 dtid : SV_DispatchThreadID)
+{
+    const uint3 id = dtid + jd3d12_thread_offset.xyz;
+    if(any(id >= jd3d12_thread_count.xyz))
+        return;
+    output_buffer.Store(id.x * 4, id.x * 3 + 1);
+}
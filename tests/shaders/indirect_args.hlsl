@@ -0,0 +1,22 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+
+cbuffer MyRootConstants : register(b1, space1)
+{
+    uint thread_count;
+    uint args_byte_offset;
+};
+RWByteAddressBuffer args_buffer : register(u0);
+
+// Writes D3D12_DISPATCH_ARGUMENTS for dispatch_threads.hlsl, which has numthreads(2, 1, 1).
+[numthreads(1, 1, 1)]
+void Main()
+{
+    args_buffer.Store3(args_byte_offset, uint3((thread_count + 1) / 2, 1, 1));
+}
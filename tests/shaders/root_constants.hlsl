@@ -0,0 +1,24 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+cbuffer MyConstants : register(b0)
+{
+    uint4 values;
+};
+cbuffer MyRootConstants : register(b1, space1)
+{
+    uint iteration_index;
+    uint multiplier;
+};
+RWByteAddressBuffer output_buffer : register(u0);
+
+[numthreads(1, 1, 1)]
+void Main()
+{
+    output_buffer.Store(iteration_index * 4, values.x + iteration_index * multiplier);
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2025-2026 Adam Sawicki
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, subject to the terms of the MIT License.
+//
+// See the LICENSE file in the project root for full license text.
+
+// Tests that need their own Environment with a specific EnvironmentDesc. Only one Environment can exist at
+// a time, so they are in a separate executable from test_main.cpp, which keeps one alive for all its tests.
+
+#include <jd3d12/jd3d12.hpp>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/catch_session.hpp>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+using namespace jd3d12;
+
+namespace
+{
+
+void WriteTextFile(const std::filesystem::path& path, const char* text)
+{
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    REQUIRE(file.is_open());
+    file.write(text, std::streamsize(strlen(text)));
+    REQUIRE(file.good());
+}
+
+size_t CountFilesInDirectory(const std::filesystem::path& directory)
+{
+    size_t file_count = 0;
+    for(const auto& entry : std::filesystem::directory_iterator(directory))
+    {
+        if(entry.is_regular_file())
+            ++file_count;
+    }
+    return file_count;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    return Catch::Session().run(argc, argv);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Tests
+
+TEST_CASE("Shader cache", "[hlsl]")
+{
+    const std::filesystem::path test_dir = std::filesystem::temp_directory_path() / L"jd3d12_test_shader_cache";
+    const std::filesystem::path cache_dir = test_dir / L"cache";
+    const std::filesystem::path source_path = test_dir / L"cache_test.hlsl";
+    const std::filesystem::path header_path = test_dir / L"cache_test_header.hlsl";
+    std::error_code error_code;
+    std::filesystem::remove_all(test_dir, error_code);
+    REQUIRE(std::filesystem::create_directories(test_dir, error_code));
+
+    WriteTextFile(source_path,
+        "#include \"cache_test_header.hlsl\"\n"
+        "RWBuffer<uint> buf : register(u0);\n"
+        "[numthreads(1, 1, 1)]\n"
+        "void Main(uint3 dtid : SV_DispatchThreadID)\n"
+        "{\n"
+        "    buf[dtid.x] = kValue;\n"
+        "}\n");
+    WriteTextFile(header_path, "static const uint kValue = 1;\n");
+
+    ShaderCompilationParams params{};
+    params.entry_point = L"Main";
+
+    auto compile = [&](Environment& env) -> std::vector<char>
+    {
+        ShaderCompilationResult* result_ptr = nullptr;
+        REQUIRE(Succeeded(env.CompileShaderFromFile(params, source_path.c_str(), result_ptr)));
+        std::unique_ptr<ShaderCompilationResult> result{result_ptr};
+        REQUIRE(Succeeded(result->GetResult()));
+        const ConstDataSpan bytecode = result->GetBytecode();
+        REQUIRE(bytecode.data != nullptr);
+        REQUIRE(bytecode.size > 0);
+        return std::vector<char>((const char*)bytecode.data, (const char*)bytecode.data + bytecode.size);
+    };
+    auto get_statistics = [](Environment& env) -> ShaderCompilationStatistics
+    {
+        ShaderCompilationStatistics stats;
+        env.GetShaderCompilationStatistics(stats);
+        return stats;
+    };
+
+    EnvironmentDesc env_desc{};
+    env_desc.flags = kEnvironmentFlagLogStandardOutput;
+    env_desc.log_severity = kLogSeverityMinWarning;
+    env_desc.shader_cache_directory = cache_dir.c_str();
+
+    std::vector<char> compiled_bytecode;
+    {
+        Environment* env_ptr = nullptr;
+        REQUIRE(Succeeded(CreateEnvironment(env_desc, env_ptr)));
+        std::unique_ptr<Environment> env{env_ptr};
+
+        compiled_bytecode = compile(*env);
+        CHECK(get_statistics(*env).dxc_compilation_count == 1);
+        CHECK(get_statistics(*env).shader_cache_hit_count == 0);
+
+        // Second time it comes from the in-memory cache, without invoking DXC.
+        CHECK(compile(*env) == compiled_bytecode);
+        CHECK(get_statistics(*env).dxc_compilation_count == 1);
+        CHECK(get_statistics(*env).shader_cache_hit_count == 1);
+    }
+
+    CHECK(CountFilesInDirectory(cache_dir) == 1);
+
+    // A new environment loads it from the file.
+    {
+        Environment* env_ptr = nullptr;
+        REQUIRE(Succeeded(CreateEnvironment(env_desc, env_ptr)));
+        std::unique_ptr<Environment> env{env_ptr};
+
+        CHECK(compile(*env) == compiled_bytecode);
+        CHECK(get_statistics(*env).dxc_compilation_count == 0);
+        CHECK(get_statistics(*env).shader_cache_hit_count == 1);
+
+        // Different macro defines produce a different entry.
+        const wchar_t* defines[] = { L"UNUSED_MACRO=1" };
+        params.macro_defines = { defines, _countof(defines) };
+        compile(*env);
+        CHECK(get_statistics(*env).dxc_compilation_count == 1);
+        params.macro_defines = {};
+
+        // Changing an included file invalidates the entry, even though the main source stays the same.
+        WriteTextFile(header_path, "static const uint kValue = 2;\n");
+        const std::vector<char> changed_bytecode = compile(*env);
+        CHECK(changed_bytecode != compiled_bytecode);
+        CHECK(get_statistics(*env).dxc_compilation_count == 2);
+        CHECK(get_statistics(*env).shader_cache_hit_count == 1);
+
+        // The entry is then replaced with the new bytecode.
+        CHECK(compile(*env) == changed_bytecode);
+        CHECK(get_statistics(*env).dxc_compilation_count == 2);
+        CHECK(get_statistics(*env).shader_cache_hit_count == 2);
+    }
+
+    CHECK(CountFilesInDirectory(cache_dir) == 2);
+
+    std::filesystem::remove_all(test_dir, error_code);
+}
+
+TEST_CASE("Asynchronous logging", "[log]")
+{
+    struct LogContext
+    {
+        std::thread::id thread_id;
+        uint32_t info_count = 0;
+        bool called_from_other_thread = false;
+    };
+    const auto callback = [](LogSeverity severity, const wchar_t* message, void* context)
+    {
+        LogContext* const ctx = (LogContext*)context;
+        if(std::this_thread::get_id() != ctx->thread_id)
+            ctx->called_from_other_thread = true;
+        if(severity == kLogSeverityInfo && wcsncmp(message, L"Test message ", 13) == 0)
+            ++ctx->info_count;
+    };
+
+    LogContext ctx;
+    ctx.thread_id = std::this_thread::get_id();
+
+    EnvironmentDesc env_desc{};
+    env_desc.flags = kEnvironmentFlagAsyncLogging;
+    env_desc.log_severity = kLogSeverityMinInfo;
+    env_desc.log_callback = callback;
+    env_desc.log_callback_context = &ctx;
+
+    constexpr uint32_t message_count = 1000;
+    uint64_t dropped_count = 0;
+
+    SECTION("All messages delivered")
+    {
+        // Room for all the test messages plus whatever the Environment logs during its initialization.
+        env_desc.async_log_capacity = message_count * 4;
+        {
+            Environment* env_ptr = nullptr;
+            REQUIRE(Succeeded(CreateEnvironment(env_desc, env_ptr)));
+            std::unique_ptr<Environment> env{env_ptr};
+            for(uint32_t i = 0; i < message_count; ++i)
+                env->LogF(kLogSeverityInfo, L"Test message %u", i);
+            dropped_count = env->GetDroppedLogMessageCount();
+        }
+        CHECK(dropped_count == 0);
+        CHECK(ctx.info_count == message_count);
+    }
+    SECTION("Messages dropped when queue is full")
+    {
+        env_desc.async_log_capacity = 4;
+        {
+            Environment* env_ptr = nullptr;
+            REQUIRE(Succeeded(CreateEnvironment(env_desc, env_ptr)));
+            std::unique_ptr<Environment> env{env_ptr};
+            for(uint32_t i = 0; i < message_count; ++i)
+                env->LogF(kLogSeverityInfo, L"Test message %u", i);
+            dropped_count = env->GetDroppedLogMessageCount();
+        }
+        // Dropped messages can also include the ones logged during the initialization.
+        CHECK(ctx.info_count + dropped_count >= message_count);
+    }
+    CHECK(ctx.called_from_other_thread);
+}
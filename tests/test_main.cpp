@@ -17,9 +17,14 @@
 #include <Windows.h>
 #include <atlbase.h>
 
+#include <algorithm>
 #include <array>
+#include <vector>
 #include <string>
 #include <memory>
+#include <filesystem>
+#include <fstream>
+#include <thread>
 
 #include <cstdint>
 #include <cmath>
@@ -261,6 +266,35 @@ TEST_CASE("Custom log message", "[logger]")
     g_env->LogF(kLogSeverityError, L"Test custom error message with hex=0x%08X, string=%s", u, s);
 }
 
+TEST_CASE("Adapter enumeration", "[gpu]")
+{
+    const uint32_t adapter_count = g_env->GetAdapterCount();
+    REQUIRE(adapter_count > 0);
+    CHECK(g_dev->GetDXGIAdapter1() == g_env->GetDXGIAdapter1());
+
+    AdapterDesc adapter_desc{};
+    for(uint32_t adapter_index = 0; adapter_index < adapter_count; ++adapter_index)
+    {
+        REQUIRE(Succeeded(g_env->GetAdapterDesc(adapter_index, adapter_desc)));
+        CHECK(adapter_desc.luid != 0);
+        // The default adapter was used to create g_dev, so it must be supported.
+        if(adapter_index == 0)
+            CHECK(adapter_desc.is_supported);
+        if(!adapter_desc.is_supported)
+            continue;
+        CHECK(adapter_desc.highest_shader_model >= kShaderModel6_0);
+
+        // Select the adapter by LUID this time.
+        DeviceDesc device_desc{};
+        device_desc.name = L"My device on another adapter";
+        device_desc.adapter_luid = adapter_desc.luid;
+        Device* device_ptr = nullptr;
+        REQUIRE(Succeeded(g_env->CreateDevice(device_desc, device_ptr)));
+        std::unique_ptr<Device> dev{ device_ptr };
+        CHECK(dev->GetDXGIAdapter1() != nullptr);
+    }
+}
+
 TEST_CASE("Getting parent object", "[buffer]")
 {
     CHECK(g_dev->GetEnvironment() == g_env);
@@ -816,6 +850,1380 @@ TEST_CASE("WriteMemoryToBuffer with a GPU read-write buffer", "[gpu][buffer]")
     CHECK(memcmp(dst_data.data(), src_data.data(), buf_desc.size) == 0);
 }
 
+// Bigger than the WriteBufferImmediate limit, so the upload ring is used, split into multiple chunks.
+TEST_CASE("WriteMemoryToBuffer with a big GPU buffer", "[gpu][buffer]")
+{
+    constexpr size_t kElementCount = 2 * kMegabyte;
+    using ElementType = uint32_t;
+    std::vector<ElementType> src_data(kElementCount);
+    for(size_t i = 0; i < kElementCount; ++i)
+        src_data[i] = ElementType(i * 7 + 3);
+
+    BufferDesc buf_desc = {
+        L"My GPU buffer", // name
+        kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc, // flags
+        kElementCount * sizeof(ElementType), // size
+    };
+    Buffer* buffer_ptr = nullptr;
+    // Initial data without kBufferUsageFlagCpuSequentialWrite also goes through the upload ring.
+    REQUIRE(Succeeded(g_dev->CreateBufferFromMemory(buf_desc,
+        ConstDataSpan{src_data.data(), buf_desc.size}, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{buffer_ptr};
+
+    for(size_t i = 0; i < kElementCount; i += 2)
+        src_data[i] = ElementType(i);
+    REQUIRE(Succeeded(g_dev->WriteMemoryToBuffer(
+        ConstDataSpan{src_data.data() + 1, buf_desc.size - 2 * sizeof(ElementType)}, *buf, sizeof(ElementType))));
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size},
+        *g_main_readback_buffer, 0)));
+    std::vector<ElementType> dst_data(kElementCount);
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    CHECK(dst_data[0] == 3);
+    CHECK(memcmp(dst_data.data() + 1, src_data.data() + 1, buf_desc.size - 2 * sizeof(ElementType)) == 0);
+}
+
+// Bigger than a quarter of the default upload ring, so the file is read in multiple chunks.
+TEST_CASE("CreateBufferFromFile", "[gpu][buffer]")
+{
+    constexpr size_t kElementCount = 9 * kMegabyte / sizeof(uint32_t);
+    std::vector<uint32_t> src_data(kElementCount);
+    for(size_t i = 0; i < kElementCount; ++i)
+        src_data[i] = uint32_t(i * 5 + 1);
+    const size_t data_size = kElementCount * sizeof(uint32_t);
+    REQUIRE(data_size <= kMainBufSize);
+
+    const std::filesystem::path file_path = std::filesystem::temp_directory_path() / L"jd3d12_test_buffer_data.bin";
+    {
+        std::ofstream file{file_path, std::ios::binary | std::ios::trunc};
+        REQUIRE(file.is_open());
+        file.write((const char*)src_data.data(), std::streamsize(data_size));
+        REQUIRE(file.good());
+    }
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer from file";
+    buf_desc.size = data_size;
+    SECTION("GPU buffer, through the upload ring")
+    {
+        buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc;
+    }
+    SECTION("Mapped buffer")
+    {
+        buf_desc.flags = kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCopySrc;
+    }
+
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBufferFromFile(buf_desc, file_path.c_str(), buffer_ptr)));
+    std::unique_ptr<Buffer> buf{buffer_ptr};
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, data_size}, *g_main_readback_buffer, 0)));
+    std::vector<uint32_t> dst_data(kElementCount);
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer, Range{0, data_size}, dst_data.data())));
+    CHECK(dst_data == src_data);
+
+    std::error_code error_code;
+    std::filesystem::remove(file_path, error_code);
+}
+
+TEST_CASE("WriteMemoryToBufferConverted and ReadBufferToMemoryConverted", "[gpu][buffer]")
+{
+    SECTION("Float to half, through the upload ring and a staging buffer")
+    {
+        // The converted data spans multiple upload ring chunks and is converted on multiple threads.
+        constexpr size_t kElementCount = 2 * kMegabyte;
+        std::vector<FloatVec4> src_data(kElementCount);
+        for(size_t i = 0; i < kElementCount; ++i)
+        {
+            // All values are exactly representable as half floats.
+            const float value = float(i % 2048) * 0.5f;
+            src_data[i] = FloatVec4{value, -value, value * 0.25f, 1.f};
+        }
+
+        BufferDesc buf_desc{};
+        buf_desc.name = L"My buffer R16G16B16A16_Float";
+        buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagTyped;
+        buf_desc.size = kElementCount * 4 * sizeof(uint16_t);
+        buf_desc.element_format = Format::kR16G16B16A16_Float;
+        Buffer* buffer_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+        std::unique_ptr<Buffer> buf{buffer_ptr};
+
+        REQUIRE(Succeeded(g_dev->WriteMemoryToBufferConverted(
+            ConstDataSpan{src_data.data(), kElementCount * sizeof(FloatVec4)},
+            Format::kR32G32B32A32_Float, *buf, 0)));
+
+        std::vector<FloatVec4> dst_data(kElementCount);
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemoryConverted(*buf, kFullRange,
+            Format::kR32G32B32A32_Float, dst_data.data())));
+        CHECK(memcmp(dst_data.data(), src_data.data(), kElementCount * sizeof(FloatVec4)) == 0);
+    }
+
+    SECTION("Float to unorm, through a mapped buffer")
+    {
+        constexpr size_t kElementCount = 256;
+        std::vector<float> src_data(kElementCount * 4);
+        for(size_t i = 0; i < src_data.size(); ++i)
+            src_data[i] = float(i % 256) / 255.f;
+        // Out-of-range values are clamped.
+        src_data[0] = -1.f;
+        src_data[1] = 2.f;
+
+        BufferDesc buf_desc{};
+        buf_desc.name = L"My buffer R8G8B8A8_Unorm";
+        buf_desc.flags = kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCopySrc | kBufferFlagTyped;
+        buf_desc.size = kElementCount * 4;
+        buf_desc.element_format = Format::kR8G8B8A8_Unorm;
+        Buffer* buffer_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+        std::unique_ptr<Buffer> buf{buffer_ptr};
+
+        REQUIRE(Succeeded(g_dev->WriteMemoryToBufferConverted(
+            ConstDataSpan{src_data.data(), src_data.size() * sizeof(float)}, Format::kR32G32B32A32_Float, *buf, 0)));
+
+        // Read only the second half.
+        std::vector<float> dst_data(kElementCount * 4 / 2);
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemoryConverted(*buf, Range{buf_desc.size / 2, buf_desc.size / 2},
+            Format::kR32G32B32A32_Float, dst_data.data())));
+        CHECK(memcmp(dst_data.data(), src_data.data() + src_data.size() / 2, dst_data.size() * sizeof(float)) == 0);
+
+        float first_values[4] = {};
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemoryConverted(*buf, Range{0, 4},
+            Format::kR32G32B32A32_Float, first_values)));
+        CHECK(first_values[0] == 0.f);
+        CHECK(first_values[1] == 1.f);
+    }
+}
+
+// Works the same whether GPU_UPLOAD heap is supported or not.
+TEST_CASE("Device with kDeviceFlagPreferGpuUploadHeap", "[gpu][buffer]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"My device with GPU_UPLOAD";
+    device_desc.flags = kDeviceFlagPreferGpuUploadHeap;
+    Device* device_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, device_ptr)));
+    std::unique_ptr<Device> dev{ device_ptr };
+
+    constexpr size_t kElementCount = 1024;
+    std::array<uint32_t, kElementCount> src_data;
+    for(uint32_t i = 0; i < kElementCount; ++i)
+        src_data[i] = i * 5 + 2;
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer written by the CPU";
+    buf_desc.flags = kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagShaderRWResource
+        | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = kElementCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.name = L"My buffer READBACK";
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = buf_desc.size;
+    REQUIRE(Succeeded(dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf{ buffer_ptr };
+
+    REQUIRE(Succeeded(dev->ClearBufferToUintValues(*buf, UintVec4{0, 0, 0, 0})));
+    REQUIRE(Succeeded(dev->WriteMemoryToBuffer(ConstDataSpan{src_data.data(), buf_desc.size}, *buf, 0)));
+    REQUIRE(Succeeded(dev->CopyBuffer(*buf, *readback_buf)));
+
+    std::array<uint32_t, kElementCount> dst_data;
+    REQUIRE(Succeeded(dev->ReadBufferToMemory(*readback_buf, kFullRange, dst_data.data())));
+    CHECK(memcmp(dst_data.data(), src_data.data(), buf_desc.size) == 0);
+}
+
+TEST_CASE("Memory statistics", "[gpu][buffer]")
+{
+    MemoryStatistics stats_before{};
+    g_dev->GetMemoryStatistics(stats_before);
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My placed buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress;
+    buf_desc.size = 1000;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> placed_buf{ buffer_ptr };
+
+    buf_desc.name = L"My dedicated buffer";
+    buf_desc.flags |= kBufferFlagDedicatedMemory;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> dedicated_buf{ buffer_ptr };
+
+    MemoryStatistics stats{};
+    g_dev->GetMemoryStatistics(stats);
+    CHECK(stats.placed_buffer_count == stats_before.placed_buffer_count + 1);
+    CHECK(stats.placed_buffer_bytes == stats_before.placed_buffer_bytes + 1000);
+    CHECK(stats.committed_buffer_count == stats_before.committed_buffer_count + 1);
+    CHECK(stats.committed_buffer_bytes == stats_before.committed_buffer_bytes + 1000);
+    CHECK(stats.block_count >= 1);
+    CHECK(stats.allocated_bytes >= stats.placed_buffer_bytes);
+    CHECK(stats.block_bytes >= stats.allocated_bytes);
+    CHECK(stats.fragmentation >= 0.f);
+    CHECK(stats.fragmentation <= 1.f);
+
+    placed_buf.reset();
+    dedicated_buf.reset();
+    g_dev->GetMemoryStatistics(stats);
+    CHECK(stats.placed_buffer_count == stats_before.placed_buffer_count);
+    CHECK(stats.committed_buffer_count == stats_before.committed_buffer_count);
+}
+
+// A new device, so that the second buffer is placed in the memory of the first one.
+TEST_CASE("Placed buffer reusing memory is zero-initialized", "[gpu][buffer]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"Device for placed buffers";
+    Device* dev_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, dev_ptr)));
+    std::unique_ptr<Device> dev{dev_ptr};
+
+    constexpr size_t kElementCount = 1024;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My placed buffer";
+    buf_desc.size = kElementCount * sizeof(uint32_t);
+    SECTION("GPU memory")
+    {
+        buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    }
+    SECTION("Mapped memory")
+    {
+        buf_desc.flags = kBufferUsageFlagCpuSequentialWrite | kBufferUsageFlagCopySrc;
+    }
+
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.name = L"My readback buffer";
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = buf_desc.size;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf{buffer_ptr};
+
+    std::vector<uint32_t> src_data(kElementCount, 0xDEADBEEF);
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{buffer_ptr};
+    REQUIRE(Succeeded(dev->WriteMemoryToBuffer(ConstDataSpan{src_data.data(), buf_desc.size}, *buf, 0)));
+    REQUIRE(Succeeded(dev->WaitForGPU()));
+    buf.reset();
+
+    MemoryStatistics stats_before{};
+    dev->GetMemoryStatistics(stats_before);
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buffer_ptr)));
+    buf.reset(buffer_ptr);
+    MemoryStatistics stats{};
+    dev->GetMemoryStatistics(stats);
+    CHECK(stats.placed_buffer_count == stats_before.placed_buffer_count + 1);
+    CHECK(stats.block_count == stats_before.block_count);
+
+    REQUIRE(Succeeded(dev->CopyBuffer(*buf, *readback_buf)));
+    std::vector<uint32_t> dst_data(kElementCount, UINT32_MAX);
+    REQUIRE(Succeeded(dev->ReadBufferToMemory(*readback_buf, kFullRange, dst_data.data())));
+    CHECK(dst_data == std::vector<uint32_t>(kElementCount, 0));
+}
+
+TEST_CASE("Device statistics", "[gpu][buffer]")
+{
+    DeviceStatistics stats_before{};
+    REQUIRE(Succeeded(g_dev->GetStatistics(stats_before)));
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer";
+    buf_desc.flags = kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst;
+    buf_desc.size = 16;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    // Small enough for WriteBufferImmediate. Then COPY_DEST -> COPY_SOURCE needs a transition.
+    const std::array<uint32_t, 4> src_data = { 1, 2, 3, 4 };
+    REQUIRE(Succeeded(g_dev->WriteMemoryToBuffer(ConstDataSpan{src_data.data(), buf_desc.size}, *buf, 0)));
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::array<uint32_t, 4> dst_data;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    CHECK(dst_data == src_data);
+
+    DeviceStatistics stats{};
+    REQUIRE(Succeeded(g_dev->GetStatistics(stats)));
+    CHECK(stats.submitted_batch_count > stats_before.submitted_batch_count);
+    CHECK(stats.total.bytes_written_immediate == stats_before.total.bytes_written_immediate + buf_desc.size);
+    CHECK(stats.total.transition_barrier_count > stats_before.total.transition_barrier_count);
+    CHECK(stats.last_batch.bytes_written_immediate >= buf_desc.size);
+    CHECK(stats.bytes_read == stats_before.bytes_read + buf_desc.size);
+    CHECK(stats.cpu_wait_milliseconds >= stats_before.cpu_wait_milliseconds);
+    CHECK(stats.dynamic_descriptor_capacity > 0);
+    CHECK(stats.peak_dynamic_descriptor_count <= stats.dynamic_descriptor_capacity);
+    CHECK(stats.persistent_descriptor_count <= stats.peak_persistent_descriptor_count);
+    CHECK(stats.local_memory_budget > 0);
+}
+
+TEST_CASE("Parallel primitives", "[gpu][buffer][hlsl]")
+{
+    // More than one block of 2048 elements, with a partial one at the end.
+    constexpr uint32_t kElementCount = 5000;
+    constexpr size_t kBufSize = kElementCount * sizeof(uint32_t);
+
+    BufferDesc buf_desc{};
+    buf_desc.flags = kBufferUsageFlagShaderResource | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress
+        | kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst;
+    buf_desc.size = kBufSize;
+    auto create_buffer = [&](const wchar_t* name, const void* data) -> std::unique_ptr<Buffer>
+    {
+        buf_desc.name = name;
+        Buffer* buf_ptr = nullptr;
+        if(data != nullptr)
+            REQUIRE(Succeeded(g_dev->CreateBufferFromMemory(buf_desc, ConstDataSpan{ data, kBufSize }, buf_ptr)));
+        else
+            REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buf_ptr)));
+        return std::unique_ptr<Buffer>{ buf_ptr };
+    };
+    auto read_buffer = [](Buffer& buf, size_t size, void* dst_memory)
+    {
+        REQUIRE(Succeeded(g_dev->CopyBufferRegion(buf, Range{ 0, size }, *g_main_readback_buffer, 0)));
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer, Range{ 0, size }, dst_memory)));
+    };
+
+    std::vector<uint32_t> src_data(kElementCount);
+    uint32_t seed = 123;
+    for(uint32_t i = 0; i < kElementCount; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        src_data[i] = seed >> 20;
+    }
+    std::unique_ptr<Buffer> src_buf = create_buffer(L"Primitives source", src_data.data());
+    std::unique_ptr<Buffer> dst_buf = create_buffer(L"Primitives destination", nullptr);
+
+    SECTION("Reduce")
+    {
+        uint32_t expected_sum = 0;
+        uint32_t expected_min = UINT32_MAX;
+        uint32_t expected_max = 0;
+        for(uint32_t val : src_data)
+        {
+            expected_sum += val;
+            expected_min = std::min(expected_min, val);
+            expected_max = std::max(expected_max, val);
+        }
+
+        REQUIRE(Succeeded(g_dev->Reduce(*src_buf, kFullRange, kPrimitiveDataTypeUint, kReduceOperationSum,
+            *dst_buf, 0)));
+        REQUIRE(Succeeded(g_dev->Reduce(*src_buf, kFullRange, kPrimitiveDataTypeUint, kReduceOperationMin,
+            *dst_buf, 4)));
+        REQUIRE(Succeeded(g_dev->Reduce(*src_buf, kFullRange, kPrimitiveDataTypeUint, kReduceOperationMax,
+            *dst_buf, 8)));
+        std::array<uint32_t, 3> results;
+        read_buffer(*dst_buf, sizeof(results), results.data());
+        CHECK(results[0] == expected_sum);
+        CHECK(results[1] == expected_min);
+        CHECK(results[2] == expected_max);
+    }
+
+    SECTION("Scan")
+    {
+        std::vector<uint32_t> results(kElementCount);
+        REQUIRE(Succeeded(g_dev->InclusiveScan(*src_buf, kFullRange, kPrimitiveDataTypeUint, *dst_buf, 0)));
+        read_buffer(*dst_buf, kBufSize, results.data());
+        uint32_t sum = 0;
+        bool all_equal = true;
+        for(uint32_t i = 0; i < kElementCount; ++i)
+        {
+            sum += src_data[i];
+            all_equal = all_equal && results[i] == sum;
+        }
+        CHECK(all_equal);
+
+        // Starting from an offset, not aligned to a block.
+        const Range src_range = { 12, kBufSize - 12 };
+        REQUIRE(Succeeded(g_dev->ExclusiveScan(*src_buf, src_range, kPrimitiveDataTypeUint, *dst_buf, 0)));
+        read_buffer(*dst_buf, src_range.count, results.data());
+        sum = 0;
+        all_equal = true;
+        for(uint32_t i = 0; i < src_range.count / 4; ++i)
+        {
+            all_equal = all_equal && results[i] == sum;
+            sum += src_data[i + 3];
+        }
+        CHECK(all_equal);
+    }
+
+    SECTION("Radix sort")
+    {
+        std::vector<uint32_t> value_data(kElementCount);
+        for(uint32_t i = 0; i < kElementCount; ++i)
+            value_data[i] = i;
+        std::unique_ptr<Buffer> values_buf = create_buffer(L"Primitives values", value_data.data());
+
+        // The keys have 12 bits.
+        REQUIRE(Succeeded(g_dev->RadixSort(*src_buf, kFullRange, values_buf.get(), 0, 12)));
+        std::vector<uint32_t> sorted_keys(kElementCount);
+        std::vector<uint32_t> sorted_values(kElementCount);
+        read_buffer(*src_buf, kBufSize, sorted_keys.data());
+        read_buffer(*values_buf, kBufSize, sorted_values.data());
+
+        // A stable sort of the indices by key gives the same values.
+        std::stable_sort(value_data.begin(), value_data.end(),
+            [&](uint32_t lhs, uint32_t rhs) { return src_data[lhs] < src_data[rhs]; });
+        std::sort(src_data.begin(), src_data.end());
+        CHECK(sorted_keys == src_data);
+        CHECK(sorted_values == value_data);
+    }
+
+    SECTION("Compact")
+    {
+        std::vector<uint32_t> flag_data(kElementCount);
+        std::vector<uint32_t> expected;
+        for(uint32_t i = 0; i < kElementCount; ++i)
+        {
+            flag_data[i] = src_data[i] % 3 == 0 ? i + 1 : 0;
+            if(flag_data[i] != 0)
+                expected.push_back(src_data[i]);
+        }
+        std::unique_ptr<Buffer> flags_buf = create_buffer(L"Primitives flags", flag_data.data());
+        std::unique_ptr<Buffer> count_buf = create_buffer(L"Primitives count", nullptr);
+
+        REQUIRE(Succeeded(g_dev->Compact(*src_buf, kFullRange, *flags_buf, 0, *dst_buf, 0, *count_buf, 0)));
+        uint32_t count = 0;
+        read_buffer(*count_buf, sizeof(count), &count);
+        REQUIRE(count == expected.size());
+        std::vector<uint32_t> results(count);
+        read_buffer(*dst_buf, count * sizeof(uint32_t), results.data());
+        CHECK(results == expected);
+    }
+}
+
+TEST_CASE("Bindless device", "[gpu][buffer][hlsl]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"My bindless device";
+    device_desc.flags = kDeviceFlagBindless;
+    Device* device_ptr = nullptr;
+    const Result res = g_env->CreateDevice(device_desc, device_ptr);
+    if(res == kErrorUnsupported)
+        SKIP("Bindless mode is not supported by this GPU.");
+    REQUIRE(Succeeded(res));
+    std::unique_ptr<Device> dev{ device_ptr };
+
+    std::unique_ptr<Shader> shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main";
+        compilation_params.shader_model = kShaderModel6_6;
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Bindless shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/bindless.hlsl", shader_ptr)));
+        shader.reset(shader_ptr);
+    }
+
+    constexpr size_t kElementCount = 64;
+    std::array<uint32_t, kElementCount> src_data;
+    for(uint32_t i = 0; i < kElementCount; ++i)
+        src_data[i] = i * 3;
+
+    BufferDesc src_buf_desc{};
+    src_buf_desc.name = L"My bindless SRV buffer";
+    src_buf_desc.flags = kBufferUsageFlagShaderResource | kBufferFlagByteAddress;
+    src_buf_desc.size = kElementCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBufferFromMemory(src_buf_desc,
+        ConstDataSpan{src_data.data(), src_buf_desc.size}, buffer_ptr)));
+    std::unique_ptr<Buffer> src_buf{ buffer_ptr };
+    CHECK(src_buf->GetBindlessSrvIndex() != UINT32_MAX);
+    CHECK(src_buf->GetBindlessUavIndex() == UINT32_MAX);
+
+    BufferDesc dst_buf_desc{};
+    dst_buf_desc.name = L"My bindless UAV buffer";
+    dst_buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    dst_buf_desc.size = src_buf_desc.size;
+    REQUIRE(Succeeded(dev->CreateBuffer(dst_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> dst_buf{ buffer_ptr };
+    CHECK(dst_buf->GetBindlessUavIndex() != UINT32_MAX);
+
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.name = L"My buffer READBACK";
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = dst_buf_desc.size;
+    REQUIRE(Succeeded(dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf{ buffer_ptr };
+
+    REQUIRE(Succeeded(dev->BindBindlessBuffer(0, src_buf.get())));
+    REQUIRE(Succeeded(dev->BindBindlessRWBuffer(1, dst_buf.get())));
+    REQUIRE(Succeeded(dev->DispatchComputeShader(*shader, { kElementCount, 1, 1 })));
+    dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(dev->CopyBuffer(*dst_buf, *readback_buf)));
+    std::array<uint32_t, kElementCount> dst_data;
+    REQUIRE(Succeeded(dev->ReadBufferToMemory(*readback_buf, kFullRange, dst_data.data())));
+    for(uint32_t i = 0; i < kElementCount; ++i)
+        CHECK(dst_data[i] == src_data[i] * 2 + 1);
+}
+
+TEST_CASE("Root constants and constant data", "[gpu][buffer][hlsl]")
+{
+    std::unique_ptr<Shader> shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Root constants shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/root_constants.hlsl", shader_ptr)));
+        shader.reset(shader_ptr);
+    }
+
+    constexpr uint32_t kIterationCount = 16;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My output buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = kIterationCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    constexpr uint32_t kMultiplier = 3;
+    REQUIRE(Succeeded(g_dev->SetRootConstants(ConstDataSpan{&kMultiplier, sizeof(kMultiplier)}, 1)));
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    for(uint32_t i = 0; i < kIterationCount; ++i)
+    {
+        // Change the constant buffer data every 4 iterations.
+        if(i % 4 == 0)
+        {
+            const UintVec4 values = { 1000 * (i / 4 + 1), 0, 0, 0 };
+            REQUIRE(Succeeded(g_dev->BindConstantValue(0, values)));
+        }
+        REQUIRE(Succeeded(g_dev->SetRootConstants(ConstDataSpan{&i, sizeof(i)})));
+        REQUIRE(Succeeded(g_dev->DispatchComputeShader(*shader, { 1, 1, 1 })));
+    }
+    g_dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::array<uint32_t, kIterationCount> dst_data;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(uint32_t i = 0; i < kIterationCount; ++i)
+        CHECK(dst_data[i] == 1000 * (i / 4 + 1) + i * kMultiplier);
+}
+
+// More than 65535 groups, so the dispatch gets split. The thread count is not a multiple of the group size.
+TEST_CASE("DispatchThreads", "[gpu][buffer][hlsl]")
+{
+    std::unique_ptr<Shader> shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"DispatchThreads shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/dispatch_threads.hlsl", shader_ptr)));
+        shader.reset(shader_ptr);
+    }
+    REQUIRE(shader->GetThreadGroupSize() == UintVec3{ 2, 1, 1 });
+
+    constexpr uint32_t kThreadCount = 140001;
+    // One more element, which must stay untouched.
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My output buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = (kThreadCount + 1) * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{ 0, 0, 0, 0 })));
+
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    REQUIRE(Succeeded(g_dev->DispatchThreads(*shader, { kThreadCount, 1, 1 })));
+    g_dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::vector<uint32_t> dst_data(kThreadCount + 1);
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(uint32_t i = 0; i < kThreadCount; ++i)
+        CHECK(dst_data[i] == i * 3 + 1);
+    CHECK(dst_data[kThreadCount] == 0);
+}
+
+TEST_CASE("DispatchIndirect", "[gpu][buffer][hlsl]")
+{
+    ShaderCompilationParams compilation_params{};
+    compilation_params.entry_point = L"Main";
+
+    std::unique_ptr<Shader> args_shader;
+    {
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Indirect args shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/indirect_args.hlsl", shader_ptr)));
+        args_shader.reset(shader_ptr);
+    }
+    std::unique_ptr<Shader> shader;
+    {
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"DispatchThreads shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/dispatch_threads.hlsl", shader_ptr)));
+        shader.reset(shader_ptr);
+    }
+
+    // Arguments at a non-zero offset.
+    constexpr uint32_t kArgsByteOffset = 4;
+    BufferDesc args_buf_desc{};
+    args_buf_desc.name = L"My indirect args buffer";
+    args_buf_desc.flags = kBufferUsageFlagIndirectArgs | kBufferUsageFlagShaderRWResource
+        | kBufferUsageFlagShaderResource | kBufferFlagByteAddress;
+    args_buf_desc.size = 4 * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(args_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> args_buf{ buffer_ptr };
+
+    // The thread count is rounded up to the group size, so the shader writes 1002 elements.
+    constexpr uint32_t kThreadCount = 1001;
+    constexpr uint32_t kElementCount = 1004;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My output buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = kElementCount * sizeof(uint32_t);
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{ 0, 0, 0, 0 })));
+
+    const uint32_t root_constants[] = { kThreadCount, kArgsByteOffset };
+    REQUIRE(Succeeded(g_dev->SetRootConstants(ConstDataSpan{root_constants, sizeof(root_constants)})));
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, args_buf.get())));
+    REQUIRE(Succeeded(g_dev->DispatchComputeShader(*args_shader, { 1, 1, 1 })));
+    g_dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    REQUIRE(Succeeded(g_dev->DispatchIndirect(*shader, *args_buf, kArgsByteOffset)));
+    g_dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::vector<uint32_t> dst_data(kElementCount);
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(uint32_t i = 0; i < kThreadCount + 1; ++i)
+        CHECK(dst_data[i] == i * 3 + 1);
+    CHECK(dst_data[kElementCount - 2] == 0);
+    CHECK(dst_data[kElementCount - 1] == 0);
+
+    // The arguments buffer cannot be bound at the same time, even as read-only.
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    REQUIRE(Succeeded(g_dev->BindBuffer(0, args_buf.get())));
+    CHECK(g_dev->DispatchIndirect(*shader, *args_buf, kArgsByteOffset) == kErrorInvalidArgument);
+    g_dev->ResetAllBindings();
+}
+
+TEST_CASE("Recording", "[gpu][buffer][hlsl]")
+{
+    std::unique_ptr<Shader> typed_shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main_Typed";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Typed shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/Test.hlsl", shader_ptr)));
+        typed_shader.reset(shader_ptr);
+    }
+
+    constexpr size_t kElementCount = 64;
+    const std::vector<float> zeros(kElementCount, 0.f);
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My typed buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst
+        | kBufferFlagTyped;
+    buf_desc.size = kElementCount * sizeof(float);
+    buf_desc.element_format = Format::kR32_Float;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBufferFromMemory(buf_desc, ConstDataSpan{zeros.data(), buf_desc.size},
+        buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+    buf_desc.name = L"My copy buffer";
+    REQUIRE(Succeeded(g_dev->CreateBufferFromMemory(buf_desc, ConstDataSpan{zeros.data(), buf_desc.size},
+        buffer_ptr)));
+    std::unique_ptr<Buffer> copy_buf{ buffer_ptr };
+
+    // Each execution calculates f = f * f + 1 in the buffer and copies the result.
+    REQUIRE(Succeeded(g_dev->BeginRecording()));
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    REQUIRE(Succeeded(g_dev->DispatchComputeShader(*typed_shader, { uint32_t(kElementCount), 1, 1 })));
+    g_dev->ResetAllBindings();
+    REQUIRE(Succeeded(g_dev->CopyBuffer(*buf, *copy_buf)));
+    Recording* recording_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->EndRecording(recording_ptr)));
+    std::unique_ptr<Recording> recording{ recording_ptr };
+    CHECK(recording->GetDevice() == g_dev);
+
+    std::vector<float> dst_data(kElementCount);
+    // Nothing is executed by the recording itself.
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*copy_buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    CHECK(dst_data[0] == 0.f);
+
+    // 0 -> 1 -> 2 -> 5
+    for(uint32_t i = 0; i < 3; ++i)
+        REQUIRE(Succeeded(g_dev->Execute(*recording)));
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*copy_buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(size_t i = 0; i < kElementCount; ++i)
+        CHECK(dst_data[i] == 5.f);
+}
+
+// Bindings of a recording belong to it, so the threads don't interfere with each other.
+TEST_CASE("Recordings on multiple threads", "[gpu][buffer][hlsl]")
+{
+    std::unique_ptr<Shader> typed_shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main_Typed";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Typed shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/Test.hlsl", shader_ptr)));
+        typed_shader.reset(shader_ptr);
+    }
+
+    constexpr size_t kThreadCount = 4;
+    constexpr size_t kElementCount = 64;
+    const std::vector<float> zeros(kElementCount, 0.f);
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My typed buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagTyped;
+    buf_desc.size = kElementCount * sizeof(float);
+    buf_desc.element_format = Format::kR32_Float;
+    std::array<std::unique_ptr<Buffer>, kThreadCount> bufs;
+    for(size_t i = 0; i < kThreadCount; ++i)
+    {
+        Buffer* buffer_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CreateBufferFromMemory(buf_desc, ConstDataSpan{zeros.data(), buf_desc.size},
+            buffer_ptr)));
+        bufs[i].reset(buffer_ptr);
+    }
+
+    // Catch2 assertions are not thread-safe, so the threads only store their results.
+    std::array<std::unique_ptr<Recording>, kThreadCount> recordings;
+    std::array<bool, kThreadCount> thread_succeeded = {};
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < kThreadCount; ++i)
+    {
+        threads.emplace_back([&, i]()
+        {
+            if(Failed(g_dev->BeginRecording()))
+                return;
+            bool ok = Succeeded(g_dev->BindRWBuffer(0, bufs[i].get()));
+            ok = ok && Succeeded(g_dev->DispatchComputeShader(*typed_shader, { uint32_t(kElementCount), 1, 1 }));
+            Recording* recording_ptr = nullptr;
+            ok = Succeeded(g_dev->EndRecording(recording_ptr)) && ok;
+            recordings[i].reset(recording_ptr);
+            thread_succeeded[i] = ok;
+        });
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+    for(size_t i = 0; i < kThreadCount; ++i)
+    {
+        REQUIRE(thread_succeeded[i]);
+        REQUIRE(recordings[i]);
+    }
+
+    // 0 -> 1 -> 2
+    for(uint32_t iteration = 0; iteration < 2; ++iteration)
+    {
+        for(size_t i = 0; i < kThreadCount; ++i)
+            REQUIRE(Succeeded(g_dev->Execute(*recordings[i])));
+    }
+
+    std::vector<float> dst_data(kElementCount);
+    for(size_t i = 0; i < kThreadCount; ++i)
+    {
+        REQUIRE(Succeeded(g_dev->CopyBufferRegion(*bufs[i], Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+            Range{0, buf_desc.size}, dst_data.data())));
+        for(size_t j = 0; j < kElementCount; ++j)
+            CHECK(dst_data[j] == 2.f);
+    }
+}
+
+// Each dispatch writes a different element, so UAV barriers between them can be skipped.
+TEST_CASE("BindRWBuffer with kBindFlagNoUavHazard", "[gpu][buffer][hlsl]")
+{
+    std::unique_ptr<Shader> shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Root constants shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(g_dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/root_constants.hlsl", shader_ptr)));
+        shader.reset(shader_ptr);
+    }
+
+    constexpr uint32_t kIterationCount = 16;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My output buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = kIterationCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    REQUIRE(g_dev->BindRWBuffer(0, buf.get()) == kSuccess);
+    // Changing only the flags still counts as a change.
+    REQUIRE(g_dev->BindRWBuffer(0, buf.get(), kFullRange, kBindFlagNoUavHazard) == kSuccess);
+    REQUIRE(g_dev->BindRWBuffer(0, buf.get(), kFullRange, kBindFlagNoUavHazard) == kFalse);
+
+    constexpr uint32_t kMultiplier = 5;
+    REQUIRE(Succeeded(g_dev->SetRootConstants(ConstDataSpan{&kMultiplier, sizeof(kMultiplier)}, 1)));
+    REQUIRE(Succeeded(g_dev->BindConstantValue(0, UintVec4{ 7, 0, 0, 0 })));
+    for(uint32_t i = 0; i < kIterationCount; ++i)
+    {
+        REQUIRE(Succeeded(g_dev->SetRootConstants(ConstDataSpan{&i, sizeof(i)})));
+        REQUIRE(Succeeded(g_dev->DispatchComputeShader(*shader, { 1, 1, 1 })));
+    }
+    g_dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::array<uint32_t, kIterationCount> dst_data;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(uint32_t i = 0; i < kIterationCount; ++i)
+        CHECK(dst_data[i] == 7 + i * kMultiplier);
+}
+
+// More distinct views than fit in one batch's partition of the descriptor heap, so the batch gets split.
+TEST_CASE("Descriptor heap exhaustion splits the batch", "[gpu][buffer][hlsl]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"My device with many batches";
+    device_desc.command_batch_count = 16;
+    Device* device_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, device_ptr)));
+    std::unique_ptr<Device> dev{ device_ptr };
+
+    std::unique_ptr<Shader> typed_shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main_Typed";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Typed shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/Test.hlsl", shader_ptr)));
+        typed_shader.reset(shader_ptr);
+    }
+
+    constexpr size_t kElementCount = 5000;
+    std::vector<float> src_data(kElementCount);
+    for(size_t i = 0; i < kElementCount; ++i)
+        src_data[i] = float(i % 100);
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My typed buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagTyped;
+    buf_desc.size = kElementCount * sizeof(float);
+    buf_desc.element_format = Format::kR32_Float;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBufferFromMemory(buf_desc,
+        ConstDataSpan{src_data.data(), buf_desc.size}, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.name = L"My buffer READBACK";
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = buf_desc.size;
+    REQUIRE(Succeeded(dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf{ buffer_ptr };
+
+    // Each element gets its own view, so the element is at index 0 of the view.
+    for(size_t i = 0; i < kElementCount; ++i)
+    {
+        REQUIRE(Succeeded(dev->BindRWBuffer(0, buf.get(), Range{i * sizeof(float), sizeof(float)})));
+        REQUIRE(Succeeded(dev->DispatchComputeShader(*typed_shader, { 1, 1, 1 })));
+    }
+    dev->ResetAllBindings();
+
+    REQUIRE(Succeeded(dev->CopyBuffer(*buf, *readback_buf)));
+    std::vector<float> dst_data(kElementCount);
+    REQUIRE(Succeeded(dev->ReadBufferToMemory(*readback_buf, kFullRange, dst_data.data())));
+    for(size_t i = 0; i < kElementCount; ++i)
+        CHECK(dst_data[i] == src_data[i] * src_data[i] + 1.f);
+}
+
+// Big copies go to the copy queue, with waits between the queues in both directions.
+TEST_CASE("Device with kDeviceFlagEnableCopyQueue", "[gpu][buffer][hlsl]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"My device with copy queue";
+    device_desc.flags = kDeviceFlagEnableCopyQueue;
+    Device* device_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, device_ptr)));
+    std::unique_ptr<Device> dev{ device_ptr };
+
+    std::unique_ptr<Shader> typed_shader;
+    {
+        ShaderCompilationParams compilation_params{};
+        compilation_params.entry_point = L"Main_Typed";
+
+        ShaderDesc shader_desc{};
+        shader_desc.name = L"Typed shader";
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(dev->CompileAndCreateShaderFromFile(compilation_params,
+            shader_desc, L"shaders/Test.hlsl", shader_ptr)));
+        typed_shader.reset(shader_ptr);
+    }
+
+    constexpr size_t kElementCount = 256 * 1024;
+    std::vector<float> src_data(kElementCount);
+    for(size_t i = 0; i < kElementCount; ++i)
+        src_data[i] = float(i % 100);
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My typed buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst
+        | kBufferFlagTyped;
+    buf_desc.size = kElementCount * sizeof(float);
+    buf_desc.element_format = Format::kR32_Float;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBufferFromMemory(buf_desc,
+        ConstDataSpan{src_data.data(), buf_desc.size}, buffer_ptr)));
+    std::unique_ptr<Buffer> src_buf{ buffer_ptr };
+    buf_desc.name = L"My destination buffer";
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> dst_buf{ buffer_ptr };
+
+    // The upload of the initial data must be submitted, or the copy stays on the main queue.
+    REQUIRE(Succeeded(dev->SubmitPendingCommands()));
+    REQUIRE(Succeeded(dev->CopyBuffer(*src_buf, *dst_buf)));
+
+    // Only the beginning of the buffer is processed by the shader.
+    constexpr size_t kProcessedElementCount = 1024;
+    REQUIRE(Succeeded(dev->BindRWBuffer(0, dst_buf.get(), Range{0, kProcessedElementCount * sizeof(float)})));
+    REQUIRE(Succeeded(dev->DispatchComputeShader(*typed_shader, { uint32_t(kProcessedElementCount), 1, 1 })));
+    dev->ResetAllBindings();
+    REQUIRE(Succeeded(dev->SubmitPendingCommands()));
+
+    std::vector<float> dst_data(kElementCount);
+    ReadbackTicket ticket;
+    REQUIRE(Succeeded(dev->ReadBufferToMemoryAsync(*dst_buf, kFullRange, dst_data.data(), ticket)));
+    REQUIRE(Succeeded(dev->WaitForReadback(ticket)));
+    for(size_t i = 0; i < kElementCount; ++i)
+    {
+        if(i < kProcessedElementCount)
+            CHECK(dst_data[i] == src_data[i] * src_data[i] + 1.f);
+        else
+            CHECK(dst_data[i] == src_data[i]);
+    }
+}
+
+// Buffers don't fit in the budget together, so each copy makes its source resident and evicts others.
+TEST_CASE("Device with kDeviceFlagEnableResidencyManagement", "[gpu][buffer]")
+{
+    constexpr size_t kBufferCount = 4;
+    constexpr size_t kElementCount = 256 * 1024;
+    constexpr size_t kBufferSize = kElementCount * sizeof(uint32_t);
+
+    DeviceDesc device_desc{};
+    device_desc.name = L"My device with residency management";
+    device_desc.flags = kDeviceFlagEnableResidencyManagement;
+    device_desc.residency_budget = 2 * kBufferSize;
+    Device* device_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, device_ptr)));
+    std::unique_ptr<Device> dev{ device_ptr };
+
+    std::vector<std::vector<uint32_t>> src_data(kBufferCount);
+    std::vector<std::unique_ptr<Buffer>> bufs(kBufferCount);
+    for(size_t buf_index = 0; buf_index < kBufferCount; ++buf_index)
+    {
+        src_data[buf_index].resize(kElementCount);
+        for(size_t i = 0; i < kElementCount; ++i)
+            src_data[buf_index][i] = uint32_t(buf_index * kElementCount + i);
+
+        BufferDesc buf_desc{};
+        buf_desc.name = L"My evictable buffer";
+        buf_desc.flags = kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst | kBufferFlagDedicatedMemory;
+        buf_desc.size = kBufferSize;
+        Buffer* buffer_ptr = nullptr;
+        REQUIRE(Succeeded(dev->CreateBufferFromMemory(buf_desc,
+            ConstDataSpan{src_data[buf_index].data(), kBufferSize}, buffer_ptr)));
+        bufs[buf_index].reset(buffer_ptr);
+    }
+    REQUIRE(Succeeded(dev->WaitForGPU()));
+
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.name = L"My buffer READBACK";
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = kBufferSize;
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf{ buffer_ptr };
+
+    std::vector<uint32_t> dst_data(kElementCount);
+    for(uint32_t pass = 0; pass < 2; ++pass)
+    {
+        for(size_t buf_index = 0; buf_index < kBufferCount; ++buf_index)
+        {
+            REQUIRE(Succeeded(dev->CopyBuffer(*bufs[buf_index], *readback_buf)));
+            REQUIRE(Succeeded(dev->ReadBufferToMemory(*readback_buf, kFullRange, dst_data.data())));
+            CHECK(dst_data == src_data[buf_index]);
+        }
+    }
+
+    DeviceStatistics stats{};
+    REQUIRE(Succeeded(dev->GetStatistics(stats)));
+    CHECK(stats.buffer_eviction_count > 0);
+    CHECK(stats.buffer_make_resident_count > 0);
+    CHECK(stats.evicted_buffer_bytes <= (kBufferCount - 1) * kBufferSize);
+}
+
+// Submit several batches back-to-back, so that recording overlaps with execution of the previous ones.
+TEST_CASE("Multiple submitted command batches", "[gpu][buffer][clear]")
+{
+    constexpr uint32_t kBatchCount = 5;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer Byte address";
+    buf_desc.flags = kBufferUsageFlagCopySrc | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress;
+    buf_desc.size = kBatchCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    for(uint32_t i = 0; i < kBatchCount; ++i)
+    {
+        REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{i + 100, 0, 0, 0}, Range{i, 1})));
+        REQUIRE(Succeeded(g_dev->SubmitPendingCommands()));
+    }
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::array<uint32_t, kBatchCount> dst_data;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer,
+        Range{0, buf_desc.size}, dst_data.data())));
+    for(uint32_t i = 0; i < kBatchCount; ++i)
+        CHECK(dst_data[i] == i + 100);
+}
+
+// Accessing a buffer waits only for the batch that last used it, not for the batches submitted after it.
+TEST_CASE("Buffer access waits only for its batch", "[gpu][buffer][clear]")
+{
+    constexpr size_t kSmallSize = 4 * kKilobyte;
+    constexpr size_t kBigSize = 32 * kMegabyte;
+    BufferDesc buf_desc{};
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    BufferDesc readback_buf_desc{};
+    readback_buf_desc.flags = kBufferUsageFlagCopyDst | kBufferUsageFlagCpuRead;
+    readback_buf_desc.size = kSmallSize;
+
+    Buffer* buffer_ptr = nullptr;
+    buf_desc.name = L"My small buffer";
+    buf_desc.size = kSmallSize;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> small_buf{ buffer_ptr };
+    buf_desc.name = L"My big buffer";
+    buf_desc.size = kBigSize;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> big_buf{ buffer_ptr };
+    readback_buf_desc.name = L"My readback buffer 1";
+    REQUIRE(Succeeded(g_dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf1{ buffer_ptr };
+    readback_buf_desc.name = L"My readback buffer 2";
+    REQUIRE(Succeeded(g_dev->CreateBuffer(readback_buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> readback_buf2{ buffer_ptr };
+
+    std::vector<uint32_t> dst_data(kSmallSize / sizeof(uint32_t));
+
+    // Batch 1, waited for by the first read.
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*small_buf, UintVec4{111, 0, 0, 0})));
+    REQUIRE(Succeeded(g_dev->CopyBuffer(*small_buf, *readback_buf1)));
+    REQUIRE(Succeeded(g_dev->SubmitPendingCommands()));
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*readback_buf1, kFullRange, dst_data.data())));
+    CHECK(dst_data == std::vector<uint32_t>(dst_data.size(), 111));
+
+    // Batch 2, made long enough to be still executing when the reads below are done.
+    constexpr uint32_t kClearCount = 8;
+    for(uint32_t i = 0; i < kClearCount; ++i)
+        REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*big_buf, UintVec4{i, 0, 0, 0})));
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*big_buf, Range{0, kSmallSize}, *readback_buf2, 0)));
+    REQUIRE(Succeeded(g_dev->SubmitPendingCommands()));
+
+    DeviceStatistics stats_before{};
+    REQUIRE(Succeeded(g_dev->GetStatistics(stats_before)));
+
+    // Batch 1 has completed, so this doesn't need to wait, whether batch 2 is still executing or not.
+    std::fill(dst_data.begin(), dst_data.end(), 0);
+    CHECK(g_dev->ReadBufferToMemory(*readback_buf1, kFullRange, dst_data.data(), kCommandFlagDontWait)
+        == kSuccess);
+    CHECK(dst_data == std::vector<uint32_t>(dst_data.size(), 111));
+
+    // Batch 2 wrote this buffer, so reading it still waits for that batch.
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*readback_buf2, kFullRange, dst_data.data())));
+    CHECK(dst_data == std::vector<uint32_t>(dst_data.size(), kClearCount - 1));
+
+    DeviceStatistics stats{};
+    REQUIRE(Succeeded(g_dev->GetStatistics(stats)));
+    CHECK(stats.wait_for_idle_count == stats_before.wait_for_idle_count);
+}
+
+// With kDeviceFlagEnableProfiling, GPU timestamps are recorded around every command.
+TEST_CASE("GPU profiling", "[gpu][buffer][clear]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"Device with profiling";
+    device_desc.flags = kDeviceFlagEnableProfiling;
+    Device* dev_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, dev_ptr)));
+    std::unique_ptr<Device> dev{dev_ptr};
+
+    ShaderCompilationParams compilation_params{};
+    compilation_params.entry_point = L"Main_Typed";
+    ShaderDesc shader_desc{};
+    shader_desc.name = L"Profiled shader";
+    Shader* shader_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CompileAndCreateShaderFromFile(compilation_params, shader_desc,
+        L"shaders/Test.hlsl", shader_ptr)));
+    std::unique_ptr<Shader> shader{shader_ptr};
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"Profiled buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferUsageFlagCopyDst
+        | kBufferFlagTyped;
+    buf_desc.element_format = Format::kR32_Uint;
+    buf_desc.size = 1024 * sizeof(uint32_t);
+    Buffer* buf_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buf_ptr)));
+    std::unique_ptr<Buffer> buf{buf_ptr};
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buf_ptr)));
+    std::unique_ptr<Buffer> buf2{buf_ptr};
+
+    REQUIRE(Succeeded(dev->ClearBufferToUintValues(*buf, UintVec4{1, 1, 1, 1})));
+    REQUIRE(Succeeded(dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *buf2, 0)));
+    REQUIRE(Succeeded(dev->DispatchComputeShader(*shader, UintVec3{4, 2, 1})));
+    REQUIRE(Succeeded(dev->WaitForGPU()));
+
+    const ArraySpan<const ProfiledCommand> commands = dev->GetProfiledCommands();
+    REQUIRE(commands.count == 3);
+    CHECK(std::wstring{commands.data[0].label} == L"ClearBufferToUintValues");
+    CHECK(commands.data[0].shader_name == nullptr);
+    CHECK(std::wstring{commands.data[1].label} == L"CopyBufferRegion");
+    CHECK(std::wstring{commands.data[2].label} == L"DispatchComputeShader");
+    REQUIRE(commands.data[2].shader_name != nullptr);
+    CHECK(std::wstring{commands.data[2].shader_name} == L"Profiled shader");
+    CHECK(commands.data[2].group_count == UintVec3{4, 2, 1});
+    for(size_t i = 0; i < commands.count; ++i)
+    {
+        CHECK(commands.data[i].gpu_begin_microseconds >= 0.0);
+        CHECK(commands.data[i].gpu_duration_microseconds >= 0.0);
+    }
+
+    const std::filesystem::path trace_path = std::filesystem::temp_directory_path() / L"jd3d12_test_trace.json";
+    CHECK(Succeeded(dev->SaveProfilingTrace(trace_path.c_str())));
+    std::error_code error_code;
+    CHECK(std::filesystem::file_size(trace_path, error_code) > 0);
+    std::filesystem::remove(trace_path, error_code);
+
+    dev->ClearProfiledCommands();
+    CHECK(dev->GetProfiledCommands().count == 0);
+}
+
+TEST_CASE("Regions", "[gpu][buffer][clear]")
+{
+    DeviceDesc device_desc{};
+    device_desc.name = L"Device with profiling";
+    device_desc.flags = kDeviceFlagEnableProfiling;
+    Device* dev_ptr = nullptr;
+    REQUIRE(Succeeded(g_env->CreateDevice(device_desc, dev_ptr)));
+    std::unique_ptr<Device> dev{dev_ptr};
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"Buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferFlagTyped;
+    buf_desc.element_format = Format::kR32_Uint;
+    buf_desc.size = 1024 * sizeof(uint32_t);
+    Buffer* buf_ptr = nullptr;
+    REQUIRE(Succeeded(dev->CreateBuffer(buf_desc, buf_ptr)));
+    std::unique_ptr<Buffer> buf{buf_ptr};
+
+    REQUIRE(Succeeded(dev->BeginRegion(L"Outer")));
+    REQUIRE(Succeeded(dev->ClearBufferToUintValues(*buf, UintVec4{1, 1, 1, 1})));
+    {
+        ScopedRegion inner_region{*dev, L"Inner"};
+        REQUIRE(Succeeded(dev->ClearBufferToUintValues(*buf, UintVec4{2, 2, 2, 2})));
+    }
+    REQUIRE(Succeeded(dev->EndRegion()));
+    REQUIRE(Succeeded(dev->WaitForGPU()));
+
+    const ArraySpan<const ProfiledCommand> commands = dev->GetProfiledCommands();
+    REQUIRE(commands.count == 4);
+    CHECK(std::wstring{commands.data[0].label} == L"Outer");
+    CHECK(commands.data[0].is_region);
+    CHECK(commands.data[0].depth == 0);
+    CHECK(!commands.data[1].is_region);
+    CHECK(commands.data[1].depth == 1);
+    CHECK(std::wstring{commands.data[2].label} == L"Inner");
+    CHECK(commands.data[2].is_region);
+    CHECK(commands.data[2].depth == 1);
+    CHECK(!commands.data[3].is_region);
+    CHECK(commands.data[3].depth == 2);
+    CHECK(commands.data[0].gpu_duration_microseconds >= commands.data[2].gpu_duration_microseconds);
+}
+
+TEST_CASE("ReadBufferToMemoryAsync", "[gpu][buffer]")
+{
+    constexpr size_t kElementCount = 64;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer Byte address";
+    buf_desc.flags = kBufferUsageFlagCopySrc | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress;
+    buf_desc.size = kElementCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{111, 0, 0, 0})));
+    std::array<uint32_t, kElementCount> dst_data_1 = {};
+    ReadbackTicket ticket_1;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemoryAsync(*buf, kFullRange, dst_data_1.data(), ticket_1)));
+    CHECK(!ticket_1.IsEmpty());
+
+    // Dispatching more work doesn't affect the data already requested.
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{222, 0, 0, 0})));
+    std::array<uint32_t, 4> dst_data_2 = {};
+    ReadbackTicket ticket_2;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemoryAsync(*buf, Range{16, sizeof(dst_data_2)},
+        dst_data_2.data(), ticket_2)));
+
+    REQUIRE(Succeeded(g_dev->WaitForReadback(ticket_2)));
+    CHECK(ticket_2.IsEmpty());
+    CHECK(g_dev->IsReadbackComplete(ticket_1));
+    REQUIRE(g_dev->TryGetReadback(ticket_1) == kSuccess);
+    CHECK(ticket_1.IsEmpty());
+
+    for(size_t i = 0; i < kElementCount; ++i)
+        CHECK(dst_data_1[i] == 111);
+    for(size_t i = 0; i < dst_data_2.size(); ++i)
+        CHECK(dst_data_2[i] == 222);
+}
+
+// A buffer read directly must not be written again before the read completes.
+TEST_CASE("ReadBufferToMemoryAsync with a buffer written again", "[gpu][buffer]")
+{
+    constexpr size_t kElementCount = 64;
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My buffer Byte address";
+    buf_desc.flags = kBufferUsageFlagCopySrc | kBufferUsageFlagShaderRWResource | kBufferFlagByteAddress;
+    buf_desc.size = kElementCount * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{111, 0, 0, 0})));
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    std::array<uint32_t, kElementCount> dst_data = {};
+    ReadbackTicket ticket;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemoryAsync(*g_main_readback_buffer, Range{0, buf_desc.size},
+        dst_data.data(), ticket)));
+
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{0, buf_desc.size}, *g_main_readback_buffer, 0)));
+    CHECK(g_dev->WaitForReadback(ticket) == kErrorChangedState);
+    CHECK(ticket.IsEmpty());
+    CHECK(dst_data[0] == 0);
+}
+
+TEST_CASE("Transient buffers", "[gpu][buffer][clear]")
+{
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My transient buffer";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagTyped;
+    buf_desc.size = 100 * sizeof(uint32_t);
+    buf_desc.element_format = Format::kR32_Uint;
+    const Range result_range = Range{0, buf_desc.size};
+
+    SECTION("Pooled")
+    {
+        Buffer* buf = nullptr;
+        REQUIRE(Succeeded(g_dev->AcquireTransientBuffer(buf_desc, buf)));
+        REQUIRE(buf != nullptr);
+        CHECK(buf->GetSize() >= buf_desc.size);
+        REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{1, 0, 0, 0})));
+        REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, result_range, *g_main_readback_buffer, 0)));
+        g_dev->ReleaseTransientBuffer(buf);
+
+        // The buffer is reused once the GPU is done with it.
+        REQUIRE(Succeeded(g_dev->WaitForGPU()));
+        Buffer* reused_buf = nullptr;
+        REQUIRE(Succeeded(g_dev->AcquireTransientBuffer(buf_desc, reused_buf)));
+        CHECK(reused_buf == buf);
+
+        // A buffer with different flags is not.
+        BufferDesc other_desc = buf_desc;
+        other_desc.flags |= kBufferUsageFlagCopyDst;
+        Buffer* other_buf = nullptr;
+        REQUIRE(Succeeded(g_dev->AcquireTransientBuffer(other_desc, other_buf)));
+        CHECK(other_buf != reused_buf);
+
+        g_dev->ReleaseTransientBuffer(other_buf);
+        g_dev->ReleaseTransientBuffer(reused_buf);
+
+        std::vector<uint32_t> dst_data(100);
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer, result_range, dst_data.data())));
+        for(size_t i = 0; i < dst_data.size(); ++i)
+            CHECK(dst_data[i] == 1);
+    }
+    SECTION("Aliased")
+    {
+        buf_desc.flags |= kBufferFlagAliasedMemory;
+
+        // Both buffers are used in the same batch, one after the other, in the same memory.
+        Buffer* buf = nullptr;
+        REQUIRE(Succeeded(g_dev->AcquireTransientBuffer(buf_desc, buf)));
+        REQUIRE(buf != nullptr);
+        CHECK(buf->GetSize() == buf_desc.size);
+        REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{1, 0, 0, 0})));
+        REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, result_range, *g_main_readback_buffer, 0)));
+        g_dev->ReleaseTransientBuffer(buf);
+
+        REQUIRE(Succeeded(g_dev->AcquireTransientBuffer(buf_desc, buf)));
+        REQUIRE(Succeeded(g_dev->ClearBufferToUintValues(*buf, UintVec4{2, 0, 0, 0})));
+        REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, result_range, *g_main_readback_buffer, buf_desc.size)));
+        g_dev->ReleaseTransientBuffer(buf);
+
+        std::vector<uint32_t> dst_data(200);
+        REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer, Range{0, buf_desc.size * 2},
+            dst_data.data())));
+        for(size_t i = 0; i < dst_data.size(); ++i)
+            CHECK(dst_data[i] == (i < 100 ? 1 : 2));
+    }
+}
+
 TEST_CASE("Shader compilation params", "[gpu][buffer][hlsl]")
 {
     std::unique_ptr<Shader> shader;
@@ -870,6 +2278,164 @@ TEST_CASE("Shader compilation params", "[gpu][buffer][hlsl]")
     CHECK(memcmp(dst_data.data(), expected_data.data(), default_buf_desc.size) == 0);
 }
 
+TEST_CASE("Shader batch compilation", "[gpu][hlsl]")
+{
+    const wchar_t* entry_points[] = { L"Main_Typed", L"Main_Structured", L"Main_ByteAddress", L"InvalidEntryPoint" };
+    constexpr size_t kItemCount = _countof(entry_points);
+
+    std::array<ShaderBatchItem, kItemCount> items;
+    for(size_t i = 0; i < kItemCount; ++i)
+    {
+        items[i].compilation_params.entry_point = entry_points[i];
+        items[i].desc.name = entry_points[i];
+        items[i].hlsl_source_file_path = L"shaders/Test.hlsl";
+    }
+
+    const Result res = g_dev->CompileAndCreateShadersBatch(ArraySpan<ShaderBatchItem>{ items.data(), kItemCount }, 4);
+    CHECK(Failed(res));
+    CHECK(res == items[3].result);
+
+    std::array<std::unique_ptr<Shader>, kItemCount> shaders;
+    std::array<std::unique_ptr<ShaderCompilationResult>, kItemCount> compilation_results;
+    for(size_t i = 0; i < kItemCount; ++i)
+    {
+        shaders[i].reset(items[i].shader);
+        compilation_results[i].reset(items[i].compilation_result);
+        REQUIRE(compilation_results[i] != nullptr);
+    }
+
+    for(size_t i = 0; i < 3; ++i)
+    {
+        CHECK(Succeeded(items[i].result));
+        REQUIRE(shaders[i] != nullptr);
+        CHECK(shaders[i]->GetThreadGroupSize() == UintVec3{1, 1, 1});
+    }
+    CHECK(shaders[3] == nullptr);
+    CHECK_THAT(compilation_results[3]->GetErrorsAndWarnings(),
+        Catch::Matchers::ContainsSubstring("error: missing entry point definition"));
+}
+
+TEST_CASE("Shader family", "[gpu][hlsl]")
+{
+    const char* const hlsl_source =
+        "RWByteAddressBuffer output : register(u0);\n"
+        "[numthreads(GROUP_SIZE, 1, 1)]\n"
+        "void Main(uint3 id : SV_DispatchThreadID)\n"
+        "{\n"
+        "#ifdef DOUBLE_VALUE\n"
+        "    output.Store(id.x * 4, id.x * 2);\n"
+        "#else\n"
+        "    output.Store(id.x * 4, id.x);\n"
+        "#endif\n"
+        "}\n";
+
+    const wchar_t* group_sizes[] = { L"32", L"64", L"128" };
+    ShaderPermutationAxis axes[3];
+    axes[0].macro_name = L"GROUP_SIZE";
+    axes[0].values = { group_sizes, _countof(group_sizes) };
+    axes[1].macro_name = L"DOUBLE_VALUE";
+    // Not referenced by the source, so it doesn't change the bytecode.
+    axes[2].macro_name = L"UNUSED_TOGGLE";
+
+    ShaderFamilyDesc family_desc{};
+    family_desc.name = L"My shader family";
+    family_desc.compilation_params.entry_point = L"Main";
+    family_desc.hlsl_source = { hlsl_source, strlen(hlsl_source) };
+    family_desc.axes = { axes, _countof(axes) };
+
+    ShaderFamily* family_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateShaderFamily(family_desc, family_ptr)));
+    std::unique_ptr<ShaderFamily> family{ family_ptr };
+    CHECK(family->GetAxisCount() == 3);
+    CHECK(family->GetPermutationCount() == 12);
+    CHECK(family->GetVariantCount() == 0);
+
+    Shader* shader = nullptr;
+    const uint32_t indices_64[] = { 1, 0, 0 };
+    REQUIRE(Succeeded(family->GetShader({ indices_64, 3 }, shader)));
+    REQUIRE(shader != nullptr);
+    CHECK(shader->GetThreadGroupSize() == UintVec3{64, 1, 1});
+    CHECK(family->GetVariantCount() == 1);
+
+    Shader* same_shader = nullptr;
+    REQUIRE(Succeeded(family->GetShader({ indices_64, 3 }, same_shader)));
+    CHECK(same_shader == shader);
+
+    const uint32_t indices_64_unused[] = { 1, 0, 1 };
+    REQUIRE(Succeeded(family->GetShader({ indices_64_unused, 3 }, same_shader)));
+    CHECK(same_shader == shader);
+    CHECK(family->GetVariantCount() == 2);
+    CHECK(family->GetUniqueShaderCount() == 1);
+
+    // Variants with DOUBLE_VALUE for all the group sizes.
+    const uint32_t prewarm_indices[] = { 0, 1, 0, 1, 1, 0, 2, 1, 0 };
+    REQUIRE(Succeeded(family->Prewarm({ prewarm_indices, _countof(prewarm_indices) }, 2)));
+    CHECK(Succeeded(family->WaitForPrewarm()));
+    CHECK(family->GetVariantCount() == 5);
+    CHECK(family->GetUniqueShaderCount() == 4);
+
+    const uint32_t indices_128_double[] = { 2, 1, 0 };
+    REQUIRE(Succeeded(family->GetShader({ indices_128_double, 3 }, shader)));
+    CHECK(shader->GetThreadGroupSize() == UintVec3{128, 1, 1});
+    CHECK(family->GetVariantCount() == 5);
+
+    BufferDesc buf_desc{};
+    buf_desc.name = L"My shader family output";
+    buf_desc.flags = kBufferUsageFlagShaderRWResource | kBufferUsageFlagCopySrc | kBufferFlagByteAddress;
+    buf_desc.size = 128 * sizeof(uint32_t);
+    Buffer* buffer_ptr = nullptr;
+    REQUIRE(Succeeded(g_dev->CreateBuffer(buf_desc, buffer_ptr)));
+    std::unique_ptr<Buffer> buf{ buffer_ptr };
+
+    REQUIRE(Succeeded(g_dev->BindRWBuffer(0, buf.get())));
+    REQUIRE(Succeeded(g_dev->DispatchComputeShader(*shader, { 1, 1, 1 })));
+    g_dev->ResetAllBindings();
+    REQUIRE(Succeeded(g_dev->CopyBufferRegion(*buf, Range{ 0, buf_desc.size }, *g_main_readback_buffer, 0)));
+
+    std::array<uint32_t, 128> dst_data;
+    REQUIRE(Succeeded(g_dev->ReadBufferToMemory(*g_main_readback_buffer, Range{ 0, buf_desc.size },
+        dst_data.data())));
+    for(uint32_t i = 0; i < 128; ++i)
+        CHECK(dst_data[i] == i * 2);
+}
+
+TEST_CASE("Pipeline library", "[gpu][hlsl]")
+{
+    const std::filesystem::path library_path =
+        std::filesystem::temp_directory_path() / L"jd3d12_test_pipeline_library.bin";
+    std::error_code error_code;
+    std::filesystem::remove(library_path, error_code);
+
+    DeviceDesc device_desc{};
+    device_desc.name = L"Device with pipeline library";
+    device_desc.pipeline_library_file_path = library_path.c_str();
+
+    ShaderCompilationParams compilation_params{};
+    compilation_params.entry_point = L"Main_Typed";
+    ShaderDesc shader_desc{};
+    shader_desc.name = L"Main_Typed shader";
+
+    for(uint32_t run = 0; run < 2; ++run)
+    {
+        Device* dev_ptr = nullptr;
+        REQUIRE(Succeeded(g_env->CreateDevice(device_desc, dev_ptr)));
+        std::unique_ptr<Device> dev{dev_ptr};
+
+        Shader* shader_ptr = nullptr;
+        REQUIRE(Succeeded(dev->CompileAndCreateShaderFromFile(compilation_params, shader_desc,
+            L"shaders/Test.hlsl", shader_ptr)));
+        std::unique_ptr<Shader> shader{shader_ptr};
+        CHECK(shader->GetThreadGroupSize() == UintVec3{1, 1, 1});
+
+        shader.reset();
+        dev.reset();
+        // Saved when the device is destroyed.
+        CHECK(std::filesystem::file_size(library_path, error_code) > 0);
+    }
+
+    std::filesystem::remove(library_path, error_code);
+}
+
 TEST_CASE("Shader source include", "[hlsl]")
 {
     ShaderCompilationParams params{};